@@ -0,0 +1,249 @@
+#include "ahrs.h"
+#include "fastmath.h"
+#include <math.h>
+#include <string.h>
+
+#define DEG_TO_RAD  0.017453292519943295f
+#define RAD_TO_DEG  57.29577951308232f
+
+void ahrs_init(ahrs_t *f, float beta, float accel_gate) {
+    memset(f, 0, sizeof(*f));
+    f->q[0] = 1.0f;
+    f->beta = beta;
+    f->accel_gate = accel_gate;
+}
+
+static void normalize3(float v[3]) {
+    float n = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    if (n > 0.0f) {
+        float r = 1.0f / n;
+        v[0] *= r;
+        v[1] *= r;
+        v[2] *= r;
+    }
+}
+
+static void cross3(const float a[3], const float b[3], float out[3]) {
+    out[0] = a[1] * b[2] - a[2] * b[1];
+    out[1] = a[2] * b[0] - a[0] * b[2];
+    out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+// Rows of the device -> earth rotation are north, west and up in device
+// axes: up from gravity, north from the horizontal part of the field
+// (device x when there is none)
+static void align(ahrs_t *f, const float acc[3], const float *mag) {
+    float up[3] = { acc[0], acc[1], acc[2] };
+    normalize3(up);
+
+    float ref[3] = { 1.0f, 0.0f, 0.0f };
+    if (mag) memcpy(ref, mag, sizeof(ref));
+
+    float west[3], north[3];
+    cross3(up, ref, west);
+    if (west[0] * west[0] + west[1] * west[1] + west[2] * west[2] < 1e-6f) {
+        const float alt[3] = { 0.0f, 1.0f, 0.0f };
+        cross3(up, alt, west);
+    }
+    normalize3(west);
+    cross3(west, up, north);
+
+    const float r[3][3] = {
+        { north[0], north[1], north[2] },
+        { west[0], west[1], west[2] },
+        { up[0], up[1], up[2] },
+    };
+    float *q = f->q;
+    float tr = r[0][0] + r[1][1] + r[2][2];
+    if (tr > 0.0f) {
+        float s = sqrtf(tr + 1.0f) * 2.0f;
+        q[0] = 0.25f * s;
+        q[1] = (r[2][1] - r[1][2]) / s;
+        q[2] = (r[0][2] - r[2][0]) / s;
+        q[3] = (r[1][0] - r[0][1]) / s;
+    } else if (r[0][0] > r[1][1] && r[0][0] > r[2][2]) {
+        float s = sqrtf(1.0f + r[0][0] - r[1][1] - r[2][2]) * 2.0f;
+        q[0] = (r[2][1] - r[1][2]) / s;
+        q[1] = 0.25f * s;
+        q[2] = (r[0][1] + r[1][0]) / s;
+        q[3] = (r[0][2] + r[2][0]) / s;
+    } else if (r[1][1] > r[2][2]) {
+        float s = sqrtf(1.0f + r[1][1] - r[0][0] - r[2][2]) * 2.0f;
+        q[0] = (r[0][2] - r[2][0]) / s;
+        q[1] = (r[0][1] + r[1][0]) / s;
+        q[2] = 0.25f * s;
+        q[3] = (r[1][2] + r[2][1]) / s;
+    } else {
+        float s = sqrtf(1.0f + r[2][2] - r[0][0] - r[1][1]) * 2.0f;
+        q[0] = (r[1][0] - r[0][1]) / s;
+        q[1] = (r[0][2] + r[2][0]) / s;
+        q[2] = (r[1][2] + r[2][1]) / s;
+        q[3] = 0.25f * s;
+    }
+    f->initialized = true;
+}
+
+// Gradient of the accel-only objective function (Madgwick 2010, eq. 25)
+static void gradient_imu(const float q[4], const float a[3], float s[4]) {
+    float q0 = q[0], q1 = q[1], q2 = q[2], q3 = q[3];
+    float _2q0 = 2.0f * q0, _2q1 = 2.0f * q1, _2q2 = 2.0f * q2, _2q3 = 2.0f * q3;
+    float _4q0 = 4.0f * q0, _4q1 = 4.0f * q1, _4q2 = 4.0f * q2;
+    float _8q1 = 8.0f * q1, _8q2 = 8.0f * q2;
+    float q0q0 = q0 * q0, q1q1 = q1 * q1, q2q2 = q2 * q2, q3q3 = q3 * q3;
+
+    s[0] = _4q0 * q2q2 + _2q2 * a[0] + _4q0 * q1q1 - _2q1 * a[1];
+    s[1] = _4q1 * q3q3 - _2q3 * a[0] + 4.0f * q0q0 * q1 - _2q0 * a[1] - _4q1 + _8q1 * q1q1 + _8q1 * q2q2 + _4q1 * a[2];
+    s[2] = 4.0f * q0q0 * q2 + _2q0 * a[0] + _4q2 * q3q3 - _2q3 * a[1] - _4q2 + _8q2 * q1q1 + _8q2 * q2q2 + _4q2 * a[2];
+    s[3] = 4.0f * q1q1 * q3 - _2q1 * a[0] + 4.0f * q2q2 * q3 - _2q2 * a[1];
+}
+
+// Gradient with the magnetic reference (Madgwick 2010, eq. 34), the field
+// reduced to its north and vertical components in the earth frame
+static void gradient_marg(const float q[4], const float a[3], const float m[3], float s[4]) {
+    float q0 = q[0], q1 = q[1], q2 = q[2], q3 = q[3];
+    float ax = a[0], ay = a[1], az = a[2];
+    float mx = m[0], my = m[1], mz = m[2];
+
+    float _2q0mx = 2.0f * q0 * mx, _2q0my = 2.0f * q0 * my, _2q0mz = 2.0f * q0 * mz;
+    float _2q1mx = 2.0f * q1 * mx;
+    float _2q0 = 2.0f * q0, _2q1 = 2.0f * q1, _2q2 = 2.0f * q2, _2q3 = 2.0f * q3;
+    float _2q0q2 = 2.0f * q0 * q2, _2q2q3 = 2.0f * q2 * q3;
+    float q0q0 = q0 * q0, q0q1 = q0 * q1, q0q2 = q0 * q2, q0q3 = q0 * q3;
+    float q1q1 = q1 * q1, q1q2 = q1 * q2, q1q3 = q1 * q3;
+    float q2q2 = q2 * q2, q2q3 = q2 * q3, q3q3 = q3 * q3;
+
+    float hx = mx * q0q0 - _2q0my * q3 + _2q0mz * q2 + mx * q1q1 + _2q1 * my * q2 + _2q1 * mz * q3 - mx * q2q2 - mx * q3q3;
+    float hy = _2q0mx * q3 + my * q0q0 - _2q0mz * q1 + _2q1mx * q2 - my * q1q1 + my * q2q2 + _2q2 * mz * q3 - my * q3q3;
+    float _2bx = sqrtf(hx * hx + hy * hy);
+    float _2bz = -_2q0mx * q2 + _2q0my * q1 + mz * q0q0 + _2q1mx * q3 - mz * q1q1 + _2q2 * my * q3 - mz * q2q2 + mz * q3q3;
+    float _4bx = 2.0f * _2bx, _4bz = 2.0f * _2bz;
+
+    // Residuals of the predicted vs. measured gravity and field
+    float fa_x = 2.0f * q1q3 - _2q0q2 - ax;
+    float fa_y = 2.0f * q0q1 + _2q2q3 - ay;
+    float fa_z = 1.0f - 2.0f * q1q1 - 2.0f * q2q2 - az;
+    float fm_x = _2bx * (0.5f - q2q2 - q3q3) + _2bz * (q1q3 - q0q2) - mx;
+    float fm_y = _2bx * (q1q2 - q0q3) + _2bz * (q0q1 + q2q3) - my;
+    float fm_z = _2bx * (q0q2 + q1q3) + _2bz * (0.5f - q1q1 - q2q2) - mz;
+
+    s[0] = -_2q2 * fa_x + _2q1 * fa_y - _2bz * q2 * fm_x + (-_2bx * q3 + _2bz * q1) * fm_y + _2bx * q2 * fm_z;
+    s[1] = _2q3 * fa_x + _2q0 * fa_y - 2.0f * _2q1 * fa_z + _2bz * q3 * fm_x + (_2bx * q2 + _2bz * q0) * fm_y +
+           (_2bx * q3 - _4bz * q1) * fm_z;
+    s[2] = -_2q0 * fa_x + _2q3 * fa_y - 2.0f * _2q2 * fa_z + (-_4bx * q2 - _2bz * q0) * fm_x +
+           (_2bx * q1 + _2bz * q3) * fm_y + (_2bx * q0 - _4bz * q2) * fm_z;
+    s[3] = _2q1 * fa_x + _2q2 * fa_y + (-_4bx * q3 + _2bz * q1) * fm_x + (-_2bx * q0 + _2bz * q2) * fm_y +
+           _2bx * q1 * fm_z;
+}
+
+void ahrs_update(ahrs_t *f, const float gyro[3], const float acc[3], const float *mag, float dt) {
+    float a[3] = { acc[0], acc[1], acc[2] };
+    float a_norm = sqrtf(a[0] * a[0] + a[1] * a[1] + a[2] * a[2]);
+    float m[3];
+    bool use_mag = mag && (mag[0] != 0.0f || mag[1] != 0.0f || mag[2] != 0.0f);
+    if (use_mag) {
+        memcpy(m, mag, sizeof(m));
+        normalize3(m);
+    }
+
+    if (!f->initialized) {
+        if (a_norm == 0.0f) return;
+        align(f, a, use_mag ? m : NULL);
+        return;
+    }
+
+    float *q = f->q;
+    float gx = gyro[0], gy = gyro[1], gz = gyro[2];
+    float qdot[4] = {
+        0.5f * (-q[1] * gx - q[2] * gy - q[3] * gz),
+        0.5f * (q[0] * gx + q[2] * gz - q[3] * gy),
+        0.5f * (q[0] * gy - q[1] * gz + q[3] * gx),
+        0.5f * (q[0] * gz + q[1] * gy - q[2] * gx),
+    };
+
+    // Sustained cornering or braking tilts the measured "gravity": leave
+    // those stretches to the gyro alone
+    bool trust_accel = a_norm > 0.0f && (f->accel_gate <= 0.0f || fabsf(a_norm - 1.0f) <= f->accel_gate);
+    if (trust_accel) {
+        float r = 1.0f / a_norm;
+        a[0] *= r;
+        a[1] *= r;
+        a[2] *= r;
+
+        float s[4];
+        if (use_mag) gradient_marg(q, a, m, s);
+        else gradient_imu(q, a, s);
+
+        float s_norm = sqrtf(s[0] * s[0] + s[1] * s[1] + s[2] * s[2] + s[3] * s[3]);
+        if (s_norm > 0.0f) {
+            float k = f->beta / s_norm;
+            for (int i = 0; i < 4; i++) qdot[i] -= k * s[i];
+        }
+    } else {
+        f->gated++;
+    }
+
+    for (int i = 0; i < 4; i++) q[i] += qdot[i] * dt;
+    float r = 1.0f / sqrtf(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    for (int i = 0; i < 4; i++) q[i] *= r;
+}
+
+void ahrs_update_block(ahrs_t *f, const imu_sample_t *s, size_t n, const mag_sample_t *mag,
+                       attitude_sample_t *out) {
+    float m[3];
+    if (mag) {
+        m[0] = mag->mx;
+        m[1] = mag->my;
+        m[2] = mag->mz;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        const float gyro[3] = { s[i].gx * DEG_TO_RAD, s[i].gy * DEG_TO_RAD, s[i].gz * DEG_TO_RAD };
+        const float acc[3] = { s[i].ax, s[i].ay, s[i].az };
+
+        float dt = f->last_us ? (s[i].t_us - f->last_us) * 1e-6f : 0.0f;
+        if (dt < 0.0f || dt > AHRS_MAX_DT_S) dt = 0.0f;
+        f->last_us = s[i].t_us;
+
+        ahrs_update(f, gyro, acc, mag ? m : NULL, dt);
+
+        if (out) {
+            attitude_sample_t *o = &out[i];
+            o->t_us = s[i].t_us;
+            memcpy(o->q, f->q, sizeof(o->q));
+            ahrs_linear_accel(f->q, acc, o->lin_body, o->lin_earth);
+            o->heading = ahrs_heading(f->q);
+        }
+    }
+}
+
+void ahrs_gravity(const float q[4], float g_body[3]) {
+    g_body[0] = 2.0f * (q[1] * q[3] - q[0] * q[2]);
+    g_body[1] = 2.0f * (q[0] * q[1] + q[2] * q[3]);
+    g_body[2] = q[0] * q[0] - q[1] * q[1] - q[2] * q[2] + q[3] * q[3];
+}
+
+void ahrs_linear_accel(const float q[4], const float acc[3], float lin_body[3], float lin_earth[3]) {
+    if (lin_body) {
+        float g[3];
+        ahrs_gravity(q, g);
+        for (int i = 0; i < 3; i++) lin_body[i] = acc[i] - g[i];
+    }
+    if (lin_earth) {
+        float w = q[0], x = q[1], y = q[2], z = q[3];
+        lin_earth[0] = (1.0f - 2.0f * (y * y + z * z)) * acc[0] + 2.0f * (x * y - w * z) * acc[1] +
+                       2.0f * (x * z + w * y) * acc[2];
+        lin_earth[1] = 2.0f * (x * y + w * z) * acc[0] + (1.0f - 2.0f * (x * x + z * z)) * acc[1] +
+                       2.0f * (y * z - w * x) * acc[2];
+        lin_earth[2] = 2.0f * (x * z - w * y) * acc[0] + 2.0f * (y * z + w * x) * acc[1] +
+                       (1.0f - 2.0f * (x * x + y * y)) * acc[2] - 1.0f;
+    }
+}
+
+float ahrs_heading(const float q[4]) {
+    // Device x in earth axes: north = R00, west = R10
+    float north = 1.0f - 2.0f * (q[2] * q[2] + q[3] * q[3]);
+    float west = 2.0f * (q[1] * q[2] + q[0] * q[3]);
+    float heading = fast_atan2f(-west, north) * RAD_TO_DEG;
+    if (heading < 0.0f) heading += 360.0f;
+    return heading;
+}
@@ -0,0 +1,176 @@
+#include "altitude.h"
+#include <math.h>
+#include <string.h>
+
+#define P0_HPA          1013.25f
+#define ISA_T0_K        288.15f
+#define ISA_LAPSE       0.0065f     // K/m
+#define ISA_EXP         0.190263f   // R L / (g M)
+#define KELVIN          273.15f
+#define LUT_SEGMENTS    32
+#define LUT_STEP        ((ALTITUDE_P_MAX_HPA - ALTITUDE_P_MIN_HPA) / LUT_SEGMENTS)
+#define GATE            25.0f       // Squared sigmas
+#define MAX_DT_S        5.0f        // Longer gaps restart from the next baro sample
+#define OFFSET_SIGMA_M  400.0f
+
+// (p / P0)^ISA_EXP and its derivative times LUT_STEP at each node
+// (generated offline); cubic Hermite in between is within 0.01 m of powf
+static const float ratio_lut[LUT_SEGMENTS + 1][2] = {
+    { 0.766236084f, 0.016400967f },  // 250.000 hPa
+    { 0.781937031f, 0.015044530f },  // 278.125 hPa
+    { 0.796400707f, 0.013915615f },  // 306.250 hPa
+    { 0.809825850f, 0.012959991f },  // 334.375 hPa
+    { 0.822365647f, 0.012139584f },  // 362.500 hPa
+    { 0.834140830f, 0.011426842f },  // 390.625 hPa
+    { 0.845248347f, 0.010801309f },  // 418.750 hPa
+    { 0.855767306f, 0.010247466f },  // 446.875 hPa
+    { 0.865763149f, 0.009753317f },  // 475.000 hPa
+    { 0.875290675f, 0.009309434f },  // 503.125 hPa
+    { 0.884396251f, 0.008908300f },  // 531.250 hPa
+    { 0.893119488f, 0.008543845f },  // 559.375 hPa
+    { 0.901494507f, 0.008211114f },  // 587.500 hPa
+    { 0.909550920f, 0.007906015f },  // 615.625 hPa
+    { 0.917314606f, 0.007625142f },  // 643.750 hPa
+    { 0.924808321f, 0.007365634f },  // 671.875 hPa
+    { 0.932052184f, 0.007125069f },  // 700.000 hPa
+    { 0.939064082f, 0.006901383f },  // 728.125 hPa
+    { 0.945859985f, 0.006692808f },  // 756.250 hPa
+    { 0.952454222f, 0.006497813f },  // 784.375 hPa
+    { 0.958859695f, 0.006315076f },  // 812.500 hPa
+    { 0.965088072f, 0.006143439f },  // 840.625 hPa
+    { 0.971149934f, 0.005981889f },  // 868.750 hPa
+    { 0.977054914f, 0.005829535f },  // 896.875 hPa
+    { 0.982811806f, 0.005685590f },  // 925.000 hPa
+    { 0.988428662f, 0.005549353f },  // 953.125 hPa
+    { 0.993912873f, 0.005420203f },  // 981.250 hPa
+    { 0.999271243f, 0.005297582f },  // 1009.375 hPa
+    { 1.004510047f, 0.005180994f },  // 1037.500 hPa
+    { 1.009635090f, 0.005069988f },  // 1065.625 hPa
+    { 1.014651749f, 0.004964160f },  // 1093.750 hPa
+    { 1.019565015f, 0.004863146f },  // 1121.875 hPa
+    { 1.024379535f, 0.004766613f },  // 1150.000 hPa
+};
+
+float altitude_pressure_ratio(float pressure_hpa) {
+    float u = (pressure_hpa - ALTITUDE_P_MIN_HPA) * (1.0f / LUT_STEP);
+    if (!(u > 0.0f)) u = 0.0f;
+    if (u > (float)LUT_SEGMENTS) u = (float)LUT_SEGMENTS;
+    int i = (int)u;
+    if (i == LUT_SEGMENTS) i--;
+    float t = u - (float)i;
+
+    float y0 = ratio_lut[i][0], m0 = ratio_lut[i][1];
+    float y1 = ratio_lut[i + 1][0], m1 = ratio_lut[i + 1][1];
+    float t2 = t * t, t3 = t2 * t;
+    return (2.0f * t3 - 3.0f * t2 + 1.0f) * y0 + (t3 - 2.0f * t2 + t) * m0 + (-2.0f * t3 + 3.0f * t2) * y1 +
+           (t3 - t2) * m1;
+}
+
+float altitude_from_pressure(float pressure_hpa, float temp_c) {
+    float r = altitude_pressure_ratio(pressure_hpa);
+    if (isnan(temp_c)) return (ISA_T0_K / ISA_LAPSE) * (1.0f - r);
+    // h = ((P0/P)^ISA_EXP - 1) * T / L, equal to the ISA form at ISA temperature
+    return (1.0f / r - 1.0f) * (temp_c + KELVIN) / ISA_LAPSE;
+}
+
+void altitude_kf_init(altitude_kf_t *f, const altitude_kf_params_t *params) {
+    memset(f, 0, sizeof(*f));
+    f->params = *params;
+}
+
+static void predict(altitude_kf_t *f, int64_t t_us) {
+    // An out-of-order measurement is applied at the state time; moving
+    // t_us back would integrate the same interval twice
+    float dt = (t_us - f->t_us) * 1e-6f;
+    if (dt <= 0.0f) return;
+    f->t_us = t_us;
+
+    float (*P)[3] = f->P;
+    f->x[0] += f->x[1] * dt;
+
+    // P = F P F^T + Q with F = [1 dt 0; 0 1 0; 0 0 1]
+    for (int j = 0; j < 3; j++) P[0][j] += dt * P[1][j];
+    for (int i = 0; i < 3; i++) P[i][0] += dt * P[i][1];
+
+    float qa = f->params.accel_noise * f->params.accel_noise;
+    P[0][0] += qa * dt * dt * dt / 3.0f;
+    P[0][1] += qa * dt * dt / 2.0f;
+    P[1][0] += qa * dt * dt / 2.0f;
+    P[1][1] += qa * dt;
+    if (f->gnss_seen) P[2][2] += f->params.bias_walk * f->params.bias_walk * dt;
+}
+
+// Scalar update z = x[0] + with_offset * x[2]
+static void update(altitude_kf_t *f, float z, float var, bool with_offset) {
+    float (*P)[3] = f->P;
+    float ph[3];
+    for (int i = 0; i < 3; i++) ph[i] = P[i][0] + (with_offset ? P[i][2] : 0.0f);
+    float s = ph[0] + (with_offset ? ph[2] : 0.0f) + var;
+    float y = z - f->x[0] - (with_offset ? f->x[2] : 0.0f);
+    if (y * y > GATE * s) {
+        f->rejected++;
+        return;
+    }
+
+    float inv_s = 1.0f / s;
+    for (int i = 0; i < 3; i++) {
+        float k = ph[i] * inv_s;
+        f->x[i] += k * y;
+        for (int j = 0; j < 3; j++) P[i][j] -= k * ph[j];
+    }
+}
+
+// (Re)start from a baro altitude. The offset is kept once GNSS has placed
+// it; before that it stays pinned at zero and the output is pressure
+// altitude
+static void start(altitude_kf_t *f, int64_t t_us, float baro_alt, float var) {
+    float offset = f->gnss_seen ? f->x[2] : 0.0f;
+    float offset_var = f->gnss_seen ? f->P[2][2] : 0.0f;
+    memset(f->P, 0, sizeof(f->P));
+    f->x[0] = baro_alt - offset;
+    f->x[1] = 0.0f;
+    f->x[2] = offset;
+    f->P[0][0] = var + offset_var;
+    f->P[0][2] = f->P[2][0] = -offset_var;
+    f->P[1][1] = 1.0f;
+    f->P[2][2] = offset_var;
+    f->t_us = t_us;
+}
+
+void altitude_kf_baro(altitude_kf_t *f, int64_t t_us, float baro_alt) {
+    float var = f->params.baro_sigma * f->params.baro_sigma;
+    if (f->t_us == 0 || (t_us - f->t_us) * 1e-6f > MAX_DT_S) {
+        start(f, t_us, baro_alt, var);
+        return;
+    }
+    predict(f, t_us);
+    update(f, baro_alt, var, true);
+}
+
+void altitude_kf_gnss(altitude_kf_t *f, int64_t t_us, float alt, float sigma) {
+    if (f->t_us == 0) return;
+    sigma = fmaxf(sigma, f->params.gnss_floor);
+    if (!f->gnss_seen) {
+        // Release the offset within a weather system's range (+-50 hPa is
+        // about +-400 m); h + offset stays as well known as before
+        f->P[2][2] = OFFSET_SIGMA_M * OFFSET_SIGMA_M;
+        f->P[0][0] += f->P[2][2];
+        f->P[0][2] = f->P[2][0] = -f->P[2][2];
+        f->gnss_seen = true;
+    }
+    predict(f, t_us);
+    update(f, alt, sigma * sigma, false);
+}
+
+void altitude_kf_output(const altitude_kf_t *f, altitude_sample_t *out) {
+    out->t_us = f->t_us;
+    out->altitude = f->x[0];
+    out->vspeed = f->x[1];
+    out->sigma = sqrtf(fmaxf(f->P[0][0], 0.0f));
+}
+
+float altitude_kf_qnh(const altitude_kf_t *f) {
+    // Sea level reads the offset as its baro altitude; invert the standard
+    // atmosphere there (display only, so powf is fine)
+    return P0_HPA * powf(1.0f - ISA_LAPSE * f->x[2] / ISA_T0_K, 1.0f / ISA_EXP);
+}
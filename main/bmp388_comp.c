@@ -0,0 +1,120 @@
+#include "bmp388_comp.h"
+
+// Operating range limits applied by the integer path
+#define TEMP_MIN_CDEG   (-4000)
+#define TEMP_MAX_CDEG   8500
+#define PRESS_MIN_CPA   3000000u
+#define PRESS_MAX_CPA   12500000u
+
+void bmp388_calib_parse(const uint8_t nvm[BMP388_CALIB_LEN], bmp388_calib_t *calib) {
+    calib->par_t1 = (uint16_t)((nvm[1] << 8) | nvm[0]);
+    calib->par_t2 = (uint16_t)((nvm[3] << 8) | nvm[2]);
+    calib->par_t3 = (int8_t)nvm[4];
+    calib->par_p1 = (int16_t)((nvm[6] << 8) | nvm[5]);
+    calib->par_p2 = (int16_t)((nvm[8] << 8) | nvm[7]);
+    calib->par_p3 = (int8_t)nvm[9];
+    calib->par_p4 = (int8_t)nvm[10];
+    calib->par_p5 = (uint16_t)((nvm[12] << 8) | nvm[11]);
+    calib->par_p6 = (uint16_t)((nvm[14] << 8) | nvm[13]);
+    calib->par_p7 = (int8_t)nvm[15];
+    calib->par_p8 = (int8_t)nvm[16];
+    calib->par_p9 = (int16_t)((nvm[18] << 8) | nvm[17]);
+    calib->par_p10 = (int8_t)nvm[19];
+    calib->par_p11 = (int8_t)nvm[20];
+}
+
+void bmp388_calib_to_double(const bmp388_calib_t *c, bmp388_calib_double_t *out) {
+    // Scaling factors (Bosch datasheet), all exact powers of two in double
+    out->T1 = (double)c->par_t1 * 256.0;                    // 2^-8
+    out->T2 = (double)c->par_t2 / 1073741824.0;             // 2^30
+    out->T3 = (double)c->par_t3 / 281474976710656.0;        // 2^48
+
+    out->P1 = (double)(c->par_p1 - 16384) / 1048576.0;      // (P1-2^14)/2^20
+    out->P2 = (double)(c->par_p2 - 16384) / 536870912.0;    // (P2-2^14)/2^29
+    out->P3 = (double)c->par_p3 / 4294967296.0;             // 2^32
+    out->P4 = (double)c->par_p4 / 137438953472.0;           // 2^37
+    out->P5 = (double)c->par_p5 * 8.0;                      // 2^-3
+    out->P6 = (double)c->par_p6 / 64.0;                     // 2^6
+    out->P7 = (double)c->par_p7 / 256.0;                    // 2^8
+    out->P8 = (double)c->par_p8 / 32768.0;                  // 2^15
+    out->P9 = (double)c->par_p9 / 281474976710656.0;        // 2^48
+    out->P10 = (double)c->par_p10 / 281474976710656.0;      // 2^48
+    out->P11 = (double)c->par_p11 / 36893488147419103232.0; // 2^65
+}
+
+void bmp388_compensate_int(const bmp388_calib_t *c, uint32_t raw_press, uint32_t raw_temp,
+                           int32_t *temp_cdeg, uint32_t *press_cpa) {
+    int64_t pd1, pd2, pd3, pd4, pd5, pd6;
+
+    // Temperature; t_lin is 0.01 deg C * 2^14 / 25 and feeds the pressure terms
+    pd1 = (int64_t)raw_temp - (int64_t)256 * c->par_t1;
+    pd2 = (int64_t)c->par_t2 * pd1;
+    pd3 = pd1 * pd1;
+    pd4 = pd3 * c->par_t3;
+    pd5 = pd2 * 262144 + pd4;
+    int64_t t_lin = pd5 / 4294967296LL;
+
+    int64_t t = (t_lin * 25) / 16384;
+    if (t < TEMP_MIN_CDEG) t = TEMP_MIN_CDEG;
+    if (t > TEMP_MAX_CDEG) t = TEMP_MAX_CDEG;
+    *temp_cdeg = (int32_t)t;
+
+    // Pressure: offset and sensitivity polynomials in t_lin
+    int64_t p = raw_press;
+    pd1 = t_lin * t_lin;
+    pd2 = pd1 / 64;
+    pd3 = (pd2 * t_lin) / 256;
+    pd4 = (c->par_p8 * pd3) / 32;
+    pd5 = (c->par_p7 * pd1) * 16;
+    pd6 = (c->par_p6 * t_lin) * 4194304;
+    int64_t offset = (int64_t)c->par_p5 * 140737488355328LL + pd4 + pd5 + pd6;
+
+    pd2 = (c->par_p4 * pd3) / 32;
+    pd4 = (c->par_p3 * pd1) * 4;
+    pd5 = (int64_t)(c->par_p2 - 16384) * t_lin * 2097152;
+    int64_t sensitivity = (int64_t)(c->par_p1 - 16384) * 70368744177664LL + pd2 + pd4 + pd5;
+
+    pd1 = (sensitivity / 16777216) * p;
+    pd2 = c->par_p10 * t_lin;
+    pd3 = pd2 + (int64_t)65536 * c->par_p9;
+    pd4 = (pd3 * p) / 8192;
+    // Divide by 10 first so p * pd4 cannot overflow
+    pd5 = (p * (pd4 / 10)) / 512;
+    pd5 = pd5 * 10;
+    pd6 = p * p;
+    pd2 = (c->par_p11 * pd6) / 65536;
+    pd3 = (pd2 * p) / 128;
+    pd4 = offset / 4 + pd1 + pd5 + pd3;
+
+    uint64_t comp = ((uint64_t)pd4 * 25) / 1099511627776ULL;
+    if (pd4 < 0 || comp < PRESS_MIN_CPA) comp = PRESS_MIN_CPA;
+    if (comp > PRESS_MAX_CPA) comp = PRESS_MAX_CPA;
+    *press_cpa = (uint32_t)comp;
+}
+
+void bmp388_compensate_double(const bmp388_calib_double_t *c, uint32_t raw_press, uint32_t raw_temp,
+                              double *temp_c, double *press_pa) {
+    double pd1, pd2, pd3, pd4, out1, out2;
+
+    pd1 = (double)raw_temp - c->T1;
+    pd2 = pd1 * c->T2;
+    double t_lin = pd2 + (pd1 * pd1) * c->T3;
+
+    pd1 = c->P6 * t_lin;
+    pd2 = c->P7 * (t_lin * t_lin);
+    pd3 = c->P8 * (t_lin * t_lin * t_lin);
+    out1 = c->P5 + pd1 + pd2 + pd3;
+
+    pd1 = c->P2 * t_lin;
+    pd2 = c->P3 * (t_lin * t_lin);
+    pd3 = c->P4 * (t_lin * t_lin * t_lin);
+    out2 = (double)raw_press * (c->P1 + pd1 + pd2 + pd3);
+
+    pd1 = (double)raw_press * (double)raw_press;
+    pd2 = c->P9 + c->P10 * t_lin;
+    pd3 = pd1 * pd2;
+    pd4 = pd3 + (double)raw_press * (double)raw_press * (double)raw_press * c->P11;
+
+    *temp_c = t_lin;
+    *press_pa = out1 + out2 + pd4;
+}
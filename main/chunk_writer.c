@@ -0,0 +1,174 @@
+#include "chunk_writer.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+void chunk_writer_init(chunk_writer_t *w, const chunk_writer_config_t *cfg) {
+    memset(w, 0, sizeof(*w));
+    w->ring = cfg->ring;
+    w->mask = cfg->ring_size - 1;
+    w->bounce = cfg->bounce;
+    w->clock_us = cfg->clock_us;
+    w->prealloc = cfg->prealloc;
+    w->fd = -1;
+    atomic_init(&w->head, 0);
+    atomic_init(&w->tail, 0);
+    latency_hist_reset(&w->flush_us);
+    latency_hist_reset(&w->commit_us);
+}
+
+int chunk_writer_open(chunk_writer_t *w, const char *path) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) return -1;
+
+    w->fd = fd;
+    w->file_len = 0;
+    w->alloc_len = 0;
+    w->committed = 0;
+    atomic_store_explicit(&w->head, 0, memory_order_relaxed);
+    atomic_store_explicit(&w->tail, 0, memory_order_relaxed);
+    return 0;
+}
+
+bool chunk_writer_stage(chunk_writer_t *w, const void *src, uint32_t len) {
+    uint32_t head = atomic_load_explicit(&w->head, memory_order_relaxed);
+    uint32_t used = head - atomic_load_explicit(&w->tail, memory_order_acquire);
+    if (used + len > w->mask + 1) return false;
+
+    // Across the wrap if needed
+    uint32_t off = head & w->mask;
+    uint32_t first = w->mask + 1 - off;
+    if (first > len) first = len;
+    memcpy(w->ring + off, src, first);
+    memcpy(w->ring, (const uint8_t *)src + first, len - first);
+
+    atomic_store_explicit(&w->head, head + len, memory_order_release);
+    if (used + len > w->high_water) w->high_water = used + len;
+    return true;
+}
+
+static const uint8_t zero_sector[CHUNK_WRITER_SECTOR];
+
+// Grow the file ahead so writes only fill clusters that are already
+// chained, and sync so the chain and the length are on the card before
+// any data lands in them. A failed ftruncate is not fatal: pwrite()
+// extends the file as well, just a cluster at a time.
+static void reserve(chunk_writer_t *w, uint32_t end) {
+    if (w->prealloc && end > w->alloc_len) {
+        uint32_t want = w->alloc_len + w->prealloc;
+        if (ftruncate(w->fd, want) == 0 && fsync(w->fd) == 0) w->alloc_len = want;
+    }
+}
+
+// Writes go to explicit offsets: a failed chunk is retried in place and
+// commits rewrite the partial chunk
+static int pwrite_all(int fd, const uint8_t *src, uint32_t len, uint32_t off) {
+    while (len) {
+        ssize_t n = pwrite(fd, src, len, (off_t)off);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (n == 0) {
+            errno = ENOSPC;
+            return -1;
+        }
+        src += n;
+        len -= (uint32_t)n;
+        off += (uint32_t)n;
+    }
+    return 0;
+}
+
+// Write len staged bytes from the tail, which must not cross the wrap
+static int write_staged(chunk_writer_t *w, uint32_t len) {
+    uint32_t tail = atomic_load_explicit(&w->tail, memory_order_relaxed);
+    const uint8_t *src = w->ring + (tail & w->mask);
+    int64_t t0 = w->clock_us();
+
+    reserve(w, w->file_len + len);
+    if (w->bounce && len <= CHUNK_WRITER_CHUNK) {
+        memcpy(w->bounce, src, len);
+        src = w->bounce;
+    }
+    if (pwrite_all(w->fd, src, len, w->file_len) != 0) {
+        w->write_errors++;
+        return -1;
+    }
+    w->file_len += len;
+    w->committed = 0;
+    atomic_store_explicit(&w->tail, tail + len, memory_order_release);
+    latency_hist_add(&w->flush_us, (uint32_t)(w->clock_us() - t0));
+    return 0;
+}
+
+int chunk_writer_flush(chunk_writer_t *w) {
+    int chunks = 0;
+    while (chunk_writer_pending(w) >= CHUNK_WRITER_CHUNK) {
+        if (write_staged(w, CHUNK_WRITER_CHUNK) != 0) return -1;
+        chunks++;
+    }
+    return chunks;
+}
+
+int chunk_writer_commit(chunk_writer_t *w) {
+    if (w->fd < 0 || chunk_writer_flush(w) < 0) return -1;
+    uint32_t pending = chunk_writer_pending(w);
+    if (pending <= w->committed) return 0;
+
+    // Whole sectors from the first one not yet on the card, zero padded;
+    // the tail is chunk aligned and pending < chunk, so this never wraps
+    // the ring
+    int64_t t0 = w->clock_us();
+    uint32_t from = w->committed & ~(uint32_t)(CHUNK_WRITER_SECTOR - 1);
+    uint32_t pad = (CHUNK_WRITER_SECTOR - pending % CHUNK_WRITER_SECTOR) % CHUNK_WRITER_SECTOR;
+    const uint8_t *src = w->ring + ((atomic_load_explicit(&w->tail, memory_order_relaxed) + from) & w->mask);
+    reserve(w, w->file_len + pending + pad);
+    int ret;
+    if (w->bounce) {
+        memcpy(w->bounce, src, pending - from);
+        memset(w->bounce + pending - from, 0, pad);
+        ret = pwrite_all(w->fd, w->bounce, pending - from + pad, w->file_len + from);
+    } else {
+        ret = pwrite_all(w->fd, src, pending - from, w->file_len + from);
+        if (ret == 0) ret = pwrite_all(w->fd, zero_sector, pad, w->file_len + pending);
+    }
+    if (ret != 0 || fsync(w->fd) != 0) {
+        w->write_errors++;
+        return -1;
+    }
+    w->committed = pending;
+    latency_hist_add(&w->commit_us, (uint32_t)(w->clock_us() - t0));
+    return 1;
+}
+
+int chunk_writer_close(chunk_writer_t *w) {
+    if (w->fd < 0) return 0;
+
+    int ret = chunk_writer_flush(w) < 0 ? -1 : 0;
+
+    // The tail is chunk aligned, so the rest wraps at most once
+    while (ret == 0 && chunk_writer_pending(w) > 0) {
+        uint32_t len = chunk_writer_pending(w);
+        uint32_t to_wrap = w->mask + 1 - (atomic_load_explicit(&w->tail, memory_order_relaxed) & w->mask);
+        if (len > to_wrap) len = to_wrap;
+        if (len > CHUNK_WRITER_CHUNK) len = CHUNK_WRITER_CHUNK;
+        if (write_staged(w, len) != 0) ret = -1;
+    }
+
+    int err = errno;
+    if (ftruncate(w->fd, w->file_len) != 0 || fsync(w->fd) != 0) {
+        err = errno;
+        ret = -1;
+    }
+    if (close(w->fd) != 0 && ret == 0) {
+        err = errno;
+        ret = -1;
+    }
+    w->fd = -1;
+    atomic_store_explicit(&w->head, 0, memory_order_relaxed);
+    atomic_store_explicit(&w->tail, 0, memory_order_relaxed);
+    errno = err;
+    return ret;
+}
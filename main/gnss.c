@@ -1,26 +1,76 @@
 #include "gnss.h"
 #include "config.h"
+#include "nmea.h"
+#include "ubx.h"
+#include "ubx_cfg.h"
+#include "gnss_link.h"
+#include "gnss_aid.h"
+#include "sat_table.h"
+#include "gnss_rx.h"
 #include "driver/uart.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "nvs.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <sys/time.h>
 
 static const char *TAG = "GNSS";
-#define BUF_SIZE 2048 // Increased buffer for fragmentation handling
-
-// UBX Constants
-#define UBX_SYNC_CHAR_1 0xB5
-#define UBX_SYNC_CHAR_2 0x62
-#define UBX_CLASS_CFG   0x06
-#define UBX_CLASS_ACK   0x05
-#define UBX_ID_ACK_ACK  0x01
-#define UBX_ID_ACK_NAK  0x00
-#define UBX_ID_CFG_VALSET 0x8A
-
-static void send_ubx_msg(uint8_t class, uint8_t id, uint8_t *payload, uint16_t payload_len) {
+#define BUF_SIZE 2048 // Chunk read from the UART ring per call
+#define UART_EVENT_QUEUE_LEN 20
+#define LATENCY_LOG_PERIOD_US (60 * 1000 * 1000)
+
+#define CFG_ACK_TIMEOUT_US  (250 * 1000)
+#define CFG_MAX_ATTEMPTS    3
+
+#define AID_NVS_NAMESPACE   "gnss"
+#define AID_NVS_KEY         "aid"
+#define AID_SAVE_PERIOD_US  (10LL * 60 * 1000 * 1000)  // Flash wear vs. position staleness
+#define AID_RTC_ACC_S       2                           // System clock kept across MCU resets
+#define AID_SOS_BACKUP_MS   1000                        // Receiver writes the backup to flash in this
+
+static QueueHandle_t uart_queue = NULL;
+static QueueHandle_t profile_queue = NULL;
+
+// Configuration transaction in flight (owned by the GNSS task)
+static ubx_valset_t cfg_valset;
+static ubx_txn_t cfg_txn;
+
+static gnss_link_t uart_link;
+static gnss_link_stats_t link_stats;
+
+// Warm/hot start state
+static gnss_aid_record_t aid_record;
+static bool aid_loaded = false;
+static bool sos_supported = false;
+static const char *start_kind = "cold";
+static int64_t power_on_us = 0;
+static int64_t ttff_us = 0;
+static int64_t aid_saved_us = 0;
+
+// Satellites in view; the GNSS task writes under the mutex, readers hold it
+// while they walk the table
+static sat_table_t sat_table;
+static SemaphoreHandle_t sats_mutex = NULL;
+static bool nav_sat_seen = false;   // NAV-SAT supersedes GSV as the source
+
+#define SATS_LOCK_WAIT_MS 5
+
+static const gnss_profile_t default_profile = {
+    .rate_hz = GNSS_DEFAULT_RATE_HZ,
+    .dyn_model = GNSS_DEFAULT_DYN_MODEL,
+    .constellations = GNSS_DEFAULT_CONSTELLATIONS,
+    .ubx_only = GNSS_DEFAULT_UBX_ONLY,
+};
+
+static void send_ubx_msg(uint8_t class, uint8_t id, const uint8_t *payload, uint16_t payload_len) {
     uint8_t header[6];
     header[0] = UBX_SYNC_CHAR_1;
     header[1] = UBX_SYNC_CHAR_2;
@@ -29,18 +79,8 @@ static void send_ubx_msg(uint8_t class, uint8_t id, uint8_t *payload, uint16_t p
     header[4] = payload_len & 0xFF;
     header[5] = (payload_len >> 8) & 0xFF;
 
-    uint8_t ck_a = 0, ck_b = 0;
-
-    // Calc header part checksum (starting from Class)
-    for(int i=2; i<6; i++) {
-        ck_a += header[i];
-        ck_b += ck_a;
-    }
-    // Calc payload part checksum
-    for(int i=0; i<payload_len; i++) {
-        ck_a += payload[i];
-        ck_b += ck_a;
-    }
+    uint8_t ck_a, ck_b;
+    ubx_checksum(class, id, payload, payload_len, &ck_a, &ck_b);
 
     uart_write_bytes(GNSS_UART_NUM, (const char*)header, 6);
     if (payload_len > 0) {
@@ -50,47 +90,103 @@ static void send_ubx_msg(uint8_t class, uint8_t id, uint8_t *payload, uint16_t p
     uart_write_bytes(GNSS_UART_NUM, (const char*)&ck_b, 1);
 }
 
-static void gnss_configure_baud_rate(void) {
-    // U-Blox Generation 9/10 (MAX-F10S) uses CFG-VALSET.
-    // Key: CFG-UART1-BAUDRATE = 0x40520001
-    // Value: 115200 = 0x0001C200
+static void send_frame(const uint8_t *frame, size_t len) {
+    if (len > 0) uart_write_bytes(GNSS_UART_NUM, (const char*)frame, len);
+}
 
-    // Payload for CFG-VALSET
-    // Version (1) + Layers (1) + Reserved (2) + Key (4) + Value (4) = 12 bytes
-    uint8_t payload[12];
-    memset(payload, 0, 12);
+static void aid_load(void) {
+    nvs_handle_t handle;
+    if (nvs_open(AID_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) return;
 
-    payload[0] = 0x00; // Version
-    payload[1] = 0x01; // Layer: RAM
-    payload[2] = 0x00; // Reserved
-    payload[3] = 0x00; // Reserved
+    size_t size = sizeof(aid_record);
+    esp_err_t err = nvs_get_blob(handle, AID_NVS_KEY, &aid_record, &size);
+    nvs_close(handle);
 
-    // Key: 0x40520001 (Little Endian) -> 01 00 52 40
-    payload[4] = 0x01;
-    payload[5] = 0x00;
-    payload[6] = 0x52;
-    payload[7] = 0x40;
+    aid_loaded = err == ESP_OK && size == sizeof(aid_record) && gnss_aid_record_valid(&aid_record);
+    if (aid_loaded) sos_supported = (aid_record.flags & GNSS_AID_FLAG_SOS) != 0;
+}
 
-    // Value: 115200 = 0x0001C200 (Little Endian) -> 00 C2 01 00
-    payload[8] = 0x00;
-    payload[9] = 0xC2;
-    payload[10] = 0x01;
-    payload[11] = 0x00;
+static esp_err_t aid_save(const gnss_fix_t *fix) {
+    gnss_aid_record_t rec;
+    if (!gnss_aid_record_from_fix(&rec, fix, sos_supported ? GNSS_AID_FLAG_SOS : 0)) {
+        return ESP_ERR_INVALID_STATE;
+    }
 
-    ESP_LOGI(TAG, "Sending U-Blox CFG-VALSET to switch baud rate to 115200...");
-    send_ubx_msg(UBX_CLASS_CFG, UBX_ID_CFG_VALSET, payload, 12);
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(AID_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) return err;
+    err = nvs_set_blob(handle, AID_NVS_KEY, &rec, sizeof(rec));
+    if (err == ESP_OK) err = nvs_commit(handle);
+    nvs_close(handle);
+    return err;
+}
+
+// Seed the receiver after the link is up: restart navigation, query the
+// UPD-SOS restore status and push the stored position and the system time
+// as MGA-INI aiding
+static void send_aiding(void) {
+    uint8_t frame[GNSS_AID_FRAME_MAX];
+    // The supply stays on across an MCU reset, so a receiver stopped by an
+    // interrupted power-off would otherwise never navigate again
+    send_frame(frame, gnss_aid_encode_gnss_start(frame, sizeof(frame)));
+    send_frame(frame, gnss_aid_encode_sos_poll(frame, sizeof(frame)));
+
+    if (!aid_loaded) {
+        ESP_LOGI(TAG, "No stored position, cold start");
+        return;
+    }
 
-    // Wait for transmission and module processing
-    vTaskDelay(pdMS_TO_TICKS(200));
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    int64_t now_s = tv.tv_sec;
+    bool time_known = now_s >= GNSS_AID_TIME_MIN_UTC_S;
 
-    ESP_LOGI(TAG, "Reconfiguring UART to 115200...");
-    uart_set_baudrate(GNSS_UART_NUM, 115200);
+    send_frame(frame, gnss_aid_encode_pos(&aid_record, frame, sizeof(frame)));
+    if (time_known) {
+        send_frame(frame, gnss_aid_encode_time(now_s, AID_RTC_ACC_S, frame, sizeof(frame)));
+    }
+
+    start_kind = gnss_aid_ephemeris_fresh(&aid_record, now_s) ? "hot" : "warm";
+    if (time_known) {
+        ESP_LOGI(TAG, "Aiding: position and time, last fix %lld s ago (%s start)",
+                 (long long)(now_s - aid_record.utc_s), start_kind);
+    } else {
+        ESP_LOGI(TAG, "Aiding: position only, time unknown (%s start)", start_kind);
+    }
+}
 
-    // Flush buffers
+static void link_set_baud(void *ctx, uint32_t baud) {
+    ESP_LOGD(TAG, "Listening at %lu baud", (unsigned long)baud);
+    uart_set_baudrate(GNSS_UART_NUM, baud);
     uart_flush_input(GNSS_UART_NUM);
-    ESP_LOGI(TAG, "Baud rate switched.");
+#if GNSS_RX_EVENT_DRIVEN
+    xQueueReset(uart_queue);
+#endif
 }
 
+static void link_send_poll(void *ctx) {
+    send_ubx_msg(UBX_CLASS_MON, UBX_ID_MON_VER, NULL, 0);
+}
+
+static void link_send_baud_cfg(void *ctx, uint32_t baud) {
+    // U-Blox Generation 9/10 (MAX-F10S) uses CFG-VALSET.
+    // Key: CFG-UART1-BAUDRATE = 0x40520001
+    ubx_valset_t vs;
+    ubx_valset_init(&vs, UBX_CFG_LAYER_RAM);
+    ubx_valset_add(&vs, UBX_KEY_UART1_BAUDRATE, baud);
+
+    ESP_LOGI(TAG, "Sending U-Blox CFG-VALSET to switch baud rate %lu -> %lu...",
+             (unsigned long)uart_link.baud, (unsigned long)baud);
+    send_ubx_msg(UBX_CLASS_CFG, UBX_ID_CFG_VALSET, vs.payload, vs.len);
+    uart_wait_tx_done(GNSS_UART_NUM, pdMS_TO_TICKS(100));
+}
+
+static const gnss_link_ops_t link_ops = {
+    .set_baud = link_set_baud,
+    .send_poll = link_send_poll,
+    .send_baud_cfg = link_send_baud_cfg,
+};
+
 esp_err_t gnss_init(void) {
     ESP_LOGI(TAG, "Initializing GNSS UART...");
 
@@ -104,9 +200,30 @@ esp_err_t gnss_init(void) {
         .source_clk = UART_SCLK_DEFAULT,
     };
 
-    ESP_ERROR_CHECK(uart_driver_install(GNSS_UART_NUM, BUF_SIZE * 2, 0, 0, NULL, 0));
+    // The RX ring cannot be resized without reinstalling the driver: size
+    // it for the worst-case burst of the boot profile
+    link_stats.rx_buf_size = gnss_link_rx_buffer_size(&default_profile, GNSS_LINK_MAX_SV);
+    if (!gnss_link_baud_sufficient(&default_profile, GNSS_LINK_MAX_SV, GNSS_BAUD_RATE)) {
+        ESP_LOGW(TAG, "%u Hz profile (%lu B/s) exceeds 75%% of %d baud",
+                 default_profile.rate_hz,
+                 (unsigned long)gnss_link_bytes_per_sec(&default_profile, GNSS_LINK_MAX_SV),
+                 GNSS_BAUD_RATE);
+    }
+    ESP_LOGI(TAG, "RX buffer %u bytes (burst up to %lu bytes)", (unsigned)link_stats.rx_buf_size,
+             (unsigned long)gnss_link_burst_bytes(&default_profile, GNSS_LINK_MAX_SV));
+
+#if GNSS_RX_EVENT_DRIVEN
+    ESP_ERROR_CHECK(uart_driver_install(GNSS_UART_NUM, link_stats.rx_buf_size, 0, UART_EVENT_QUEUE_LEN, &uart_queue, 0));
+#else
+    ESP_ERROR_CHECK(uart_driver_install(GNSS_UART_NUM, link_stats.rx_buf_size, 0, 0, NULL, 0));
+#endif
     ESP_ERROR_CHECK(uart_param_config(GNSS_UART_NUM, &uart_config));
     ESP_ERROR_CHECK(uart_set_pin(GNSS_UART_NUM, GNSS_TX_PIN_ESP, GNSS_RX_PIN_ESP, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
+#if GNSS_RX_EVENT_DRIVEN
+    // Raise a data event a few symbols after the line goes quiet instead of
+    // waiting for the FIFO threshold
+    ESP_ERROR_CHECK(uart_set_rx_timeout(GNSS_UART_NUM, GNSS_RX_TOUT_SYMBOLS));
+#endif
 
     // 2. Enable LDO if needed
     gpio_config_t ldo_conf = {
@@ -119,128 +236,403 @@ esp_err_t gnss_init(void) {
     gpio_config(&ldo_conf);
     gpio_set_level(GNSS_LDO_EN_PIN, 1);
 
-    // Give it some time to boot
-    vTaskDelay(pdMS_TO_TICKS(500));
+    power_on_us = esp_timer_get_time();
 
-    // 3. Switch Baud Rate
-    gnss_configure_baud_rate();
+    if (!profile_queue) profile_queue = xQueueCreate(1, sizeof(gnss_profile_t));
+    if (!sats_mutex) {
+        sats_mutex = xSemaphoreCreateMutex();
+        sat_table_init(&sat_table);
+    }
+
+    aid_load();
 
+    // No boot delay: the GNSS task keeps probing until the receiver answers
     return ESP_OK;
 }
 
-// Simple parser state
-typedef enum {
-    PARSE_IDLE,
-    PARSE_NMEA,
-    PARSE_UBX_SYNC1,
-    PARSE_UBX_CLASS,
-    PARSE_UBX_ID,
-    PARSE_UBX_LEN1,
-    PARSE_UBX_LEN2,
-    PARSE_UBX_PAYLOAD,
-    PARSE_UBX_CKA,
-    PARSE_UBX_CKB
-} ParserState;
+static nmea_decoder_t nmea_dec;
+static ubx_engine_t ubx_eng;
+static gnss_rx_t gnss_rx;
+static gnss_snapshot_store_t fix_store;
 
-void gnss_task_entry(void *pvParameters) {
-    gnss_init();
+// Source of the most recent position update, published at epoch end
+static const gnss_fix_t *pending_fix = NULL;
 
-    uint8_t *data = (uint8_t *) malloc(BUF_SIZE);
-    uint8_t *ubx_payload = (uint8_t *) malloc(1024); // Max UBX payload
-    uint8_t nmea_buf[256];
-
-    ParserState state = PARSE_IDLE;
-    int nmea_idx = 0;
-    int ubx_idx = 0;
-    int ubx_len = 0;
-    uint8_t ubx_class = 0;
-    uint8_t ubx_id = 0;
-    while (1) {
-        // Read data from UART
-        int len = uart_read_bytes(GNSS_UART_NUM, data, BUF_SIZE, pdMS_TO_TICKS(50));
+bool gnss_get_snapshot(gnss_snapshot_t *out) {
+    return gnss_snapshot_read(&fix_store, out);
+}
 
-        // Debug Log: Print Raw Hex for debugging connection
-        if (len > 0) {
-            // ESP_LOG_BUFFER_HEXDUMP(TAG, data, len, ESP_LOG_INFO);
+bool gnss_get_snapshot_newer(uint32_t last_epoch, gnss_snapshot_t *out) {
+    return gnss_snapshot_read_newer(&fix_store, last_epoch, out);
+}
+
+const sat_table_t *gnss_sats_lock(int timeout_ms) {
+    if (!sats_mutex) return NULL;
+    if (xSemaphoreTake(sats_mutex, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) return NULL;
+    return &sat_table;
+}
+
+void gnss_sats_unlock(void) {
+    xSemaphoreGive(sats_mutex);
+}
+
+// NAV-PVT carries more than RMC/GGA (velocity, accuracies), so once it
+// has reported an epoch the NMEA sentences of the same epoch are ignored,
+// whichever order they arrive in
+static bool ubx_fix_has_epoch(const gnss_fix_t *nmea_fix) {
+    const gnss_fix_t *ubx_fix = &ubx_eng.fix;
+    if (pending_fix == ubx_fix) return true;
+    return (ubx_fix->valid & nmea_fix->valid & GNSS_VALID_TIME) && ubx_fix->hour == nmea_fix->hour &&
+           ubx_fix->min == nmea_fix->min && ubx_fix->sec == nmea_fix->sec && ubx_fix->ms == nmea_fix->ms;
+}
+
+static void handle_nmea_frame(const uint8_t *frame, size_t len) {
+    nmea_msg_t msg = nmea_decode(&nmea_dec, (const char *)frame, len);
+    if ((msg == NMEA_MSG_RMC || msg == NMEA_MSG_GGA) && !ubx_fix_has_epoch(&nmea_dec.fix)) {
+        pending_fix = &nmea_dec.fix;
+    }
+    if (msg == NMEA_MSG_GSV && !nav_sat_seen &&
+        xSemaphoreTake(sats_mutex, pdMS_TO_TICKS(SATS_LOCK_WAIT_MS)) == pdTRUE) {
+        sat_table_feed_gsv(&sat_table, &nmea_dec.gsv);
+        xSemaphoreGive(sats_mutex);
+    }
+    if (msg == NMEA_MSG_GGA) {
+        const gnss_fix_t *fix = &nmea_dec.fix;
+        ESP_LOGD(TAG, "FIX: type=%d sv=%d lat=%ld lon=%ld alt=%ldmm",
+                 fix->fix_type, fix->num_sv, (long)fix->lat, (long)fix->lon, (long)fix->alt_mm);
+    } else if (msg == NMEA_MSG_INVALID) {
+        ESP_LOGW(TAG, "Malformed NMEA sentence (%d bytes)", (int)len);
+    }
+}
+
+static void handle_ubx_frame(const uint8_t *frame, size_t len) {
+    uint8_t ubx_class = frame[2];
+    uint8_t ubx_id = frame[3];
+    uint16_t ubx_len = (uint16_t)(len - UBX_FRAME_OVERHEAD);
+
+    ubx_status_t st = ubx_engine_dispatch(&ubx_eng, ubx_class, ubx_id, &frame[UBX_HEADER_LEN], ubx_len);
+    if (ubx_eng.ack.pending) {
+        // Payload: CLS ID of acked message
+        if (ubx_eng.ack.ack) {
+            ESP_LOGI(TAG, "UBX ACK-ACK: For Msg 0x%02X-0x%02X", ubx_eng.ack.cls, ubx_eng.ack.id);
         } else {
-             // ESP_LOGW(TAG, "No GNSS Data");
+            ESP_LOGW(TAG, "UBX ACK-NAK: For Msg 0x%02X-0x%02X", ubx_eng.ack.cls, ubx_eng.ack.id);
+        }
+        if (ubx_txn_on_ack(&cfg_txn, &ubx_eng.ack, esp_timer_get_time())) {
+            int rtt_ms = (int)((cfg_txn.done_us - cfg_txn.sent_us) / 1000);
+            if (cfg_txn.state == UBX_TXN_ACKED) {
+                ESP_LOGI(TAG, "Profile applied: %d keys, %d ms round trip, attempt %d",
+                         cfg_valset.keys, rtt_ms, cfg_txn.attempts);
+            } else {
+                ESP_LOGE(TAG, "Profile rejected (ACK-NAK) after %d ms", rtt_ms);
+            }
+        }
+        ubx_eng.ack.pending = false;
+    } else if (st == UBX_OK && ubx_class == UBX_CLASS_NAV && ubx_id == UBX_ID_NAV_PVT) {
+        const gnss_fix_t *fix = &ubx_eng.fix;
+        pending_fix = fix;
+        ESP_LOGD(TAG, "PVT: type=%d sv=%d lat=%ld lon=%ld speed=%lumm/s",
+                 fix->fix_type, fix->num_sv, (long)fix->lat, (long)fix->lon, (unsigned long)fix->speed_mmps);
+    } else if (st == UBX_OK && ubx_class == UBX_CLASS_NAV && ubx_id == UBX_ID_NAV_SAT) {
+        if (xSemaphoreTake(sats_mutex, pdMS_TO_TICKS(SATS_LOCK_WAIT_MS)) == pdTRUE) {
+            if (!nav_sat_seen) {
+                // GSV entries are keyed by signal and would linger next to NAV-SAT ones
+                nav_sat_seen = true;
+                sat_table_init(&sat_table);
+            }
+            sat_table_feed_nav_sat(&sat_table, &ubx_eng.sat, ubx_eng.sat_svs);
+            xSemaphoreGive(sats_mutex);
+        }
+    } else if (ubx_class == UBX_CLASS_UPD && ubx_id == UBX_ID_UPD_SOS) {
+        static const char *const sos_text[] = { "unknown", "failed", "restored", "no backup" };
+        gnss_sos_restore_t sos;
+        if (gnss_aid_parse_sos(&frame[UBX_HEADER_LEN], ubx_len, &sos)) {
+            sos_supported = true;
+            if (sos == GNSS_SOS_RESTORED) start_kind = "restored";
+            ESP_LOGI(TAG, "UPD-SOS backup: %s", sos_text[sos]);
+        }
+    } else if (st == UBX_UNHANDLED) {
+        ESP_LOGD(TAG, "UBX Packet: Class=0x%02X ID=0x%02X Len=%d", ubx_class, ubx_id, ubx_len);
+    }
+}
+
+static void cfg_start_profile(const gnss_profile_t *profile);
+
+static void on_gnss_frame(void *ctx, gnss_frame_type_t type, const uint8_t *frame, size_t len) {
+    // A frame passing its checksum proves the baud rate
+    if (!gnss_link_up(&uart_link) && gnss_link_on_frame(&uart_link, esp_timer_get_time())) {
+        ESP_LOGI(TAG, "Link up at %lu baud after %d ms%s", (unsigned long)uart_link.baud,
+                 (int)((uart_link.up_us - uart_link.started_us) / 1000),
+                 uart_link.fallback ? " (switch failed, staying at detected rate)" : "");
+        send_aiding();
+        cfg_start_profile(&default_profile);
+    }
+
+    if (type == GNSS_FRAME_NMEA) handle_nmea_frame(frame, len);
+    else handle_ubx_frame(frame, len);
+}
+
+esp_err_t gnss_set_profile(const gnss_profile_t *profile) {
+    if (!profile_queue) return ESP_ERR_INVALID_STATE;
+    xQueueOverwrite(profile_queue, profile);
+    return ESP_OK;
+}
+
+// Send the whole profile as one CFG-VALSET and wait for its ACK
+static void cfg_start_profile(const gnss_profile_t *profile) {
+    if (!ubx_cfg_build_profile(&cfg_valset, profile, UBX_CFG_LAYER_RAM)) {
+        ESP_LOGE(TAG, "Invalid GNSS profile (%u Hz)", profile->rate_hz);
+        return;
+    }
+    if (!gnss_link_baud_sufficient(profile, GNSS_LINK_MAX_SV, uart_link.baud) ||
+        gnss_link_rx_buffer_size(profile, GNSS_LINK_MAX_SV) > link_stats.rx_buf_size) {
+        ESP_LOGW(TAG, "Profile may overrun the link: %lu B/s at %lu baud, %lu byte bursts, %u byte RX buffer",
+                 (unsigned long)gnss_link_bytes_per_sec(profile, GNSS_LINK_MAX_SV), (unsigned long)uart_link.baud,
+                 (unsigned long)gnss_link_burst_bytes(profile, GNSS_LINK_MAX_SV), (unsigned)link_stats.rx_buf_size);
+    }
+    ESP_LOGI(TAG, "Applying profile: %u Hz, dyn model %u, GNSS mask 0x%02X, %s",
+             profile->rate_hz, profile->dyn_model, profile->constellations,
+             profile->ubx_only ? "UBX only" : "UBX+NMEA");
+
+    send_ubx_msg(UBX_CLASS_CFG, UBX_ID_CFG_VALSET, cfg_valset.payload, cfg_valset.len);
+    ubx_txn_start(&cfg_txn, UBX_CLASS_CFG, UBX_ID_CFG_VALSET, esp_timer_get_time(),
+                  CFG_ACK_TIMEOUT_US, CFG_MAX_ATTEMPTS);
+}
+
+// Retry on ACK timeout, then pick up the next requested profile
+static void cfg_service(void) {
+    if (ubx_txn_poll(&cfg_txn, esp_timer_get_time())) {
+        ESP_LOGW(TAG, "No ACK for CFG-VALSET, retry %d/%d", cfg_txn.attempts, cfg_txn.max_attempts);
+        send_ubx_msg(UBX_CLASS_CFG, UBX_ID_CFG_VALSET, cfg_valset.payload, cfg_valset.len);
+    } else if (cfg_txn.state == UBX_TXN_TIMEOUT) {
+        ESP_LOGE(TAG, "CFG-VALSET unanswered after %d attempts", cfg_txn.attempts);
+        cfg_txn.state = UBX_TXN_IDLE;
+    }
+
+    gnss_profile_t profile;
+    if (gnss_link_up(&uart_link) && !ubx_txn_busy(&cfg_txn) && xQueueReceive(profile_queue, &profile, 0) == pdTRUE) {
+        cfg_start_profile(&profile);
+    }
+}
+
+static TickType_t ticks_until(int64_t deadline_us) {
+    int64_t remaining_us = deadline_us - esp_timer_get_time();
+    TickType_t ticks = remaining_us > 0 ? pdMS_TO_TICKS(remaining_us / 1000) : 0;
+    return ticks > 0 ? ticks : 1;
+}
+
+// Longest the receive loop may block before the link or configuration
+// timeouts must run. New profile requests are picked up with the next
+// UART event, which arrives at least once per navigation epoch.
+static TickType_t max_wait(void) {
+    TickType_t wait = portMAX_DELAY;
+    if (!gnss_link_up(&uart_link)) {
+        wait = ticks_until(uart_link.deadline_us);
+    }
+    if (ubx_txn_busy(&cfg_txn)) {
+        TickType_t cfg_wait = ticks_until(cfg_txn.deadline_us);
+        if (cfg_wait < wait) wait = cfg_wait;
+    }
+    return wait;
+}
+
+static void on_gnss_epoch(void *ctx, int64_t last_byte_us, gnss_epoch_end_t reason) {
+    if (!pending_fix) return;
+
+    const gnss_fix_t *fix = pending_fix;
+    gnss_snapshot_publish(&fix_store, fix, last_byte_us);
+    pending_fix = NULL;
+
+    int64_t now = esp_timer_get_time();
+    gnss_rx_record_publish(&gnss_rx, last_byte_us, now);
+
+    if (!(fix->valid & GNSS_VALID_POS) || fix->fix_type < GNSS_FIX_2D || fix->fix_type == GNSS_FIX_TIME_ONLY) {
+        return;
+    }
+    if (ttff_us == 0) {
+        ttff_us = now - power_on_us;
+        ESP_LOGI(TAG, "TTFF %lld ms (%s start, %u sats)", (long long)(ttff_us / 1000), start_kind, fix->num_sv);
+
+        // Keep the system clock for time aiding after an MCU reset
+        const uint16_t dt = GNSS_VALID_DATE | GNSS_VALID_TIME;
+        if ((fix->valid & dt) == dt) {
+            struct timeval tv = {
+                .tv_sec = gnss_aid_utc_seconds(fix->year, fix->month, fix->day, fix->hour, fix->min, fix->sec),
+                .tv_usec = fix->ms * 1000,
+            };
+            settimeofday(&tv, NULL);
+        }
+    }
+    // First fix is saved at once, so a power cut soon after boot still leaves aiding data
+    if (aid_saved_us == 0 || now - aid_saved_us >= AID_SAVE_PERIOD_US) {
+        aid_saved_us = now;
+        esp_err_t err = aid_save(fix);
+        if (err != ESP_OK) ESP_LOGW(TAG, "Saving aiding data failed: %s", esp_err_to_name(err));
+    }
+}
+
+void gnss_power_off(void) {
+    gnss_snapshot_t snap;
+    if (gnss_get_snapshot(&snap)) aid_save(&snap.fix);
+
+    if (sos_supported) {
+        // Receiver must stop navigating before it writes the backup to flash
+        uint8_t frame[GNSS_AID_FRAME_MAX];
+        send_frame(frame, gnss_aid_encode_gnss_stop(frame, sizeof(frame)));
+        send_frame(frame, gnss_aid_encode_sos_create(frame, sizeof(frame)));
+        uart_wait_tx_done(GNSS_UART_NUM, pdMS_TO_TICKS(50));
+        vTaskDelay(pdMS_TO_TICKS(AID_SOS_BACKUP_MS));
+    }
+    gpio_set_level(GNSS_LDO_EN_PIN, 0);
+}
+
+static uint32_t framer_error_total(void) {
+    const gnss_framer_t *fr = &gnss_rx.framer;
+    return fr->nmea.corrupt + fr->nmea.overflowed + fr->ubx.corrupt + fr->ubx.overflowed;
+}
+
+static void log_framer_stats(void) {
+    const gnss_framer_t *fr = &gnss_rx.framer;
+    ESP_LOGW(TAG, "Framer: NMEA ok=%lu bad=%lu ovf=%lu resync=%lu | UBX ok=%lu bad=%lu ovf=%lu resync=%lu | dropped=%lu",
+             (unsigned long)fr->nmea.framed, (unsigned long)fr->nmea.corrupt,
+             (unsigned long)fr->nmea.overflowed, (unsigned long)fr->nmea.resynced,
+             (unsigned long)fr->ubx.framed, (unsigned long)fr->ubx.corrupt,
+             (unsigned long)fr->ubx.overflowed, (unsigned long)fr->ubx.resynced,
+             (unsigned long)fr->dropped_bytes);
+}
+
+static void log_link_stats(void) {
+    ESP_LOGI(TAG, "Link: %lu baud, RX high water %u/%u bytes, FIFO overflows=%lu, buffer full=%lu",
+             (unsigned long)uart_link.baud, (unsigned)link_stats.rx_high_water, (unsigned)link_stats.rx_buf_size,
+             (unsigned long)link_stats.fifo_overflows, (unsigned long)link_stats.buffer_full);
+}
+
+static void sample_rx_level(void) {
+    size_t buffered = 0;
+    if (uart_get_buffered_data_len(GNSS_UART_NUM, &buffered) == ESP_OK &&
+        buffered > link_stats.rx_high_water) {
+        link_stats.rx_high_water = buffered;
+    }
+}
+
+static void log_latency_stats(void) {
+    const latency_hist_t *h = &gnss_rx.latency;
+    ESP_LOGI(TAG, "Fix latency: n=%lu mean=%luus p50<%luus p99<%luus max=%luus (EOE=%lu idle=%lu)",
+             (unsigned long)h->total, (unsigned long)latency_hist_mean(h),
+             (unsigned long)latency_hist_percentile(h, 50), (unsigned long)latency_hist_percentile(h, 99),
+             (unsigned long)h->max_us,
+             (unsigned long)gnss_rx.epochs[GNSS_EPOCH_END_EOE],
+             (unsigned long)gnss_rx.epochs[GNSS_EPOCH_END_IDLE]);
+}
+
+#if GNSS_RX_EVENT_DRIVEN
+// Wait for UART events. A data event flagged as RX timeout means the line
+// went quiet GNSS_RX_TOUT_SYMBOLS ago; no event for GNSS_EPOCH_IDLE_MS
+// closes the epoch when the receiver does not emit NAV-EOE.
+static void gnss_receive(uint8_t *data, TickType_t max_wait) {
+    uint32_t baud = 0;
+    uart_get_baudrate(GNSS_UART_NUM, &baud);
+    int64_t tout_us = baud ? (int64_t)GNSS_RX_TOUT_SYMBOLS * 10 * 1000000 / baud : 0;
+
+    // Only an open epoch without NAV-EOE needs the idle timeout
+    TickType_t wait = max_wait;
+    bool idle_wait = false;
+    if (gnss_rx.epoch_open && !gnss_rx.eoe_seen) {
+        TickType_t idle = pdMS_TO_TICKS(GNSS_EPOCH_IDLE_MS) > 0 ? pdMS_TO_TICKS(GNSS_EPOCH_IDLE_MS) : 1;
+        if (idle <= wait) {
+            wait = idle;
+            idle_wait = true;
         }
+    }
 
-        if (len < 0) continue;
-
-        for (int i = 0; i < len; i++) {
-            uint8_t byte = data[i];
-
-            // 1. NMEA Check ($...CRLF)
-            if (state == PARSE_IDLE || state == PARSE_NMEA) {
-                if (byte == '$') {
-                    state = PARSE_NMEA;
-                    nmea_idx = 0;
-                    nmea_buf[nmea_idx++] = byte;
-                } else if (state == PARSE_NMEA) {
-                    if (nmea_idx < sizeof(nmea_buf) - 1) {
-                        nmea_buf[nmea_idx++] = byte;
-                        if (byte == '\n') {
-                            nmea_buf[nmea_idx] = 0;
-                            // Trim CR LF
-                            char *crlf = strpbrk((char*)nmea_buf, "\r\n");
-                            if (crlf) *crlf = 0;
-
-                            ESP_LOGI(TAG, "NMEA: %s", nmea_buf);
-                            state = PARSE_IDLE;
-                        }
-                    } else {
-                        state = PARSE_IDLE; // Overflow
-                    }
-                }
+    uart_event_t event;
+    if (xQueueReceive(uart_queue, &event, wait) != pdTRUE) {
+        if (idle_wait) gnss_rx_idle(&gnss_rx);
+        return;
+    }
+
+    switch (event.type) {
+        case UART_DATA: {
+            int64_t arrival_us = esp_timer_get_time();
+            if (event.timeout_flag) arrival_us -= tout_us;
+            sample_rx_level();
+
+            size_t remaining = event.size;
+            while (remaining > 0) {
+                int len = uart_read_bytes(GNSS_UART_NUM, data, remaining < BUF_SIZE ? remaining : BUF_SIZE, 0);
+                if (len <= 0) break;
+                gnss_rx_feed(&gnss_rx, data, len, arrival_us);
+                remaining -= len;
             }
+            break;
+        }
+        case UART_FIFO_OVF:
+        case UART_BUFFER_FULL:
+            if (event.type == UART_FIFO_OVF) link_stats.fifo_overflows++;
+            else link_stats.buffer_full++;
+            ESP_LOGW(TAG, "UART RX overflow (event %d), flushing", event.type);
+            uart_flush_input(GNSS_UART_NUM);
+            xQueueReset(uart_queue);
+            break;
+        default:
+            break;
+    }
+}
+#else
+static void gnss_receive(uint8_t *data, TickType_t max_wait) {
+    sample_rx_level();
+
+    // Read data from UART
+    int len = uart_read_bytes(GNSS_UART_NUM, data, BUF_SIZE, pdMS_TO_TICKS(50));
+    if (len > 0) {
+        gnss_rx_feed(&gnss_rx, data, len, esp_timer_get_time());
+    }
+    // A short read means the 50 ms wait expired: treat it as end of epoch
+    if (len < BUF_SIZE) gnss_rx_idle(&gnss_rx);
+}
+#endif
+
+void gnss_task_entry(void *pvParameters) {
+    gnss_init();
+
+    uint8_t *data = (uint8_t *) malloc(BUF_SIZE);
 
-            // 2. UBX Check (0xB5 0x62 ...)
-            if (state == PARSE_IDLE && byte == UBX_SYNC_CHAR_1) {
-                state = PARSE_UBX_SYNC1;
-            } else if (state == PARSE_UBX_SYNC1) {
-                if (byte == UBX_SYNC_CHAR_2) state = PARSE_UBX_CLASS;
-                else state = PARSE_IDLE;
-            } else if (state == PARSE_UBX_CLASS) {
-                ubx_class = byte;
-                state = PARSE_UBX_ID;
-            } else if (state == PARSE_UBX_ID) {
-                ubx_id = byte;
-                state = PARSE_UBX_LEN1;
-            } else if (state == PARSE_UBX_LEN1) {
-                ubx_len = byte;
-                state = PARSE_UBX_LEN2;
-            } else if (state == PARSE_UBX_LEN2) {
-                ubx_len |= (byte << 8);
-                ubx_idx = 0;
-                if (ubx_len > 1024) state = PARSE_IDLE; // Safety
-                else state = PARSE_UBX_PAYLOAD;
-            } else if (state == PARSE_UBX_PAYLOAD) {
-                if (ubx_idx < ubx_len) {
-                    ubx_payload[ubx_idx++] = byte;
-                }
-                if (ubx_idx == ubx_len) state = PARSE_UBX_CKA;
-            } else if (state == PARSE_UBX_CKA) {
-                // ubx_ck_a = byte;
-                state = PARSE_UBX_CKB;
-            } else if (state == PARSE_UBX_CKB) {
-                // ubx_ck_b = byte;
-                // Packet Complete
-                if (ubx_class == UBX_CLASS_ACK) {
-                    if (ubx_id == UBX_ID_ACK_ACK) {
-                        // Payload: CLS ID of acked message
-                        ESP_LOGI(TAG, "UBX ACK-ACK: For Msg 0x%02X-0x%02X", ubx_payload[0], ubx_payload[1]);
-                    } else if (ubx_id == UBX_ID_ACK_NAK) {
-                        ESP_LOGW(TAG, "UBX ACK-NAK: For Msg 0x%02X-0x%02X", ubx_payload[0], ubx_payload[1]);
-                    }
-                } else {
-                    ESP_LOGI(TAG, "UBX Packet: Class=0x%02X ID=0x%02X Len=%d", ubx_class, ubx_id, ubx_len);
-                }
-                state = PARSE_IDLE;
+    nmea_decoder_init(&nmea_dec);
+    ubx_engine_init(&ubx_eng);
+    gnss_rx_init(&gnss_rx, on_gnss_frame, on_gnss_epoch, NULL);
+    gnss_snapshot_init(&fix_store);
+
+    // The default profile is applied once the link is up
+    gnss_link_start(&uart_link, &link_ops, NULL, GNSS_BAUD_RATE, esp_timer_get_time());
+
+    uint32_t errors_logged = 0;
+    uint32_t rounds_logged = 0;
+    int64_t latency_logged_us = esp_timer_get_time();
+    while (1) {
+        gnss_receive(data, max_wait());
+        if (!gnss_link_up(&uart_link)) {
+            gnss_link_poll(&uart_link, esp_timer_get_time());
+            if (uart_link.probe_rounds != rounds_logged) {
+                ESP_LOGW(TAG, "No response from receiver at any baud rate (%lu rounds)",
+                         (unsigned long)uart_link.probe_rounds);
+                rounds_logged = uart_link.probe_rounds;
             }
         }
+        cfg_service();
+
+        uint32_t errors = framer_error_total();
+        if (errors != errors_logged) {
+            log_framer_stats();
+            errors_logged = errors;
+        }
+
+        int64_t now = esp_timer_get_time();
+        if (now - latency_logged_us >= LATENCY_LOG_PERIOD_US) {
+            log_latency_stats();
+            log_link_stats();
+            latency_logged_us = now;
+        }
     }
     free(data);
-    free(ubx_payload);
     vTaskDelete(NULL);
 }
@@ -0,0 +1,139 @@
+#include "gnss_aid.h"
+#include <string.h>
+
+#define MGA_INI_POS_LLH     0x01
+#define MGA_INI_TIME_UTC    0x10
+#define SOS_CMD_CREATE      0
+#define SOS_CMD_RESTORED    3
+#define CFG_RST_GNSS_STOP   0x08
+#define CFG_RST_GNSS_START  0x09
+
+static void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = (v >> (8 * i)) & 0xFF;
+}
+
+int64_t gnss_aid_utc_seconds(uint16_t year, uint8_t month, uint8_t day,
+                             uint8_t hour, uint8_t min, uint8_t sec) {
+    // Days from civil (proleptic Gregorian), March-based year
+    int32_t y = (int32_t)year - (month <= 2);
+    int32_t era = (y >= 0 ? y : y - 399) / 400;
+    int32_t yoe = y - era * 400;
+    int32_t doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    int64_t days = (int64_t)era * 146097 + doe - 719468;
+    return days * 86400 + hour * 3600 + min * 60 + sec;
+}
+
+static void utc_calendar(int64_t utc_s, uint16_t *year, uint8_t *month, uint8_t *day,
+                         uint8_t *hour, uint8_t *min, uint8_t *sec) {
+    int64_t days = utc_s / 86400;
+    int32_t tod = (int32_t)(utc_s % 86400);
+    if (tod < 0) {
+        tod += 86400;
+        days--;
+    }
+    *hour = tod / 3600;
+    *min = (tod / 60) % 60;
+    *sec = tod % 60;
+
+    // Civil from days
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    int32_t doe = (int32_t)(days - era * 146097);
+    int32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int32_t mp = (5 * doy + 2) / 153;
+    *day = doy - (153 * mp + 2) / 5 + 1;
+    *month = mp < 10 ? mp + 3 : mp - 9;
+    *year = (uint16_t)(yoe + era * 400 + (*month <= 2));
+}
+
+bool gnss_aid_record_from_fix(gnss_aid_record_t *rec, const gnss_fix_t *fix, uint8_t flags) {
+    const uint16_t need = GNSS_VALID_POS | GNSS_VALID_DATE | GNSS_VALID_TIME;
+    if ((fix->valid & need) != need) return false;
+
+    memset(rec, 0, sizeof(*rec));
+    rec->version = GNSS_AID_VERSION;
+    rec->flags = flags;
+    rec->fix_type = fix->fix_type;
+    rec->lat = fix->lat;
+    rec->lon = fix->lon;
+    rec->alt_mm = (fix->valid & GNSS_VALID_ALT) ? fix->alt_mm : 0;
+    rec->h_acc_mm = fix->h_acc_mm;
+    rec->utc_s = gnss_aid_utc_seconds(fix->year, fix->month, fix->day, fix->hour, fix->min, fix->sec);
+    return true;
+}
+
+bool gnss_aid_record_valid(const gnss_aid_record_t *rec) {
+    return rec->version == GNSS_AID_VERSION &&
+           rec->lat >= -900000000 && rec->lat <= 900000000 &&
+           rec->lon >= -1800000000 && rec->lon <= 1800000000 &&
+           rec->utc_s >= GNSS_AID_TIME_MIN_UTC_S;
+}
+
+bool gnss_aid_ephemeris_fresh(const gnss_aid_record_t *rec, int64_t now_utc_s) {
+    if (now_utc_s < GNSS_AID_TIME_MIN_UTC_S || now_utc_s < rec->utc_s) return false;
+    return now_utc_s - rec->utc_s < GNSS_AID_EPH_MAX_AGE_S;
+}
+
+size_t gnss_aid_encode_pos(const gnss_aid_record_t *rec, uint8_t *buf, size_t buf_size) {
+    uint8_t p[20] = { 0 };
+    p[0] = MGA_INI_POS_LLH;
+    // Height above MSL stands in for the ellipsoidal height: the geoid
+    // separation is far below the accuracy given
+    put_u32(&p[4], (uint32_t)rec->lat);
+    put_u32(&p[8], (uint32_t)rec->lon);
+    put_u32(&p[12], (uint32_t)(rec->alt_mm / 10));
+    put_u32(&p[16], rec->h_acc_mm / 10 + GNSS_AID_POS_ACC_CM);
+    return ubx_build_frame(UBX_CLASS_MGA, UBX_ID_MGA_INI, p, sizeof(p), buf, buf_size);
+}
+
+size_t gnss_aid_encode_time(int64_t utc_s, uint16_t acc_s, uint8_t *buf, size_t buf_size) {
+    uint16_t year;
+    uint8_t month, day, hour, min, sec;
+    utc_calendar(utc_s, &year, &month, &day, &hour, &min, &sec);
+
+    uint8_t p[24] = { 0 };
+    p[0] = MGA_INI_TIME_UTC;
+    p[2] = 0;                   // Time reference: on receipt of this message
+    p[3] = (uint8_t)-128;       // Leap seconds unknown
+    put_u16(&p[4], year);
+    p[6] = month;
+    p[7] = day;
+    p[8] = hour;
+    p[9] = min;
+    p[10] = sec;
+    put_u16(&p[16], acc_s);
+    return ubx_build_frame(UBX_CLASS_MGA, UBX_ID_MGA_INI, p, sizeof(p), buf, buf_size);
+}
+
+size_t gnss_aid_encode_sos_poll(uint8_t *buf, size_t buf_size) {
+    return ubx_build_frame(UBX_CLASS_UPD, UBX_ID_UPD_SOS, NULL, 0, buf, buf_size);
+}
+
+size_t gnss_aid_encode_sos_create(uint8_t *buf, size_t buf_size) {
+    const uint8_t p[4] = { SOS_CMD_CREATE, 0, 0, 0 };
+    return ubx_build_frame(UBX_CLASS_UPD, UBX_ID_UPD_SOS, p, sizeof(p), buf, buf_size);
+}
+
+size_t gnss_aid_encode_gnss_stop(uint8_t *buf, size_t buf_size) {
+    // navBbrMask 0 (keep everything), resetMode: controlled GNSS stop
+    const uint8_t p[4] = { 0, 0, CFG_RST_GNSS_STOP, 0 };
+    return ubx_build_frame(UBX_CLASS_CFG, UBX_ID_CFG_RST, p, sizeof(p), buf, buf_size);
+}
+
+size_t gnss_aid_encode_gnss_start(uint8_t *buf, size_t buf_size) {
+    const uint8_t p[4] = { 0, 0, CFG_RST_GNSS_START, 0 };
+    return ubx_build_frame(UBX_CLASS_CFG, UBX_ID_CFG_RST, p, sizeof(p), buf, buf_size);
+}
+
+bool gnss_aid_parse_sos(const uint8_t *payload, uint16_t len, gnss_sos_restore_t *status) {
+    if (len < 8 || payload[0] != SOS_CMD_RESTORED) return false;
+    *status = payload[4] <= GNSS_SOS_NO_BACKUP ? (gnss_sos_restore_t)payload[4] : GNSS_SOS_UNKNOWN;
+    return true;
+}
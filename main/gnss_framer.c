@@ -0,0 +1,219 @@
+#include "gnss_framer.h"
+#include "ubx.h"
+#include <string.h>
+
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "SWAR scanning assumes a little-endian target"
+#endif
+
+// SWAR helpers: the lowest flagged byte of each mask is always a true match
+#define SWAR_ONES   0x01010101u
+#define SWAR_HIGHS  0x80808080u
+
+static inline uint32_t swar_zero(uint32_t v) {
+    return (v - SWAR_ONES) & ~v & SWAR_HIGHS;
+}
+
+static inline uint32_t swar_eq(uint32_t v, uint8_t c) {
+    return swar_zero(v ^ (SWAR_ONES * c));
+}
+
+typedef enum {
+    SCAN_SYNC,      // '$' or UBX sync 1
+    SCAN_NMEA_END,  // '\n', '$' or any non-ASCII byte (truncated sentence)
+} scan_mode_t;
+
+typedef enum {
+    FRAME_DONE,     // Frame consumed
+    FRAME_MORE,     // Need more bytes
+    FRAME_SKIP,     // Not a frame here, continue after the sync byte
+} frame_result_t;
+
+static inline bool scan_byte(uint8_t b, scan_mode_t mode) {
+    if (mode == SCAN_SYNC) return b == '$' || b == UBX_SYNC_CHAR_1;
+    return b == '\n' || b == '$' || b >= 0x80;
+}
+
+static inline uint32_t scan_word(uint32_t w, scan_mode_t mode) {
+    if (mode == SCAN_SYNC) return swar_eq(w, '$') | swar_eq(w, UBX_SYNC_CHAR_1);
+    return swar_eq(w, '\n') | swar_eq(w, '$') | (w & SWAR_HIGHS);
+}
+
+// Index of the first matching byte in [from, to), or 'to'
+static inline size_t scan(const uint8_t *buf, size_t from, size_t to, scan_mode_t mode) {
+    size_t i = from;
+
+    // Xtensa faults on unaligned word loads, so walk up to a boundary first
+    while (i < to && ((uintptr_t)(buf + i) & 3)) {
+        if (scan_byte(buf[i], mode)) return i;
+        i++;
+    }
+    while (i + 4 <= to) {
+        uint32_t w;
+        memcpy(&w, __builtin_assume_aligned(buf + i, 4), 4);
+        uint32_t m = scan_word(w, mode);
+        if (m) return i + (__builtin_ctz(m) >> 3);
+        i += 4;
+    }
+    while (i < to) {
+        if (scan_byte(buf[i], mode)) return i;
+        i++;
+    }
+    return to;
+}
+
+static uint8_t nmea_xor(const uint8_t *p, size_t n) {
+    uint8_t x = 0;
+    size_t i = 0;
+
+    while (i < n && ((uintptr_t)(p + i) & 3)) x ^= p[i++];
+
+    uint32_t acc = 0;
+    for (; i + 4 <= n; i += 4) {
+        uint32_t w;
+        memcpy(&w, __builtin_assume_aligned(p + i, 4), 4);
+        acc ^= w;
+    }
+    acc ^= acc >> 16;
+    acc ^= acc >> 8;
+    x ^= (uint8_t)acc;
+
+    while (i < n) x ^= p[i++];
+    return x;
+}
+
+static inline int hex_value(uint8_t c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+// "$....*hh[\r]\n": validate the XOR of everything between '$' and '*'
+static bool nmea_checksum_ok(const uint8_t *s, size_t len) {
+    size_t end = len - 1;                   // '\n'
+    if (end > 0 && s[end - 1] == '\r') end--;
+    if (end < 4 || s[end - 3] != '*') return false;
+
+    int hi = hex_value(s[end - 2]);
+    int lo = hex_value(s[end - 1]);
+    if (hi < 0 || lo < 0) return false;
+
+    return nmea_xor(s + 1, end - 4) == (uint8_t)((hi << 4) | lo);
+}
+
+static void frame_delivered(gnss_framer_t *fr, gnss_framer_stats_t *st, gnss_frame_type_t type,
+                            const uint8_t *frame, size_t len) {
+    st->framed++;
+    if (fr->lost_sync) {
+        st->resynced++;
+        fr->lost_sync = false;
+    }
+    if (fr->cb) fr->cb(fr->ctx, type, frame, len);
+}
+
+static frame_result_t try_nmea(gnss_framer_t *fr, size_t start, size_t *consumed) {
+    size_t limit = fr->len;
+    if (limit - start > GNSS_FRAMER_NMEA_MAX_LEN) limit = start + GNSS_FRAMER_NMEA_MAX_LEN;
+
+    size_t e = scan(fr->buf, start + 1, limit, SCAN_NMEA_END);
+    if (e == limit) {
+        if (limit - start < GNSS_FRAMER_NMEA_MAX_LEN) return FRAME_MORE;
+        fr->nmea.overflowed++;
+        return FRAME_SKIP;
+    }
+    if (fr->buf[e] != '\n') {
+        // Cut short by the next sync or binary data
+        fr->nmea.corrupt++;
+        return FRAME_SKIP;
+    }
+
+    size_t len = e - start + 1;
+    if (!nmea_checksum_ok(&fr->buf[start], len)) {
+        fr->nmea.corrupt++;
+        return FRAME_SKIP;
+    }
+    frame_delivered(fr, &fr->nmea, GNSS_FRAME_NMEA, &fr->buf[start], len);
+    *consumed = len;
+    return FRAME_DONE;
+}
+
+static frame_result_t try_ubx(gnss_framer_t *fr, size_t start, size_t *consumed) {
+    size_t avail = fr->len - start;
+    const uint8_t *p = &fr->buf[start];
+
+    if (avail < 2) return FRAME_MORE;
+    if (p[1] != UBX_SYNC_CHAR_2) return FRAME_SKIP;
+    if (avail < UBX_HEADER_LEN) return FRAME_MORE;
+
+    uint16_t payload_len = (uint16_t)(p[4] | (p[5] << 8));
+    if (payload_len > GNSS_FRAMER_UBX_MAX_PAYLOAD) {
+        fr->ubx.overflowed++;
+        return FRAME_SKIP;
+    }
+
+    size_t total = (size_t)payload_len + UBX_FRAME_OVERHEAD;
+    if (avail < total) return FRAME_MORE;
+
+    uint8_t ck_a, ck_b;
+    ubx_checksum(p[2], p[3], &p[UBX_HEADER_LEN], payload_len, &ck_a, &ck_b);
+    if (ck_a != p[total - 2] || ck_b != p[total - 1]) {
+        fr->ubx.corrupt++;
+        return FRAME_SKIP;
+    }
+    frame_delivered(fr, &fr->ubx, GNSS_FRAME_UBX, p, total);
+    *consumed = total;
+    return FRAME_DONE;
+}
+
+static void framer_process(gnss_framer_t *fr) {
+    size_t pos = 0;
+
+    while (pos < fr->len) {
+        size_t k = scan(fr->buf, pos, fr->len, SCAN_SYNC);
+        if (k > pos) {
+            fr->dropped_bytes += k - pos;
+            fr->lost_sync = true;
+        }
+        pos = k;
+        if (pos >= fr->len) break;
+
+        size_t consumed = 0;
+        frame_result_t r = (fr->buf[pos] == '$') ? try_nmea(fr, pos, &consumed)
+                                                 : try_ubx(fr, pos, &consumed);
+        if (r == FRAME_MORE) break;
+        if (r == FRAME_DONE) {
+            pos += consumed;
+        } else {
+            // Resync at the next candidate after this sync byte
+            fr->dropped_bytes++;
+            fr->lost_sync = true;
+            pos++;
+        }
+    }
+
+    if (pos > 0) {
+        fr->len -= pos;
+        memmove(fr->buf, fr->buf + pos, fr->len);
+    }
+}
+
+void gnss_framer_init(gnss_framer_t *fr, gnss_frame_cb_t cb, void *ctx) {
+    memset(fr, 0, sizeof(*fr));
+    fr->cb = cb;
+    fr->ctx = ctx;
+}
+
+void gnss_framer_feed(gnss_framer_t *fr, const uint8_t *data, size_t len) {
+    while (len > 0) {
+        size_t space = sizeof(fr->buf) - fr->len;
+        size_t n = len < space ? len : space;
+
+        memcpy(fr->buf + fr->len, data, n);
+        fr->len += n;
+        data += n;
+        len -= n;
+
+        framer_process(fr);
+    }
+}
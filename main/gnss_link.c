@@ -0,0 +1,147 @@
+#include "gnss_link.h"
+#include <string.h>
+
+// Rates tried after the target, in the order a receiver is likely to be at
+static const uint32_t std_bauds[] = { 9600, 38400, 115200, 230400, 460800, 921600 };
+#define NUM_CANDIDATES (1 + sizeof(std_bauds) / sizeof(std_bauds[0]))
+
+// Frame sizes including the UBX header/checksum or the NMEA "$...*CS\r\n"
+#define UBX_NAV_PVT_BYTES       100
+#define UBX_NAV_DOP_BYTES       26
+#define UBX_NAV_EOE_BYTES       12
+#define UBX_NAV_TIMEUTC_BYTES   28
+#define UBX_NAV_SAT_BYTES(n)    (16 + 12 * (n))
+#define NMEA_RMC_BYTES          72
+#define NMEA_GGA_BYTES          78
+#define NMEA_GSA_BYTES          66      // One per constellation
+#define NMEA_GSV_BYTES          70      // Four satellites per sentence
+
+#define RX_BUF_MIN  1024
+#define RX_BUF_MAX  16384
+
+static uint32_t candidate(const gnss_link_t *link, uint8_t idx) {
+    return idx == 0 ? link->target_baud : std_bauds[idx - 1];
+}
+
+static void probe(gnss_link_t *link, int64_t now_us) {
+    link->state = GNSS_LINK_PROBING;
+    link->baud = candidate(link, link->probe_idx);
+    link->ops->set_baud(link->ctx, link->baud);
+    link->ops->send_poll(link->ctx);
+    link->deadline_us = now_us + GNSS_LINK_PROBE_WINDOW_US;
+}
+
+static void probe_next(gnss_link_t *link, int64_t now_us) {
+    do {
+        if (++link->probe_idx >= NUM_CANDIDATES) {
+            link->probe_idx = 0;
+            link->probe_rounds++;
+        }
+    } while (link->probe_idx > 0 && candidate(link, link->probe_idx) == link->target_baud);
+    probe(link, now_us);
+}
+
+void gnss_link_start(gnss_link_t *link, const gnss_link_ops_t *ops, void *ctx,
+                     uint32_t target_baud, int64_t now_us) {
+    memset(link, 0, sizeof(*link));
+    link->ops = ops;
+    link->ctx = ctx;
+    link->target_baud = target_baud;
+    link->started_us = now_us;
+    probe(link, now_us);
+}
+
+bool gnss_link_on_frame(gnss_link_t *link, int64_t now_us) {
+    switch (link->state) {
+        case GNSS_LINK_PROBING:
+            link->detected_baud = link->baud;
+            if (link->baud != link->target_baud &&
+                link->switch_attempts < GNSS_LINK_SWITCH_ATTEMPTS) {
+                // Receiver switches as soon as the command is processed; the
+                // ACK would already be sent at the new rate
+                link->switch_attempts++;
+                link->ops->send_baud_cfg(link->ctx, link->target_baud);
+                link->state = GNSS_LINK_SWITCHING;
+                link->deadline_us = now_us + GNSS_LINK_SWITCH_DELAY_US;
+                return false;
+            }
+            break;
+        case GNSS_LINK_VERIFYING:
+            break;
+        default:
+            return false;
+    }
+
+    link->state = GNSS_LINK_UP;
+    link->fallback = link->baud != link->target_baud;
+    link->up_us = now_us;
+    return true;
+}
+
+void gnss_link_poll(gnss_link_t *link, int64_t now_us) {
+    if (link->state == GNSS_LINK_UP || now_us < link->deadline_us) return;
+
+    switch (link->state) {
+        case GNSS_LINK_PROBING:
+            probe_next(link, now_us);
+            break;
+        case GNSS_LINK_SWITCHING:
+            link->state = GNSS_LINK_VERIFYING;
+            link->baud = link->target_baud;
+            link->ops->set_baud(link->ctx, link->baud);
+            link->ops->send_poll(link->ctx);
+            link->deadline_us = now_us + GNSS_LINK_PROBE_WINDOW_US;
+            break;
+        case GNSS_LINK_VERIFYING:
+            // Nothing heard at the new rate: find the receiver again
+            link->probe_idx = 0;
+            probe(link, now_us);
+            break;
+        default:
+            break;
+    }
+}
+
+static uint32_t num_systems(const gnss_profile_t *profile) {
+    uint32_t n = 0;
+    for (uint8_t m = profile->constellations & ~GNSS_CONST_SBAS; m; m &= m - 1) n++;
+    return n ? n : 1;
+}
+
+static uint32_t epoch_bytes(const gnss_profile_t *profile) {
+    uint32_t bytes = UBX_NAV_PVT_BYTES + UBX_NAV_DOP_BYTES + UBX_NAV_EOE_BYTES;
+    if (!profile->ubx_only) {
+        bytes += NMEA_RMC_BYTES + NMEA_GGA_BYTES + NMEA_GSA_BYTES * num_systems(profile);
+    }
+    return bytes;
+}
+
+// Satellite lists and time, output once per second
+static uint32_t list_bytes(const gnss_profile_t *profile, uint8_t num_sv) {
+    uint32_t bytes = UBX_NAV_TIMEUTC_BYTES + UBX_NAV_SAT_BYTES(num_sv);
+    if (!profile->ubx_only) {
+        // Each constellation starts its own GSV group
+        bytes += NMEA_GSV_BYTES * ((num_sv + 3) / 4 + num_systems(profile));
+    }
+    return bytes;
+}
+
+uint32_t gnss_link_burst_bytes(const gnss_profile_t *profile, uint8_t num_sv) {
+    return epoch_bytes(profile) + list_bytes(profile, num_sv);
+}
+
+uint32_t gnss_link_bytes_per_sec(const gnss_profile_t *profile, uint8_t num_sv) {
+    return epoch_bytes(profile) * profile->rate_hz + list_bytes(profile, num_sv);
+}
+
+size_t gnss_link_rx_buffer_size(const gnss_profile_t *profile, uint8_t num_sv) {
+    uint32_t need = 2 * gnss_link_burst_bytes(profile, num_sv);
+    size_t size = RX_BUF_MIN;
+    while (size < need && size < RX_BUF_MAX) size <<= 1;
+    return size;
+}
+
+bool gnss_link_baud_sufficient(const gnss_profile_t *profile, uint8_t num_sv, uint32_t baud) {
+    // 10 bits per byte on an 8N1 line
+    return (uint64_t)gnss_link_bytes_per_sec(profile, num_sv) * 10 * 4 <= (uint64_t)baud * 3;
+}
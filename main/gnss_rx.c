@@ -0,0 +1,47 @@
+#include "gnss_rx.h"
+#include "ubx.h"
+#include <string.h>
+
+static void close_epoch(gnss_rx_t *rx, gnss_epoch_end_t reason) {
+    rx->epoch_open = false;
+    rx->epochs[reason]++;
+    if (rx->epoch_cb) rx->epoch_cb(rx->ctx, rx->last_byte_us, reason);
+}
+
+static void on_frame(void *ctx, gnss_frame_type_t type, const uint8_t *frame, size_t len) {
+    gnss_rx_t *rx = (gnss_rx_t *)ctx;
+
+    rx->epoch_open = true;
+    rx->last_byte_us = rx->chunk_us;
+    if (rx->frame_cb) rx->frame_cb(rx->ctx, type, frame, len);
+
+    if (type == GNSS_FRAME_UBX && frame[2] == UBX_CLASS_NAV && frame[3] == UBX_ID_NAV_EOE) {
+        rx->eoe_seen = true;
+        close_epoch(rx, GNSS_EPOCH_END_EOE);
+    }
+}
+
+void gnss_rx_init(gnss_rx_t *rx, gnss_frame_cb_t frame_cb, gnss_epoch_cb_t epoch_cb, void *ctx) {
+    memset(rx, 0, sizeof(*rx));
+    gnss_framer_init(&rx->framer, on_frame, rx);
+    rx->frame_cb = frame_cb;
+    rx->epoch_cb = epoch_cb;
+    rx->ctx = ctx;
+}
+
+void gnss_rx_feed(gnss_rx_t *rx, const uint8_t *data, size_t len, int64_t arrival_us) {
+    rx->chunk_us = arrival_us;
+    gnss_framer_feed(&rx->framer, data, len);
+}
+
+void gnss_rx_idle(gnss_rx_t *rx) {
+    if (rx->epoch_open && !rx->eoe_seen) {
+        close_epoch(rx, GNSS_EPOCH_END_IDLE);
+    }
+}
+
+void gnss_rx_record_publish(gnss_rx_t *rx, int64_t last_byte_us, int64_t published_us) {
+    int64_t dt = published_us - last_byte_us;
+    if (dt < 0) dt = 0;
+    latency_hist_add(&rx->latency, dt > UINT32_MAX ? UINT32_MAX : (uint32_t)dt);
+}
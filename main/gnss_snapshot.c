@@ -0,0 +1,83 @@
+#include "gnss_snapshot.h"
+#include <stddef.h>
+#include <string.h>
+
+// A reader that preempted the writer mid-publish on the same core would
+// spin forever, so readers give up after a few attempts instead
+#define READ_MAX_ATTEMPTS 8
+
+typedef union {
+    gnss_snapshot_t snap;
+    uint32_t words[GNSS_SNAPSHOT_WORDS];
+} snapshot_buf_t;
+
+// Epoch lives at a fixed word so readers can peek at it without a full copy
+#define EPOCH_WORD (offsetof(gnss_snapshot_t, epoch) / 4)
+
+_Static_assert(offsetof(gnss_snapshot_t, epoch) % 4 == 0, "epoch must be word aligned");
+
+void gnss_snapshot_init(gnss_snapshot_store_t *store) {
+    atomic_init(&store->seq, 0);
+    for (size_t i = 0; i < GNSS_SNAPSHOT_WORDS; i++) {
+        atomic_init(&store->words[i], 0);
+    }
+}
+
+uint32_t gnss_snapshot_publish(gnss_snapshot_store_t *store, const gnss_fix_t *fix, int64_t capture_us) {
+    snapshot_buf_t buf;
+
+    uint32_t epoch = atomic_load_explicit(&store->words[EPOCH_WORD], memory_order_relaxed) + 1;
+    memset(&buf, 0, sizeof(buf));
+    buf.snap.fix = *fix;
+    buf.snap.epoch = epoch;
+    buf.snap.capture_us = capture_us;
+
+    unsigned seq = atomic_load_explicit(&store->seq, memory_order_relaxed);
+    atomic_store_explicit(&store->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    for (size_t i = 0; i < GNSS_SNAPSHOT_WORDS; i++) {
+        atomic_store_explicit(&store->words[i], buf.words[i], memory_order_relaxed);
+    }
+
+    atomic_store_explicit(&store->seq, seq + 2, memory_order_release);
+    return epoch;
+}
+
+static bool snapshot_copy(const gnss_snapshot_store_t *store, uint32_t last_epoch, bool only_newer,
+                          gnss_snapshot_t *out) {
+    snapshot_buf_t buf;
+
+    for (int attempt = 0; ; attempt++) {
+        if (attempt == READ_MAX_ATTEMPTS) return false;
+
+        unsigned seq1 = atomic_load_explicit(&store->seq, memory_order_acquire);
+        if (seq1 & 1) continue;     // Publish in progress
+        if (seq1 == 0) return false;
+
+        if (only_newer &&
+            atomic_load_explicit(&store->words[EPOCH_WORD], memory_order_relaxed) == last_epoch) {
+            atomic_thread_fence(memory_order_acquire);
+            if (atomic_load_explicit(&store->seq, memory_order_relaxed) == seq1) return false;
+            continue;
+        }
+
+        for (size_t i = 0; i < GNSS_SNAPSHOT_WORDS; i++) {
+            buf.words[i] = atomic_load_explicit(&store->words[i], memory_order_relaxed);
+        }
+
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&store->seq, memory_order_relaxed) == seq1) break;
+    }
+
+    *out = buf.snap;
+    return true;
+}
+
+bool gnss_snapshot_read(const gnss_snapshot_store_t *store, gnss_snapshot_t *out) {
+    return snapshot_copy(store, 0, false, out);
+}
+
+bool gnss_snapshot_read_newer(const gnss_snapshot_store_t *store, uint32_t last_epoch, gnss_snapshot_t *out) {
+    return snapshot_copy(store, last_epoch, true, out);
+}
@@ -0,0 +1,130 @@
+#include "gpx_writer.h"
+#include <stdio.h>
+#include <string.h>
+
+#define PUT(p, lit) (memcpy((p), (lit), sizeof(lit) - 1), (p) + sizeof(lit) - 1)
+
+static const char gpx_footer[] = "</trkseg></trk>\n</gpx>\n";
+
+static const uint32_t pow10_u32[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000 };
+
+void gpx_writer_init(gpx_writer_t *w, const chunk_writer_config_t *cfg) {
+    memset(w, 0, sizeof(*w));
+    chunk_writer_init(&w->out, cfg);
+    latency_hist_reset(&w->format_us);
+}
+
+// Decimal, zero padded to at least min_digits
+static char *put_uint(char *p, uint32_t v, int min_digits) {
+    char tmp[10];
+    int n = 0;
+    do {
+        tmp[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    while (n < min_digits) tmp[n++] = '0';
+    while (n) *p++ = tmp[--n];
+    return p;
+}
+
+// v / 10^decimals with every fraction digit, no float rounding
+static char *put_fixed(char *p, int32_t v, int decimals) {
+    uint32_t u = (uint32_t)v;
+    if (v < 0) {
+        *p++ = '-';
+        u = 0u - u;
+    }
+    uint32_t scale = pow10_u32[decimals];
+    p = put_uint(p, u / scale, 1);
+    if (decimals) {
+        *p++ = '.';
+        p = put_uint(p, u % scale, decimals);
+    }
+    return p;
+}
+
+static uint32_t format_point(char *buf, const gpx_point_t *pt) {
+    char *p = buf;
+    p = PUT(p, "<trkpt lat=\"");
+    p = put_fixed(p, pt->lat, 7);
+    p = PUT(p, "\" lon=\"");
+    p = put_fixed(p, pt->lon, 7);
+    p = PUT(p, "\"><ele>");
+    p = put_fixed(p, pt->ele_mm, 3);
+    p = PUT(p, "</ele><time>");
+    p = put_uint(p, pt->year, 4);
+    *p++ = '-';
+    p = put_uint(p, pt->month, 2);
+    *p++ = '-';
+    p = put_uint(p, pt->day, 2);
+    *p++ = 'T';
+    p = put_uint(p, pt->hour, 2);
+    *p++ = ':';
+    p = put_uint(p, pt->min, 2);
+    *p++ = ':';
+    p = put_uint(p, pt->sec, 2);
+    *p++ = '.';
+    p = put_uint(p, pt->ms, 3);
+    p = PUT(p, "Z</time>");
+    // GPX fix: 3d includes GNSS + dead reckoning, pure DR has no GPX value
+    if (pt->fix_type == 2) {
+        p = PUT(p, "<fix>2d</fix>");
+    } else if (pt->fix_type == 3 || pt->fix_type == 4) {
+        p = PUT(p, "<fix>3d</fix>");
+    }
+    p = PUT(p, "<sat>");
+    p = put_uint(p, pt->num_sv, 1);
+    p = PUT(p, "</sat><hdop>");
+    p = put_fixed(p, pt->hdop, 2);
+    p = PUT(p, "</hdop><extensions><gpxtpx:TrackPointExtension><gpxtpx:atemp>");
+    p = put_fixed(p, pt->temp_c10, 1);
+    p = PUT(p, "</gpxtpx:atemp><gpxtpx:speed>");
+    p = put_fixed(p, (int32_t)pt->speed_mmps, 3);
+    p = PUT(p, "</gpxtpx:speed><gpxtpx:course>");
+    p = put_fixed(p, pt->course / 1000, 2);
+    p = PUT(p, "</gpxtpx:course></gpxtpx:TrackPointExtension><log:g>");
+    p = put_fixed(p, pt->g_milli, 3);
+    p = PUT(p, "</log:g><log:bat>");
+    p = put_uint(p, pt->bat_mv, 1);
+    p = PUT(p, "</log:bat><log:mode>");
+    p = put_uint(p, pt->mode, 1);
+    p = PUT(p, "</log:mode><log:pbox>");
+    p = put_uint(p, pt->pbox, 1);
+    p = PUT(p, "</log:pbox></extensions></trkpt>\n");
+    return (uint32_t)(p - buf);
+}
+
+int gpx_writer_open(gpx_writer_t *w, const char *path, const char *name) {
+    if (chunk_writer_open(&w->out, path) != 0) return -1;
+
+    char header[512];
+    int len = snprintf(header, sizeof(header),
+                       "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                       "<gpx version=\"1.1\" creator=\"ESP32-S3 GPS Logger\""
+                       " xmlns=\"http://www.topografix.com/GPX/1/1\""
+                       " xmlns:gpxtpx=\"http://www.garmin.com/xmlschemas/TrackPointExtension/v2\""
+                       " xmlns:log=\"urn:esp32-gps-logger:track:1\">\n"
+                       "<trk><name>%.64s</name><trkseg>\n", name);
+    chunk_writer_stage(&w->out, header, (uint32_t)len);
+    return 0;
+}
+
+bool gpx_writer_add(gpx_writer_t *w, const gpx_point_t *p) {
+    int64_t t0 = w->out.clock_us();
+    char buf[GPX_WRITER_POINT_MAX];
+    uint32_t len = format_point(buf, p);
+    if (!chunk_writer_stage(&w->out, buf, len)) {
+        w->dropped++;
+        return false;
+    }
+    w->points++;
+    latency_hist_add(&w->format_us, (uint32_t)(w->out.clock_us() - t0));
+    return true;
+}
+
+int gpx_writer_close(gpx_writer_t *w) {
+    if (!chunk_writer_is_open(&w->out)) return 0;
+    // With a failed flush the ring may still be full: close what is there
+    if (chunk_writer_flush(&w->out) >= 0) chunk_writer_stage(&w->out, gpx_footer, sizeof(gpx_footer) - 1);
+    return chunk_writer_close(&w->out);
+}
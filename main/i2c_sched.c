@@ -0,0 +1,110 @@
+#include "i2c_sched.h"
+#include <string.h>
+
+void i2c_sched_init(i2c_sched_t *s, const i2c_bus_ops_t *ops, void *ctx) {
+    memset(s, 0, sizeof(*s));
+    s->ops = ops;
+    s->ctx = ctx;
+}
+
+static bool more_urgent(const i2c_txn_t *a, const i2c_txn_t *b) {
+    if (a->prio != b->prio) return a->prio < b->prio;
+    return a->deadline_us < b->deadline_us;
+}
+
+void i2c_sched_submit(i2c_sched_t *s, i2c_txn_t *txn, int64_t now_us) {
+    txn->status = I2C_TXN_QUEUED;
+    txn->queued_us = now_us;
+
+    i2c_txn_t **pp = &s->queue;
+    while (*pp && !more_urgent(txn, *pp)) pp = &(*pp)->next;
+    txn->next = *pp;
+    *pp = txn;
+}
+
+static bool mergeable(const i2c_txn_t *t) {
+    return !(t->flags & (I2C_TXN_WRITE | I2C_TXN_NO_MERGE));
+}
+
+i2c_txn_t *i2c_sched_pop(i2c_sched_t *s) {
+    i2c_txn_t *head = s->queue;
+    if (!head) return NULL;
+    s->queue = head->next;
+    head->next = NULL;
+    if (!mergeable(head)) return head;
+
+    // Grow the register range until no queued read touches it; a read that
+    // bridges two others can pull in the second one on the next pass
+    unsigned lo = head->reg, hi = head->reg + head->len;
+    i2c_txn_t *tail = head;
+    bool grew = true;
+    while (grew) {
+        grew = false;
+        i2c_txn_t **pp = &s->queue;
+        while (*pp) {
+            i2c_txn_t *t = *pp;
+            unsigned t_lo = t->reg, t_hi = t->reg + t->len;
+            unsigned new_lo = t_lo < lo ? t_lo : lo;
+            unsigned new_hi = t_hi > hi ? t_hi : hi;
+            if (t->dev == head->dev && mergeable(t) && t_lo <= hi && t_hi >= lo &&
+                new_hi - new_lo <= I2C_SCHED_MAX_BURST) {
+                *pp = t->next;
+                t->next = NULL;
+                tail->next = t;
+                tail = t;
+                lo = new_lo;
+                hi = new_hi;
+                grew = true;
+            } else {
+                pp = &t->next;
+            }
+        }
+    }
+    return head;
+}
+
+void i2c_sched_execute(i2c_sched_t *s, i2c_txn_t *batch) {
+    i2c_sched_stats_t *st = &s->stats;
+    bool merged = batch->next != NULL;
+
+    unsigned lo = batch->reg, hi = batch->reg + batch->len;
+    uint32_t timeout_us = batch->timeout_us;
+    for (i2c_txn_t *t = batch->next; t; t = t->next) {
+        if (t->reg < lo) lo = t->reg;
+        if (t->reg + t->len > hi) hi = t->reg + t->len;
+        if (t->timeout_us > timeout_us) timeout_us = t->timeout_us;
+    }
+
+    uint8_t *buf = merged ? s->burst : batch->data;
+    int64_t start_us = s->ops->now_us(s->ctx);
+    int status = s->ops->transfer(s->ctx, batch->dev, (uint8_t)lo, batch->flags & I2C_TXN_WRITE,
+                                  buf, hi - lo, timeout_us);
+    int64_t end_us = s->ops->now_us(s->ctx);
+
+    st->transfers++;
+    st->busy_us += end_us - start_us;
+    if (status == I2C_TXN_TIMEOUT) {
+        st->timeouts++;
+        s->ops->recover(s->ctx);
+    } else if (status != I2C_TXN_OK) {
+        status = I2C_TXN_ERROR;
+        st->errors++;
+    }
+
+    i2c_txn_t *t = batch;
+    while (t) {
+        // The completion may reuse the transaction
+        i2c_txn_t *next = t->next;
+        if (merged && status == I2C_TXN_OK) memcpy(t->data, s->burst + (t->reg - lo), t->len);
+        if (t != batch) st->merged++;
+        if (start_us > t->deadline_us) st->late++;
+        latency_hist_add(&st->queue_delay, (uint32_t)(start_us - t->queued_us));
+
+        t->status = status;
+        t->start_us = start_us;
+        t->end_us = end_us;
+        t->next = NULL;
+        if (t->done) t->done(t, t->arg);
+        t = next;
+    }
+}
@@ -0,0 +1,245 @@
+#include "imu_bias.h"
+#include <math.h>
+#include <string.h>
+
+#define ACCEL_BIAS_MAX_G    0.1f    // Larger sphere offsets are a bad fit
+#define ACCEL_SCALE_TOL     0.1f    // Sphere radius within 1 +- this
+
+bool imu_bias_table_valid(const imu_bias_table_t *t) {
+    if (t->version != IMU_BIAS_VERSION) return false;
+    for (int i = 0; i < IMU_BIAS_NODES; i++) {
+        if (!(t->weight[i] >= 0.0f)) return false;
+        for (int k = 0; k < 3; k++) {
+            if (!isfinite(t->gyro[i][k])) return false;
+        }
+    }
+    return !t->accel_valid || (isfinite(t->accel[0]) && isfinite(t->accel[1]) && isfinite(t->accel[2]));
+}
+
+static void window_reset(imu_bias_t *e) {
+    e->n = 0;
+    memset(e->sum, 0, sizeof(e->sum));
+    memset(e->sq, 0, sizeof(e->sq));
+    e->temp_sum = 0.0f;
+}
+
+void imu_bias_init(imu_bias_t *e, const imu_bias_params_t *params, const imu_bias_table_t *stored) {
+    memset(e, 0, sizeof(*e));
+    e->params = *params;
+    if (stored && imu_bias_table_valid(stored)) {
+        e->table = *stored;
+    } else {
+        e->table.version = IMU_BIAS_VERSION;
+    }
+    window_reset(e);
+}
+
+// Fractional node position of a temperature, clamped to the table
+static float node_pos(float temp, int *i) {
+    float x = (temp - IMU_BIAS_TEMP_MIN) / IMU_BIAS_TEMP_STEP;
+    if (!(x > 0.0f)) x = 0.0f;
+    if (x > IMU_BIAS_NODES - 1) x = IMU_BIAS_NODES - 1;
+    *i = (int)x;
+    if (*i > IMU_BIAS_NODES - 2) *i = IMU_BIAS_NODES - 2;
+    return x - *i;
+}
+
+static void node_add(imu_bias_t *e, int i, float w, const float g[3]) {
+    if (w <= 0.0f) return;
+    imu_bias_table_t *t = &e->table;
+    float total = t->weight[i] + w;
+    float k = w / total;
+    for (int a = 0; a < 3; a++) t->gyro[i][a] += k * (g[a] - t->gyro[i][a]);
+    t->weight[i] = total < e->params.node_weight_max ? total : e->params.node_weight_max;
+}
+
+// 4x4 upper triangle, row-major
+static int tri4(int i, int j) {
+    return i * 4 - i * (i - 1) / 2 + (j - i);
+}
+
+// One still orientation on the gravity sphere |a - b| = r:
+// 2 a.b + (r^2 - |b|^2) = |a|^2, linear in b and c = r^2 - |b|^2
+static void sphere_add(imu_bias_t *e, const float a[3]) {
+    const double row[4] = { 2.0 * a[0], 2.0 * a[1], 2.0 * a[2], 1.0 };
+    double rhs = (double)a[0] * a[0] + (double)a[1] * a[1] + (double)a[2] * a[2];
+    for (int i = 0; i < 4; i++) {
+        for (int j = i; j < 4; j++) e->ata[tri4(i, j)] += row[i] * row[j];
+        e->atb[i] += row[i] * rhs;
+    }
+
+    int k = 0;
+    if (fabsf(a[1]) > fabsf(a[k])) k = 1;
+    if (fabsf(a[2]) > fabsf(a[k])) k = 2;
+    e->faces |= 1u << (k * 2 + (a[k] < 0.0f));
+    if (e->faces != (1u << IMU_BIAS_ACCEL_FACES) - 1) return;
+
+    double l[4][4] = { { 0 } }, y[4], x[4];
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j <= i; j++) {
+            double s = e->ata[tri4(j, i)];
+            for (int m = 0; m < j; m++) s -= l[i][m] * l[j][m];
+            if (i == j) {
+                if (s <= 0.0) return;
+                l[i][i] = sqrt(s);
+            } else {
+                l[i][j] = s / l[j][j];
+            }
+        }
+    }
+    for (int i = 0; i < 4; i++) {
+        double s = e->atb[i];
+        for (int m = 0; m < i; m++) s -= l[i][m] * y[m];
+        y[i] = s / l[i][i];
+    }
+    for (int i = 3; i >= 0; i--) {
+        double s = y[i];
+        for (int m = i + 1; m < 4; m++) s -= l[m][i] * x[m];
+        x[i] = s / l[i][i];
+    }
+
+    double b2 = x[0] * x[0] + x[1] * x[1] + x[2] * x[2];
+    double r = sqrt(fmax(x[3] + b2, 0.0));
+    if (sqrt(b2) > ACCEL_BIAS_MAX_G || fabs(r - 1.0) > ACCEL_SCALE_TOL) return;
+    for (int i = 0; i < 3; i++) e->table.accel[i] = (float)x[i];
+    e->table.accel_valid = true;
+}
+
+static bool predict(const imu_bias_t *e, float temp, float gyro[3]);
+
+static bool window_end(imu_bias_t *e) {
+    const imu_bias_params_t *p = &e->params;
+    float mean[6];
+    bool still = true;
+    for (int k = 0; k < 6; k++) {
+        float m = e->sum[k] / e->n;
+        float var = e->sq[k] / e->n - m * m;
+        mean[k] = e->ref[k] + m;
+        float limit = k < 3 ? p->gyro_std : p->accel_std;
+        if (var > limit * limit) still = false;
+        if (k < 3 && fabsf(mean[k]) > p->gyro_max) still = false;
+    }
+    float norm = sqrtf(mean[3] * mean[3] + mean[4] * mean[4] + mean[5] * mean[5]);
+    if (fabsf(norm - 1.0f) > p->accel_norm) still = false;
+    float temp = e->temp_sum / e->n;
+    window_reset(e);
+    e->windows++;
+
+    if (!still) {
+        imu_bias_veto(e);
+        return false;
+    }
+    if (e->still_count < UINT8_MAX) e->still_count++;
+    // The first windows may still hold the end of the last movement
+    if (e->still_count < p->still_windows) return false;
+
+    // Compared with the stretch so far, or with what is known before it.
+    // A mismatch ends the stretch; after enough of them in a row it is
+    // taken as a real bias shift.
+    float known[3];
+    bool have = e->stretch_n > 0 ? (memcpy(known, e->live, sizeof(known)), true) : predict(e, temp, known);
+    if (have && e->mismatch < p->relearn_windows) {
+        for (int k = 0; k < 3; k++) {
+            if (fabsf(mean[k] - known[k]) > p->gyro_step) {
+                e->mismatch++;
+                e->stretch_n = 0;
+                memset(e->stretch, 0, sizeof(e->stretch));
+                return false;
+            }
+        }
+    }
+    e->mismatch = 0;
+
+    e->stretch_n++;
+    for (int k = 0; k < 3; k++) {
+        e->stretch[k] += mean[k];
+        e->live[k] = e->stretch[k] / e->stretch_n;
+    }
+    e->live_temp = temp;
+    e->live_valid = true;
+
+    int i;
+    float f = node_pos(temp, &i);
+    node_add(e, i, 1.0f - f, mean);
+    node_add(e, i + 1, f, mean);
+    sphere_add(e, &mean[3]);
+    e->still++;
+    return true;
+}
+
+bool imu_bias_feed(imu_bias_t *e, const imu_sample_t *s) {
+    const float v[6] = { s->gx, s->gy, s->gz, s->ax, s->ay, s->az };
+    if (e->n == 0) memcpy(e->ref, v, sizeof(e->ref));
+    for (int k = 0; k < 6; k++) {
+        float d = v[k] - e->ref[k];
+        e->sum[k] += d;
+        e->sq[k] += d * d;
+    }
+    e->temp_sum += s->temp;
+    return ++e->n >= e->params.window && window_end(e);
+}
+
+void imu_bias_veto(imu_bias_t *e) {
+    window_reset(e);
+    e->still_count = 0;
+    e->mismatch = 0;
+    e->stretch_n = 0;
+    memset(e->stretch, 0, sizeof(e->stretch));
+}
+
+bool imu_bias_still(const imu_bias_t *e) {
+    return e->stretch_n > 0;
+}
+
+// Bias from the table and the last stretch, ignoring the current stillness;
+// false if nothing has been measured yet
+static bool predict(const imu_bias_t *e, float temp, float gyro[3]) {
+    const imu_bias_table_t *t = &e->table;
+    int i;
+    float f = node_pos(temp, &i);
+    if (t->weight[i] > 0.0f && t->weight[i + 1] > 0.0f) {
+        for (int k = 0; k < 3; k++) gyro[k] = t->gyro[i][k] + f * (t->gyro[i + 1][k] - t->gyro[i][k]);
+        return true;
+    }
+
+    // Nearest measurement: a table node or the last still stretch
+    float x = i + f;
+    int best = -1;
+    for (int j = 0; j < IMU_BIAS_NODES; j++) {
+        if (t->weight[j] > 0.0f && (best < 0 || fabsf(j - x) < fabsf(best - x))) best = j;
+    }
+    float node_dist = best >= 0 ? fabsf(best - x) * IMU_BIAS_TEMP_STEP : INFINITY;
+    if (e->live_valid && fabsf(temp - e->live_temp) <= node_dist) {
+        memcpy(gyro, e->live, sizeof(e->live));
+    } else if (best >= 0) {
+        memcpy(gyro, t->gyro[best], sizeof(t->gyro[best]));
+    } else {
+        gyro[0] = gyro[1] = gyro[2] = 0.0f;
+        return false;
+    }
+    return true;
+}
+
+void imu_bias_get(const imu_bias_t *e, float temp, float gyro[3], float accel[3]) {
+    const imu_bias_table_t *t = &e->table;
+    for (int k = 0; k < 3; k++) accel[k] = t->accel_valid ? t->accel[k] : 0.0f;
+    if (imu_bias_still(e)) {
+        memcpy(gyro, e->live, sizeof(e->live));
+    } else {
+        predict(e, temp, gyro);
+    }
+}
+
+void imu_bias_apply(const imu_bias_t *e, imu_sample_t *s, size_t n) {
+    if (n == 0) return;
+    float g[3], a[3];
+    imu_bias_get(e, s[0].temp, g, a);
+    for (size_t i = 0; i < n; i++) {
+        s[i].gx -= g[0];
+        s[i].gy -= g[1];
+        s[i].gz -= g[2];
+        s[i].ax -= a[0];
+        s[i].ay -= a[1];
+        s[i].az -= a[2];
+    }
+}
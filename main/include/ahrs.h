@@ -0,0 +1,79 @@
+#ifndef AHRS_H
+#define AHRS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sensor_types.h"
+
+// Pure C, no ESP-IDF dependencies: builds on Linux as well.
+
+#define AHRS_MAX_DT_S       0.1f    // Longer gaps restart integration
+
+/**
+ * @brief Madgwick gradient-descent attitude filter, one instance per user
+ *
+ * The quaternion rotates device vectors into the earth frame (x magnetic
+ * north, y west, z up). Accelerometer readings are specific force, so
+ * a device at rest reads +1 g along earth z.
+ */
+typedef struct {
+    float q[4];             // w, x, y, z
+    float beta;             // Correction gain, rad/s
+    float accel_gate;       // g: skip the accel correction when | |a| - 1 | exceeds this
+    int64_t last_us;        // Time of the last block sample, 0 = none
+    bool initialized;       // q set from the first accel (+ mag) reading
+    uint32_t gated;         // Updates that ran without the accel correction
+} ahrs_t;
+
+/**
+ * @brief Reset the filter
+ *
+ * @param beta Gain; about sqrt(3/4) x gyro error in rad/s
+ * @param accel_gate Acceleration beyond which gravity is not trusted (g),
+ *                   0 = always trust it
+ */
+void ahrs_init(ahrs_t *f, float beta, float accel_gate);
+
+/**
+ * @brief One filter step
+ *
+ * The first call aligns the quaternion with the accel (and mag) reading
+ * instead of converging from identity.
+ *
+ * @param gyro rad/s
+ * @param acc g
+ * @param mag Any unit, NULL = no heading correction
+ * @param dt Seconds since the previous update
+ */
+void ahrs_update(ahrs_t *f, const float gyro[3], const float acc[3], const float *mag, float dt);
+
+/**
+ * @brief Run a FIFO block through the filter, dt taken from the timestamps
+ *
+ * @param mag Latest magnetometer sample applied to the whole block, NULL = none
+ * @param out One output per input sample, NULL = not needed
+ */
+void ahrs_update_block(ahrs_t *f, const imu_sample_t *s, size_t n, const mag_sample_t *mag,
+                       attitude_sample_t *out);
+
+/**
+ * @brief Gravity direction in device axes (unit vector, g)
+ */
+void ahrs_gravity(const float q[4], float g_body[3]);
+
+/**
+ * @brief Remove gravity from an accelerometer reading
+ *
+ * @param acc g, device axes
+ * @param lin_body Out, device axes (may be NULL)
+ * @param lin_earth Out, earth axes (may be NULL)
+ */
+void ahrs_linear_accel(const float q[4], const float acc[3], float lin_body[3], float lin_earth[3]);
+
+/**
+ * @brief Heading of the device x axis, degrees clockwise from magnetic north
+ */
+float ahrs_heading(const float q[4]);
+
+#endif // AHRS_H
@@ -0,0 +1,92 @@
+#ifndef ALTITUDE_H
+#define ALTITUDE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Pure C, no ESP-IDF dependencies: builds on Linux as well.
+
+#define ALTITUDE_P_MIN_HPA  250.0f      // Kernel range, about 10.4 km ...
+#define ALTITUDE_P_MAX_HPA  1150.0f     // ... to -1 km in the standard atmosphere
+
+/**
+ * @brief (p / 1013.25)^0.190263 from a cubic Hermite table, no powf
+ *
+ * Pressure is clamped to the kernel range.
+ */
+float altitude_pressure_ratio(float pressure_hpa);
+
+/**
+ * @brief Altitude from pressure
+ *
+ * Hypsometric formula with the given station temperature; the standard
+ * atmosphere when temp_c is NaN. Both refer to 1013.25 hPa at sea level,
+ * the QNH offset is left to the caller (or altitude_kf_t).
+ *
+ * @return m
+ */
+float altitude_from_pressure(float pressure_hpa, float temp_c);
+
+/**
+ * @brief Fused vertical channel at one baro sample
+ */
+typedef struct {
+    int64_t t_us;
+    float altitude;         // m above MSL (pressure altitude before the first GNSS fix)
+    float vspeed;           // m/s, up
+    float sigma;            // m, 1 sigma of the altitude
+} altitude_sample_t;
+
+typedef struct {
+    float accel_noise;      // m/s^2, vertical acceleration of the constant-velocity model
+    float bias_walk;        // m per sqrt(s): QNH drift with the weather
+    float baro_sigma;       // m, baro altitude noise
+    float gnss_floor;       // m, lower bound of the GNSS altitude sigma
+} altitude_kf_params_t;
+
+#define ALTITUDE_KF_DEFAULT_PARAMS { \
+    .accel_noise = 0.5f,            \
+    .bias_walk = 0.05f,             \
+    .baro_sigma = 0.3f,             \
+    .gnss_floor = 3.0f,             \
+}
+
+/**
+ * @brief Vertical-channel Kalman filter: altitude, vertical speed and the
+ *        baro offset (QNH error expressed in metres)
+ *
+ * Baro altitude (h + offset) is applied at sensor rate and keeps the
+ * output smooth; GNSS altitude (h) pins the offset slowly. Before the
+ * first GNSS fix the output is pressure altitude.
+ */
+typedef struct {
+    altitude_kf_params_t params;
+    float x[3];             // h (m), vz (m/s), baro offset (m)
+    float P[3][3];
+    int64_t t_us;           // Time of the state, 0 = not initialised
+    bool gnss_seen;
+    uint32_t rejected;      // Measurements outside the gate
+} altitude_kf_t;
+
+void altitude_kf_init(altitude_kf_t *f, const altitude_kf_params_t *params);
+
+/**
+ * @brief Predict to t_us and apply one baro altitude (altitude_from_pressure)
+ */
+void altitude_kf_baro(altitude_kf_t *f, int64_t t_us, float baro_alt);
+
+/**
+ * @brief Predict to t_us and apply a GNSS altitude above MSL
+ *
+ * @param sigma Vertical accuracy (m), floored at params.gnss_floor
+ */
+void altitude_kf_gnss(altitude_kf_t *f, int64_t t_us, float alt, float sigma);
+
+void altitude_kf_output(const altitude_kf_t *f, altitude_sample_t *out);
+
+/**
+ * @brief Sea-level pressure implied by the offset, for display
+ */
+float altitude_kf_qnh(const altitude_kf_t *f);
+
+#endif // ALTITUDE_H
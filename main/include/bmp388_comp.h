@@ -0,0 +1,68 @@
+#ifndef BMP388_COMP_H
+#define BMP388_COMP_H
+
+#include <stdint.h>
+
+// Pure C, no ESP-IDF dependencies: builds on Linux as well.
+
+#define BMP388_CALIB_REG    0x31
+#define BMP388_CALIB_LEN    21
+
+/**
+ * @brief Trimming coefficients as stored in the sensor NVM
+ */
+typedef struct {
+    uint16_t par_t1;
+    uint16_t par_t2;
+    int8_t   par_t3;
+    int16_t  par_p1;
+    int16_t  par_p2;
+    int8_t   par_p3;
+    int8_t   par_p4;
+    uint16_t par_p5;
+    uint16_t par_p6;
+    int8_t   par_p7;
+    int8_t   par_p8;
+    int16_t  par_p9;
+    int8_t   par_p10;
+    int8_t   par_p11;
+} bmp388_calib_t;
+
+/**
+ * @brief Coefficients scaled per the datasheet for the double-precision path
+ */
+typedef struct {
+    double T1, T2, T3;
+    double P1, P2, P3, P4, P5, P6, P7, P8, P9, P10, P11;
+} bmp388_calib_double_t;
+
+void bmp388_calib_parse(const uint8_t nvm[BMP388_CALIB_LEN], bmp388_calib_t *calib);
+
+void bmp388_calib_to_double(const bmp388_calib_t *calib, bmp388_calib_double_t *out);
+
+/**
+ * @brief 64-bit integer compensation (Bosch reference integer algorithm)
+ *
+ * Results are clamped to the sensor's operating range.
+ *
+ * @param calib Coefficients
+ * @param raw_press 24-bit pressure reading
+ * @param raw_temp 24-bit temperature reading
+ * @param temp_cdeg Temperature in 0.01 deg C
+ * @param press_cpa Pressure in 0.01 Pa
+ */
+void bmp388_compensate_int(const bmp388_calib_t *calib, uint32_t raw_press, uint32_t raw_temp,
+                           int32_t *temp_cdeg, uint32_t *press_cpa);
+
+/**
+ * @brief Double-precision compensation (datasheet floating point algorithm)
+ *
+ * Reference for the integer path; soft-float on the ESP32-S3.
+ *
+ * @param temp_c Temperature in deg C
+ * @param press_pa Pressure in Pa
+ */
+void bmp388_compensate_double(const bmp388_calib_double_t *calib, uint32_t raw_press, uint32_t raw_temp,
+                              double *temp_c, double *press_pa);
+
+#endif // BMP388_COMP_H
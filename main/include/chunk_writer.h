@@ -0,0 +1,138 @@
+#ifndef CHUNK_WRITER_H
+#define CHUNK_WRITER_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "latency_hist.h"
+
+// Pure C, no ESP-IDF dependencies: builds on Linux as well. The file is
+// driven through POSIX calls only (open/pwrite/ftruncate/fsync), which the
+// ESP-IDF FAT VFS provides, so the same code runs against a Linux file.
+
+#define CHUNK_WRITER_CHUNK      (32 * 1024)     // Bytes per write: one FAT cluster
+#define CHUNK_WRITER_SECTOR     512
+
+/**
+ * @brief Append-only file with a staging ring between producer and SD
+ *
+ * The producer copies finished records into the ring and never waits:
+ * when the ring is full the record is refused. The flushing task writes
+ * only whole CHUNK_WRITER_CHUNK blocks, so every write but the last
+ * starts on a chunk boundary of the file, and grows the file ahead of
+ * the data with ftruncate so the FAT chain is extended prealloc bytes at
+ * a time rather than on every write. With at least two chunks in the
+ * ring one fills while the other is written. Close writes the tail and
+ * trims the file to its real length.
+ *
+ * Between chunks, chunk_writer_commit puts the partial chunk on the card
+ * in whole sectors at its final offset and syncs, so a power loss costs
+ * at most the data staged since the last commit. Because the file is
+ * already allocated past the data, such a write changes no FAT metadata
+ * and costs one sync; the chunk is written again in one piece once
+ * complete. The file is only synced there, at close and when it grows.
+ *
+ * One producer and one flusher; the ring indices are free-running byte
+ * counts shared through atomics, as in sample_ring_t.
+ */
+typedef struct {
+    uint8_t *ring;
+    uint32_t mask;          // Ring size - 1
+    uint8_t *bounce;        // Optional chunk-sized copy target for the write (DMA-capable RAM)
+    int64_t (*clock_us)(void);
+
+    atomic_uint head;       // Bytes staged (producer)
+    atomic_uint tail;       // Bytes written to the file (flusher)
+    int fd;
+    uint32_t file_len;      // Bytes written
+    uint32_t alloc_len;     // Bytes reserved with ftruncate
+    uint32_t prealloc;
+    uint32_t committed;     // Stream bytes on the card in the partial chunk (tail-relative)
+
+    uint32_t high_water;    // Most bytes ever waiting in the ring (producer)
+    latency_hist_t flush_us;    // Per write (flusher)
+    latency_hist_t commit_us;   // Per commit, write and sync
+    uint32_t write_errors;
+} chunk_writer_t;
+
+typedef struct {
+    void *ring;             // Staging buffer
+    uint32_t ring_size;     // Bytes, power of two, at least two chunks
+    void *bounce;           // NULL = write straight from the ring
+    uint32_t prealloc;      // Bytes the file grows by at a time, multiple of CHUNK_WRITER_CHUNK
+    int64_t (*clock_us)(void);  // Monotonic time for the statistics
+} chunk_writer_config_t;
+
+void chunk_writer_init(chunk_writer_t *w, const chunk_writer_config_t *cfg);
+
+/**
+ * @brief Create the file (flusher, no producer running)
+ *
+ * An existing file is never overwritten: that fails with EEXIST.
+ *
+ * @return 0, or -1 with errno set
+ */
+int chunk_writer_open(chunk_writer_t *w, const char *path);
+
+/**
+ * @brief Copy len bytes into the ring (producer, never blocks)
+ *
+ * @return false if they did not fit; nothing was staged
+ */
+bool chunk_writer_stage(chunk_writer_t *w, const void *src, uint32_t len);
+
+/**
+ * @brief Bytes staged and not yet written
+ */
+static inline uint32_t chunk_writer_pending(const chunk_writer_t *w) {
+    return atomic_load_explicit(&w->head, memory_order_acquire) -
+           atomic_load_explicit(&w->tail, memory_order_relaxed);
+}
+
+/**
+ * @brief Free ring space for the producer
+ */
+static inline uint32_t chunk_writer_space(const chunk_writer_t *w) {
+    return w->mask + 1 - (atomic_load_explicit(&w->head, memory_order_relaxed) -
+                          atomic_load_explicit(&w->tail, memory_order_acquire));
+}
+
+/**
+ * @brief Bytes staged so far, i.e. the file offset of the next staged byte
+ *        (producer)
+ */
+static inline uint32_t chunk_writer_staged(const chunk_writer_t *w) {
+    return atomic_load_explicit(&w->head, memory_order_relaxed);
+}
+
+/**
+ * @brief Write every complete chunk in the ring (flusher)
+ *
+ * @return Chunks written, -1 on a write error (the chunk stays staged)
+ */
+int chunk_writer_flush(chunk_writer_t *w);
+
+/**
+ * @brief Put the staged part of the current chunk on the card and sync
+ *        (flusher); the caller bounds how often
+ *
+ * The last sector is padded with zeros.
+ *
+ * @return 1 if something was written, 0 if there was nothing new, -1 on
+ *         error
+ */
+int chunk_writer_commit(chunk_writer_t *w);
+
+/**
+ * @brief Write the rest, trim, sync and close (flusher, after the
+ *        producer has stopped)
+ *
+ * @return 0, or -1 with errno set; the file is closed either way
+ */
+int chunk_writer_close(chunk_writer_t *w);
+
+static inline bool chunk_writer_is_open(const chunk_writer_t *w) {
+    return w->fd >= 0;
+}
+
+#endif // CHUNK_WRITER_H
@@ -24,7 +24,19 @@
 #define GNSS_TX_PIN_ESP     18
 #define GNSS_RX_PIN_ESP     17
 #define GNSS_LDO_EN_PIN     14
-#define GNSS_BAUD_RATE      115200
+#define GNSS_BAUD_RATE      460800  // Negotiated at start-up (460800 or 921600)
+
+// GNSS reception: 1 = UART event queue with RX timeout (epoch processed as
+// soon as its last byte arrives), 0 = legacy 50 ms polling
+#define GNSS_RX_EVENT_DRIVEN    1
+#define GNSS_RX_TOUT_SYMBOLS    3   // RX timeout interrupt after 3 idle symbol times
+#define GNSS_EPOCH_IDLE_MS      3   // Quiet time closing an epoch when NAV-EOE is absent
+
+// Default GNSS profile applied at boot (see gnss_profile_t in ubx_cfg.h)
+#define GNSS_DEFAULT_RATE_HZ        10      // 1 / 5 / 10 / 25
+#define GNSS_DEFAULT_DYN_MODEL      4       // Automotive
+#define GNSS_DEFAULT_CONSTELLATIONS 0x1D    // GPS + Galileo + BeiDou + QZSS
+#define GNSS_DEFAULT_UBX_ONLY       0       // 1 = disable NMEA output
 
 // I2C
 #define I2C_MASTER_NUM      I2C_NUM_0
@@ -58,6 +70,8 @@
 #define ENC_A_PIN           1
 #define ENC_B_PIN           3
 #define KEY_MAIN_PIN        2
+#define KEY_POWER_OFF_MS    5000    // Main key held this long: power off
+#define KEY_STOP_WAIT_MS    3000    // Power-off waits this long for an open track to close
 
 // Debug UART
 #define DEBUG_UART_NUM      UART_NUM_0
@@ -72,5 +86,51 @@
 #define IMU_I2C_ADDR        0x6A
 #define MAG_I2C_ADDR        0x1E
 #define BARO_I2C_ADDR       0x76
+#define IMU_INT_PIN         41  // ACCGYRO_INT -> LSM6DSR INT1
+
+// LSM6DSR FIFO batching
+#define IMU_FIFO_ODR_HZ     416 // Accel and gyro rate while batching
+#define IMU_FIFO_WATERMARK  32  // Sample sets per interrupt (~13 Hz at 416 Hz)
+
+// Sensor service: polling rates and ring depths (samples, power of two)
+#define SENSOR_MAG_RATE_HZ      50
+#define SENSOR_BARO_RATE_HZ     25
+#define SENSOR_IMU_RING_LEN     512     // ~1.2 s at 416 Hz
+#define SENSOR_MAG_RING_LEN     64
+#define SENSOR_BARO_RING_LEN    32
+#define SENSOR_I2C_TIMEOUT_MS   20      // Per transaction; a stuck device fails instead of blocking
+
+// Attitude filter (Madgwick), run on every IMU sample
+#define AHRS_BETA               0.05f   // rad/s, ~sqrt(3/4) x gyro error
+#define AHRS_ACCEL_GATE_G       0.1f    // Gravity not trusted beyond 1 +- this
+#define AHRS_MAG_MAX_AGE_US     (200 * 1000)    // Older mag samples are not fused
+#define SENSOR_MAG_CAL_TIMEOUT_US   (60 * 1000 * 1000)  // Rotation time allowed for a calibration
+#define IMU_BIAS_SAVE_PERIOD_US     (10LL * 60 * 1000 * 1000)   // Learned table written to NVS at most this often
+#define IMU_BIAS_MAG_VETO_COS       0.9986f     // cos(3 deg): mag turning more than this ends a still stretch
+#define SENSOR_ATT_RING_LEN     128
+
+// GNSS/IMU fusion (nav_ekf), output sampled on IMU time
+#define NAV_OUTPUT_HZ           100
+#define NAV_RING_LEN            128     // ~1.3 s at 100 Hz
+#define NAV_ALT_RING_LEN        64      // Fused altitude, one per baro sample
+#define NAV_PBOX_RING_LEN       8       // Completed P-Box runs
+#define NAV_GNSS_LATENCY_US     (50 * 1000)     // Fix validity to the end of its epoch on the UART
+
+// Track logger (gpx_writer): points staged in RAM, written to SD in whole chunks
+#define LOGGER_MOUNT_POINT      "/sdcard"
+#define LOGGER_GPX_DIR          LOGGER_MOUNT_POINT "/GPX"
+#define LOGGER_RING_PSRAM       (256 * 1024)    // ~6 s of 100 Hz points: covers SD garbage collection stalls
+#define LOGGER_RING_INTERNAL    (64 * 1024)     // Without PSRAM: two chunks
+#define LOGGER_PREALLOC         (1024 * 1024)   // File grown this far ahead of the data
+#define LOGGER_FORMAT_TRK       1       // 1 = binary .TRK with IMU and baro (tools/trk_convert), 0 = .GPX
+#define LOGGER_IMU_DECIM        4       // IMU samples averaged per .TRK record (104 Hz)
+#define LOGGER_INDEX_PATH       LOGGER_GPX_DIR "/TRACKS.IDX"   // Session summaries (track_index)
+#define LOGGER_COMMIT_PERIOD_US (5 * 1000 * 1000)   // Partial chunk synced to SD: at most this much track lost, 12 syncs/min
+#define LOGGER_RIDE_RING_LEN    4       // Ride statistics (ride_stats), one per fix
+#define LOGGER_RIDE_SAVE_PERIOD_US  (60 * 1000 * 1000)  // Ride statistics written to NVS at most this often while moving
+
+// BMP388 compensation: 1 = 64-bit integer (Bosch reference), 0 = double
+// precision (software floating point on the ESP32-S3)
+#define BMP388_INTEGER_COMPENSATION 1
 
 #endif // CONFIG_H
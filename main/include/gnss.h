@@ -1,10 +1,19 @@
 #ifndef GNSS_H
 #define GNSS_H
 
+#include <stdbool.h>
+#include <stdint.h>
 #include "esp_err.h"
+#include "gnss_snapshot.h"
+#include "ubx_cfg.h"
+#include "sat_table.h"
 
 /**
- * @brief Initialize GNSS UART and switch baud rate to 115200
+ * @brief Initialize the GNSS UART and power up the receiver
+ *
+ * The UART starts at 9600 baud with its RX ring sized for the default
+ * profile. The link rate is negotiated later by the GNSS task: it probes
+ * for the receiver's current rate and raises it to GNSS_BAUD_RATE.
  *
  * @return esp_err_t ESP_OK on success
  */
@@ -16,4 +25,61 @@ esp_err_t gnss_init(void);
  */
 void gnss_task_entry(void *pvParameters);
 
+/**
+ * @brief Copy the latest published fix
+ *
+ * Lock-free; safe from any task and never blocks the GNSS task.
+ *
+ * @param out Snapshot destination
+ * @return true if a fix has been published
+ */
+bool gnss_get_snapshot(gnss_snapshot_t *out);
+
+/**
+ * @brief Copy the latest fix only if its epoch differs from last_epoch
+ *
+ * @param last_epoch Epoch of the caller's previous snapshot (0 for none)
+ * @param out Snapshot destination
+ * @return true if a newer epoch was copied
+ */
+bool gnss_get_snapshot_newer(uint32_t last_epoch, gnss_snapshot_t *out);
+
+/**
+ * @brief Lock the satellite table for reading
+ *
+ * Walk it in CN0 order with sat_table_sorted() and release it quickly:
+ * the GNSS task waits at most a few ms before skipping an update.
+ *
+ * @param timeout_ms Maximum wait
+ * @return Table, or NULL on timeout (do not unlock then)
+ */
+const sat_table_t *gnss_sats_lock(int timeout_ms);
+
+/**
+ * @brief Release the satellite table
+ */
+void gnss_sats_unlock(void);
+
+/**
+ * @brief Request a receiver profile (rate, dynamic model, constellations)
+ *
+ * The GNSS task sends it as a single CFG-VALSET, waits for ACK-ACK/NAK
+ * and retries on timeout; the outcome is logged. A newer request
+ * replaces one that has not been started yet.
+ *
+ * @param profile Profile to apply
+ * @return esp_err_t ESP_ERR_INVALID_STATE before gnss_init()
+ */
+esp_err_t gnss_set_profile(const gnss_profile_t *profile);
+
+/**
+ * @brief Save the receiver state and switch the receiver off
+ *
+ * Stores the last fix in NVS for MGA-INI aiding on the next boot and, if
+ * the receiver supports it, stops it and has it write a UPD-SOS backup
+ * before its supply is cut. For the power-off key only: the receiver
+ * does not navigate again until the next gnss_init().
+ */
+void gnss_power_off(void);
+
 #endif // GNSS_H
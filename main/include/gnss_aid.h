@@ -0,0 +1,109 @@
+#ifndef GNSS_AID_H
+#define GNSS_AID_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "gnss_types.h"
+#include "ubx.h"
+
+// Pure C, no ESP-IDF dependencies: builds on Linux as well. The caller
+// stores the record (NVS) and sends the encoded frames.
+
+#define GNSS_AID_VERSION        1
+#define GNSS_AID_FLAG_SOS       0x01            // Receiver answered UPD-SOS: backups possible
+
+#define GNSS_AID_POS_ACC_CM     (10 * 1000 * 100)   // Device may have moved while off
+#define GNSS_AID_EPH_MAX_AGE_S  (4 * 3600)          // Broadcast ephemeris usable for about 4 h
+#define GNSS_AID_TIME_MIN_UTC_S 1704067200          // 2024-01-01: older clocks are not set
+
+#define GNSS_AID_FRAME_MAX      (8 + 24)        // Largest frame encoded here (MGA-INI-TIME_UTC)
+
+/**
+ * @brief UPD-SOS restore status reported after boot
+ */
+typedef enum {
+    GNSS_SOS_UNKNOWN = 0,
+    GNSS_SOS_FAILED = 1,
+    GNSS_SOS_RESTORED = 2,
+    GNSS_SOS_NO_BACKUP = 3,
+} gnss_sos_restore_t;
+
+/**
+ * @brief Last known receiver state, persisted across power cycles
+ */
+typedef struct {
+    uint16_t version;           // GNSS_AID_VERSION
+    uint8_t flags;              // GNSS_AID_FLAG_*
+    uint8_t fix_type;
+    int32_t lat;                // 1e-7 deg
+    int32_t lon;                // 1e-7 deg
+    int32_t alt_mm;             // Height above MSL
+    uint32_t h_acc_mm;
+    int64_t utc_s;              // Time of the fix, seconds since 1970-01-01 UTC
+} gnss_aid_record_t;
+
+/**
+ * @brief Seconds since 1970-01-01 for a UTC calendar date and time
+ */
+int64_t gnss_aid_utc_seconds(uint16_t year, uint8_t month, uint8_t day,
+                             uint8_t hour, uint8_t min, uint8_t sec);
+
+/**
+ * @brief Fill a record from a fix
+ *
+ * @return false if the fix has no position, date or time
+ */
+bool gnss_aid_record_from_fix(gnss_aid_record_t *rec, const gnss_fix_t *fix, uint8_t flags);
+
+/**
+ * @brief Check a record read back from storage
+ */
+bool gnss_aid_record_valid(const gnss_aid_record_t *rec);
+
+/**
+ * @brief Broadcast ephemeris from the record's time is still usable at now_utc_s
+ *        (hot start possible); false also when the time is unknown
+ */
+bool gnss_aid_ephemeris_fresh(const gnss_aid_record_t *rec, int64_t now_utc_s);
+
+/**
+ * @brief Encode UBX-MGA-INI-POS_LLH from the record
+ *
+ * @return Frame length, 0 if buf is too small
+ */
+size_t gnss_aid_encode_pos(const gnss_aid_record_t *rec, uint8_t *buf, size_t buf_size);
+
+/**
+ * @brief Encode UBX-MGA-INI-TIME_UTC
+ *
+ * @param utc_s Current UTC time
+ * @param acc_s Accuracy of utc_s in seconds
+ * @return Frame length, 0 if buf is too small
+ */
+size_t gnss_aid_encode_time(int64_t utc_s, uint16_t acc_s, uint8_t *buf, size_t buf_size);
+
+/**
+ * @brief Encode UBX-UPD-SOS: empty poll (restore status) or create backup
+ */
+size_t gnss_aid_encode_sos_poll(uint8_t *buf, size_t buf_size);
+size_t gnss_aid_encode_sos_create(uint8_t *buf, size_t buf_size);
+
+/**
+ * @brief Encode UBX-CFG-RST controlled GNSS stop, required before a backup
+ */
+size_t gnss_aid_encode_gnss_stop(uint8_t *buf, size_t buf_size);
+
+/**
+ * @brief Encode UBX-CFG-RST controlled GNSS start; harmless while running
+ */
+size_t gnss_aid_encode_gnss_start(uint8_t *buf, size_t buf_size);
+
+/**
+ * @brief Parse a UPD-SOS restore status message (cmd 3)
+ *
+ * @return false if the payload is not a restore status
+ */
+bool gnss_aid_parse_sos(const uint8_t *payload, uint16_t len, gnss_sos_restore_t *status);
+
+#endif // GNSS_AID_H
@@ -0,0 +1,60 @@
+#ifndef GNSS_FRAMER_H
+#define GNSS_FRAMER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Pure C, no ESP-IDF dependencies: builds on Linux as well.
+
+#define GNSS_FRAMER_BUF_SIZE        2048
+#define GNSS_FRAMER_NMEA_MAX_LEN    128     // NMEA 0183 allows 82, leave room for extensions
+#define GNSS_FRAMER_UBX_MAX_PAYLOAD 1024
+
+typedef enum {
+    GNSS_FRAME_NMEA,
+    GNSS_FRAME_UBX,
+} gnss_frame_type_t;
+
+typedef struct {
+    uint32_t framed;        // Frames delivered with a valid checksum
+    uint32_t corrupt;       // Checksum failure or frame cut short by a new sync
+    uint32_t overflowed;    // Length beyond the protocol limit
+    uint32_t resynced;      // Frames acquired after discarding bytes
+} gnss_framer_stats_t;
+
+/**
+ * @brief Frame callback
+ *
+ * NMEA frames span '$' through '\n'; UBX frames span the sync chars
+ * through CK_B. Checksums have already been verified. The pointer is
+ * only valid for the duration of the call.
+ */
+typedef void (*gnss_frame_cb_t)(void *ctx, gnss_frame_type_t type, const uint8_t *frame, size_t len);
+
+typedef struct {
+    uint8_t buf[GNSS_FRAMER_BUF_SIZE] __attribute__((aligned(4)));
+    size_t len;
+    bool lost_sync;         // Bytes were discarded since the last good frame
+
+    gnss_frame_cb_t cb;
+    void *ctx;
+
+    gnss_framer_stats_t nmea;
+    gnss_framer_stats_t ubx;
+    uint32_t dropped_bytes;
+} gnss_framer_t;
+
+void gnss_framer_init(gnss_framer_t *fr, gnss_frame_cb_t cb, void *ctx);
+
+/**
+ * @brief Feed a chunk of received bytes
+ *
+ * Sync candidates ('$', 0xB5 0x62) and NMEA terminators are located a
+ * word at a time. After a checksum or length error the framer restarts
+ * at the next candidate after the failed sync, so a corrupt length
+ * field never swallows the frames that follow it.
+ */
+void gnss_framer_feed(gnss_framer_t *fr, const uint8_t *data, size_t len);
+
+#endif // GNSS_FRAMER_H
@@ -0,0 +1,104 @@
+#ifndef GNSS_LINK_H
+#define GNSS_LINK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "ubx_cfg.h"
+
+// Pure C, no ESP-IDF dependencies: builds on Linux as well. The caller
+// performs the UART operations through gnss_link_ops_t and reports every
+// valid frame and the passage of time.
+
+#define GNSS_LINK_PROBE_WINDOW_US   (1200 * 1000)   // Power-on output rate is 1 Hz
+#define GNSS_LINK_SWITCH_DELAY_US   (100 * 1000)    // Let the VALSET drain before retuning
+#define GNSS_LINK_SWITCH_ATTEMPTS   2
+#define GNSS_LINK_MAX_SV            48              // Worst case used for load estimates
+
+typedef enum {
+    GNSS_LINK_PROBING,      // Looking for the receiver's current baud rate
+    GNSS_LINK_SWITCHING,    // Baud change sent, waiting before retuning the UART
+    GNSS_LINK_VERIFYING,    // Listening for valid frames at the new rate
+    GNSS_LINK_UP,           // Valid frames at link->baud
+} gnss_link_state_t;
+
+typedef struct {
+    void (*set_baud)(void *ctx, uint32_t baud);         // Retune the local UART, drop pending input
+    void (*send_poll)(void *ctx);                       // Provoke output (UBX-MON-VER poll)
+    void (*send_baud_cfg)(void *ctx, uint32_t baud);    // CFG-VALSET CFG-UART1-BAUDRATE
+} gnss_link_ops_t;
+
+typedef struct {
+    const gnss_link_ops_t *ops;
+    void *ctx;
+
+    uint32_t target_baud;
+    uint32_t baud;              // Current local UART rate
+    uint32_t detected_baud;     // Rate the receiver answered at, 0 = not found yet
+    uint8_t state;              // gnss_link_state_t
+    uint8_t probe_idx;
+    uint8_t switch_attempts;
+    bool fallback;              // Switch failed, running at detected_baud
+    uint32_t probe_rounds;      // Completed passes over the candidate list
+    int64_t deadline_us;
+    int64_t started_us;
+    int64_t up_us;
+} gnss_link_t;
+
+/**
+ * @brief UART receive buffer statistics (filled in by the driver glue)
+ */
+typedef struct {
+    size_t rx_buf_size;
+    size_t rx_high_water;       // Most bytes ever waiting in the RX ring
+    uint32_t fifo_overflows;    // Hardware FIFO overran before the ISR ran
+    uint32_t buffer_full;       // RX ring full, bytes lost
+} gnss_link_stats_t;
+
+/**
+ * @brief Start probing for the receiver and negotiate target_baud
+ *
+ * The target rate is tried first (receiver kept its setting across an MCU
+ * reset), then the standard rates from 9600 up.
+ */
+void gnss_link_start(gnss_link_t *link, const gnss_link_ops_t *ops, void *ctx,
+                     uint32_t target_baud, int64_t now_us);
+
+/**
+ * @brief Report a frame that passed its checksum at the current rate
+ *
+ * @return true if the link just came up
+ */
+bool gnss_link_on_frame(gnss_link_t *link, int64_t now_us);
+
+/**
+ * @brief Advance timeouts; call at link->deadline_us while the link is not up
+ */
+void gnss_link_poll(gnss_link_t *link, int64_t now_us);
+
+static inline bool gnss_link_up(const gnss_link_t *link) {
+    return link->state == GNSS_LINK_UP;
+}
+
+/**
+ * @brief Bytes of the largest epoch burst (the one carrying the 1 Hz
+ *        satellite lists) for a profile
+ */
+uint32_t gnss_link_burst_bytes(const gnss_profile_t *profile, uint8_t num_sv);
+
+/**
+ * @brief Average line load for a profile in bytes per second
+ */
+uint32_t gnss_link_bytes_per_sec(const gnss_profile_t *profile, uint8_t num_sv);
+
+/**
+ * @brief RX ring size holding two worst-case bursts, power of two
+ */
+size_t gnss_link_rx_buffer_size(const gnss_profile_t *profile, uint8_t num_sv);
+
+/**
+ * @brief Check that a profile keeps the line below 75 % utilization
+ */
+bool gnss_link_baud_sufficient(const gnss_profile_t *profile, uint8_t num_sv, uint32_t baud);
+
+#endif // GNSS_LINK_H
@@ -0,0 +1,71 @@
+#ifndef GNSS_RX_H
+#define GNSS_RX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "gnss_framer.h"
+#include "latency_hist.h"
+
+// Pure C, no ESP-IDF dependencies: builds on Linux as well. The UART
+// (or a fake source on the host) pushes chunks and idle notifications.
+
+typedef enum {
+    GNSS_EPOCH_END_EOE,     // UBX NAV-EOE received
+    GNSS_EPOCH_END_IDLE,    // Line went idle after an epoch's burst
+    GNSS_EPOCH_END_COUNT,
+} gnss_epoch_end_t;
+
+/**
+ * @brief Epoch completion callback
+ *
+ * @param ctx User context
+ * @param last_byte_us Arrival time of the epoch's last byte
+ * @param reason What closed the epoch
+ */
+typedef void (*gnss_epoch_cb_t)(void *ctx, int64_t last_byte_us, gnss_epoch_end_t reason);
+
+typedef struct {
+    gnss_framer_t framer;
+
+    gnss_frame_cb_t frame_cb;
+    gnss_epoch_cb_t epoch_cb;
+    void *ctx;
+
+    bool epoch_open;        // Frames received since the last epoch end
+    bool eoe_seen;          // Receiver emits NAV-EOE, idle gaps no longer close epochs
+    int64_t chunk_us;       // Arrival time of the chunk being fed
+    int64_t last_byte_us;   // Arrival time of the newest byte
+
+    uint32_t epochs[GNSS_EPOCH_END_COUNT];
+    latency_hist_t latency; // Last byte received -> fix published
+} gnss_rx_t;
+
+void gnss_rx_init(gnss_rx_t *rx, gnss_frame_cb_t frame_cb, gnss_epoch_cb_t epoch_cb, void *ctx);
+
+/**
+ * @brief Feed received bytes
+ *
+ * Frames are forwarded to frame_cb. A NAV-EOE frame closes the epoch
+ * immediately, before the rest of the chunk is processed.
+ *
+ * @param rx Receiver state
+ * @param data Bytes
+ * @param len Number of bytes
+ * @param arrival_us Arrival time of the last byte in this chunk
+ */
+void gnss_rx_feed(gnss_rx_t *rx, const uint8_t *data, size_t len, int64_t arrival_us);
+
+/**
+ * @brief Report that the line has been idle since the last chunk
+ *
+ * Closes an open epoch unless the receiver is known to emit NAV-EOE.
+ */
+void gnss_rx_idle(gnss_rx_t *rx);
+
+/**
+ * @brief Record the time an epoch's fix became visible to readers
+ */
+void gnss_rx_record_publish(gnss_rx_t *rx, int64_t last_byte_us, int64_t published_us);
+
+#endif // GNSS_RX_H
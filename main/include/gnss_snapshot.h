@@ -0,0 +1,64 @@
+#ifndef GNSS_SNAPSHOT_H
+#define GNSS_SNAPSHOT_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "gnss_types.h"
+
+// Pure C, no ESP-IDF dependencies: builds on Linux as well.
+
+/**
+ * @brief One published epoch
+ */
+typedef struct {
+    gnss_fix_t fix;
+    uint32_t epoch;         // Monotonic, incremented per publish
+    uint32_t reserved;
+    int64_t  capture_us;    // Arrival time of the epoch's data (esp_timer)
+} gnss_snapshot_t;
+
+#define GNSS_SNAPSHOT_WORDS ((sizeof(gnss_snapshot_t) + 3) / 4)
+
+/**
+ * @brief Single-writer, multi-reader seqlock holding the latest epoch
+ *
+ * The writer never waits; readers retry a bounded number of times if a
+ * publish overlapped their copy, so they never observe a torn snapshot
+ * and never block behind a preempted writer. The payload is stored as
+ * relaxed atomic words so concurrent access is well defined without
+ * costing more than plain loads/stores on Xtensa.
+ */
+typedef struct {
+    atomic_uint seq;        // Odd while a publish is in progress
+    atomic_uint words[GNSS_SNAPSHOT_WORDS];
+} gnss_snapshot_store_t;
+
+void gnss_snapshot_init(gnss_snapshot_store_t *store);
+
+/**
+ * @brief Publish a fix (writer side, single task only)
+ *
+ * @param store Snapshot store
+ * @param fix Fix to publish
+ * @param capture_us Arrival timestamp of the epoch
+ * @return uint32_t Epoch number assigned to this publish
+ */
+uint32_t gnss_snapshot_publish(gnss_snapshot_store_t *store, const gnss_fix_t *fix, int64_t capture_us);
+
+/**
+ * @brief Copy the latest snapshot (reader side, any task)
+ *
+ * @return false if nothing has been published yet, or every attempt
+ *         overlapped a publish (keep the previous copy and retry later)
+ */
+bool gnss_snapshot_read(const gnss_snapshot_store_t *store, gnss_snapshot_t *out);
+
+/**
+ * @brief Copy the latest snapshot only if it is newer than last_epoch
+ *
+ * Cheap poll for consumers that only care about new epochs.
+ */
+bool gnss_snapshot_read_newer(const gnss_snapshot_store_t *store, uint32_t last_epoch, gnss_snapshot_t *out);
+
+#endif // GNSS_SNAPSHOT_H
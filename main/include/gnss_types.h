@@ -0,0 +1,61 @@
+#ifndef GNSS_TYPES_H
+#define GNSS_TYPES_H
+
+#include <stdint.h>
+
+// Fix type, numbered like UBX NAV-PVT fixType so both decoders share it
+typedef enum {
+    GNSS_FIX_NONE      = 0,
+    GNSS_FIX_DR        = 1,
+    GNSS_FIX_2D        = 2,
+    GNSS_FIX_3D        = 3,
+    GNSS_FIX_GNSS_DR   = 4,
+    GNSS_FIX_TIME_ONLY = 5,
+} gnss_fix_type_t;
+
+// gnss_fix_t.valid bits
+#define GNSS_VALID_TIME     (1u << 0)
+#define GNSS_VALID_DATE     (1u << 1)
+#define GNSS_VALID_POS      (1u << 2)
+#define GNSS_VALID_ALT      (1u << 3)
+#define GNSS_VALID_SPEED    (1u << 4)
+#define GNSS_VALID_COURSE   (1u << 5)
+#define GNSS_VALID_DOP      (1u << 6)
+#define GNSS_VALID_VEL      (1u << 7)   // NED velocity and accuracies (UBX only)
+
+/**
+ * @brief Decoded navigation solution
+ *
+ * Integer units match UBX NAV-PVT so NMEA and UBX fill the same fields
+ * without float conversion.
+ */
+typedef struct {
+    uint32_t itow_ms;       // GPS time of week (UBX only)
+    int32_t  lat;           // deg * 1e-7
+    int32_t  lon;           // deg * 1e-7
+    int32_t  alt_mm;        // height above MSL (mm)
+    uint32_t speed_mmps;    // ground speed (mm/s)
+    int32_t  course;        // course over ground (deg * 1e-5)
+    int32_t  vel_n;         // mm/s
+    int32_t  vel_e;         // mm/s
+    int32_t  vel_d;         // mm/s
+    uint32_t h_acc_mm;      // horizontal accuracy estimate
+    uint32_t v_acc_mm;      // vertical accuracy estimate
+    uint32_t s_acc_mmps;    // speed accuracy estimate
+    uint16_t hdop;          // * 0.01
+    uint16_t vdop;          // * 0.01
+    uint16_t pdop;          // * 0.01
+    uint16_t year;
+    uint8_t  month;
+    uint8_t  day;
+    uint8_t  hour;
+    uint8_t  min;
+    uint8_t  sec;
+    uint8_t  fix_type;      // gnss_fix_type_t
+    uint16_t ms;
+    uint8_t  num_sv;        // satellites used in solution
+    uint8_t  reserved;
+    uint16_t valid;         // GNSS_VALID_* bits
+} gnss_fix_t;
+
+#endif // GNSS_TYPES_H
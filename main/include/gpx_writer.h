@@ -0,0 +1,73 @@
+#ifndef GPX_WRITER_H
+#define GPX_WRITER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "chunk_writer.h"
+#include "latency_hist.h"
+
+// Pure C, no ESP-IDF dependencies: builds on Linux as well.
+
+#define GPX_WRITER_POINT_MAX    640             // Longest formatted <trkpt>
+
+/**
+ * @brief One track point, integer fields as the GNSS delivers them
+ */
+typedef struct {
+    int32_t lat, lon;       // 1e-7 deg
+    int32_t ele_mm;         // m above MSL * 1000
+    uint32_t speed_mmps;
+    int32_t course;         // 1e-5 deg
+    uint16_t year;
+    uint8_t month, day, hour, min, sec;
+    uint16_t ms;
+    uint8_t fix_type;       // gnss_fix_type_t
+    uint8_t num_sv;
+    uint16_t hdop;          // * 0.01
+    int16_t temp_c10;       // deg C * 10
+    uint16_t g_milli;       // Linear acceleration magnitude, g * 1000
+    uint16_t bat_mv;
+    uint8_t mode;           // UI mode the point was taken in
+    uint8_t pbox;           // pbox_phase_t
+} gpx_point_t;
+
+/**
+ * @brief Streaming GPX file over a chunk_writer_t
+ *
+ * The producer formats each point with integer formatters (no printf
+ * floats) and stages it; when the ring is full the point is dropped and
+ * counted. The flushing task drives out through chunk_writer_flush.
+ */
+typedef struct {
+    chunk_writer_t out;
+    latency_hist_t format_us;   // Per point, formatting and staging
+    uint32_t points;
+    uint32_t dropped;
+} gpx_writer_t;
+
+void gpx_writer_init(gpx_writer_t *w, const chunk_writer_config_t *cfg);
+
+/**
+ * @brief Create the file and stage the GPX header (flusher, no producer running)
+ *
+ * @param name Track name, XML-escaped by the caller
+ * @return 0, or -1 with errno set (EEXIST if path exists)
+ */
+int gpx_writer_open(gpx_writer_t *w, const char *path, const char *name);
+
+/**
+ * @brief Format one point into the ring (producer, never blocks)
+ *
+ * @return false if the ring was full and the point was dropped
+ */
+bool gpx_writer_add(gpx_writer_t *w, const gpx_point_t *p);
+
+/**
+ * @brief Stage the footer, then write the rest and close (flusher, after
+ *        the producer has stopped)
+ *
+ * @return 0, or -1 with errno set; the file is closed either way
+ */
+int gpx_writer_close(gpx_writer_t *w);
+
+#endif // GPX_WRITER_H
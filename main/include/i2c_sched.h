@@ -0,0 +1,106 @@
+#ifndef I2C_SCHED_H
+#define I2C_SCHED_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "latency_hist.h"
+
+// Pure C, no ESP-IDF dependencies: builds on Linux as well. The caller
+// performs the bus operations through i2c_bus_ops_t and serializes
+// i2c_sched_submit / i2c_sched_pop; i2c_sched_execute runs on one
+// executor without the queue lock.
+
+#define I2C_SCHED_MAX_BURST     64      // Bytes of one merged read
+
+// Transaction flags
+#define I2C_TXN_WRITE           0x01
+#define I2C_TXN_NO_MERGE        0x02    // Read with side effects (FIFO port, clear-on-read)
+
+typedef enum {
+    I2C_TXN_QUEUED = 0,
+    I2C_TXN_OK,
+    I2C_TXN_ERROR,          // NACK or arbitration loss
+    I2C_TXN_TIMEOUT,        // Bus held; recovered before the next transfer
+} i2c_txn_status_t;
+
+typedef struct i2c_txn i2c_txn_t;
+typedef void (*i2c_txn_done_t)(i2c_txn_t *txn, void *arg);
+
+/**
+ * @brief One register transfer, owned by the submitter until done runs
+ */
+struct i2c_txn {
+    uint8_t dev;            // Device index understood by the bus ops
+    uint8_t reg;            // First register
+    uint8_t flags;          // I2C_TXN_*
+    uint8_t prio;           // 0 = most urgent class
+    uint16_t len;
+    uint8_t *data;
+    int64_t deadline_us;    // Order within a priority class (earliest first)
+    uint32_t timeout_us;    // Longest the transfer may hold the bus
+    i2c_txn_done_t done;    // Called from the executor, may be NULL
+    void *arg;
+
+    // Filled in by the scheduler
+    uint8_t status;         // i2c_txn_status_t
+    int64_t queued_us;
+    int64_t start_us;
+    int64_t end_us;
+    i2c_txn_t *next;        // Queue link, then link inside a merged batch
+};
+
+typedef struct {
+    // Returns i2c_txn_status_t; data holds len bytes to write or to fill
+    int (*transfer)(void *ctx, uint8_t dev, uint8_t reg, bool write,
+                    uint8_t *data, size_t len, uint32_t timeout_us);
+    void (*recover)(void *ctx);     // Clock out a stuck slave, reset the controller
+    int64_t (*now_us)(void *ctx);
+} i2c_bus_ops_t;
+
+typedef struct {
+    uint32_t transfers;     // Bus transactions issued
+    uint32_t merged;        // Reads folded into another read's burst
+    uint32_t errors;
+    uint32_t timeouts;      // Each one followed by a bus recovery
+    uint32_t late;          // Started after their deadline
+    uint64_t busy_us;       // Time spent in transfers
+    latency_hist_t queue_delay;     // Submission to start of transfer
+} i2c_sched_stats_t;
+
+typedef struct {
+    const i2c_bus_ops_t *ops;
+    void *ctx;
+    i2c_txn_t *queue;       // Sorted by (prio, deadline_us), FIFO among equals
+    i2c_sched_stats_t stats;        // Written by the executor only
+    uint8_t burst[I2C_SCHED_MAX_BURST];
+} i2c_sched_t;
+
+void i2c_sched_init(i2c_sched_t *s, const i2c_bus_ops_t *ops, void *ctx);
+
+/**
+ * @brief Queue a transaction
+ *
+ * I2C_SCHED_MAX_BURST only bounds the register range of a merged burst:
+ * a plain read longer than that is never merged and goes straight into
+ * its own buffer. Writes and I2C_TXN_NO_MERGE reads, such as the 448 B
+ * FIFO drains, may have any length.
+ */
+void i2c_sched_submit(i2c_sched_t *s, i2c_txn_t *txn, int64_t now_us);
+
+/**
+ * @brief Take the most urgent transaction off the queue
+ *
+ * Queued reads of the same device whose register ranges touch or overlap
+ * it are taken along, whatever their priority, and served by one burst.
+ *
+ * @return Batch linked through next, NULL if the queue is empty
+ */
+i2c_txn_t *i2c_sched_pop(i2c_sched_t *s);
+
+/**
+ * @brief Run a batch from i2c_sched_pop and complete its transactions
+ */
+void i2c_sched_execute(i2c_sched_t *s, i2c_txn_t *batch);
+
+#endif // I2C_SCHED_H
@@ -0,0 +1,135 @@
+#ifndef IMU_BIAS_H
+#define IMU_BIAS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sensor_types.h"
+
+// Pure C, no ESP-IDF dependencies: builds on Linux as well.
+
+#define IMU_BIAS_VERSION        1
+#define IMU_BIAS_TEMP_MIN       -20.0f  // deg C of node 0
+#define IMU_BIAS_TEMP_STEP      5.0f
+#define IMU_BIAS_NODES          17      // -20 .. 60 deg C
+#define IMU_BIAS_ACCEL_FACES    6       // +-x, +-y, +-z up
+
+typedef struct {
+    float gyro_std;         // dps: every axis below this over a window = still
+    float accel_std;        // g
+    float accel_norm;       // g: |mean accel| within 1 +- this
+    float gyro_max;         // dps: larger window means are rotation, not bias
+    float gyro_step;        // dps: max distance from the known bias
+    uint16_t window;        // Samples per stillness window
+    uint8_t still_windows;  // Consecutive still windows before the bias is measured
+    uint8_t relearn_windows;// Still windows in a row beyond gyro_step that are accepted
+    float node_weight_max;  // Windows a table node remembers; older ones fade
+} imu_bias_params_t;
+
+#define IMU_BIAS_DEFAULT_PARAMS {   \
+    .gyro_std = 0.3f,               \
+    .accel_std = 0.01f,             \
+    .accel_norm = 0.05f,            \
+    .gyro_max = 3.0f,               \
+    .gyro_step = 0.3f,              \
+    .window = 208,                  \
+    .still_windows = 2,             \
+    .relearn_windows = 60,          \
+    .node_weight_max = 120.0f,      \
+}
+
+/**
+ * @brief Learned biases, stored in NVS as is
+ *
+ * Gyro bias per temperature node; a window measured between two nodes is
+ * split between them by distance, and lookups interpolate the same way.
+ */
+typedef struct {
+    uint16_t version;       // IMU_BIAS_VERSION
+    uint16_t reserved;
+    float gyro[IMU_BIAS_NODES][3];  // dps
+    float weight[IMU_BIAS_NODES];   // Windows folded in (capped), 0 = no data
+    float accel[3];         // g
+    bool accel_valid;       // Gravity seen on every face
+} imu_bias_table_t;
+
+/**
+ * @brief Online gyro/accel bias estimator
+ *
+ * Raw samples are summed over fixed windows; a window whose gyro and
+ * accel spread are both at noise level, with about 1 g of gravity and
+ * a small mean rate, counts as still. A steady yaw leaves gravity alone,
+ * so a mean far from the known bias needs a long stillness to count, and
+ * the caller can veto stretches another sensor saw turning. While still
+ * the window mean rate is the gyro bias: it is used directly and folded
+ * into the table. Each
+ * still window's mean accel is also one point on the gravity sphere; once
+ * all six faces have been seen, the sphere centre is the accel offset.
+ */
+typedef struct {
+    imu_bias_params_t params;
+    imu_bias_table_t table;
+
+    // Current window, relative to its first sample to keep float sums exact
+    uint16_t n;
+    float ref[6];
+    float sum[6], sq[6];    // gx gy gz ax ay az
+    float temp_sum;
+
+    uint8_t still_count;    // Consecutive still windows
+    uint8_t mismatch;       // Consecutive still windows away from the known bias
+    float stretch[3];       // Sum of window means over the still stretch
+    uint32_t stretch_n;
+    float live[3];          // dps, last measured bias
+    float live_temp;
+    bool live_valid;
+
+    // Gravity sphere: normal equations of 2 a.b + c = |a|^2
+    double ata[10], atb[4];
+    uint8_t faces;          // Bit per face seen
+
+    uint32_t windows;
+    uint32_t still;         // Still windows measured
+} imu_bias_t;
+
+/**
+ * @brief Reset the estimator
+ *
+ * @param stored Table loaded from NVS, NULL or invalid = start empty
+ */
+void imu_bias_init(imu_bias_t *e, const imu_bias_params_t *params, const imu_bias_table_t *stored);
+
+bool imu_bias_table_valid(const imu_bias_table_t *t);
+
+/**
+ * @brief Feed one uncorrected sample
+ *
+ * @return true when a still window updated the table
+ */
+bool imu_bias_feed(imu_bias_t *e, const imu_sample_t *s);
+
+/**
+ * @brief Bias at a temperature
+ *
+ * While still, the bias just measured; otherwise the table interpolated
+ * at temp, or the nearest measurement when the nodes around it are empty.
+ *
+ * @param gyro dps
+ * @param accel g, zero until the sphere fit has converged
+ */
+void imu_bias_get(const imu_bias_t *e, float temp, float gyro[3], float accel[3]);
+
+/**
+ * @brief Subtract the bias at s[0].temp from a FIFO block in place
+ */
+void imu_bias_apply(const imu_bias_t *e, imu_sample_t *s, size_t n);
+
+bool imu_bias_still(const imu_bias_t *e);
+
+/**
+ * @brief Outside evidence of rotation (e.g. the magnetometer turning):
+ *        ends the still stretch and drops the current window
+ */
+void imu_bias_veto(imu_bias_t *e);
+
+#endif // IMU_BIAS_H
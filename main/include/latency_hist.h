@@ -0,0 +1,35 @@
+#ifndef LATENCY_HIST_H
+#define LATENCY_HIST_H
+
+#include <stdint.h>
+
+// Pure C, no ESP-IDF dependencies: builds on Linux as well.
+
+// Bucket 0 holds 0-1 us, bucket i holds [2^i, 2^(i+1)) us, the last one everything above
+#define LATENCY_HIST_BUCKETS 18
+
+typedef struct {
+    uint32_t count[LATENCY_HIST_BUCKETS];
+    uint32_t total;
+    uint32_t max_us;
+    uint64_t sum_us;
+} latency_hist_t;
+
+void latency_hist_reset(latency_hist_t *h);
+
+void latency_hist_add(latency_hist_t *h, uint32_t us);
+
+/**
+ * @brief Upper bound (us) of the bucket holding the given percentile
+ *
+ * @param h Histogram
+ * @param pct Percentile 0-100
+ * @return uint32_t Bucket upper bound, 0 if empty
+ */
+uint32_t latency_hist_percentile(const latency_hist_t *h, uint32_t pct);
+
+static inline uint32_t latency_hist_mean(const latency_hist_t *h) {
+    return h->total ? (uint32_t)(h->sum_us / h->total) : 0;
+}
+
+#endif // LATENCY_HIST_H
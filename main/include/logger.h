@@ -0,0 +1,68 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "sample_ring.h"
+
+typedef enum {
+    LOGGER_IDLE,
+    LOGGER_OPENING,         // Start requested, file being created
+    LOGGER_RECORDING,
+    LOGGER_CLOSING,         // Stop requested, tail being written
+} logger_state_t;
+
+/**
+ * @brief Mount the SD card and allocate the GPX staging ring (PSRAM when
+ *        available); call before the logger tasks start
+ *
+ * @return esp_err_t ESP_ERR_NO_MEM if no ring could be allocated. A
+ *         missing card is not an error: recording is then refused.
+ */
+esp_err_t logger_init(void);
+
+/**
+ * @brief Track point producer
+ *
+ * Formats a point per new GNSS epoch into the staging ring while
+ * recording and wakes the flush task once a chunk is complete. Never
+ * touches the card.
+ */
+void logger_task_entry(void *pvParameters);
+
+/**
+ * @brief Low-priority SD side: creates and closes the files and writes
+ *        the staged chunks
+ */
+void logger_flush_task_entry(void *pvParameters);
+
+/**
+ * @brief Start or stop recording; takes effect on the logger task
+ */
+void logger_toggle_recording(void);
+
+logger_state_t logger_state(void);
+
+bool logger_sd_ready(void);
+
+/**
+ * @brief UI mode written with each point
+ */
+void logger_set_mode(uint8_t mode);
+
+/**
+ * @brief Ride statistics for the bike computer (ride_stats_summary_t),
+ *        one per fix
+ *
+ * They run whether or not a track is recorded, survive restarts through
+ * NVS and start over on logger_reset_ride.
+ */
+const sample_ring_t *logger_ride_ring(void);
+
+/**
+ * @brief Start a new ride; takes effect on the logger task
+ */
+void logger_reset_ride(void);
+
+#endif // LOGGER_H
@@ -0,0 +1,92 @@
+#ifndef LSM6DSR_FIFO_H
+#define LSM6DSR_FIFO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Pure C, no ESP-IDF dependencies: builds on Linux as well.
+
+// Registers
+#define LSM6DSR_REG_FIFO_CTRL1      0x07    // WTM[7:0]
+#define LSM6DSR_REG_FIFO_CTRL2      0x08    // WTM[8]
+#define LSM6DSR_REG_FIFO_CTRL3      0x09    // BDR_GY[7:4] BDR_XL[3:0]
+#define LSM6DSR_REG_FIFO_CTRL4      0x0A    // DEC_TS_BATCH[7:6] FIFO_MODE[2:0]
+#define LSM6DSR_REG_INT1_CTRL       0x0D
+#define LSM6DSR_REG_CTRL1_XL        0x10
+#define LSM6DSR_REG_CTRL2_G         0x11
+#define LSM6DSR_REG_CTRL10_C        0x19
+#define LSM6DSR_REG_FIFO_STATUS1    0x3A    // DIFF_FIFO[7:0]
+#define LSM6DSR_REG_FIFO_DATA_OUT   0x78    // TAG + 6 data bytes, wraps for burst reads
+
+#define LSM6DSR_FIFO_MODE_BYPASS     0x00
+#define LSM6DSR_FIFO_MODE_CONTINUOUS 0x06
+#define LSM6DSR_FIFO_DEC_TS_1        (0x01 << 6)    // Timestamp every batch slot
+#define LSM6DSR_INT1_FIFO_TH         0x08
+#define LSM6DSR_TIMESTAMP_EN         0x20
+#define LSM6DSR_FIFO_STATUS2_OVR     0x40
+#define LSM6DSR_FIFO_STATUS2_WTM     0x80
+
+#define LSM6DSR_FIFO_WORD_LEN       7
+#define LSM6DSR_FIFO_WORDS          438     // 3 KB FIFO
+#define LSM6DSR_TS_US_PER_TICK      25
+
+// TAG_SENSOR values
+#define LSM6DSR_TAG_GYRO            0x01
+#define LSM6DSR_TAG_ACCEL           0x02
+#define LSM6DSR_TAG_TEMP            0x03
+#define LSM6DSR_TAG_TIMESTAMP       0x04
+#define LSM6DSR_TAG_CFG_CHANGE      0x05
+
+/**
+ * @brief Output data rate / batch data rate code for a rate in Hz
+ *        (12.5 Hz .. 6667 Hz, rounded up)
+ */
+uint8_t lsm6dsr_odr_code(uint16_t hz);
+
+/**
+ * @brief Nominal rate (Hz, rounded) of an ODR code, 0 if invalid
+ */
+uint16_t lsm6dsr_odr_hz(uint8_t code);
+
+/**
+ * @brief One accel + gyro sample set, raw sensor axes and units
+ */
+typedef struct {
+    uint32_t timestamp;     // LSM6DSR_TS_US_PER_TICK ticks
+    int16_t acc[3];
+    int16_t gyro[3];
+} lsm6dsr_fifo_sample_t;
+
+typedef struct {
+    lsm6dsr_fifo_sample_t pending;  // Slot being assembled
+    uint8_t have;                   // Parts of pending received
+    uint8_t slot;                   // TAG_CNT of pending
+    uint32_t timestamp;             // Latest timestamp word
+
+    uint32_t samples;
+    uint32_t incomplete;            // Slots missing accel or gyro
+    uint32_t other;                 // Temperature / config change / unknown words
+} lsm6dsr_fifo_decoder_t;
+
+void lsm6dsr_fifo_decoder_init(lsm6dsr_fifo_decoder_t *dec);
+
+/**
+ * @brief Decode FIFO words into sample sets
+ *
+ * Words of one batch slot share TAG_CNT. A set is emitted once accel,
+ * gyro and timestamp are in, or when the next slot begins; a slot split
+ * across two reads is completed by the next call.
+ *
+ * @param dec Decoder state
+ * @param words n_words * LSM6DSR_FIFO_WORD_LEN bytes read from FIFO_DATA_OUT
+ * @param n_words Number of words
+ * @param out Output samples
+ * @param max_out Capacity of out; words past it are left undecoded
+ * @param consumed Words decoded (may be NULL)
+ * @return Number of samples written
+ */
+size_t lsm6dsr_fifo_decode(lsm6dsr_fifo_decoder_t *dec, const uint8_t *words, size_t n_words,
+                           lsm6dsr_fifo_sample_t *out, size_t max_out, size_t *consumed);
+
+#endif // LSM6DSR_FIFO_H
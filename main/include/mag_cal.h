@@ -0,0 +1,84 @@
+#ifndef MAG_CAL_H
+#define MAG_CAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Pure C, no ESP-IDF dependencies: builds on Linux as well.
+
+#define MAG_CAL_VERSION     1
+#define MAG_CAL_TERMS       10      // Quadric coefficients
+#define MAG_CAL_BINS        24      // Direction bins: dominant axis x sign x quadrant
+#define MAG_CAL_MIN_BINS    18      // Coverage needed before solving
+#define MAG_CAL_MIN_SAMPLES 150
+#define MAG_CAL_MIN_STEP_UT 2.0f    // Closer samples repeat the same direction
+
+/**
+ * @brief Hard/soft-iron correction, stored in NVS as is
+ *
+ * corrected = soft * (raw - offset)
+ */
+typedef struct {
+    uint16_t version;       // MAG_CAL_VERSION
+    uint16_t reserved;
+    float offset[3];        // uT, hard iron
+    float soft[3][3];       // Symmetric; identity = no soft-iron error
+    float field_ut;         // Field magnitude after correction
+    float residual;         // RMS fit residual, fraction of the field
+} mag_cal_t;
+
+/**
+ * @brief Sufficient statistics of the ellipsoid fit
+ *
+ * Every accepted sample is folded into the scatter matrix of the quadric
+ * a x^2 + b y^2 + c z^2 + 2d xy + 2e xz + 2f yz + 2g x + 2h y + 2i z + j = 0,
+ * so memory does not grow with the number of samples. The solve fixes
+ * a + b + c = 3, which unlike j = -1 does not degenerate when the hard
+ * iron offset is as large as the field itself.
+ */
+typedef struct {
+    double dtd[MAG_CAL_TERMS * (MAG_CAL_TERMS + 1) / 2];   // Upper triangle, row-major
+    uint32_t n;
+    float last[3];          // Last accepted sample
+    float min[3], max[3];   // Bounding box, centre for the coverage bins
+    uint32_t bins;          // Bit per covered direction bin
+} mag_cal_acc_t;
+
+void mag_cal_identity(mag_cal_t *cal);
+
+bool mag_cal_valid(const mag_cal_t *cal);
+
+/**
+ * @brief corrected = soft * (raw - offset); in and out may alias
+ */
+void mag_cal_apply(const mag_cal_t *cal, const float in[3], float out[3]);
+
+void mag_cal_acc_init(mag_cal_acc_t *acc);
+
+/**
+ * @brief Fold one uncorrected sample (uT) into the fit
+ *
+ * @return false if the sample was too close to the previous one
+ */
+bool mag_cal_acc_add(mag_cal_acc_t *acc, const float m[3]);
+
+/**
+ * @brief Direction bins covered so far (0 .. MAG_CAL_BINS)
+ */
+uint8_t mag_cal_coverage(const mag_cal_acc_t *acc);
+
+/**
+ * @brief 0-100; 100 once coverage and sample count allow a solve
+ */
+uint8_t mag_cal_progress(const mag_cal_acc_t *acc);
+
+/**
+ * @brief Solve the fit
+ *
+ * @return false if the samples do not describe an ellipsoid (too little
+ *         rotation, a degenerate fit or a large residual); out is then
+ *         not usable
+ */
+bool mag_cal_solve(const mag_cal_acc_t *acc, mag_cal_t *out);
+
+#endif // MAG_CAL_H
@@ -0,0 +1,56 @@
+#ifndef NAV_H
+#define NAV_H
+
+#include "esp_err.h"
+#include "altitude.h"
+#include "nav_ekf.h"
+#include "pbox.h"
+#include "sample_ring.h"
+
+/**
+ * @brief A completed P-Box run
+ */
+typedef struct {
+    uint8_t interval;       // Position in the interval table of nav.c
+    pbox_result_t result;
+} nav_pbox_run_t;
+
+/**
+ * @brief Set up the filter and the output ring; call after
+ *        sensor_service_init and before the task and any consumer start
+ */
+esp_err_t nav_init(void);
+
+/**
+ * @brief Fusion task
+ *
+ * Feeds every AHRS output into the GNSS/IMU filter and corrects it with
+ * each new GNSS epoch, dated NAV_GNSS_LATENCY_US before its arrival.
+ * Output samples are taken every 1/NAV_OUTPUT_HZ of IMU time, so they
+ * arrive in bursts of one FIFO watermark; each one also drives the P-Box
+ * engine, whose completed intervals are logged and published. Baro
+ * samples and GNSS altitude run through the vertical filter.
+ */
+void nav_task_entry(void *pvParameters);
+
+/**
+ * @brief Output ring (nav_sample_t), NAV_OUTPUT_HZ
+ */
+const sample_ring_t *nav_ring(void);
+
+/**
+ * @brief Fused altitude and vertical speed (altitude_sample_t), one per baro sample
+ */
+const sample_ring_t *nav_altitude_ring(void);
+
+/**
+ * @brief Current P-Box phase (pbox_phase_t), for the track log
+ */
+uint8_t nav_pbox_phase(void);
+
+/**
+ * @brief Completed P-Box runs (nav_pbox_run_t)
+ */
+const sample_ring_t *nav_pbox_ring(void);
+
+#endif // NAV_H
@@ -0,0 +1,107 @@
+#ifndef NAV_EKF_H
+#define NAV_EKF_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "gnss_types.h"
+#include "sensor_types.h"
+
+// Pure C, no ESP-IDF dependencies: builds on Linux as well.
+
+#define NAV_EKF_STATES      9       // Position, velocity, accelerometer bias
+#define NAV_EKF_HISTORY     64      // Past states kept for delayed fixes (~150 ms at 416 Hz)
+#define NAV_EKF_GATE        25.0f   // Innovation gate, squared sigmas
+#define NAV_EKF_MAX_DT_S    0.1f    // Longer IMU gaps only advance the time
+
+// State indices; earth axes as in the AHRS (x north, y west, z up)
+#define NAV_P   0
+#define NAV_V   3
+#define NAV_BA  6
+
+typedef struct {
+    float accel_noise;      // m/s^2 per sqrt(Hz), includes attitude error
+    float bias_walk;        // m/s^2 per sqrt(s)
+    float bias_init;        // m/s^2, initial bias sigma
+    float speed_floor;      // m/s, lower bound of the GNSS velocity sigma
+    float pos_floor;        // m, lower bound of the GNSS position sigma
+} nav_ekf_params_t;
+
+#define NAV_EKF_DEFAULT_PARAMS { \
+    .accel_noise = 0.5f,        \
+    .bias_walk = 0.01f,         \
+    .bias_init = 0.3f,          \
+    .speed_floor = 0.05f,       \
+    .pos_floor = 0.5f,          \
+}
+
+/**
+ * @brief Fused output at one instant
+ */
+typedef struct {
+    int64_t t_us;           // Time of the last IMU sample used
+    float pos[3];           // m from the first fix, earth axes
+    float vel[3];           // m/s, earth axes
+    float accel[3];         // m/s^2, earth axes, gravity and bias removed
+    float speed;            // m/s, horizontal
+    float speed_sigma;      // m/s, 1 sigma
+    uint32_t fix_age_ms;    // Since the last GNSS correction
+} nav_sample_t;
+
+/**
+ * @brief Loosely coupled GNSS/IMU error-state Kalman filter
+ *
+ * The nominal state is integrated from earth-frame acceleration at IMU
+ * rate; the 9x9 error covariance uses fixed-size arrays and each GNSS
+ * component is applied as a scalar update, so no matrix is ever inverted.
+ * A fix is compared with the state at its measurement time (kept in a
+ * short history) and the correction applied to the current state.
+ */
+typedef struct {
+    nav_ekf_params_t params;
+    float p[3];             // m
+    float v[3];             // m/s
+    float ba[3];            // m/s^2, device axes
+    float a[3];             // m/s^2, last bias-corrected earth acceleration
+    float P[NAV_EKF_STATES][NAV_EKF_STATES];
+    int64_t t_us;           // Time of the nominal state, 0 = none yet
+    int64_t fix_us;         // Time of the last correction
+    bool aligned;           // Origin set by the first fix
+
+    // Origin of the local frame
+    int32_t lat0, lon0, alt0_mm;
+    float m_per_lon;        // Metres per 1e-7 deg of longitude at lat0
+
+    struct {
+        int64_t t_us;
+        float p[3], v[3];
+    } hist[NAV_EKF_HISTORY];
+    uint8_t hist_head;
+
+    uint32_t updates;       // Scalar measurements applied
+    uint32_t rejected;      // Scalar measurements outside the gate
+} nav_ekf_t;
+
+void nav_ekf_init(nav_ekf_t *f, const nav_ekf_params_t *params);
+
+/**
+ * @brief Propagate with one AHRS output (earth-frame acceleration + attitude)
+ */
+void nav_ekf_predict(nav_ekf_t *f, const attitude_sample_t *att);
+
+/**
+ * @brief Correct with a GNSS fix
+ *
+ * Uses NED velocity when available, otherwise speed and course, and the
+ * position. The first usable fix sets the local origin.
+ *
+ * @param t_meas_us When the fix was valid (esp_timer time)
+ * @return false if the fix carries nothing usable
+ */
+bool nav_ekf_update_gnss(nav_ekf_t *f, const gnss_fix_t *fix, int64_t t_meas_us);
+
+/**
+ * @brief Current output
+ */
+void nav_ekf_output(const nav_ekf_t *f, nav_sample_t *out);
+
+#endif // NAV_EKF_H
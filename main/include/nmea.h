@@ -0,0 +1,76 @@
+#ifndef NMEA_H
+#define NMEA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "gnss_types.h"
+
+// Pure C, no ESP-IDF dependencies: builds on Linux as well.
+
+typedef enum {
+    NMEA_MSG_UNKNOWN = 0,
+    NMEA_MSG_RMC,
+    NMEA_MSG_GGA,
+    NMEA_MSG_GSA,
+    NMEA_MSG_GSV,
+    NMEA_MSG_VTG,
+    NMEA_MSG_INVALID,   // Recognized but malformed
+} nmea_msg_t;
+
+// Constellation derived from the talker ID
+typedef enum {
+    NMEA_TALKER_UNKNOWN = 0,
+    NMEA_TALKER_GPS,        // GP
+    NMEA_TALKER_GLONASS,    // GL
+    NMEA_TALKER_GALILEO,    // GA
+    NMEA_TALKER_BEIDOU,     // GB / BD
+    NMEA_TALKER_QZSS,       // GQ
+    NMEA_TALKER_COMBINED,   // GN
+} nmea_talker_t;
+
+#define NMEA_GSV_SATS_PER_MSG 4
+
+typedef struct {
+    uint8_t  svid;
+    int8_t   elev;      // deg, -1 if empty
+    uint16_t azim;      // deg
+    uint8_t  cn0;       // dBHz, 0 if not tracked
+} nmea_gsv_sat_t;
+
+/**
+ * @brief One decoded GSV page (up to 4 satellites)
+ */
+typedef struct {
+    uint8_t talker;         // nmea_talker_t
+    uint8_t total_msgs;
+    uint8_t msg_num;
+    uint8_t num_in_view;
+    uint8_t signal_id;      // NMEA 4.10+, 0 if absent
+    uint8_t count;          // Valid entries in sats[]
+    nmea_gsv_sat_t sats[NMEA_GSV_SATS_PER_MSG];
+} nmea_gsv_t;
+
+typedef struct {
+    gnss_fix_t fix;         // Accumulated from RMC/GGA/GSA/VTG
+    nmea_gsv_t gsv;         // Last decoded GSV page
+    uint32_t sentences;     // Successfully decoded sentences
+    uint32_t errors;        // Malformed sentences
+} nmea_decoder_t;
+
+void nmea_decoder_init(nmea_decoder_t *dec);
+
+/**
+ * @brief Decode one NMEA sentence in place
+ *
+ * Fields are walked directly in the caller's buffer: no copies, no
+ * allocation, no strtok/sscanf/atof. The sentence may include the
+ * trailing "*hh" and CR/LF; checksum validation is left to the framer.
+ *
+ * @param dec Decoder state (fix is updated field by field)
+ * @param s Sentence starting with '$'
+ * @param len Sentence length in bytes
+ * @return nmea_msg_t Type of sentence decoded
+ */
+nmea_msg_t nmea_decode(nmea_decoder_t *dec, const char *s, size_t len);
+
+#endif // NMEA_H
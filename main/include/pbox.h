@@ -0,0 +1,149 @@
+#ifndef PBOX_H
+#define PBOX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "nav_ekf.h"
+
+// Pure C, no ESP-IDF dependencies: builds on Linux as well.
+
+#define PBOX_MAX_INTERVALS  8
+
+typedef enum {
+    PBOX_SPEED,             // from -> to, m/s; from 0 = from launch, to < from = braking
+    PBOX_DISTANCE,          // from launch to `to` metres
+} pbox_kind_t;
+
+typedef struct {
+    const char *name;
+    uint8_t kind;           // pbox_kind_t
+    float from;
+    float to;
+} pbox_interval_cfg_t;
+
+typedef struct {
+    float start_speed;      // m/s: below this the vehicle is stopped and the engine armed
+    float start_accel;      // m/s^2: horizontal acceleration that triggers a launch
+    float fit_speed;        // m/s: launch line fitted between start_speed and this
+    float stop_speed;       // m/s: braking runs to 0 are extrapolated from here
+    uint32_t fit_timeout_us;// Trigger not reaching fit_speed in time = false start
+} pbox_params_t;
+
+#define PBOX_START_SPEED_KMH    1.0f    // Armed below this
+#define PBOX_START_ACCEL_G      0.15f   // Horizontal acceleration that starts a run
+#define PBOX_FIT_SPEED_KMH      20.0f   // Launch confirmed by the speed line up to here
+#define PBOX_STOP_SPEED_KMH     3.0f    // Braking runs to 0 extrapolated from here
+#define PBOX_FIT_TIMEOUT_MS     3000    // Trigger without reaching the fit speed = false start
+
+#define PBOX_DEFAULT_PARAMS { \
+    .start_speed = PBOX_START_SPEED_KMH / 3.6f,         \
+    .start_accel = PBOX_START_ACCEL_G * 9.80665f,       \
+    .fit_speed = PBOX_FIT_SPEED_KMH / 3.6f,             \
+    .stop_speed = PBOX_STOP_SPEED_KMH / 3.6f,           \
+    .fit_timeout_us = PBOX_FIT_TIMEOUT_MS * 1000,       \
+}
+
+// The intervals the device times, for a pbox_interval_cfg_t array. The
+// position is the interval number in the track index, so new ones go at
+// the end.
+#define PBOX_DEFAULT_INTERVALS { \
+    { "0-60 km/h", PBOX_SPEED, 0.0f, 60.0f / 3.6f },                   \
+    { "0-100 km/h", PBOX_SPEED, 0.0f, 100.0f / 3.6f },                 \
+    { "100-200 km/h", PBOX_SPEED, 100.0f / 3.6f, 200.0f / 3.6f },      \
+    { "1/4 mile", PBOX_DISTANCE, 0.0f, 402.336f },                     \
+    { "100-0 km/h", PBOX_SPEED, 100.0f / 3.6f, 0.0f },                 \
+}
+
+typedef struct {
+    int64_t start_us;       // Launch or first threshold crossing (esp_timer time)
+    int64_t end_us;
+    float time_s;
+    float sigma_s;          // 1 sigma from the speed sigma and the launch fit
+    float end_speed;        // m/s (trap speed for distance runs)
+    float distance;         // m covered during the interval
+} pbox_result_t;
+
+typedef enum {
+    PBOX_IV_IDLE,
+    PBOX_IV_RUNNING,        // Start crossed (or launch triggered), end not yet
+    PBOX_IV_ENDED,          // End crossed before the launch fit completed
+} pbox_iv_state_t;
+
+typedef struct {
+    pbox_interval_cfg_t cfg;
+    uint8_t state;          // pbox_iv_state_t
+    int64_t start_us;
+    float start_var;        // s^2
+    int64_t end_us;
+    float end_var;
+    float end_speed;
+    float start_dist;       // Run distance at the start crossing
+    float end_dist;
+    pbox_result_t result;   // Last completed run
+    uint32_t runs;          // Completed runs
+} pbox_interval_t;
+
+typedef enum {
+    PBOX_WAIT,              // Moving without a timed launch
+    PBOX_ARMED,             // Stopped, waiting for the acceleration trigger
+    PBOX_LAUNCH,            // Triggered, fitting the launch line
+    PBOX_RUN,               // Launch time known
+} pbox_phase_t;
+
+/**
+ * @brief Streaming P-Box timer over fused speed samples
+ *
+ * Every configured interval is timed in the same pass with O(1) state
+ * each, and threshold crossings are interpolated between samples.
+ *
+ * The launch instant is where the acceleration rise that triggered it
+ * extrapolates back to zero. A least-squares line through the speed
+ * between start_speed and fit_speed (kept as running sums) confirms the
+ * launch and replaces the onset when the two disagree.
+ */
+typedef struct {
+    pbox_params_t params;
+    pbox_interval_t iv[PBOX_MAX_INTERVALS];
+    uint8_t count;
+
+    uint8_t phase;          // pbox_phase_t
+    nav_sample_t prev;      // prev.t_us 0 = none
+    float dist;             // m since the launch trigger
+
+    // Acceleration onset: last quiet sample before the trigger and the
+    // standstill noise, tracked while armed
+    int64_t armed_us;
+    int64_t quiet_us;
+    float quiet_accel;
+    float accel_var;
+    int64_t onset_us;
+    float onset_var;
+
+    // Launch fit, time relative to trig_us
+    int64_t trig_us;
+    float s_t, s_v, s_tt, s_tv, s_vv, s_var;
+    uint32_t n;
+    int64_t launch_us;
+    float launch_var;
+
+    uint32_t launches;
+    uint32_t false_starts;
+} pbox_t;
+
+/**
+ * @brief Reset the engine
+ *
+ * @param count Intervals, at most PBOX_MAX_INTERVALS (extra ones are ignored)
+ */
+void pbox_init(pbox_t *e, const pbox_params_t *params, const pbox_interval_cfg_t *intervals, size_t count);
+
+/**
+ * @brief Feed one fused sample
+ *
+ * @return Bit i set when interval i completed on this sample; its time is
+ *         in e->iv[i].result
+ */
+uint32_t pbox_feed(pbox_t *e, const nav_sample_t *s);
+
+#endif // PBOX_H
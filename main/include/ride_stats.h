@@ -0,0 +1,153 @@
+#ifndef RIDE_STATS_H
+#define RIDE_STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Pure C, no ESP-IDF dependencies: builds on Linux as well.
+
+#define RIDE_STATS_VERSION      1
+#define RIDE_STATS_EQUIRECT_MAX_E7  1000000     // 0.1 deg: longer steps use haversine
+
+typedef struct {
+    float pause_speed;      // m/s: slower than this for pause_delay_us pauses
+    float resume_speed;     // m/s: faster than this resumes at once
+    uint32_t pause_delay_us;
+    uint32_t max_gap_us;    // Longer gaps between fixes are not integrated
+    float max_accel;        // m/s^2: speed jumps beyond this never make a maximum
+    float ele_band;         // m: a climb or descent counts once it exceeds this
+    float vam_min_rate;     // m/h: slower rises are riding, not climbing, for VAM
+} ride_stats_params_t;
+
+#define RIDE_STATS_DEFAULT_PARAMS { \
+    .pause_speed = 0.8f, \
+    .resume_speed = 1.4f, \
+    .pause_delay_us = 3000000, \
+    .max_gap_us = 5000000, \
+    .max_accel = 15.0f, \
+    .ele_band = 2.0f, \
+    .vam_min_rate = 150.0f, \
+}
+
+/**
+ * @brief Float sum with Kahan compensation
+ *
+ * The rounding error of each addition is carried into the next one, so
+ * the total stays within a few ulp however many small steps go into it.
+ * Relies on strict IEEE evaluation: never build with -ffast-math, which
+ * folds the compensation away.
+ */
+typedef struct {
+    float sum;
+    float c;
+} ride_kahan_t;
+
+/**
+ * @brief The accumulated values, 72 bytes, stored as is in NVS
+ *
+ * Only durations and sums: nothing refers to the clock or to the last
+ * fix, so after a restore the first fix starts a new segment instead of
+ * bridging the gap.
+ */
+typedef struct {
+    uint16_t version;
+    bool paused;
+    ride_kahan_t distance;  // m
+    ride_kahan_t gain;      // m
+    ride_kahan_t loss;      // m
+    ride_kahan_t vam_gain;  // m, the part of gain climbed at vam_min_rate or more
+    int64_t elapsed_us;     // Time between fixes, pauses included, gaps not
+    int64_t moving_us;
+    int64_t climb_us;       // Moving time over which vam_gain was climbed
+    float max_speed;        // m/s
+} ride_stats_state_t;
+
+/**
+ * @brief Streaming ride statistics, O(1) per fix and per altitude sample
+ *
+ * Each step between fixes less than max_gap_us apart adds to the
+ * distance while moving: equirectangular on the WGS84 radii of curvature
+ * at the mid latitude, which matches the geodesic to well under a
+ * millimetre on the steps of a 1-25 Hz stream, and haversine beyond
+ * RIDE_STATS_EQUIRECT_MAX_E7. Auto-pause engages after pause_delay_us
+ * below pause_speed and takes back the time and distance of that delay,
+ * which at a standstill is position noise; resume_speed above it keeps
+ * a rider at walking pace from toggling.
+ *
+ * Gain and loss run through a Schmitt trigger of width ele_band: while
+ * climbing every new high counts, and only a drop of more than the band
+ * turns it into a descent, counted in full, and the other way round. A
+ * climb is counted from its lowest point to its highest, and noise
+ * smaller than the band never adds up. Altitude is ignored while paused,
+ * before the first fix and more than max_gap_us after the last one, and
+ * the reference restarts on resume and after a gap, so barometric drift
+ * during a stop or a GNSS outage is not climbed.
+ */
+typedef struct {
+    ride_stats_params_t params;
+    ride_stats_state_t st;
+
+    // Not persisted
+    bool have_fix;
+    int32_t lat, lon;       // Last fix, 1e-7 deg
+    int64_t fix_us;
+    float speed;            // m/s at the last fix
+    int64_t slow_us;        // Time and distance since the speed fell below pause_speed
+    float slow_m;
+    int8_t ele_dir;         // 1 climbing, -1 descending, 0 not yet known
+    float ele_ext;          // m: highest point of the climb or lowest of the descent, NAN = restart
+    int64_t ele_ext_us;     // moving_us when ele_ext was reached
+} ride_stats_t;
+
+/**
+ * @brief Derived values
+ */
+typedef struct {
+    float distance_m;
+    float elapsed_s;
+    float moving_s;
+    float avg_speed;        // m/s over moving time
+    float max_speed;        // m/s
+    float gain_m;
+    float loss_m;
+    float vam;              // m/h, ascent rate over the climbing time
+    bool paused;
+} ride_stats_summary_t;
+
+/**
+ * @brief Start from zero, or from a stored state
+ *
+ * @param saved NULL, or a state from ride_stats_t.st; ignored unless
+ *              ride_stats_state_valid
+ */
+void ride_stats_init(ride_stats_t *s, const ride_stats_params_t *params, const ride_stats_state_t *saved);
+
+/**
+ * @brief Version and sanity check of a stored state
+ */
+bool ride_stats_state_valid(const ride_stats_state_t *st);
+
+/**
+ * @brief Feed one GNSS fix
+ *
+ * @param speed Ground speed, m/s (Doppler)
+ */
+void ride_stats_fix(ride_stats_t *s, int64_t t_us, int32_t lat, int32_t lon, float speed);
+
+/**
+ * @brief Feed one altitude sample, m: the fused barometric altitude, or
+ *        the fix altitude without a barometer
+ *
+ * @param t_us Sample time, on the clock of the fixes
+ */
+void ride_stats_alt(ride_stats_t *s, int64_t t_us, float alt);
+
+void ride_stats_summary(const ride_stats_t *s, ride_stats_summary_t *out);
+
+/**
+ * @brief Metres between two 1e-7 degree positions, as summed for the
+ *        distance
+ */
+float ride_stats_step_m(int32_t lat1, int32_t lon1, int32_t lat2, int32_t lon2);
+
+#endif // RIDE_STATS_H
@@ -0,0 +1,92 @@
+#ifndef SAMPLE_RING_H
+#define SAMPLE_RING_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Pure C, no ESP-IDF dependencies: builds on Linux as well.
+
+/**
+ * @brief Lock-free single-producer sample ring
+ *
+ * One task publishes fixed-size samples; every consumer owns a cursor and
+ * reads the slots in place. The producer never waits: when a consumer
+ * falls more than capacity - 1 samples behind, the oldest samples are
+ * overwritten and counted as lost on that consumer's cursor. Because the
+ * slot being written is never handed out, a consumer only has to check
+ * after using a slot that the producer did not lap it meanwhile
+ * (sample_ring_consume), seqlock style.
+ */
+typedef struct {
+    uint8_t *slots;
+    uint32_t elem_size;
+    uint32_t mask;          // Capacity - 1
+    atomic_uint head;       // Samples published so far (wraps)
+} sample_ring_t;
+
+/**
+ * @brief Read position of one consumer
+ */
+typedef struct {
+    uint32_t seq;           // Next sample to read
+    uint32_t lost;          // Samples overwritten before they were read
+} sample_cursor_t;
+
+/**
+ * @brief Set up a ring over caller-provided storage
+ *
+ * @param slots capacity * elem_size bytes
+ * @param capacity Power of two, at least 2
+ */
+void sample_ring_init(sample_ring_t *ring, void *slots, uint32_t elem_size, uint32_t capacity);
+
+/**
+ * @brief Slot to fill with the next sample (producer only)
+ */
+void *sample_ring_claim(sample_ring_t *ring);
+
+/**
+ * @brief Make the claimed slot visible to consumers (producer only)
+ */
+void sample_ring_publish(sample_ring_t *ring);
+
+/**
+ * @brief Place a cursor at the head: it sees samples published from now on
+ */
+void sample_cursor_init(const sample_ring_t *ring, sample_cursor_t *cur);
+
+/**
+ * @brief Contiguous run of unread samples, in place
+ *
+ * Skips (and counts as lost) samples that are about to be overwritten.
+ *
+ * @param n Out: number of samples in the run (stops at the wrap point)
+ * @return First sample of the run, NULL if there is nothing new
+ */
+const void *sample_ring_peek(const sample_ring_t *ring, sample_cursor_t *cur, uint32_t *n);
+
+/**
+ * @brief Release the first n samples returned by sample_ring_peek
+ *
+ * @return false if the producer overwrote some of them while they were in
+ *         use: discard what was read; the cursor now skips the overwritten
+ *         samples and the next peek returns the intact ones again
+ */
+bool sample_ring_consume(const sample_ring_t *ring, sample_cursor_t *cur, uint32_t n);
+
+/**
+ * @brief Copy the newest sample, for consumers that only want the latest value
+ *
+ * @return false if nothing was published yet
+ */
+bool sample_ring_read_latest(const sample_ring_t *ring, void *out);
+
+/**
+ * @brief Samples published so far (wraps)
+ */
+static inline uint32_t sample_ring_count(const sample_ring_t *ring) {
+    return atomic_load_explicit(&ring->head, memory_order_acquire);
+}
+
+#endif // SAMPLE_RING_H
@@ -0,0 +1,86 @@
+#ifndef SAT_TABLE_H
+#define SAT_TABLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "nmea.h"
+#include "ubx.h"
+
+// Pure C, no ESP-IDF dependencies: builds on Linux as well.
+
+#define SAT_TABLE_MAX       128     // Satellite signals; dual-band sky at 60+ SVs
+#define SAT_TABLE_MAX_RUNS  16      // Concurrent GSV runs (constellation x signal)
+
+// Constellation, numbered as UBX gnssId
+typedef enum {
+    SAT_GNSS_GPS     = 0,
+    SAT_GNSS_SBAS    = 1,
+    SAT_GNSS_GALILEO = 2,
+    SAT_GNSS_BEIDOU  = 3,
+    SAT_GNSS_QZSS    = 5,
+    SAT_GNSS_GLONASS = 6,
+} sat_gnss_t;
+
+#define SAT_FLAG_TRACKED    0x01    // CN0 above zero
+#define SAT_FLAG_USED       0x02    // Used in the navigation solution (NAV-SAT only)
+
+// Key layout: gnss (3 bits) | signal (4 bits) | svid (8 bits)
+#define SAT_KEY(gnss, sig, svid) ((uint16_t)(((gnss) << 12) | (((sig) & 0x0F) << 8) | (svid)))
+#define SAT_KEY_GNSS(key)   ((uint8_t)((key) >> 12))
+#define SAT_KEY_SIG(key)    ((uint8_t)(((key) >> 8) & 0x0F))
+#define SAT_KEY_SVID(key)   ((uint8_t)((key) & 0xFF))
+
+/**
+ * @brief Satellites in view, structure of arrays
+ *
+ * Entries are unordered (removal moves the last entry into the hole);
+ * order[] lists them by descending CN0 and is repaired incrementally.
+ */
+typedef struct {
+    uint16_t key[SAT_TABLE_MAX];
+    uint16_t azim[SAT_TABLE_MAX];   // deg
+    int8_t   elev[SAT_TABLE_MAX];   // deg, -1 unknown
+    uint8_t  cn0[SAT_TABLE_MAX];    // dBHz
+    uint8_t  flags[SAT_TABLE_MAX];  // SAT_FLAG_*
+    uint8_t  seen[SAT_TABLE_MAX];   // Generation of the run that last reported it
+
+    uint8_t  order[SAT_TABLE_MAX];  // Entry indices, strongest first
+    uint8_t  rank[SAT_TABLE_MAX];   // Position of each entry in order[]
+    uint8_t  count;
+
+    struct {
+        uint8_t gnss;               // 0xFF = any (NAV-SAT)
+        uint8_t sig;
+        uint8_t next_msg;           // Expected GSV page, 0 = no run open
+        uint8_t gen;
+    } runs[SAT_TABLE_MAX_RUNS];
+    uint8_t num_runs;
+
+    uint32_t updates;               // Completed runs
+    uint32_t dropped;               // Satellites not reported again
+    uint32_t overflows;             // Table full, satellite ignored
+} sat_table_t;
+
+void sat_table_init(sat_table_t *t);
+
+/**
+ * @brief Merge one GSV page
+ *
+ * Pages must arrive in order; the run's satellites that were not
+ * reported are dropped when its last page arrives.
+ */
+void sat_table_feed_gsv(sat_table_t *t, const nmea_gsv_t *gsv);
+
+/**
+ * @brief Merge a complete NAV-SAT message, dropping satellites it omits
+ */
+void sat_table_feed_nav_sat(sat_table_t *t, const ubx_nav_sat_hdr_t *hdr, const ubx_nav_sat_sv_t *svs);
+
+/**
+ * @brief Entry index of the n-th strongest satellite (n < count)
+ */
+static inline uint8_t sat_table_sorted(const sat_table_t *t, uint8_t n) {
+    return t->order[n];
+}
+
+#endif // SAT_TABLE_H
@@ -0,0 +1,76 @@
+#ifndef SENSOR_SERVICE_H
+#define SENSOR_SERVICE_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "sample_ring.h"
+#include "sensors.h"
+
+typedef enum {
+    SENSOR_IMU,     // imu_sample_t
+    SENSOR_MAG,     // mag_sample_t
+    SENSOR_BARO,    // baro_sample_t
+    SENSOR_COUNT,
+} sensor_id_t;
+
+typedef enum {
+    SENSOR_MAG_CAL_IDLE,
+    SENSOR_MAG_CAL_RUNNING,     // Collecting: rotate the device through all directions
+    SENSOR_MAG_CAL_DONE,        // Solved, applied and saved
+    SENSOR_MAG_CAL_FAILED,      // Timed out without a usable fit; old calibration kept
+} sensor_mag_cal_state_t;
+
+typedef struct {
+    uint16_t imu_hz;        // FIFO batch rate
+    uint16_t imu_watermark; // Sample sets per FIFO interrupt
+    uint16_t mag_hz;        // 0 = not sampled
+    uint16_t baro_hz;       // 0 = not sampled
+} sensor_service_config_t;
+
+/**
+ * @brief Set up the rings and load the stored magnetometer calibration;
+ *        call before the task and any consumer start
+ *
+ * @param cfg Rates
+ * @return esp_err_t ESP_ERR_INVALID_ARG for a zero IMU rate or watermark
+ */
+esp_err_t sensor_service_init(const sensor_service_config_t *cfg);
+
+/**
+ * @brief Acquisition task
+ *
+ * The IMU is drained on its FIFO watermark interrupt; mag and baro reads
+ * are queued on the I2C scheduler from esp_timer ticks at their own rates. Every sample is stamped with
+ * esp_timer time and published into the sensor's ring; IMU blocks also
+ * go through the attitude filter. Jitter, dropped
+ * samples and bus errors are logged per sensor.
+ */
+void sensor_task_entry(void *pvParameters);
+
+/**
+ * @brief Ring of one sensor; consumers read it through their own cursor
+ */
+const sample_ring_t *sensor_service_ring(sensor_id_t id);
+
+/**
+ * @brief AHRS output ring (attitude_sample_t), one entry per IMU sample
+ */
+const sample_ring_t *sensor_service_attitude_ring(void);
+
+/**
+ * @brief Start a magnetometer hard/soft-iron calibration
+ *
+ * Runs on the sensor task over the following mag samples (restarting a
+ * running one). Published samples keep the previous calibration until
+ * the fit succeeds; the result is then applied and stored in NVS.
+ */
+void sensor_service_mag_cal_start(void);
+
+void sensor_service_mag_cal_cancel(void);
+
+/**
+ * @brief Calibration state; progress 0-100 (coverage and sample count)
+ */
+sensor_mag_cal_state_t sensor_service_mag_cal_status(uint8_t *progress);
+
+#endif // SENSOR_SERVICE_H
@@ -0,0 +1,43 @@
+#ifndef SENSOR_TYPES_H
+#define SENSOR_TYPES_H
+
+#include <stdint.h>
+
+// Samples published by the sensor service, in device axes. Pure C so the
+// fusion code can use them on Linux as well.
+
+/**
+ * @brief One accel + gyro sample from the IMU FIFO (same axes and units as
+ *        sensors_read_imu)
+ */
+typedef struct {
+    int64_t t_us;           // esp_timer time, spacing from the IMU timestamps
+    float ax, ay, az;       // g
+    float gx, gy, gz;       // dps
+    float temp;             // deg C, read once per FIFO block
+} imu_sample_t;
+
+typedef struct {
+    int64_t t_us;           // esp_timer time of the read
+    float mx, my, mz;       // uT
+    float temp;             // deg C
+} mag_sample_t;
+
+typedef struct {
+    int64_t t_us;           // esp_timer time of the read
+    float pressure;         // hPa
+    float temp;             // deg C
+} baro_sample_t;
+
+/**
+ * @brief AHRS output for one IMU sample
+ */
+typedef struct {
+    int64_t t_us;           // Time of the IMU sample
+    float q[4];             // w, x, y, z: device -> earth (x magnetic north, y west, z up)
+    float lin_body[3];      // g, gravity removed, device axes
+    float lin_earth[3];     // g, gravity removed, earth axes
+    float heading;          // deg clockwise from magnetic north, tilt compensated
+} attitude_sample_t;
+
+#endif // SENSOR_TYPES_H
@@ -4,6 +4,10 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "i2c_sched.h"
+#include "sensor_types.h"
 
 // I2C Addresses
 #include "config.h"
@@ -33,6 +37,14 @@ bool sensors_check_baro(void);
  */
 esp_err_t sensors_read_imu(float *ax, float *ay, float *az, float *gx, float *gy, float *gz, float *temp);
 
+/**
+ * @brief Set the magnetometer output rate
+ *
+ * @param hz Rate in Hz (10, 20, 50 or 100; rounded up)
+ * @return esp_err_t
+ */
+esp_err_t sensors_set_mag_rate(uint16_t hz);
+
 /**
  * @brief Read Magnetometer data
  *
@@ -53,9 +65,58 @@ esp_err_t sensors_read_mag(float *mx, float *my, float *mz, float *temp);
  */
 esp_err_t sensors_read_baro(float *pressure, float *temp);
 
+/**
+ * @brief Read queued on the I2C bus task; keep it alive until done runs
+ */
+typedef struct {
+    i2c_txn_t txn;          // txn.start_us: when the bus transfer began
+    uint8_t raw[8];
+} sensors_read_req_t;
+
+/**
+ * @brief Queue a magnetometer / barometer read without waiting for the bus
+ *
+ * @param done Called on the I2C bus task when req->txn completes; decode
+ *             the result with sensors_decode_mag / sensors_decode_baro
+ */
+void sensors_read_mag_async(sensors_read_req_t *req, i2c_txn_done_t done, void *arg);
+void sensors_read_baro_async(sensors_read_req_t *req, i2c_txn_done_t done, void *arg);
+
+/**
+ * @brief Convert a completed asynchronous read (same units as the blocking reads)
+ *
+ * @return ESP_ERR_TIMEOUT or ESP_FAIL if the transfer failed
+ */
+esp_err_t sensors_decode_mag(const sensors_read_req_t *req, float *mx, float *my, float *mz, float *temp);
+esp_err_t sensors_decode_baro(const sensors_read_req_t *req, float *pressure, float *temp);
+
+/**
+ * @brief Batch accel/gyro in the LSM6DSR FIFO with timestamps and raise
+ *        ACCGYRO_INT at the watermark
+ *
+ * @param odr_hz Sample rate (rounded up to a supported ODR)
+ * @param watermark Sample sets per interrupt
+ * @param task Task notified from the interrupt
+ * @param notify_bits Notification bits set on the task (eSetBits)
+ * @return esp_err_t
+ */
+esp_err_t sensors_imu_fifo_start(uint16_t odr_hz, uint16_t watermark, TaskHandle_t task, uint32_t notify_bits);
+
+/**
+ * @brief Drain the FIFO in burst reads
+ *
+ * @param out Sample block
+ * @param max Capacity of out; remaining samples stay in the FIFO
+ * @return Number of samples, or -1 on bus error
+ */
+int sensors_imu_fifo_read(imu_sample_t *out, int max);
+
 // Helper functions for derived data
-void sensors_calc_gravity_linear(float ax, float ay, float az, float *grav_x, float *grav_y, float *grav_z, float *lin_x, float *lin_y, float *lin_z);
-float sensors_calc_heading(float mx, float my);
+
+/**
+ * @brief Altitude for 1013.25 hPa at sea level, hypsometric with temp_c
+ *        (NaN = standard atmosphere); the fused altitude is in nav_altitude_ring
+ */
 float sensors_calc_altitude(float pressure_hpa, float temp_c);
 
 #endif // SENSORS_H
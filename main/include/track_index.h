@@ -0,0 +1,136 @@
+#ifndef TRACK_INDEX_H
+#define TRACK_INDEX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "gpx_writer.h"
+#include "pbox.h"
+#include "ride_stats.h"
+
+// Pure C, no ESP-IDF dependencies: builds on Linux as well.
+
+#define TRACK_INDEX_MAGIC       0x58444954u     // "TIDX"
+#define TRACK_INDEX_VERSION     1
+#define TRACK_INDEX_HEADER_LEN  16
+#define TRACK_INDEX_NAME_LEN    16
+
+/**
+ * @brief One session, 96 bytes little endian as laid out here
+ *
+ * Times are UTC seconds since 1970 from the first point with a date, 0
+ * when the session never had one. pbox_ms holds the best time of each
+ * P-Box interval in the order nav configures them, 0 = not run.
+ */
+typedef struct {
+    char name[TRACK_INDEX_NAME_LEN];    // File name in the track directory, NUL padded
+    uint32_t start_s;
+    uint32_t duration_s;
+    uint32_t distance_m;
+    uint32_t max_speed_mmps;
+    uint32_t gain_m;
+    int32_t lat_min, lat_max;           // Bounding box, 1e-7 deg
+    int32_t lon_min, lon_max;
+    uint32_t pbox_ms[PBOX_MAX_INTERVALS];
+    uint32_t points;
+    uint32_t file_len;
+    uint32_t crc;                       // track_crc32 of the preceding bytes
+} track_index_rec_t;
+
+_Static_assert(sizeof(track_index_rec_t) == 96, "index records are 96 bytes");
+
+/**
+ * @brief Session summary built point by point while recording, and from
+ *        a finished .TRK file when the index is rebuilt
+ *
+ * Distance, maximum speed and gain come from ride_stats with its default
+ * parameters, fed the points' position, speed and elevation, so the index
+ * agrees with the ride statistics of the same stretch.
+ */
+typedef struct {
+    track_index_rec_t rec;
+    int64_t first_us, last_us;
+    ride_stats_t ride;
+} track_summary_t;
+
+/**
+ * @brief Start a summary
+ *
+ * @param name File name without directory, truncated to fit the record
+ */
+void track_summary_begin(track_summary_t *s, const char *name);
+
+void track_summary_point(track_summary_t *s, int64_t t_us, const gpx_point_t *p);
+
+/**
+ * @brief A completed P-Box run; the best time per interval is kept
+ */
+void track_summary_pbox(track_summary_t *s, uint8_t interval, float time_s);
+
+/**
+ * @brief Finish the record, with the final file length and CRC
+ */
+const track_index_rec_t *track_summary_end(track_summary_t *s, uint32_t file_len);
+
+/**
+ * @brief Summarise a .TRK file; damaged blocks and the rest of their
+ *        chunk are skipped
+ *
+ * @return 0, or -1 with errno set (EINVAL: not a track log)
+ */
+int track_summary_file(track_summary_t *s, const char *path, const char *name);
+
+// Index file: TRACK_INDEX_HEADER_LEN bytes (magic, version, record
+// length), then records sorted by start time. Sessions close in time
+// order, so a new record is written at the end in O(1); one that starts
+// before the last is inserted in place. Lookups by time are binary
+// searches, one read per step.
+
+/**
+ * @brief Add a record, creating the file if needed
+ *
+ * @return 0, or -1 with errno set (EINVAL: not an index file)
+ */
+int track_index_append(const char *path, const track_index_rec_t *r);
+
+/**
+ * @brief Number of records, -1 with errno set if the file is missing or
+ *        not an index
+ */
+int32_t track_index_count(const char *path);
+
+/**
+ * @brief Read records [first, first + n)
+ *
+ * @return Records read, -1 with errno set; records failing their CRC are
+ *         read as well and left for the caller to check
+ */
+int32_t track_index_read(const char *path, uint32_t first, uint32_t n, track_index_rec_t *out);
+
+/**
+ * @brief Position of the first record starting at or after start_s
+ *
+ * @return 0 .. count, -1 with errno set
+ */
+int32_t track_index_find(const char *path, uint32_t start_s);
+
+/**
+ * @brief Whether the session start_s / name is in the index, by a binary
+ *        search on start_s
+ *
+ * @return 1 if it is, 0 if not, -1 with errno set
+ */
+int track_index_contains(const char *path, uint32_t start_s, const char *name);
+
+bool track_index_rec_valid(const track_index_rec_t *r);
+
+/**
+ * @brief Recreate the index from every ACT_* file in dir, replacing path
+ *
+ * A .TRK file is summarised in full; a .GPX file gets its name and size
+ * only, its statistics having come from the recording.
+ *
+ * @return Sessions indexed, -1 with errno set
+ */
+int32_t track_index_rebuild(const char *dir, const char *path);
+
+#endif // TRACK_INDEX_H
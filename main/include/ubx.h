@@ -0,0 +1,186 @@
+#ifndef UBX_H
+#define UBX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "gnss_types.h"
+
+// Pure C, no ESP-IDF dependencies: builds on Linux as well.
+
+#define UBX_SYNC_CHAR_1     0xB5
+#define UBX_SYNC_CHAR_2     0x62
+#define UBX_HEADER_LEN      6       // sync(2) + class + id + len(2)
+#define UBX_FRAME_OVERHEAD  8       // header + CK_A + CK_B
+
+// Classes
+#define UBX_CLASS_NAV       0x01
+#define UBX_CLASS_ACK       0x05
+#define UBX_CLASS_CFG       0x06
+#define UBX_CLASS_UPD       0x09
+#define UBX_CLASS_MON       0x0A
+#define UBX_CLASS_MGA       0x13
+
+// IDs
+#define UBX_ID_NAV_DOP      0x04
+#define UBX_ID_NAV_PVT      0x07
+#define UBX_ID_NAV_TIMEUTC  0x21
+#define UBX_ID_NAV_SAT      0x35
+#define UBX_ID_NAV_EOE      0x61
+#define UBX_ID_ACK_NAK      0x00
+#define UBX_ID_ACK_ACK      0x01
+#define UBX_ID_CFG_RST      0x04
+#define UBX_ID_CFG_VALSET   0x8A
+#define UBX_ID_UPD_SOS      0x14
+#define UBX_ID_MON_VER      0x04
+#define UBX_ID_MGA_INI      0x40
+
+#define UBX_NAV_SAT_MAX_SVS 64
+
+// NAV-PVT valid / flags bits
+#define UBX_PVT_VALID_DATE  0x01
+#define UBX_PVT_VALID_TIME  0x02
+#define UBX_PVT_FLAGS_FIXOK 0x01
+
+typedef struct __attribute__((packed)) {
+    uint32_t iTOW;
+    uint16_t year;
+    uint8_t  month, day, hour, min, sec;
+    uint8_t  valid;
+    uint32_t tAcc;
+    int32_t  nano;
+    uint8_t  fixType;
+    uint8_t  flags;
+    uint8_t  flags2;
+    uint8_t  numSV;
+    int32_t  lon, lat;
+    int32_t  height, hMSL;
+    uint32_t hAcc, vAcc;
+    int32_t  velN, velE, velD;
+    int32_t  gSpeed;
+    int32_t  headMot;
+    uint32_t sAcc;
+    uint32_t headAcc;
+    uint16_t pDOP;
+    uint16_t flags3;
+    uint8_t  reserved0[4];
+    int32_t  headVeh;
+    int16_t  magDec;
+    uint16_t magAcc;
+} ubx_nav_pvt_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t iTOW;
+    uint16_t gDOP, pDOP, tDOP, vDOP, hDOP, nDOP, eDOP;
+} ubx_nav_dop_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t iTOW;
+    uint32_t tAcc;
+    int32_t  nano;
+    uint16_t year;
+    uint8_t  month, day, hour, min, sec;
+    uint8_t  valid;
+} ubx_nav_timeutc_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t iTOW;
+    uint8_t  version;
+    uint8_t  numSvs;
+    uint8_t  reserved0[2];
+} ubx_nav_sat_hdr_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t  gnssId;
+    uint8_t  svId;
+    uint8_t  cno;
+    int8_t   elev;
+    int16_t  azim;
+    int16_t  prRes;
+    uint32_t flags;
+} ubx_nav_sat_sv_t;
+
+_Static_assert(sizeof(ubx_nav_pvt_t) == 92, "NAV-PVT size");
+_Static_assert(sizeof(ubx_nav_dop_t) == 18, "NAV-DOP size");
+_Static_assert(sizeof(ubx_nav_timeutc_t) == 20, "NAV-TIMEUTC size");
+_Static_assert(sizeof(ubx_nav_sat_hdr_t) == 8, "NAV-SAT header size");
+_Static_assert(sizeof(ubx_nav_sat_sv_t) == 12, "NAV-SAT block size");
+
+typedef enum {
+    UBX_OK = 0,         // Checksum valid, handler ran
+    UBX_UNHANDLED,      // Checksum valid, no handler for (class, id)
+    UBX_ERR_CHECKSUM,
+    UBX_ERR_LENGTH,     // Payload shorter than the handler requires
+} ubx_status_t;
+
+typedef struct {
+    uint8_t cls;        // Class of the acknowledged message
+    uint8_t id;
+    bool    ack;        // true = ACK-ACK, false = ACK-NAK
+    bool    pending;    // Set by the engine, cleared by the consumer
+} ubx_ack_t;
+
+typedef struct {
+    gnss_fix_t fix;                 // Updated by NAV-PVT and NAV-DOP
+
+    ubx_nav_pvt_t     pvt;
+    ubx_nav_dop_t     dop;
+    ubx_nav_timeutc_t timeutc;
+    ubx_nav_sat_hdr_t sat;
+    ubx_nav_sat_sv_t  sat_svs[UBX_NAV_SAT_MAX_SVS];
+    ubx_ack_t ack;
+
+    uint32_t frames;                // Frames with a valid checksum
+    uint32_t ck_errors;
+    uint32_t len_errors;
+    uint32_t unhandled;
+} ubx_engine_t;
+
+void ubx_engine_init(ubx_engine_t *eng);
+
+/**
+ * @brief Fletcher-8 checksum over class, id, length and payload
+ */
+void ubx_checksum(uint8_t cls, uint8_t id, const uint8_t *payload, uint16_t len,
+                  uint8_t *ck_a, uint8_t *ck_b);
+
+/**
+ * @brief Build a complete UBX frame into buf
+ *
+ * @return size_t Frame length, or 0 if buf_size is too small
+ */
+size_t ubx_build_frame(uint8_t cls, uint8_t id, const uint8_t *payload, uint16_t len,
+                       uint8_t *buf, size_t buf_size);
+
+/**
+ * @brief Verify and dispatch one UBX message
+ *
+ * The handler is picked from a static (class, id) table.
+ *
+ * @param eng Engine state
+ * @param cls Message class
+ * @param id Message ID
+ * @param payload Payload bytes
+ * @param len Payload length
+ * @param ck_a Received CK_A
+ * @param ck_b Received CK_B
+ * @return ubx_status_t
+ */
+ubx_status_t ubx_engine_process(ubx_engine_t *eng, uint8_t cls, uint8_t id,
+                                const uint8_t *payload, uint16_t len,
+                                uint8_t ck_a, uint8_t ck_b);
+
+/**
+ * @brief Dispatch one UBX message whose checksum was already verified
+ *
+ * Used behind gnss_framer, which checks CK_A/CK_B while framing.
+ */
+ubx_status_t ubx_engine_dispatch(ubx_engine_t *eng, uint8_t cls, uint8_t id,
+                                 const uint8_t *payload, uint16_t len);
+
+/**
+ * @brief Verify and dispatch a complete frame (sync chars through CK_B)
+ */
+ubx_status_t ubx_engine_process_frame(ubx_engine_t *eng, const uint8_t *frame, size_t len);
+
+#endif // UBX_H
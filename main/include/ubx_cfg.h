@@ -0,0 +1,151 @@
+#ifndef UBX_CFG_H
+#define UBX_CFG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "ubx.h"
+
+// Pure C, no ESP-IDF dependencies: builds on Linux as well.
+
+// CFG-VALSET layers
+#define UBX_CFG_LAYER_RAM   0x01
+#define UBX_CFG_LAYER_BBR   0x02
+#define UBX_CFG_LAYER_FLASH 0x04
+
+#define UBX_VALSET_MAX_KEYS     64      // Protocol limit per message
+#define UBX_VALSET_MAX_PAYLOAD  (4 + UBX_VALSET_MAX_KEYS * 8)
+
+// Configuration keys (u-blox M10 interface description). The value size
+// is encoded in bits 28..30 of the key.
+#define UBX_KEY_UART1_BAUDRATE          0x40520001u
+#define UBX_KEY_UART1OUTPROT_UBX        0x10740001u
+#define UBX_KEY_UART1OUTPROT_NMEA       0x10740002u
+#define UBX_KEY_RATE_MEAS               0x30210001u
+#define UBX_KEY_RATE_NAV                0x30210002u
+#define UBX_KEY_NAVSPG_DYNMODEL         0x20110021u
+#define UBX_KEY_SIGNAL_GPS_ENA          0x1031001Fu
+#define UBX_KEY_SIGNAL_SBAS_ENA         0x10310020u
+#define UBX_KEY_SIGNAL_GAL_ENA          0x10310021u
+#define UBX_KEY_SIGNAL_BDS_ENA          0x10310022u
+#define UBX_KEY_SIGNAL_QZSS_ENA         0x10310024u
+#define UBX_KEY_SIGNAL_GLO_ENA          0x10310025u
+#define UBX_KEY_MSGOUT_NAV_PVT_UART1    0x20910007u
+#define UBX_KEY_MSGOUT_NAV_SAT_UART1    0x20910016u
+#define UBX_KEY_MSGOUT_NAV_DOP_UART1    0x20910039u
+#define UBX_KEY_MSGOUT_NAV_TIMEUTC_UART1 0x2091005Cu
+#define UBX_KEY_MSGOUT_NAV_EOE_UART1    0x20910160u
+#define UBX_KEY_MSGOUT_NMEA_RMC_UART1   0x209100ACu
+#define UBX_KEY_MSGOUT_NMEA_VTG_UART1   0x209100B1u
+#define UBX_KEY_MSGOUT_NMEA_GGA_UART1   0x209100BBu
+#define UBX_KEY_MSGOUT_NMEA_GSA_UART1   0x209100C0u
+#define UBX_KEY_MSGOUT_NMEA_GSV_UART1   0x209100C5u
+#define UBX_KEY_MSGOUT_NMEA_GLL_UART1   0x209100CAu
+
+/**
+ * @brief CFG-VALSET payload under construction
+ */
+typedef struct {
+    uint8_t payload[UBX_VALSET_MAX_PAYLOAD];
+    uint16_t len;
+    uint8_t keys;
+    bool overflow;          // A key did not fit; the payload must not be sent
+} ubx_valset_t;
+
+void ubx_valset_init(ubx_valset_t *vs, uint8_t layers);
+
+/**
+ * @brief Append one key/value pair, sized from the key's size field
+ *
+ * @return false if the key has an invalid size or the message is full
+ */
+bool ubx_valset_add(ubx_valset_t *vs, uint32_t key, uint64_t value);
+
+// Transaction tracking for a command answered by ACK-ACK / ACK-NAK
+
+typedef enum {
+    UBX_TXN_IDLE = 0,
+    UBX_TXN_WAIT_ACK,
+    UBX_TXN_ACKED,
+    UBX_TXN_NAKED,
+    UBX_TXN_TIMEOUT,        // All attempts went unanswered
+} ubx_txn_state_t;
+
+typedef struct {
+    uint8_t cls;
+    uint8_t id;
+    uint8_t state;          // ubx_txn_state_t
+    uint8_t attempts;
+    uint8_t max_attempts;
+    uint32_t timeout_us;
+    int64_t sent_us;
+    int64_t deadline_us;
+    int64_t done_us;        // Time the ACK/NAK arrived
+} ubx_txn_t;
+
+/**
+ * @brief Start waiting for the ACK of a command that was just sent
+ */
+void ubx_txn_start(ubx_txn_t *txn, uint8_t cls, uint8_t id, int64_t now_us,
+                   uint32_t timeout_us, uint8_t max_attempts);
+
+/**
+ * @brief Match an ACK-ACK / ACK-NAK against the open transaction
+ *
+ * @return true if the acknowledgement belonged to this transaction
+ */
+bool ubx_txn_on_ack(ubx_txn_t *txn, const ubx_ack_t *ack, int64_t now_us);
+
+/**
+ * @brief Check for timeout
+ *
+ * @return true if the command must be sent again (attempt counted and
+ *         deadline rearmed); false otherwise
+ */
+bool ubx_txn_poll(ubx_txn_t *txn, int64_t now_us);
+
+static inline bool ubx_txn_busy(const ubx_txn_t *txn) {
+    return txn->state == UBX_TXN_WAIT_ACK;
+}
+
+// Receiver profiles
+
+typedef enum {
+    GNSS_DYN_PORTABLE   = 0,
+    GNSS_DYN_STATIONARY = 2,
+    GNSS_DYN_PEDESTRIAN = 3,
+    GNSS_DYN_AUTOMOTIVE = 4,
+    GNSS_DYN_SEA        = 5,
+    GNSS_DYN_AIRBORNE1G = 6,
+    GNSS_DYN_AIRBORNE2G = 7,
+    GNSS_DYN_AIRBORNE4G = 8,
+    GNSS_DYN_WRIST      = 9,
+    GNSS_DYN_BIKE       = 10,
+} gnss_dyn_model_t;
+
+#define GNSS_CONST_GPS      (1u << 0)
+#define GNSS_CONST_GLONASS  (1u << 1)
+#define GNSS_CONST_GALILEO  (1u << 2)
+#define GNSS_CONST_BEIDOU   (1u << 3)
+#define GNSS_CONST_QZSS     (1u << 4)
+#define GNSS_CONST_SBAS     (1u << 5)
+
+typedef struct {
+    uint8_t rate_hz;            // Navigation rate: 1, 5, 10 or 25
+    uint8_t dyn_model;          // gnss_dyn_model_t
+    uint8_t constellations;     // GNSS_CONST_* mask
+    bool ubx_only;              // Turn NMEA output off on UART1
+} gnss_profile_t;
+
+/**
+ * @brief Pack a complete profile (rate, model, signals, message outputs)
+ *        into one CFG-VALSET
+ *
+ * Satellite lists (NAV-SAT / GSV) are limited to about 1 Hz; PVT, DOP and
+ * NAV-EOE are output every epoch.
+ *
+ * @return false if the profile is invalid or does not fit
+ */
+bool ubx_cfg_build_profile(ubx_valset_t *vs, const gnss_profile_t *profile, uint8_t layers);
+
+#endif // UBX_CFG_H
@@ -1,7 +1,12 @@
 #include "input.h"
 #include "config.h"
+#include "logger.h"
+#include "gnss.h"
+#include "sensor_service.h"
 #include "driver/gpio.h"
+#include "driver/rtc_io.h"
 #include "esp_log.h"
+#include "esp_sleep.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_timer.h"
@@ -16,13 +21,48 @@ typedef enum {
     BTN_IDLE,
     BTN_PRESSED,
     BTN_RELEASED,
-    BTN_WAIT_DOUBLE
+    BTN_WAIT_DOUBLE,
+    BTN_WAIT_TRIPLE,
+    BTN_WAIT_RELEASE
 } btn_state_t;
 
 static btn_state_t key_state = BTN_IDLE;
 static int64_t key_press_time = 0;
 static int64_t key_release_time = 0;
 
+// Close the track, let the receiver back up its state, then deep sleep
+// until the key is pressed again, which boots from scratch
+static void power_off(void) {
+    ESP_LOGI(TAG, "Powering off");
+    if (logger_state() != LOGGER_IDLE) {
+        if (logger_state() == LOGGER_RECORDING) logger_toggle_recording();
+        for (int waited = 0; logger_state() != LOGGER_IDLE && waited < KEY_STOP_WAIT_MS; waited += 50) {
+            vTaskDelay(pdMS_TO_TICKS(50));
+        }
+    }
+    gnss_power_off();
+
+    // A key still held would wake the chip straight away
+    while (gpio_get_level(KEY_MAIN_PIN) == 0) vTaskDelay(pdMS_TO_TICKS(20));
+    rtc_gpio_pullup_en(KEY_MAIN_PIN);
+    rtc_gpio_pulldown_dis(KEY_MAIN_PIN);
+    esp_sleep_enable_ext0_wakeup(KEY_MAIN_PIN, 0);
+    esp_deep_sleep_start();
+}
+
+// Triple click starts the magnetometer calibration (turn the device through
+// all directions until it completes) or cancels a running one. Long press
+// stays with the settings screen.
+static void toggle_mag_cal(void) {
+    if (sensor_service_mag_cal_status(NULL) == SENSOR_MAG_CAL_RUNNING) {
+        ESP_LOGI(TAG, "Mag calibration: cancel");
+        sensor_service_mag_cal_cancel();
+    } else {
+        ESP_LOGI(TAG, "Mag calibration: start");
+        sensor_service_mag_cal_start();
+    }
+}
+
 static void process_key_logic(int key_level) {
     int64_t now = esp_timer_get_time() / 1000; // ms
 
@@ -38,7 +78,10 @@ static void process_key_logic(int key_level) {
             break;
 
         case BTN_PRESSED:
-            if (!pressed) {
+            if (pressed && now - key_press_time >= KEY_POWER_OFF_MS) {
+                diagnostics_trigger("KEY: POWER OFF");
+                power_off();
+            } else if (!pressed) {
                 // Released
                 int64_t duration = now - key_press_time;
                 key_state = BTN_RELEASED;
@@ -49,6 +92,7 @@ static void process_key_logic(int key_level) {
                     key_state = BTN_IDLE; // Reset
                 } else if (duration > 500) {
                     diagnostics_trigger("KEY: MEDIUM PRESS");
+                    logger_toggle_recording();
                     key_state = BTN_IDLE; // Reset
                 }
                 // else: Short press candidate, wait for potential double click
@@ -64,8 +108,7 @@ static void process_key_logic(int key_level) {
                 // Or better: Treat as new press but check gap.
                 int64_t gap = now - key_release_time;
                 if (gap < 300) { // 300ms double click window
-                    diagnostics_trigger("KEY: DOUBLE CLICK");
-                    key_state = BTN_WAIT_DOUBLE; // Wait for release of 2nd press to reset
+                    key_state = BTN_WAIT_DOUBLE; // Wait for release of 2nd press
                 } else {
                     // Too slow, previous was short press
                     diagnostics_trigger("KEY: SHORT PRESS");
@@ -82,6 +125,28 @@ static void process_key_logic(int key_level) {
             break;
 
         case BTN_WAIT_DOUBLE:
+            if (!pressed) {
+                key_state = BTN_WAIT_TRIPLE;
+                key_release_time = now;
+            }
+            break;
+
+        case BTN_WAIT_TRIPLE:
+            // A double click only counts once no third press follows, so
+            // a triple click leaves the ride alone
+            if (pressed && now - key_release_time < 300) {
+                diagnostics_trigger("KEY: TRIPLE CLICK");
+                toggle_mag_cal();
+                key_state = BTN_WAIT_RELEASE;
+            } else if (pressed || now - key_release_time > 300) {
+                diagnostics_trigger("KEY: DOUBLE CLICK");
+                logger_reset_ride();
+                key_state = pressed ? BTN_PRESSED : BTN_IDLE; // Too slow: a new press
+                key_press_time = now;
+            }
+            break;
+
+        case BTN_WAIT_RELEASE:
             if (!pressed) {
                 key_state = BTN_IDLE;
             }
@@ -133,7 +198,8 @@ esp_err_t input_init(void) {
     esp_err_t err = gpio_config(&io_conf);
     if (err != ESP_OK) return err;
 
-    xTaskCreate(input_task, "input_task", 2048, NULL, 5, NULL);
+    // Power-off writes NVS from this task
+    xTaskCreate(input_task, "input_task", 4096, NULL, 5, NULL);
 
     ESP_LOGI(TAG, "Input configured successfully.");
     return ESP_OK;
@@ -0,0 +1,30 @@
+#include "latency_hist.h"
+#include <string.h>
+
+void latency_hist_reset(latency_hist_t *h) {
+    memset(h, 0, sizeof(*h));
+}
+
+void latency_hist_add(latency_hist_t *h, uint32_t us) {
+    int bucket = us ? 31 - __builtin_clz(us) : 0;
+    if (bucket >= LATENCY_HIST_BUCKETS) bucket = LATENCY_HIST_BUCKETS - 1;
+
+    h->count[bucket]++;
+    h->total++;
+    h->sum_us += us;
+    if (us > h->max_us) h->max_us = us;
+}
+
+uint32_t latency_hist_percentile(const latency_hist_t *h, uint32_t pct) {
+    if (h->total == 0) return 0;
+
+    uint64_t target = ((uint64_t)h->total * pct + 99) / 100;
+    if (target == 0) target = 1;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < LATENCY_HIST_BUCKETS - 1; i++) {
+        seen += h->count[i];
+        if (seen >= target) return (2u << i) - 1;
+    }
+    return h->max_us;
+}
@@ -0,0 +1,642 @@
+#include "logger.h"
+#include "config.h"
+#include "battery.h"
+#include "gnss.h"
+#include "gpx_writer.h"
+#include "track_index.h"
+#include "track_log.h"
+#include "nav.h"
+#include "ride_stats.h"
+#include "sensor_service.h"
+#include "driver/sdmmc_host.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "esp_vfs_fat.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdmmc_cmd.h"
+#include <dirent.h>
+#include <errno.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+
+static const char *TAG = "LOGGER";
+
+#define LOGGER_POLL_MS          10
+#define FLUSH_IDLE_MS           1000    // Flush task wake-up without a full chunk
+#define BAT_READ_PERIOD_US      (1000 * 1000)
+#define STATS_LOG_PERIOD_US     (10 * 1000 * 1000)
+#define RIDE_NVS_NAMESPACE      "ride"
+#define RIDE_NVS_KEY            "stats"
+#define TRACK_NUMBER_MAX        9999    // ACT_nnnn
+
+#if LOGGER_FORMAT_TRK
+static track_log_t trk;
+static chunk_writer_t *const out = &trk.out;
+#define TRACK_EXT               "TRK"
+#else
+static gpx_writer_t gpx;
+static chunk_writer_t *const out = &gpx.out;
+#define TRACK_EXT               "GPX"
+#endif
+static sdmmc_card_t *card;
+static bool sd_ok;
+static atomic_uint state;       // logger_state_t
+static atomic_bool toggle_req;
+static atomic_uint ui_mode;
+static TaskHandle_t flush_task = NULL;
+
+// Summary for the index: the flush task starts and ends it, the logger
+// task adds to it while recording
+static track_summary_t summary;
+
+// Ride statistics for the bike computer, kept across recordings and
+// restarts: the logger task feeds them and publishes a summary per fix
+static const ride_stats_params_t ride_params = RIDE_STATS_DEFAULT_PARAMS;
+static ride_stats_t ride;
+static ride_stats_state_t ride_saved;   // As last written to NVS
+static int64_t ride_saved_us;
+static atomic_bool ride_reset_req;
+static sample_ring_t ride_ring;
+static ride_stats_summary_t ride_slots[LOGGER_RIDE_RING_LEN];
+
+// Owned by the logger task
+static sample_cursor_t baro_cursor;
+static sample_cursor_t pbox_cursor;
+static sample_cursor_t alt_cursor;
+#if LOGGER_FORMAT_TRK
+static sample_cursor_t imu_cursor;
+static imu_sample_t imu_sum;    // Running sum of the IMU samples being averaged
+static uint8_t imu_n;
+#endif
+static float baro_temp = NAN;
+static uint16_t bat_mv;
+static int64_t bat_read_us;
+
+_Static_assert((LOGGER_RING_PSRAM & (LOGGER_RING_PSRAM - 1)) == 0, "ring size must be a power of two");
+_Static_assert((LOGGER_RING_INTERNAL & (LOGGER_RING_INTERNAL - 1)) == 0, "ring size must be a power of two");
+_Static_assert(LOGGER_RING_INTERNAL >= 2 * CHUNK_WRITER_CHUNK, "ring must hold two chunks");
+
+static esp_err_t sd_mount(void) {
+    sdmmc_host_t host = SDMMC_HOST_DEFAULT();
+    sdmmc_slot_config_t slot = SDMMC_SLOT_CONFIG_DEFAULT();
+    slot.width = 4;
+    slot.clk = SD_CLK_PIN;
+    slot.cmd = SD_CMD_PIN;
+    slot.d0 = SD_D0_PIN;
+    slot.d1 = SD_D1_PIN;
+    slot.d2 = SD_D2_PIN;
+    slot.d3 = SD_D3_PIN;
+    slot.flags |= SDMMC_SLOT_FLAG_INTERNAL_PULLUP;
+
+    // A card formatted here gets clusters the size of one writer chunk
+    const esp_vfs_fat_sdmmc_mount_config_t mount_cfg = {
+        .format_if_mount_failed = false,
+        .max_files = 4,
+        .allocation_unit_size = CHUNK_WRITER_CHUNK,
+    };
+    esp_err_t err = esp_vfs_fat_sdmmc_mount(LOGGER_MOUNT_POINT, &host, &slot, &mount_cfg, &card);
+    if (err != ESP_OK) return err;
+
+    if (mkdir(LOGGER_GPX_DIR, 0775) != 0 && errno != EEXIST) {
+        ESP_LOGE(TAG, "Cannot create %s: errno %d", LOGGER_GPX_DIR, errno);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+// Highest ACT_nnnn number in the GPX directory, 0 if none; 8.3 names, so
+// no long file name support is needed. Numbers only grow: the newest
+// track is always the highest one.
+static unsigned last_track_number(void) {
+    unsigned last = 0;
+    DIR *dir = opendir(LOGGER_GPX_DIR);
+    if (!dir) return 0;
+    struct dirent *e;
+    while ((e = readdir(dir)) != NULL) {
+        if (strncasecmp(e->d_name, "ACT_", 4) != 0) continue;
+        unsigned n = (unsigned)strtoul(e->d_name + 4, NULL, 10);
+        if (n > last) last = n;
+    }
+    closedir(dir);
+    return last;
+}
+
+#if LOGGER_FORMAT_TRK
+// The newest track is the only one that can have been left open by a
+// reset or power loss; trim it to its last intact block
+static void recover_last_track(void) {
+    unsigned n = last_track_number();
+    if (n == 0 || n > TRACK_NUMBER_MAX) return;
+    char path[64];
+    snprintf(path, sizeof(path), "%s/ACT_%04u." TRACK_EXT, LOGGER_GPX_DIR, n);
+
+    int64_t t0 = esp_timer_get_time();
+    track_recovery_t r;
+    int ret = track_log_recover(path, &r);
+    uint32_t took_ms = (uint32_t)((esp_timer_get_time() - t0) / 1000);
+    if (ret < 0) {
+        if (errno != ENOENT) ESP_LOGW(TAG, "%s not recoverable: errno %d", path, errno);
+    } else if (ret > 0) {
+        ESP_LOGW(TAG, "%s was left open: kept %lu of %lu KB, %lu blocks, %.1f min of track (%lu checkpoints, %lums)",
+                 path, (unsigned long)(r.length / 1024), (unsigned long)(r.size / 1024), (unsigned long)r.seq,
+                 (r.end_us - r.start_us) / 60e6, (unsigned long)r.checkpoints, (unsigned long)took_ms);
+    }
+}
+#endif
+
+static void ride_load(void) {
+    ride_stats_state_t rec;
+    size_t size = sizeof(rec);
+    esp_err_t err = ESP_ERR_NVS_NOT_FOUND;
+    nvs_handle_t handle;
+    if (nvs_open(RIDE_NVS_NAMESPACE, NVS_READONLY, &handle) == ESP_OK) {
+        err = nvs_get_blob(handle, RIDE_NVS_KEY, &rec, &size);
+        nvs_close(handle);
+    }
+
+    bool ok = err == ESP_OK && size == sizeof(rec) && ride_stats_state_valid(&rec);
+    ride_stats_init(&ride, &ride_params, ok ? &rec : NULL);
+    ride_saved = ride.st;
+    if (ok) {
+        ride_stats_summary_t s;
+        ride_stats_summary(&ride, &s);
+        ESP_LOGI(TAG, "Ride restored: %.2f km, %.0f min moving, +%.0f m", s.distance_m / 1000.0f,
+                 s.moving_s / 60.0f, s.gain_m);
+    }
+}
+
+static esp_err_t ride_save(void) {
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(RIDE_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) return err;
+    err = nvs_set_blob(handle, RIDE_NVS_KEY, &ride.st, sizeof(ride.st));
+    if (err == ESP_OK) err = nvs_commit(handle);
+    nvs_close(handle);
+    return err;
+}
+
+// Runs in the logger task ahead of the first start, so a long rebuild
+// holds up recording but not app_main. The index is rebuilt from the
+// files when missing or unreadable; otherwise the newest track is added
+// if it is not in it, whether recovery trimmed it or a reset came between
+// closing the file and writing its record.
+static void index_init(void) {
+    int64_t t0 = esp_timer_get_time();
+#if LOGGER_FORMAT_TRK
+    recover_last_track();
+#endif
+    int32_t n = track_index_count(LOGGER_INDEX_PATH);
+    if (n < 0) {
+        n = track_index_rebuild(LOGGER_GPX_DIR, LOGGER_INDEX_PATH);
+        if (n < 0) {
+            ESP_LOGE(TAG, "Cannot rebuild %s: errno %d", LOGGER_INDEX_PATH, errno);
+        } else {
+            ESP_LOGI(TAG, "Rebuilt %s: %ld sessions in %lums", LOGGER_INDEX_PATH, (long)n,
+                     (unsigned long)((esp_timer_get_time() - t0) / 1000));
+        }
+        return;
+    }
+#if LOGGER_FORMAT_TRK
+    unsigned last = last_track_number();
+    if (last > 0 && last <= TRACK_NUMBER_MAX) {
+        char name[16], path[64];
+        track_index_rec_t r;
+        snprintf(name, sizeof(name), "ACT_%04u." TRACK_EXT, last);
+        // Usually the last record already: no need to read the file
+        bool indexed = n > 0 && track_index_read(LOGGER_INDEX_PATH, (uint32_t)n - 1, 1, &r) == 1 &&
+                       strncmp(r.name, name, TRACK_INDEX_NAME_LEN) == 0;
+        snprintf(path, sizeof(path), "%s/%s", LOGGER_GPX_DIR, name);
+        if (!indexed && track_summary_file(&summary, path, name) == 0) {
+            int in = track_index_contains(LOGGER_INDEX_PATH, summary.rec.start_s, summary.rec.name);
+            if (in == 0 && track_index_append(LOGGER_INDEX_PATH, &summary.rec) == 0) {
+                ESP_LOGI(TAG, "Indexed %s", name);
+                n++;
+            } else if (in != 1) {
+                ESP_LOGW(TAG, "Cannot index %s: errno %d", path, errno);
+            }
+        } else if (!indexed && errno != ENOENT) {
+            ESP_LOGW(TAG, "Cannot summarise %s: errno %d", path, errno);
+        }
+    }
+#endif
+    ESP_LOGI(TAG, "%s: %ld sessions (%lums)", LOGGER_INDEX_PATH, (long)n,
+             (unsigned long)((esp_timer_get_time() - t0) / 1000));
+}
+
+esp_err_t logger_init(void) {
+    // The ring sits in PSRAM: SDMMC DMA cannot read it, so each chunk is
+    // copied into an internal bounce buffer before the write. Without
+    // PSRAM the smaller ring is DMA-capable and written in place.
+    uint32_t ring_size = LOGGER_RING_PSRAM;
+    void *bounce = NULL;
+    void *ring = heap_caps_malloc(ring_size, MALLOC_CAP_SPIRAM);
+    if (ring) {
+        bounce = heap_caps_malloc(CHUNK_WRITER_CHUNK, MALLOC_CAP_DMA);
+        if (!bounce) {
+            heap_caps_free(ring);
+            ring = NULL;
+        }
+    }
+    if (!ring) {
+        ring_size = LOGGER_RING_INTERNAL;
+        ring = heap_caps_malloc(ring_size, MALLOC_CAP_DMA);
+    }
+    if (!ring) return ESP_ERR_NO_MEM;
+
+    const chunk_writer_config_t cfg = {
+        .ring = ring,
+        .ring_size = ring_size,
+        .bounce = bounce,
+        .prealloc = LOGGER_PREALLOC,
+        .clock_us = esp_timer_get_time,
+    };
+#if LOGGER_FORMAT_TRK
+    track_log_init(&trk, &cfg);
+#else
+    gpx_writer_init(&gpx, &cfg);
+#endif
+    atomic_store(&state, LOGGER_IDLE);
+    sample_cursor_init(sensor_service_ring(SENSOR_BARO), &baro_cursor);
+    sample_cursor_init(nav_pbox_ring(), &pbox_cursor);
+    sample_cursor_init(nav_altitude_ring(), &alt_cursor);
+#if LOGGER_FORMAT_TRK
+    sample_cursor_init(sensor_service_ring(SENSOR_IMU), &imu_cursor);
+#endif
+    sample_ring_init(&ride_ring, ride_slots, sizeof(ride_slots[0]), LOGGER_RIDE_RING_LEN);
+    ride_load();
+    ESP_LOGI(TAG, "Track ring %lu KB in %s", (unsigned long)(ring_size / 1024), bounce ? "PSRAM" : "internal RAM");
+
+    esp_err_t err = sd_mount();
+    sd_ok = err == ESP_OK;
+    if (sd_ok) {
+        // Recovery and the index wait for the logger task
+        sdmmc_card_print_info(stdout, card);
+    } else {
+        ESP_LOGW(TAG, "No SD card (%s), recording disabled", esp_err_to_name(err));
+    }
+    return ESP_OK;
+}
+
+void logger_toggle_recording(void) {
+    atomic_store(&toggle_req, true);
+}
+
+logger_state_t logger_state(void) {
+    return (logger_state_t)atomic_load(&state);
+}
+
+bool logger_sd_ready(void) {
+    return sd_ok;
+}
+
+void logger_set_mode(uint8_t mode) {
+    atomic_store(&ui_mode, mode);
+}
+
+const sample_ring_t *logger_ride_ring(void) {
+    return &ride_ring;
+}
+
+void logger_reset_ride(void) {
+    atomic_store(&ride_reset_req, true);
+}
+
+static void wake_flush(void) {
+    if (flush_task) xTaskNotifyGive(flush_task);
+}
+
+static bool fix_usable(const gnss_fix_t *fix) {
+    const uint16_t need = GNSS_VALID_POS | GNSS_VALID_TIME | GNSS_VALID_DATE;
+    bool has_fix = fix->fix_type == GNSS_FIX_2D || fix->fix_type == GNSS_FIX_3D || fix->fix_type == GNSS_FIX_GNSS_DR;
+    return has_fix && (fix->valid & need) == need;
+}
+
+// Keeps the newest baro temperature, the closest to ambient of the
+// on-board sensors, and logs every sample into a .TRK file
+static void drain_baro(bool recording) {
+    const sample_ring_t *ring = sensor_service_ring(SENSOR_BARO);
+    uint32_t n;
+    const baro_sample_t *run;
+    while ((run = sample_ring_peek(ring, &baro_cursor, &n)) != NULL) {
+        baro_sample_t s = run[0];
+        if (!sample_ring_consume(ring, &baro_cursor, 1)) continue;
+        baro_temp = s.temp;
+#if LOGGER_FORMAT_TRK
+        if (recording) track_log_baro(&trk, &s);
+#endif
+    }
+}
+
+// Best P-Box times of the session
+static void drain_pbox(bool recording) {
+    const sample_ring_t *ring = nav_pbox_ring();
+    uint32_t n;
+    const nav_pbox_run_t *run;
+    while ((run = sample_ring_peek(ring, &pbox_cursor, &n)) != NULL) {
+        nav_pbox_run_t r = run[0];
+        if (!sample_ring_consume(ring, &pbox_cursor, 1)) continue;
+        if (recording) track_summary_pbox(&summary, r.interval, r.result.time_s);
+    }
+}
+
+// Fused altitude into the ride statistics
+static void drain_alt(void) {
+    const sample_ring_t *ring = nav_altitude_ring();
+    uint32_t n;
+    const altitude_sample_t *run;
+    while ((run = sample_ring_peek(ring, &alt_cursor, &n)) != NULL) {
+        altitude_sample_t a = run[0];
+        if (!sample_ring_consume(ring, &alt_cursor, 1)) continue;
+        ride_stats_alt(&ride, a.t_us, a.altitude);
+    }
+}
+
+static void ride_fix(const gnss_snapshot_t *snap) {
+    const gnss_fix_t *fix = &snap->fix;
+    ride_stats_fix(&ride, snap->capture_us, fix->lat, fix->lon, fix->speed_mmps * 1e-3f);
+    // Without a barometer there is no fused altitude
+    if (sample_ring_count(nav_altitude_ring()) == 0) ride_stats_alt(&ride, snap->capture_us, fix->alt_mm * 1e-3f);
+    ride_stats_summary_t *s = sample_ring_claim(&ride_ring);
+    ride_stats_summary(&ride, s);
+    sample_ring_publish(&ride_ring);
+}
+
+// Written when a pause starts, the likely moment for a power-off, and at
+// most every LOGGER_RIDE_SAVE_PERIOD_US while riding
+static void ride_checkpoint(int64_t now) {
+    bool changed = ride.st.moving_us != ride_saved.moving_us || ride.st.paused != ride_saved.paused;
+    bool due = (ride.st.paused && !ride_saved.paused) || now - ride_saved_us >= LOGGER_RIDE_SAVE_PERIOD_US;
+    if (!changed || !due) return;
+    ride_saved_us = now;
+    esp_err_t err = ride_save();
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Cannot save the ride statistics: %s", esp_err_to_name(err));
+        return;
+    }
+    ride_saved = ride.st;
+}
+
+#if LOGGER_FORMAT_TRK
+// IMU into the .TRK file, LOGGER_IMU_DECIM samples averaged per record
+static void drain_imu(bool recording) {
+    const sample_ring_t *ring = sensor_service_ring(SENSOR_IMU);
+    if (!recording) {
+        sample_cursor_init(ring, &imu_cursor);
+        imu_n = 0;
+        return;
+    }
+    uint32_t n;
+    const imu_sample_t *run;
+    while ((run = sample_ring_peek(ring, &imu_cursor, &n)) != NULL) {
+        imu_sample_t s = run[0];
+        if (!sample_ring_consume(ring, &imu_cursor, 1)) continue;
+        if (imu_n == 0) memset(&imu_sum, 0, sizeof(imu_sum));
+        imu_sum.ax += s.ax;
+        imu_sum.ay += s.ay;
+        imu_sum.az += s.az;
+        imu_sum.gx += s.gx;
+        imu_sum.gy += s.gy;
+        imu_sum.gz += s.gz;
+        if (++imu_n < LOGGER_IMU_DECIM) continue;
+
+        const float k = 1.0f / LOGGER_IMU_DECIM;
+        const imu_sample_t avg = {
+            .t_us = s.t_us,
+            .ax = imu_sum.ax * k, .ay = imu_sum.ay * k, .az = imu_sum.az * k,
+            .gx = imu_sum.gx * k, .gy = imu_sum.gy * k, .gz = imu_sum.gz * k,
+            .temp = s.temp,
+        };
+        track_log_imu(&trk, &avg);
+        imu_n = 0;
+    }
+}
+#endif
+
+static void fill_point(gpx_point_t *p, const gnss_fix_t *fix, int64_t now) {
+    memset(p, 0, sizeof(*p));
+    p->lat = fix->lat;
+    p->lon = fix->lon;
+    p->ele_mm = fix->alt_mm;
+    p->speed_mmps = fix->speed_mmps;
+    p->course = fix->course;
+    p->year = fix->year;
+    p->month = fix->month;
+    p->day = fix->day;
+    p->hour = fix->hour;
+    p->min = fix->min;
+    p->sec = fix->sec;
+    p->ms = fix->ms;
+    p->fix_type = fix->fix_type;
+    p->num_sv = fix->num_sv;
+    p->hdop = fix->hdop;
+
+    // Smoothed barometric altitude once the vertical filter has run
+    altitude_sample_t alt;
+    if (sample_ring_read_latest(nav_altitude_ring(), &alt)) p->ele_mm = (int32_t)lrintf(alt.altitude * 1000.0f);
+
+    attitude_sample_t att;
+    if (sample_ring_read_latest(sensor_service_attitude_ring(), &att)) {
+        const float *l = att.lin_body;
+        float g = sqrtf(l[0] * l[0] + l[1] * l[1] + l[2] * l[2]);
+        p->g_milli = (uint16_t)fminf(g * 1000.0f, UINT16_MAX);
+    }
+
+    if (!isnan(baro_temp)) p->temp_c10 = (int16_t)lrintf(baro_temp * 10.0f);
+
+    if (bat_read_us == 0 || now - bat_read_us >= BAT_READ_PERIOD_US) {
+        uint32_t mv;
+        if (battery_read_voltage(&mv) == ESP_OK) bat_mv = (uint16_t)mv;
+        bat_read_us = now;
+    }
+    p->bat_mv = bat_mv;
+    p->mode = (uint8_t)atomic_load(&ui_mode);
+    p->pbox = nav_pbox_phase();
+}
+
+void logger_task_entry(void *pvParameters) {
+    ESP_LOGI(TAG, "Logger Task Started");
+    if (sd_ok) index_init();
+
+    gnss_snapshot_t snap;
+    uint32_t last_epoch = 0;
+
+    while (1) {
+        // Start/stop transitions happen here only, so the writer never
+        // sees a point while the flush task opens or closes the file
+        logger_state_t st = logger_state();
+        if (atomic_exchange(&toggle_req, false)) {
+            if (st == LOGGER_IDLE) {
+                if (sd_ok) {
+                    atomic_store(&state, LOGGER_OPENING);
+                    wake_flush();
+                } else {
+                    ESP_LOGW(TAG, "No SD card, not recording");
+                }
+            } else if (st == LOGGER_RECORDING) {
+                atomic_store(&state, LOGGER_CLOSING);
+                wake_flush();
+            }
+            st = logger_state();
+        }
+
+        bool recording = st == LOGGER_RECORDING;
+#if LOGGER_FORMAT_TRK
+        drain_imu(recording);
+#endif
+        drain_baro(recording);
+        drain_pbox(recording);
+        drain_alt();
+
+        if (atomic_exchange(&ride_reset_req, false)) {
+            ride_stats_init(&ride, &ride_params, NULL);
+            ride_saved_us = esp_timer_get_time() - LOGGER_RIDE_SAVE_PERIOD_US;     // Saved right away
+            ESP_LOGI(TAG, "New ride");
+        }
+
+        if (gnss_get_snapshot_newer(last_epoch, &snap)) {
+            last_epoch = snap.epoch;
+            bool usable = fix_usable(&snap.fix);
+            if (usable) ride_fix(&snap);
+            if (recording && usable) {
+                gpx_point_t p;
+                fill_point(&p, &snap.fix, esp_timer_get_time());
+                track_summary_point(&summary, snap.capture_us, &p);
+#if LOGGER_FORMAT_TRK
+                track_log_point(&trk, snap.capture_us, &p);
+#else
+                gpx_writer_add(&gpx, &p);
+#endif
+            }
+        }
+        ride_checkpoint(esp_timer_get_time());
+        if (recording && chunk_writer_pending(out) >= CHUNK_WRITER_CHUNK) wake_flush();
+        vTaskDelay(pdMS_TO_TICKS(LOGGER_POLL_MS));
+    }
+}
+
+static void session_open(void) {
+    char name[16], file[16], path[64];
+    unsigned n = last_track_number() + 1;
+    if (n > TRACK_NUMBER_MAX) {
+        // Wrapping to ACT_0000 would break the newest-is-highest order
+        // that recovery relies on; the files have to be moved off the card
+        ESP_LOGE(TAG, "Track numbers used up (ACT_%04u exists): archive %s", TRACK_NUMBER_MAX, LOGGER_GPX_DIR);
+        atomic_store(&state, LOGGER_IDLE);
+        return;
+    }
+    snprintf(name, sizeof(name), "ACT_%04u", n);
+    snprintf(file, sizeof(file), "%s." TRACK_EXT, name);
+    snprintf(path, sizeof(path), "%s/%s", LOGGER_GPX_DIR, file);
+    track_summary_begin(&summary, file);
+#if LOGGER_FORMAT_TRK
+    int ret = track_log_open(&trk, path, esp_timer_get_time(), esp_random(), LOGGER_IMU_DECIM);
+    memset(trk.count, 0, sizeof(trk.count));
+    trk.blocks = trk.checkpoints = trk.dropped = 0;
+    latency_hist_reset(&trk.encode_us);
+#else
+    int ret = gpx_writer_open(&gpx, path, name);
+    gpx.points = gpx.dropped = 0;
+    latency_hist_reset(&gpx.format_us);
+#endif
+    if (ret != 0) {
+        ESP_LOGE(TAG, "Cannot create %s: errno %d", path, errno);
+        atomic_store(&state, LOGGER_IDLE);
+        return;
+    }
+    out->high_water = out->write_errors = 0;
+    latency_hist_reset(&out->flush_us);
+    latency_hist_reset(&out->commit_us);
+    ESP_LOGI(TAG, "Recording to %s", path);
+    atomic_store(&state, LOGGER_RECORDING);
+}
+
+static void session_index(void) {
+    const track_index_rec_t *r = track_summary_end(&summary, out->file_len);
+    if (track_index_append(LOGGER_INDEX_PATH, r) != 0) {
+        ESP_LOGE(TAG, "Cannot update %s: errno %d", LOGGER_INDEX_PATH, errno);
+        return;
+    }
+    ESP_LOGI(TAG, "%s: %lu s, %.2f km, max %.1f km/h, +%lu m", r->name, (unsigned long)r->duration_s,
+             r->distance_m / 1000.0f, r->max_speed_mmps * 0.0036f, (unsigned long)r->gain_m);
+}
+
+static void log_stats(void) {
+#if LOGGER_FORMAT_TRK
+    const latency_hist_t *f = &trk.encode_us;
+    ESP_LOGI(TAG, "TRK: %lu points, %lu IMU, %lu baro in %lu blocks, %lu records dropped, encode mean=%luus p99<%luus max=%luus",
+             (unsigned long)trk.count[TRACK_REC_POINT], (unsigned long)trk.count[TRACK_REC_IMU],
+             (unsigned long)trk.count[TRACK_REC_BARO], (unsigned long)trk.blocks, (unsigned long)trk.dropped,
+             (unsigned long)latency_hist_mean(f), (unsigned long)latency_hist_percentile(f, 99),
+             (unsigned long)f->max_us);
+#else
+    const latency_hist_t *f = &gpx.format_us;
+    ESP_LOGI(TAG, "GPX: %lu points, %lu dropped, format mean=%luus p99<%luus max=%luus",
+             (unsigned long)gpx.points, (unsigned long)gpx.dropped, (unsigned long)latency_hist_mean(f),
+             (unsigned long)latency_hist_percentile(f, 99), (unsigned long)f->max_us);
+#endif
+    const latency_hist_t *w = &out->flush_us, *c = &out->commit_us;
+    ESP_LOGI(TAG, "SD: %lu KB written, flush mean=%luus p99<%luus max=%luus, ring high water %lu/%lu KB, errors=%lu",
+             (unsigned long)(out->file_len / 1024), (unsigned long)latency_hist_mean(w),
+             (unsigned long)latency_hist_percentile(w, 99), (unsigned long)w->max_us,
+             (unsigned long)(out->high_water / 1024), (unsigned long)((out->mask + 1) / 1024),
+             (unsigned long)out->write_errors);
+    ESP_LOGI(TAG, "SD: %lu commits, mean=%luus p99<%luus max=%luus", (unsigned long)c->total,
+             (unsigned long)latency_hist_mean(c), (unsigned long)latency_hist_percentile(c, 99),
+             (unsigned long)c->max_us);
+}
+
+void logger_flush_task_entry(void *pvParameters) {
+    ESP_LOGI(TAG, "Flush Task Started");
+    flush_task = xTaskGetCurrentTaskHandle();
+    int64_t next_log_us = 0, next_commit_us = 0;
+    int ret;
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(FLUSH_IDLE_MS));
+
+        switch (logger_state()) {
+        case LOGGER_OPENING:
+            session_open();
+            next_log_us = esp_timer_get_time() + STATS_LOG_PERIOD_US;
+            next_commit_us = esp_timer_get_time() + LOGGER_COMMIT_PERIOD_US;
+            break;
+        case LOGGER_RECORDING:
+            // Whole chunks as they fill; the partial one every commit
+            // period, which bounds both the loss and the syncs
+            if (esp_timer_get_time() >= next_commit_us) {
+                next_commit_us = esp_timer_get_time() + LOGGER_COMMIT_PERIOD_US;
+                ret = chunk_writer_commit(out);
+            } else {
+                ret = chunk_writer_flush(out);
+            }
+            if (ret < 0) ESP_LOGW(TAG, "SD write failed: errno %d, retrying", errno);
+            if (esp_timer_get_time() >= next_log_us) {
+                next_log_us = esp_timer_get_time() + STATS_LOG_PERIOD_US;
+                log_stats();
+            }
+            break;
+        case LOGGER_CLOSING:
+#if LOGGER_FORMAT_TRK
+            ret = track_log_close(&trk);
+#else
+            ret = gpx_writer_close(&gpx);
+#endif
+            if (ret != 0) ESP_LOGE(TAG, "Track not closed cleanly: errno %d", errno);
+            log_stats();
+            session_index();
+            atomic_store(&state, LOGGER_IDLE);
+            break;
+        default:
+            break;
+        }
+    }
+}
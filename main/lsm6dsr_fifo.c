@@ -0,0 +1,97 @@
+#include "lsm6dsr_fifo.h"
+#include <string.h>
+
+#define HAVE_ACC    0x01
+#define HAVE_GYRO   0x02
+#define HAVE_TS     0x04
+#define HAVE_ALL    (HAVE_ACC | HAVE_GYRO | HAVE_TS)
+
+// ODR codes 1..10: 12.5 Hz doubling up to 6667 Hz
+static const uint16_t odr_hz[] = { 13, 26, 52, 104, 208, 417, 833, 1667, 3333, 6667 };
+
+uint8_t lsm6dsr_odr_code(uint16_t hz) {
+    for (uint8_t i = 0; i < sizeof(odr_hz) / sizeof(odr_hz[0]); i++) {
+        if (hz <= odr_hz[i]) return i + 1;
+    }
+    return sizeof(odr_hz) / sizeof(odr_hz[0]);
+}
+
+uint16_t lsm6dsr_odr_hz(uint8_t code) {
+    if (code == 0 || code > sizeof(odr_hz) / sizeof(odr_hz[0])) return 0;
+    return odr_hz[code - 1];
+}
+
+void lsm6dsr_fifo_decoder_init(lsm6dsr_fifo_decoder_t *dec) {
+    memset(dec, 0, sizeof(*dec));
+}
+
+static int16_t le16(const uint8_t *p) {
+    return (int16_t)(p[0] | (p[1] << 8));
+}
+
+static bool flush_slot(lsm6dsr_fifo_decoder_t *dec, lsm6dsr_fifo_sample_t *out) {
+    uint8_t have = dec->have;
+    dec->have = 0;
+    if ((have & (HAVE_ACC | HAVE_GYRO)) != (HAVE_ACC | HAVE_GYRO)) {
+        if (have) dec->incomplete++;
+        return false;
+    }
+    // Without a timestamp word in this slot, reuse the latest one
+    if (!(have & HAVE_TS)) dec->pending.timestamp = dec->timestamp;
+    *out = dec->pending;
+    dec->samples++;
+    return true;
+}
+
+size_t lsm6dsr_fifo_decode(lsm6dsr_fifo_decoder_t *dec, const uint8_t *words, size_t n_words,
+                           lsm6dsr_fifo_sample_t *out, size_t max_out, size_t *consumed) {
+    size_t n_out = 0;
+    size_t i = 0;
+
+    for (; i < n_words; i++) {
+        const uint8_t *w = &words[i * LSM6DSR_FIFO_WORD_LEN];
+        uint8_t sensor = w[0] >> 3;
+        uint8_t slot = (w[0] >> 1) & 0x03;
+        const uint8_t *d = &w[1];
+
+        if (sensor != LSM6DSR_TAG_GYRO && sensor != LSM6DSR_TAG_ACCEL && sensor != LSM6DSR_TAG_TIMESTAMP) {
+            dec->other++;
+            continue;
+        }
+
+        // A new slot closes the previous one
+        if (dec->have && slot != dec->slot) {
+            if (n_out >= max_out) break;
+            if (flush_slot(dec, &out[n_out])) n_out++;
+        }
+        dec->slot = slot;
+
+        switch (sensor) {
+            case LSM6DSR_TAG_GYRO:
+                for (int k = 0; k < 3; k++) dec->pending.gyro[k] = le16(&d[2 * k]);
+                dec->have |= HAVE_GYRO;
+                break;
+            case LSM6DSR_TAG_ACCEL:
+                for (int k = 0; k < 3; k++) dec->pending.acc[k] = le16(&d[2 * k]);
+                dec->have |= HAVE_ACC;
+                break;
+            default:
+                dec->timestamp = (uint32_t)d[0] | ((uint32_t)d[1] << 8) |
+                                 ((uint32_t)d[2] << 16) | ((uint32_t)d[3] << 24);
+                dec->pending.timestamp = dec->timestamp;
+                dec->have |= HAVE_TS;
+                break;
+        }
+
+        if (dec->have == HAVE_ALL) {
+            if (n_out >= max_out) {
+                i++;
+                break;
+            }
+            flush_slot(dec, &out[n_out++]);
+        }
+    }
+
+    if (consumed) *consumed = i;
+    return n_out;
+}
@@ -0,0 +1,246 @@
+#include "mag_cal.h"
+#include <math.h>
+#include <string.h>
+
+#define SCALE_UT            50.0f   // Fit in units of a typical field: keeps the sums well scaled
+#define MAX_AXIS_RATIO      4.0     // Soft iron beyond this is a bad fit, not a magnet
+#define FIELD_MIN_UT        10.0f
+#define FIELD_MAX_UT        150.0f
+#define MAX_RESIDUAL        0.1     // Fraction of the field: the samples are not one ellipsoid
+#define JACOBI_SWEEPS       10
+
+void mag_cal_identity(mag_cal_t *cal) {
+    memset(cal, 0, sizeof(*cal));
+    cal->version = MAG_CAL_VERSION;
+    for (int i = 0; i < 3; i++) cal->soft[i][i] = 1.0f;
+}
+
+bool mag_cal_valid(const mag_cal_t *cal) {
+    if (cal->version != MAG_CAL_VERSION) return false;
+    for (int i = 0; i < 3; i++) {
+        if (!isfinite(cal->offset[i]) || !(cal->soft[i][i] > 0.0f)) return false;
+    }
+    return true;
+}
+
+void mag_cal_apply(const mag_cal_t *cal, const float in[3], float out[3]) {
+    float d[3] = { in[0] - cal->offset[0], in[1] - cal->offset[1], in[2] - cal->offset[2] };
+    for (int i = 0; i < 3; i++) {
+        out[i] = cal->soft[i][0] * d[0] + cal->soft[i][1] * d[1] + cal->soft[i][2] * d[2];
+    }
+}
+
+void mag_cal_acc_init(mag_cal_acc_t *acc) {
+    memset(acc, 0, sizeof(*acc));
+}
+
+// Index of (i, j), i <= j, in the packed upper triangle
+static int tri(int i, int j) {
+    return i * MAG_CAL_TERMS - i * (i - 1) / 2 + (j - i);
+}
+
+static void design_row(const float m[3], double d[MAG_CAL_TERMS]) {
+    double x = m[0] / SCALE_UT, y = m[1] / SCALE_UT, z = m[2] / SCALE_UT;
+    d[0] = x * x;
+    d[1] = y * y;
+    d[2] = z * z;
+    d[3] = 2.0 * x * y;
+    d[4] = 2.0 * x * z;
+    d[5] = 2.0 * y * z;
+    d[6] = 2.0 * x;
+    d[7] = 2.0 * y;
+    d[8] = 2.0 * z;
+    d[9] = 1.0;
+}
+
+// Dominant axis (3) x its sign (2) x signs of the other two axes (4),
+// around the centre of the bounding box seen so far
+static int direction_bin(const mag_cal_acc_t *acc, const float m[3]) {
+    float d[3];
+    for (int i = 0; i < 3; i++) d[i] = m[i] - 0.5f * (acc->min[i] + acc->max[i]);
+    int k = 0;
+    if (fabsf(d[1]) > fabsf(d[k])) k = 1;
+    if (fabsf(d[2]) > fabsf(d[k])) k = 2;
+    int o1 = (k + 1) % 3, o2 = (k + 2) % 3;
+    return k * 8 + (d[k] < 0.0f) * 4 + (d[o1] < 0.0f) * 2 + (d[o2] < 0.0f);
+}
+
+bool mag_cal_acc_add(mag_cal_acc_t *acc, const float m[3]) {
+    if (acc->n > 0) {
+        float dx = m[0] - acc->last[0], dy = m[1] - acc->last[1], dz = m[2] - acc->last[2];
+        if (dx * dx + dy * dy + dz * dz < MAG_CAL_MIN_STEP_UT * MAG_CAL_MIN_STEP_UT) return false;
+    }
+
+    double d[MAG_CAL_TERMS];
+    design_row(m, d);
+    for (int i = 0; i < MAG_CAL_TERMS; i++) {
+        for (int j = i; j < MAG_CAL_TERMS; j++) acc->dtd[tri(i, j)] += d[i] * d[j];
+    }
+
+    for (int i = 0; i < 3; i++) {
+        if (acc->n == 0 || m[i] < acc->min[i]) acc->min[i] = m[i];
+        if (acc->n == 0 || m[i] > acc->max[i]) acc->max[i] = m[i];
+    }
+    memcpy(acc->last, m, sizeof(acc->last));
+    acc->n++;
+    acc->bins |= 1u << direction_bin(acc, m);
+    return true;
+}
+
+uint8_t mag_cal_coverage(const mag_cal_acc_t *acc) {
+    return (uint8_t)__builtin_popcount(acc->bins);
+}
+
+uint8_t mag_cal_progress(const mag_cal_acc_t *acc) {
+    uint32_t cov = mag_cal_coverage(acc) * 100u / MAG_CAL_MIN_BINS;
+    uint32_t cnt = acc->n * 100u / MAG_CAL_MIN_SAMPLES;
+    uint32_t p = cov < cnt ? cov : cnt;
+    return (uint8_t)(p > 100 ? 100 : p);
+}
+
+// Minimise |D p|^2 subject to a + b + c = 3: p = 3 S^-1 t / (t^T S^-1 t),
+// S = D^T D by Cholesky, t = [1 1 1 0 ...]; false if S is singular
+static bool solve_quadric(const mag_cal_acc_t *acc, double p[MAG_CAL_TERMS]) {
+    double l[MAG_CAL_TERMS][MAG_CAL_TERMS] = { { 0 } };
+    for (int i = 0; i < MAG_CAL_TERMS; i++) {
+        for (int j = 0; j <= i; j++) {
+            double s = acc->dtd[tri(j, i)];
+            for (int k = 0; k < j; k++) s -= l[i][k] * l[j][k];
+            if (i == j) {
+                if (s <= 0.0) return false;
+                l[i][i] = sqrt(s);
+            } else {
+                l[i][j] = s / l[j][j];
+            }
+        }
+    }
+    double y[MAG_CAL_TERMS];
+    for (int i = 0; i < MAG_CAL_TERMS; i++) {
+        double s = i < 3 ? 1.0 : 0.0;
+        for (int k = 0; k < i; k++) s -= l[i][k] * y[k];
+        y[i] = s / l[i][i];
+    }
+    for (int i = MAG_CAL_TERMS - 1; i >= 0; i--) {
+        double s = y[i];
+        for (int k = i + 1; k < MAG_CAL_TERMS; k++) s -= l[k][i] * p[k];
+        p[i] = s / l[i][i];
+    }
+    double trace = p[0] + p[1] + p[2];
+    if (!(trace > 0.0)) return false;
+    for (int i = 0; i < MAG_CAL_TERMS; i++) p[i] *= 3.0 / trace;
+    return true;
+}
+
+// Eigen-decomposition of a symmetric 3x3 matrix (cyclic Jacobi):
+// a = v diag(w) v^T, eigenvectors in the columns of v
+static void eigen_sym3(const double a_in[3][3], double w[3], double v[3][3]) {
+    double a[3][3];
+    memcpy(a, a_in, sizeof(a));
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) v[i][j] = i == j;
+    }
+    for (int sweep = 0; sweep < JACOBI_SWEEPS; sweep++) {
+        double off = a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2];
+        if (off < 1e-30) break;
+        for (int p = 0; p < 2; p++) {
+            for (int q = p + 1; q < 3; q++) {
+                if (fabs(a[p][q]) < 1e-300) continue;
+                double theta = (a[q][q] - a[p][p]) / (2.0 * a[p][q]);
+                double t = (theta >= 0.0 ? 1.0 : -1.0) / (fabs(theta) + sqrt(theta * theta + 1.0));
+                double c = 1.0 / sqrt(t * t + 1.0), s = t * c;
+                for (int k = 0; k < 3; k++) {
+                    double akp = a[k][p], akq = a[k][q];
+                    a[k][p] = c * akp - s * akq;
+                    a[k][q] = s * akp + c * akq;
+                }
+                for (int k = 0; k < 3; k++) {
+                    double apk = a[p][k], aqk = a[q][k];
+                    a[p][k] = c * apk - s * aqk;
+                    a[q][k] = s * apk + c * aqk;
+                }
+                for (int k = 0; k < 3; k++) {
+                    double vkp = v[k][p], vkq = v[k][q];
+                    v[k][p] = c * vkp - s * vkq;
+                    v[k][q] = s * vkp + c * vkq;
+                }
+            }
+        }
+    }
+    for (int i = 0; i < 3; i++) w[i] = a[i][i];
+}
+
+static bool invert3(const double m[3][3], double inv[3][3]) {
+    double det = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+                 m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+                 m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+    if (fabs(det) < 1e-30) return false;
+    double r = 1.0 / det;
+    inv[0][0] = (m[1][1] * m[2][2] - m[1][2] * m[2][1]) * r;
+    inv[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) * r;
+    inv[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * r;
+    inv[1][0] = (m[1][2] * m[2][0] - m[1][0] * m[2][2]) * r;
+    inv[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * r;
+    inv[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) * r;
+    inv[2][0] = (m[1][0] * m[2][1] - m[1][1] * m[2][0]) * r;
+    inv[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) * r;
+    inv[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * r;
+    return true;
+}
+
+bool mag_cal_solve(const mag_cal_acc_t *acc, mag_cal_t *out) {
+    if (acc->n < MAG_CAL_MIN_SAMPLES || mag_cal_coverage(acc) < MAG_CAL_MIN_BINS) return false;
+
+    double p[MAG_CAL_TERMS];
+    if (!solve_quadric(acc, p)) return false;
+
+    // (u - c)^T A (u - c) = k with c = -A^-1 v, k = c^T A c - j
+    const double a[3][3] = {
+        { p[0], p[3], p[4] },
+        { p[3], p[1], p[5] },
+        { p[4], p[5], p[2] },
+    };
+    const double v[3] = { p[6], p[7], p[8] };
+    double a_inv[3][3];
+    if (!invert3(a, a_inv)) return false;
+
+    double c[3], k = -p[9];
+    for (int i = 0; i < 3; i++) c[i] = -(a_inv[i][0] * v[0] + a_inv[i][1] * v[1] + a_inv[i][2] * v[2]);
+    for (int i = 0; i < 3; i++) k -= c[i] * v[i];
+    if (k <= 0.0) return false;
+
+    double w[3], e[3][3];
+    eigen_sym3(a, w, e);
+    for (int i = 0; i < 3; i++) {
+        w[i] /= k;
+        if (w[i] <= 0.0) return false;
+    }
+    double w_min = fmin(fmin(w[0], w[1]), w[2]);
+    double w_max = fmax(fmax(w[0], w[1]), w[2]);
+    if (sqrt(w_max / w_min) > MAX_AXIS_RATIO) return false;
+
+    // Map the ellipsoid onto a sphere of its geometric-mean radius:
+    // soft = det(M)^(-1/6) * sqrt(M), M = A / k
+    double radius = pow(w[0] * w[1] * w[2], -1.0 / 6.0);
+    double field = radius * SCALE_UT;
+    if (field < FIELD_MIN_UT || field > FIELD_MAX_UT) return false;
+
+    mag_cal_identity(out);
+    for (int i = 0; i < 3; i++) {
+        out->offset[i] = (float)(c[i] * SCALE_UT);
+        for (int j = 0; j < 3; j++) {
+            double s = 0.0;
+            for (int q = 0; q < 3; q++) s += e[i][q] * sqrt(w[q]) * e[j][q];
+            out->soft[i][j] = (float)(radius * s);
+        }
+    }
+    out->field_ut = (float)field;
+
+    // Algebraic residual from the sums: |D p|^2 = p^T S p; on the fitted
+    // surface a relative radial error e gives about 2 k e
+    double r2 = 0.0;
+    for (int i = 0; i < MAG_CAL_TERMS; i++) {
+        for (int j = 0; j < MAG_CAL_TERMS; j++) r2 += p[i] * p[j] * acc->dtd[i <= j ? tri(i, j) : tri(j, i)];
+    }
+    out->residual = (float)(sqrt(fmax(r2, 0.0) / acc->n) / (2.0 * k));
+    return out->residual <= MAX_RESIDUAL;
+}
@@ -4,27 +4,67 @@
 #include "freertos/task.h"
 #include "esp_log.h"
 #include "esp_system.h"
+#include "esp_timer.h"
 #include "nvs_flash.h"
 #include "config.h"
 #include "sensors.h"
+#include "sensor_service.h"
+#include "ahrs.h"
 #include "display.h"
 #include "input.h"
 #include "gnss.h"
+#include "nav.h"
 #include "battery.h"
+#include "logger.h"
 
 static const char *TAG = "MAIN";
 
 // Task Priorities
+#define TASK_PRIO_SENSOR    6
 #define TASK_PRIO_GNSS      5
+#define TASK_PRIO_NAV       5
 #define TASK_PRIO_UI        5
 #define TASK_PRIO_LOGGER    4
 #define TASK_PRIO_DIAG      3
+#define TASK_PRIO_LOG_FLUSH 2
 
 // Task Stack Sizes
+#define TASK_STACK_SENSOR   4096
 #define TASK_STACK_GNSS     4096
+#define TASK_STACK_NAV      4096
 #define TASK_STACK_UI       8192
 #define TASK_STACK_LOGGER   4096
 #define TASK_STACK_DIAG     4096
+#define TASK_STACK_LOG_FLUSH 4096
+
+static void log_gnss_status(void) {
+    gnss_snapshot_t snap;
+    if (!gnss_get_snapshot(&snap)) {
+        ESP_LOGI(TAG, "GNSS: NO DATA");
+        return;
+    }
+    const gnss_fix_t *fix = &snap.fix;
+    ESP_LOGI(TAG, "GNSS: %s, %u sats, (%.4f,%.4f) epoch=%lu age=%lldms",
+             (fix->valid & GNSS_VALID_POS) ? "OK" : "NO FIX", fix->num_sv,
+             fix->lat * 1e-7, fix->lon * 1e-7, (unsigned long)snap.epoch,
+             (long long)((esp_timer_get_time() - snap.capture_us) / 1000));
+
+    nav_sample_t nav;
+    if (sample_ring_read_latest(nav_ring(), &nav)) {
+        ESP_LOGI(TAG, "NAV: %.1f km/h +- %.2f, fix age %lums", nav.speed * 3.6f, nav.speed_sigma * 3.6f,
+                 (unsigned long)nav.fix_age_ms);
+    }
+
+    const sat_table_t *sats = gnss_sats_lock(10);
+    if (sats) {
+        if (sats->count > 0) {
+            uint8_t best = sat_table_sorted(sats, 0);
+            ESP_LOGI(TAG, "SATS: %u in view, best %u/%u %u dBHz", sats->count,
+                     SAT_KEY_GNSS(sats->key[best]), SAT_KEY_SVID(sats->key[best]), sats->cn0[best]);
+        }
+        gnss_sats_unlock();
+    }
+}
 
 // Global trigger function for diagnostics
 void diagnostics_trigger(const char *event) {
@@ -41,15 +81,29 @@ void ui_task(void *pvParameters) {
     }
 
     // Create a Label for testing
+    lv_obj_t *label = NULL;
     if (display_lock(100)) {
-        lv_obj_t *label = lv_label_create(lv_scr_act());
+        label = lv_label_create(lv_scr_act());
         lv_label_set_text(label, "ESP32-S3 GPS Logger");
         lv_obj_align(label, LV_ALIGN_CENTER, 0, 0);
         display_unlock();
     }
 
+    gnss_snapshot_t snap;
+    uint32_t last_epoch = 0;
+    char text[48];
+
     while (1) {
+        // Non-blocking: only redraw when the GNSS task published a new epoch
+        bool new_fix = gnss_get_snapshot_newer(last_epoch, &snap);
+        if (new_fix) {
+            last_epoch = snap.epoch;
+            snprintf(text, sizeof(text), "%u sats\n%.1f km/h", snap.fix.num_sv,
+                     snap.fix.speed_mmps * 0.0036f);
+        }
+
         if (display_lock(10)) {
+            if (new_fix && label) lv_label_set_text(label, text);
             lv_timer_handler();
             display_unlock();
         }
@@ -57,47 +111,58 @@ void ui_task(void *pvParameters) {
     }
 }
 
-void logger_task(void *pvParameters) {
-    ESP_LOGI(TAG, "Logger Task Started");
-    // TODO: Initialize SD Card, Handle GPX writing
-    while (1) {
-        vTaskDelay(pdMS_TO_TICKS(100));
+// Latest sample of each sensor from the service rings; never touches the bus
+static void log_sensor_status(bool verbose) {
+    imu_sample_t imu;
+    mag_sample_t mag;
+    baro_sample_t baro;
+    attitude_sample_t att;
+    altitude_sample_t alt;
+    float grav[3] = {0};
+    float altitude = 0;
+    uint32_t bat_mv = 0;
+
+    if (!sample_ring_read_latest(sensor_service_ring(SENSOR_IMU), &imu)) memset(&imu, 0, sizeof(imu));
+    if (!sample_ring_read_latest(sensor_service_ring(SENSOR_MAG), &mag)) memset(&mag, 0, sizeof(mag));
+    if (sample_ring_read_latest(sensor_service_ring(SENSOR_BARO), &baro)) {
+        altitude = sensors_calc_altitude(baro.pressure, baro.temp);
+    } else {
+        memset(&baro, 0, sizeof(baro));
+    }
+    if (sample_ring_read_latest(sensor_service_attitude_ring(), &att)) {
+        ahrs_gravity(att.q, grav);
+    } else {
+        memset(&att, 0, sizeof(att));
+    }
+    if (!sample_ring_read_latest(nav_altitude_ring(), &alt)) memset(&alt, 0, sizeof(alt));
+    battery_read_voltage(&bat_mv);
+
+    const float *lin = att.lin_body;
+    if (verbose) {
+        ESP_LOGI(TAG, "IMU: ACC(%.2f,%.2f,%.2f) GRAV(%.2f,%.2f,%.2f) LIN(%.2f,%.2f,%.2f)",
+                 imu.ax, imu.ay, imu.az, grav[0], grav[1], grav[2], lin[0], lin[1], lin[2]);
+        ESP_LOGI(TAG, "GYRO: (%.2f,%.2f,%.2f) dps", imu.gx, imu.gy, imu.gz);
+        ESP_LOGI(TAG, "MAG: (%.2f,%.2f,%.2f) Heading=%.1f", mag.mx, mag.my, mag.mz, att.heading);
+        ESP_LOGI(TAG, "BARO: P=%.1f hPa Alt=%.1f m Fused=%.1f m Vario=%+.2f m/s", baro.pressure, altitude,
+                 alt.altitude, alt.vspeed);
+        ESP_LOGI(TAG, "TEMP: IMU=%.1f C, MAG=%.1f C, BARO=%.1f C", imu.temp, mag.temp, baro.temp);
+        ESP_LOGI(TAG, "BAT: %lu mV", bat_mv);
+    } else {
+        // Compact Log
+        ESP_LOGI(TAG, "HB: LIN(%.2f,%.2f,%.2f) GYR(%.2f,%.2f,%.2f) HDG(%.1f) ALT(%.1f) VS(%+.2f) T(%.1f) BAT(%lu)",
+                 lin[0], lin[1], lin[2], imu.gx, imu.gy, imu.gz, att.heading, alt.altitude, alt.vspeed, imu.temp,
+                 bat_mv);
     }
 }
 
 void diagnostics_task(void *pvParameters) {
     ESP_LOGI(TAG, "Diagnostics Task Started");
 
-    float ax, ay, az, gx, gy, gz, temp_imu;
-    float grav_x, grav_y, grav_z, lin_x, lin_y, lin_z;
-    float mx, my, mz, temp_mag;
-    float heading;
-    float press, temp_baro, altitude;
-    uint32_t bat_mv;
-
     // Phase 1: Startup Self-Test (0-5s)
     for (int i = 0; i < 5; i++) {
         ESP_LOGI(TAG, "--- SELF TEST T=%ds ---", i);
-
-        // Read Sensors
-        sensors_read_imu(&ax, &ay, &az, &gx, &gy, &gz, &temp_imu);
-        sensors_calc_gravity_linear(ax, ay, az, &grav_x, &grav_y, &grav_z, &lin_x, &lin_y, &lin_z);
-
-        sensors_read_mag(&mx, &my, &mz, &temp_mag);
-        heading = sensors_calc_heading(mx, my);
-
-        sensors_read_baro(&press, &temp_baro);
-        altitude = sensors_calc_altitude(press, temp_baro);
-
-        battery_read_voltage(&bat_mv);
-
-        ESP_LOGI(TAG, "IMU: ACC(%.2f,%.2f,%.2f) GRAV(%.2f,%.2f,%.2f) LIN(%.2f,%.2f,%.2f)",
-                 ax, ay, az, grav_x, grav_y, grav_z, lin_x, lin_y, lin_z);
-        ESP_LOGI(TAG, "GYRO: (%.2f,%.2f,%.2f) dps", gx, gy, gz);
-        ESP_LOGI(TAG, "MAG: (%.2f,%.2f,%.2f) Heading=%.1f", mx, my, mz, heading);
-        ESP_LOGI(TAG, "BARO: P=%.1f hPa Alt=%.1f m", press, altitude);
-        ESP_LOGI(TAG, "TEMP: IMU=%.1f C, MAG=%.1f C, BARO=%.1f C", temp_imu, temp_mag, temp_baro);
-        ESP_LOGI(TAG, "BAT: %lu mV", bat_mv);
+        log_sensor_status(true);
+        log_gnss_status();
 
         vTaskDelay(pdMS_TO_TICKS(1000));
     }
@@ -107,17 +172,8 @@ void diagnostics_task(void *pvParameters) {
     // Phase 2: Runtime Heartbeat
     while (1) {
         // Heartbeat includes sensor snapshot
-        sensors_read_imu(&ax, &ay, &az, &gx, &gy, &gz, &temp_imu);
-        sensors_calc_gravity_linear(ax, ay, az, &grav_x, &grav_y, &grav_z, &lin_x, &lin_y, &lin_z);
-        sensors_read_mag(&mx, &my, &mz, &temp_mag);
-        heading = sensors_calc_heading(mx, my);
-        sensors_read_baro(&press, &temp_baro);
-        altitude = sensors_calc_altitude(press, temp_baro);
-        battery_read_voltage(&bat_mv);
-
-        // Compact Log
-        ESP_LOGI(TAG, "HB: LIN(%.2f,%.2f,%.2f) GYR(%.2f,%.2f,%.2f) HDG(%.1f) ALT(%.1f) T(%.1f) BAT(%lu)",
-                 lin_x, lin_y, lin_z, gx, gy, gz, heading, altitude, temp_imu, bat_mv);
+        log_sensor_status(false);
+        log_gnss_status();
 
         vTaskDelay(pdMS_TO_TICKS(5000));
     }
@@ -139,6 +195,15 @@ void app_main(void) {
         ESP_LOGE(TAG, "Sensor initialization failed!");
     }
 
+    const sensor_service_config_t sensor_cfg = {
+        .imu_hz = IMU_FIFO_ODR_HZ,
+        .imu_watermark = IMU_FIFO_WATERMARK,
+        .mag_hz = SENSOR_MAG_RATE_HZ,
+        .baro_hz = SENSOR_BARO_RATE_HZ,
+    };
+    ESP_ERROR_CHECK(sensor_service_init(&sensor_cfg));
+    ESP_ERROR_CHECK(nav_init());
+
     // Initialize Input
     if (input_init() != ESP_OK) {
         ESP_LOGE(TAG, "Input initialization failed!");
@@ -149,9 +214,17 @@ void app_main(void) {
         ESP_LOGE(TAG, "Battery initialization failed!");
     }
 
+    // SD card and GPX staging ring
+    if (logger_init() != ESP_OK) {
+        ESP_LOGE(TAG, "Logger initialization failed!");
+    }
+
     // Create Tasks
+    xTaskCreate(sensor_task_entry, "sensor_task", TASK_STACK_SENSOR, NULL, TASK_PRIO_SENSOR, NULL);
     xTaskCreate(gnss_task_entry, "gnss_task", TASK_STACK_GNSS, NULL, TASK_PRIO_GNSS, NULL);
+    xTaskCreate(nav_task_entry, "nav_task", TASK_STACK_NAV, NULL, TASK_PRIO_NAV, NULL);
     xTaskCreate(ui_task, "ui_task", TASK_STACK_UI, NULL, TASK_PRIO_UI, NULL);
-    xTaskCreate(logger_task, "logger_task", TASK_STACK_LOGGER, NULL, TASK_PRIO_LOGGER, NULL);
+    xTaskCreate(logger_task_entry, "logger_task", TASK_STACK_LOGGER, NULL, TASK_PRIO_LOGGER, NULL);
+    xTaskCreate(logger_flush_task_entry, "log_flush_task", TASK_STACK_LOG_FLUSH, NULL, TASK_PRIO_LOG_FLUSH, NULL);
     xTaskCreate(diagnostics_task, "diagnostics_task", TASK_STACK_DIAG, NULL, TASK_PRIO_DIAG, NULL);
 }
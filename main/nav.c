@@ -0,0 +1,193 @@
+#include "nav.h"
+#include "config.h"
+#include "altitude.h"
+#include "gnss.h"
+#include "pbox.h"
+#include "sensor_service.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <math.h>
+#include <string.h>
+
+static const char *TAG = "NAV";
+
+#define NAV_BLOCK_MAX           32
+#define NAV_POLL_MS             10
+#define STATS_LOG_PERIOD_US     (10 * 1000 * 1000)
+#define FIX_HOLD_MAX_US         (200 * 1000)    // Apply a held fix anyway after this
+
+static nav_sample_t nav_slots[NAV_RING_LEN];
+static sample_ring_t out_ring;
+static altitude_sample_t alt_slots[NAV_ALT_RING_LEN];
+static sample_ring_t alt_ring;
+static nav_pbox_run_t pbox_slots[NAV_PBOX_RING_LEN];
+static sample_ring_t pbox_ring;
+
+// Owned by the nav task
+static nav_ekf_t ekf;
+static sample_cursor_t att_cursor;
+static altitude_kf_t alt_kf;
+static sample_cursor_t baro_cursor;
+static int64_t next_out_us;
+static uint32_t torn_blocks;    // Attitude runs overwritten while being copied
+static pbox_t pbox;
+
+static const pbox_interval_cfg_t pbox_intervals[] = PBOX_DEFAULT_INTERVALS;
+
+_Static_assert((NAV_RING_LEN & (NAV_RING_LEN - 1)) == 0, "ring length must be a power of two");
+_Static_assert((NAV_ALT_RING_LEN & (NAV_ALT_RING_LEN - 1)) == 0, "ring length must be a power of two");
+_Static_assert((NAV_PBOX_RING_LEN & (NAV_PBOX_RING_LEN - 1)) == 0, "ring length must be a power of two");
+
+esp_err_t nav_init(void) {
+    const nav_ekf_params_t params = NAV_EKF_DEFAULT_PARAMS;
+    nav_ekf_init(&ekf, &params);
+    sample_ring_init(&out_ring, nav_slots, sizeof(nav_slots[0]), NAV_RING_LEN);
+    sample_cursor_init(sensor_service_attitude_ring(), &att_cursor);
+
+    const altitude_kf_params_t alt_params = ALTITUDE_KF_DEFAULT_PARAMS;
+    altitude_kf_init(&alt_kf, &alt_params);
+    sample_ring_init(&alt_ring, alt_slots, sizeof(alt_slots[0]), NAV_ALT_RING_LEN);
+    sample_ring_init(&pbox_ring, pbox_slots, sizeof(pbox_slots[0]), NAV_PBOX_RING_LEN);
+    sample_cursor_init(sensor_service_ring(SENSOR_BARO), &baro_cursor);
+
+    const pbox_params_t pbox_params = PBOX_DEFAULT_PARAMS;
+    pbox_init(&pbox, &pbox_params, pbox_intervals, sizeof(pbox_intervals) / sizeof(pbox_intervals[0]));
+    return ESP_OK;
+}
+
+const sample_ring_t *nav_ring(void) {
+    return &out_ring;
+}
+
+const sample_ring_t *nav_altitude_ring(void) {
+    return &alt_ring;
+}
+
+const sample_ring_t *nav_pbox_ring(void) {
+    return &pbox_ring;
+}
+
+// A single byte written by the nav task: safe to read from any task
+uint8_t nav_pbox_phase(void) {
+    return pbox.phase;
+}
+
+static void report_pbox(uint32_t done) {
+    for (int i = 0; done; i++, done >>= 1) {
+        if (!(done & 1)) continue;
+        const pbox_result_t *r = &pbox.iv[i].result;
+        ESP_LOGI(TAG, "P-Box %s: %.3f s +- %.3f, %.1f km/h, %.1f m", pbox_intervals[i].name, r->time_s,
+                 r->sigma_s, r->end_speed * 3.6f, r->distance);
+        nav_pbox_run_t *run = sample_ring_claim(&pbox_ring);
+        run->interval = (uint8_t)i;
+        run->result = *r;
+        sample_ring_publish(&pbox_ring);
+    }
+}
+
+// Propagate through every new attitude sample, publishing an output each
+// time IMU time crosses the next output instant
+static void drain_attitude(void) {
+    const sample_ring_t *ring = sensor_service_attitude_ring();
+    static attitude_sample_t block[NAV_BLOCK_MAX];
+    const int64_t period_us = 1000000 / NAV_OUTPUT_HZ;
+
+    uint32_t n;
+    const attitude_sample_t *run;
+    while ((run = sample_ring_peek(ring, &att_cursor, &n)) != NULL) {
+        if (n > NAV_BLOCK_MAX) n = NAV_BLOCK_MAX;
+        memcpy(block, run, n * sizeof(block[0]));
+        if (!sample_ring_consume(ring, &att_cursor, n)) {
+            torn_blocks++;
+            continue;
+        }
+
+        for (uint32_t i = 0; i < n; i++) {
+            nav_ekf_predict(&ekf, &block[i]);
+            if (block[i].t_us < next_out_us) continue;
+            if (!ekf.aligned) continue;
+
+            nav_sample_t out;
+            nav_ekf_output(&ekf, &out);
+            memcpy(sample_ring_claim(&out_ring), &out, sizeof(out));
+            sample_ring_publish(&out_ring);
+            report_pbox(pbox_feed(&pbox, &out));
+            next_out_us += period_us;
+            if (next_out_us <= block[i].t_us) next_out_us = block[i].t_us + period_us;
+        }
+    }
+}
+
+// Standard-atmosphere altitude into the vertical filter: the station
+// temperature would scale the whole column and show up as climb
+static void drain_baro(void) {
+    const sample_ring_t *ring = sensor_service_ring(SENSOR_BARO);
+    uint32_t n;
+    const baro_sample_t *run;
+    while ((run = sample_ring_peek(ring, &baro_cursor, &n)) != NULL) {
+        baro_sample_t s = run[0];
+        if (!sample_ring_consume(ring, &baro_cursor, 1)) continue;
+
+        altitude_kf_baro(&alt_kf, s.t_us, altitude_from_pressure(s.pressure, NAN));
+        altitude_kf_output(&alt_kf, sample_ring_claim(&alt_ring));
+        sample_ring_publish(&alt_ring);
+    }
+}
+
+static void log_stats(void) {
+    nav_sample_t out;
+    nav_ekf_output(&ekf, &out);
+    ESP_LOGI(TAG, "%s: %.2f +- %.2f m/s, fix age %lu ms, updates %lu, rejected %lu, att lost %lu, torn %lu",
+             ekf.aligned ? "aligned" : "waiting for fix", out.speed, out.speed_sigma,
+             (unsigned long)out.fix_age_ms, (unsigned long)ekf.updates, (unsigned long)ekf.rejected,
+             (unsigned long)att_cursor.lost, (unsigned long)torn_blocks);
+    ESP_LOGI(TAG, "ALT: %.1f m %+.2f m/s, QNH %.1f hPa%s, rejected %lu", alt_kf.x[0], alt_kf.x[1],
+             altitude_kf_qnh(&alt_kf), alt_kf.gnss_seen ? "" : " (no GNSS yet)", (unsigned long)alt_kf.rejected);
+}
+
+void nav_task_entry(void *pvParameters) {
+    ESP_LOGI(TAG, "Nav Task Started");
+
+    gnss_snapshot_t snap;
+    uint32_t last_epoch = 0;
+    bool fix_held = false;
+    int64_t next_log_us = esp_timer_get_time() + STATS_LOG_PERIOD_US;
+
+    while (1) {
+        // IMU first so the filter time is past the fix being applied
+        drain_attitude();
+        drain_baro();
+
+        if (!fix_held && gnss_get_snapshot_newer(last_epoch, &snap)) {
+            last_epoch = snap.epoch;
+            fix_held = true;
+
+            const gnss_fix_t *fix = &snap.fix;
+            bool fix_3d = fix->fix_type == GNSS_FIX_3D || fix->fix_type == GNSS_FIX_GNSS_DR;
+            if (fix_3d && (fix->valid & GNSS_VALID_ALT)) {
+                // No vAcc from NMEA: 0 falls back to the filter's floor
+                altitude_kf_gnss(&alt_kf, snap.capture_us - NAV_GNSS_LATENCY_US, fix->alt_mm * 1e-3f,
+                                 fix->v_acc_mm * 1e-3f);
+            }
+        }
+
+        // The IMU arrives one FIFO watermark late: hold a fix until the
+        // filter has reached its measurement time
+        int64_t now = esp_timer_get_time();
+        if (fix_held) {
+            int64_t t_meas = snap.capture_us - NAV_GNSS_LATENCY_US;
+            if (ekf.t_us >= t_meas || now - snap.capture_us > FIX_HOLD_MAX_US) {
+                nav_ekf_update_gnss(&ekf, &snap.fix, t_meas);
+                fix_held = false;
+            }
+        }
+
+        if (now >= next_log_us) {
+            next_log_us = now + STATS_LOG_PERIOD_US;
+            log_stats();
+        }
+        vTaskDelay(pdMS_TO_TICKS(NAV_POLL_MS));
+    }
+}
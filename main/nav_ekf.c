@@ -0,0 +1,300 @@
+#include "nav_ekf.h"
+#include <math.h>
+#include <string.h>
+
+#define G_MPS2              9.80665f
+#define DEG_TO_RAD          0.017453292519943295f
+#define M_PER_LAT_E7        0.011119493f    // Metres per 1e-7 deg of latitude
+#define REORIGIN_M          10000.0f        // Keep the float position small
+#define MIN_COURSE_MPS      0.5f            // NMEA course is noise below this
+#define NMEA_SPEED_SIGMA    0.3f            // m/s, no accuracy in NMEA
+#define NMEA_UERE_M         3.0f            // m per unit of HDOP
+#define NMEA_POS_SIGMA      5.0f            // m, no HDOP either
+
+void nav_ekf_init(nav_ekf_t *f, const nav_ekf_params_t *params) {
+    memset(f, 0, sizeof(*f));
+    f->params = *params;
+}
+
+// Device -> earth rotation matrix of the AHRS quaternion
+static void quat_to_rot(const float q[4], float r[3][3]) {
+    float w = q[0], x = q[1], y = q[2], z = q[3];
+    r[0][0] = 1.0f - 2.0f * (y * y + z * z);
+    r[0][1] = 2.0f * (x * y - w * z);
+    r[0][2] = 2.0f * (x * z + w * y);
+    r[1][0] = 2.0f * (x * y + w * z);
+    r[1][1] = 1.0f - 2.0f * (x * x + z * z);
+    r[1][2] = 2.0f * (y * z - w * x);
+    r[2][0] = 2.0f * (x * z - w * y);
+    r[2][1] = 2.0f * (y * z + w * x);
+    r[2][2] = 1.0f - 2.0f * (x * x + y * y);
+}
+
+// P = F P F^T with F = [I I*dt 0; 0 I -R*dt; 0 0 I], done block-wise: the
+// full 9x9 product would be ~1500 MACs per IMU sample, this is ~300
+static void propagate_cov(float P[NAV_EKF_STATES][NAV_EKF_STATES], const float r[3][3], float dt) {
+    for (int j = 0; j < NAV_EKF_STATES; j++) {
+        float rb[3];
+        for (int i = 0; i < 3; i++) {
+            rb[i] = r[i][0] * P[NAV_BA][j] + r[i][1] * P[NAV_BA + 1][j] + r[i][2] * P[NAV_BA + 2][j];
+        }
+        for (int i = 0; i < 3; i++) {
+            P[NAV_P + i][j] += dt * P[NAV_V + i][j];
+            P[NAV_V + i][j] -= dt * rb[i];
+        }
+    }
+    for (int i = 0; i < NAV_EKF_STATES; i++) {
+        float *row = P[i];
+        float cb[3];
+        for (int j = 0; j < 3; j++) {
+            cb[j] = row[NAV_BA] * r[j][0] + row[NAV_BA + 1] * r[j][1] + row[NAV_BA + 2] * r[j][2];
+        }
+        for (int j = 0; j < 3; j++) {
+            row[NAV_P + j] += dt * row[NAV_V + j];
+            row[NAV_V + j] -= dt * cb[j];
+        }
+    }
+}
+
+static void hist_push(nav_ekf_t *f) {
+    f->hist_head = (uint8_t)((f->hist_head + 1) % NAV_EKF_HISTORY);
+    f->hist[f->hist_head].t_us = f->t_us;
+    memcpy(f->hist[f->hist_head].p, f->p, sizeof(f->p));
+    memcpy(f->hist[f->hist_head].v, f->v, sizeof(f->v));
+}
+
+void nav_ekf_predict(nav_ekf_t *f, const attitude_sample_t *att) {
+    float dt = f->t_us ? (att->t_us - f->t_us) * 1e-6f : 0.0f;
+    f->t_us = att->t_us;
+    if (!f->aligned || dt <= 0.0f || dt > NAV_EKF_MAX_DT_S) return;
+
+    float r[3][3];
+    quat_to_rot(att->q, r);
+
+    float a[3];
+    for (int i = 0; i < 3; i++) {
+        a[i] = att->lin_earth[i] * G_MPS2 - (r[i][0] * f->ba[0] + r[i][1] * f->ba[1] + r[i][2] * f->ba[2]);
+        f->p[i] += (f->v[i] + 0.5f * a[i] * dt) * dt;
+        f->v[i] += a[i] * dt;
+    }
+    memcpy(f->a, a, sizeof(a));
+
+    propagate_cov(f->P, r, dt);
+    float qv = f->params.accel_noise * f->params.accel_noise * dt;
+    float qb = f->params.bias_walk * f->params.bias_walk * dt;
+    for (int i = 0; i < 3; i++) {
+        f->P[NAV_V + i][NAV_V + i] += qv;
+        f->P[NAV_BA + i][NAV_BA + i] += qb;
+    }
+
+    hist_push(f);
+}
+
+// Newest stored state not after t_us; the oldest one when the fix is
+// older than the history, the current one when it is newer
+static void state_at(const nav_ekf_t *f, int64_t t_us, const float **p, const float **v) {
+    *p = f->p;
+    *v = f->v;
+    if (t_us >= f->t_us) return;
+    for (int k = 0; k < NAV_EKF_HISTORY; k++) {
+        int idx = (f->hist_head + NAV_EKF_HISTORY - k) % NAV_EKF_HISTORY;
+        if (f->hist[idx].t_us == 0) break;
+        *p = f->hist[idx].p;
+        *v = f->hist[idx].v;
+        if (f->hist[idx].t_us <= t_us) break;
+    }
+}
+
+// One scalar measurement of state idx: innovation against the predicted
+// state plus the correction gathered so far. P stays symmetric because
+// the update is built from a single column.
+static bool update_scalar(nav_ekf_t *f, int idx, float z, float pred, float var, float dx[NAV_EKF_STATES]) {
+    float y = z - pred - dx[idx];
+    float s = f->P[idx][idx] + var;
+    if (y * y > NAV_EKF_GATE * s) {
+        f->rejected++;
+        return false;
+    }
+
+    float ph[NAV_EKF_STATES];
+    for (int i = 0; i < NAV_EKF_STATES; i++) ph[i] = f->P[i][idx];
+    float inv_s = 1.0f / s;
+    for (int i = 0; i < NAV_EKF_STATES; i++) {
+        float k = ph[i] * inv_s;
+        dx[i] += k * y;
+        for (int j = 0; j < NAV_EKF_STATES; j++) f->P[i][j] -= k * ph[j];
+    }
+    f->updates++;
+    return true;
+}
+
+static void local_position(const nav_ekf_t *f, const gnss_fix_t *fix, float pos[3]) {
+    int64_t dlon = (int64_t)fix->lon - f->lon0;
+    if (dlon > 1800000000) dlon -= 3600000000LL;
+    if (dlon < -1800000000) dlon += 3600000000LL;
+    pos[0] = (float)(fix->lat - f->lat0) * M_PER_LAT_E7;
+    pos[1] = -(float)dlon * f->m_per_lon;
+    pos[2] = (float)(fix->alt_mm - f->alt0_mm) * 1e-3f;
+}
+
+static void set_origin(nav_ekf_t *f, int32_t lat, int32_t lon, int32_t alt_mm) {
+    f->lat0 = lat;
+    f->lon0 = lon;
+    f->alt0_mm = alt_mm;
+    f->m_per_lon = M_PER_LAT_E7 * cosf(lat * 1e-7f * DEG_TO_RAD);
+}
+
+// Move the origin under the current position so the float state keeps
+// millimetre resolution on long rides
+static void reorigin(nav_ekf_t *f) {
+    float n = f->p[0], w = f->p[1];
+    if (n * n + w * w < REORIGIN_M * REORIGIN_M) return;
+
+    int32_t dlat = (int32_t)lrintf(n / M_PER_LAT_E7);
+    int32_t dlon = (int32_t)lrintf(-w / f->m_per_lon);
+    float shift_n = dlat * M_PER_LAT_E7;
+    float shift_w = -dlon * f->m_per_lon;
+    set_origin(f, f->lat0 + dlat, f->lon0 + dlon, f->alt0_mm);
+    f->p[0] -= shift_n;
+    f->p[1] -= shift_w;
+    for (int k = 0; k < NAV_EKF_HISTORY; k++) {
+        f->hist[k].p[0] -= shift_n;
+        f->hist[k].p[1] -= shift_w;
+    }
+}
+
+// GNSS velocity in earth axes (north, west, up) and its per-axis variance;
+// returns the number of axes measured (0, 2 or 3)
+static int gnss_velocity(const nav_ekf_t *f, const gnss_fix_t *fix, float vel[3], float *var) {
+    float floor = f->params.speed_floor;
+    if (fix->valid & GNSS_VALID_VEL) {
+        vel[0] = fix->vel_n * 1e-3f;
+        vel[1] = -fix->vel_e * 1e-3f;
+        vel[2] = -fix->vel_d * 1e-3f;
+        float sigma = fmaxf(fix->s_acc_mmps * 1e-3f, floor);
+        *var = sigma * sigma;
+        return 3;
+    }
+    if (!(fix->valid & GNSS_VALID_SPEED)) return 0;
+
+    // NMEA: speed and course; below walking pace the course is random, so
+    // the fix only says "about stopped"
+    float speed = fix->speed_mmps * 1e-3f;
+    float sigma = fmaxf(fix->s_acc_mmps ? fix->s_acc_mmps * 1e-3f : NMEA_SPEED_SIGMA, floor);
+    if (speed < MIN_COURSE_MPS) {
+        vel[0] = vel[1] = 0.0f;
+        sigma = fmaxf(sigma, MIN_COURSE_MPS);
+    } else if (fix->valid & GNSS_VALID_COURSE) {
+        float course = fix->course * 1e-5f * DEG_TO_RAD;
+        vel[0] = speed * cosf(course);
+        vel[1] = -speed * sinf(course);
+    } else {
+        return 0;
+    }
+    *var = sigma * sigma;
+    return 2;
+}
+
+static float gnss_pos_sigma(const nav_ekf_t *f, const gnss_fix_t *fix, bool vertical) {
+    float sigma;
+    uint32_t acc = vertical ? fix->v_acc_mm : fix->h_acc_mm;
+    uint16_t dop = vertical ? fix->vdop : fix->hdop;
+    if (acc) sigma = acc * 1e-3f;
+    else if ((fix->valid & GNSS_VALID_DOP) && dop) sigma = dop * 0.01f * NMEA_UERE_M;
+    else sigma = NMEA_POS_SIGMA;
+    return fmaxf(sigma, f->params.pos_floor);
+}
+
+static void align(nav_ekf_t *f, const gnss_fix_t *fix, int64_t t_meas_us) {
+    memset(f->p, 0, sizeof(f->p));
+    memset(f->v, 0, sizeof(f->v));
+    memset(f->ba, 0, sizeof(f->ba));
+    memset(f->P, 0, sizeof(f->P));
+    set_origin(f, fix->lat, fix->lon, (fix->valid & GNSS_VALID_ALT) ? fix->alt_mm : 0);
+
+    float h_sigma = gnss_pos_sigma(f, fix, false);
+    float v_sigma = gnss_pos_sigma(f, fix, true);
+    f->P[NAV_P][NAV_P] = f->P[NAV_P + 1][NAV_P + 1] = h_sigma * h_sigma;
+    f->P[NAV_P + 2][NAV_P + 2] = v_sigma * v_sigma;
+
+    float vel[3] = { 0 }, var = 0.0f;
+    int axes = gnss_velocity(f, fix, vel, &var);
+    for (int i = 0; i < 3; i++) {
+        f->v[i] = i < axes ? vel[i] : 0.0f;
+        f->P[NAV_V + i][NAV_V + i] = i < axes ? var : 1.0f;
+        f->P[NAV_BA + i][NAV_BA + i] = f->params.bias_init * f->params.bias_init;
+    }
+
+    memset(f->hist, 0, sizeof(f->hist));
+    f->fix_us = t_meas_us;
+    f->aligned = true;
+}
+
+bool nav_ekf_update_gnss(nav_ekf_t *f, const gnss_fix_t *fix, int64_t t_meas_us) {
+    if (fix->fix_type < GNSS_FIX_2D || fix->fix_type > GNSS_FIX_GNSS_DR || !(fix->valid & GNSS_VALID_POS)) {
+        return false;
+    }
+    if (!f->aligned) {
+        align(f, fix, t_meas_us);
+        return true;
+    }
+
+    const float *p_then, *v_then;
+    state_at(f, t_meas_us, &p_then, &v_then);
+
+    float dx[NAV_EKF_STATES] = { 0 };
+    bool used = false;
+
+    float vel[3], var;
+    int axes = gnss_velocity(f, fix, vel, &var);
+    for (int i = 0; i < axes; i++) used |= update_scalar(f, NAV_V + i, vel[i], v_then[i], var, dx);
+
+    float pos[3];
+    local_position(f, fix, pos);
+    float h_sigma = gnss_pos_sigma(f, fix, false);
+    int pos_axes = (fix->fix_type != GNSS_FIX_2D && (fix->valid & GNSS_VALID_ALT)) ? 3 : 2;
+    for (int i = 0; i < pos_axes; i++) {
+        float sigma = i < 2 ? h_sigma : gnss_pos_sigma(f, fix, true);
+        used |= update_scalar(f, NAV_P + i, pos[i], p_then[i], sigma * sigma, dx);
+    }
+    if (!used) return false;
+
+    // Inject into the current state and shift the history with it so the
+    // next delayed fix is compared with corrected states
+    for (int i = 0; i < 3; i++) {
+        f->p[i] += dx[NAV_P + i];
+        f->v[i] += dx[NAV_V + i];
+        f->ba[i] += dx[NAV_BA + i];
+    }
+    for (int k = 0; k < NAV_EKF_HISTORY; k++) {
+        for (int i = 0; i < 3; i++) {
+            f->hist[k].p[i] += dx[NAV_P + i];
+            f->hist[k].v[i] += dx[NAV_V + i];
+        }
+    }
+    for (int i = 0; i < NAV_EKF_STATES; i++) {
+        for (int j = i + 1; j < NAV_EKF_STATES; j++) {
+            float m = 0.5f * (f->P[i][j] + f->P[j][i]);
+            f->P[i][j] = f->P[j][i] = m;
+        }
+    }
+
+    reorigin(f);
+    f->fix_us = t_meas_us;
+    return true;
+}
+
+void nav_ekf_output(const nav_ekf_t *f, nav_sample_t *out) {
+    out->t_us = f->t_us;
+    memcpy(out->pos, f->p, sizeof(out->pos));
+    memcpy(out->vel, f->v, sizeof(out->vel));
+    memcpy(out->accel, f->a, sizeof(out->accel));
+
+    float vn = f->v[0], vw = f->v[1];
+    float pnn = f->P[NAV_V][NAV_V], pww = f->P[NAV_V + 1][NAV_V + 1], pnw = f->P[NAV_V][NAV_V + 1];
+    float s2 = vn * vn + vw * vw;
+    out->speed = sqrtf(s2);
+    float var = s2 > 1e-4f ? (vn * vn * pnn + 2.0f * vn * vw * pnw + vw * vw * pww) / s2 : 0.5f * (pnn + pww);
+    out->speed_sigma = sqrtf(fmaxf(var, 0.0f));
+    out->fix_age_ms = f->aligned && f->t_us > f->fix_us ? (uint32_t)((f->t_us - f->fix_us) / 1000) : 0;
+}
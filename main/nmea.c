@@ -0,0 +1,381 @@
+#include "nmea.h"
+#include <stdbool.h>
+#include <string.h>
+
+// Max fields in a supported sentence (GSV: id + 3 + 4*4 + signal id)
+#define NMEA_MAX_FIELDS 24
+
+// Sentence formatter packed as 24-bit big-endian constant
+#define NMEA_ID(a, b, c) (((uint32_t)(a) << 16) | ((uint32_t)(b) << 8) | (uint32_t)(c))
+
+// A field is a view into the caller's buffer
+typedef struct {
+    const char *s;
+    uint8_t len;
+} nmea_field_t;
+
+static const uint32_t pow10_u32[] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+void nmea_decoder_init(nmea_decoder_t *dec) {
+    memset(dec, 0, sizeof(*dec));
+}
+
+// Split payload on ',' up to '*' / CR / LF. Returns number of fields.
+static int nmea_tokenize(const char *s, size_t len, nmea_field_t *fields) {
+    int n = 0;
+    const char *start = s;
+    const char *end = s + len;
+    const char *p = s;
+
+    for (; p < end; p++) {
+        char c = *p;
+        if (c == '*' || c == '\r' || c == '\n') break;
+        if (c == ',') {
+            if (n >= NMEA_MAX_FIELDS) return -1;
+            fields[n].s = start;
+            fields[n].len = (uint8_t)(p - start);
+            n++;
+            start = p + 1;
+        }
+    }
+    if (n >= NMEA_MAX_FIELDS) return -1;
+    fields[n].s = start;
+    fields[n].len = (uint8_t)(p - start);
+    return n + 1;
+}
+
+static bool parse_uint(const nmea_field_t *f, uint32_t *out) {
+    if (f->len == 0) return false;
+    uint32_t v = 0;
+    for (int i = 0; i < f->len; i++) {
+        uint32_t d = (uint32_t)(f->s[i] - '0');
+        if (d > 9) return false;
+        v = v * 10 + d;
+    }
+    *out = v;
+    return true;
+}
+
+// Parse "[-]int[.frac]" into a fixed-point integer with 'frac' decimal
+// digits. Extra fractional digits are truncated, missing ones padded.
+static bool parse_fixed(const nmea_field_t *f, int frac, int64_t *out) {
+    if (f->len == 0) return false;
+    const char *p = f->s;
+    const char *end = f->s + f->len;
+    bool neg = false;
+
+    if (*p == '-') {
+        neg = true;
+        p++;
+    }
+
+    int64_t v = 0;
+    bool any = false;
+    for (; p < end && *p != '.'; p++) {
+        uint32_t d = (uint32_t)(*p - '0');
+        if (d > 9) return false;
+        v = v * 10 + d;
+        any = true;
+    }
+
+    int digits = 0;
+    if (p < end) {
+        p++; // Skip '.'
+        for (; p < end; p++) {
+            uint32_t d = (uint32_t)(*p - '0');
+            if (d > 9) return false;
+            if (digits < frac) {
+                v = v * 10 + d;
+                digits++;
+            }
+            any = true;
+        }
+    }
+    if (!any) return false;
+
+    v *= pow10_u32[frac - digits];
+    *out = neg ? -v : v;
+    return true;
+}
+
+static inline uint8_t two_digits(const char *p) {
+    return (uint8_t)((p[0] - '0') * 10 + (p[1] - '0'));
+}
+
+static bool all_digits(const char *p, int n) {
+    for (int i = 0; i < n; i++) {
+        if ((uint32_t)(p[i] - '0') > 9) return false;
+    }
+    return true;
+}
+
+// hhmmss[.sss]
+static bool parse_time(const nmea_field_t *f, gnss_fix_t *fix) {
+    if (f->len < 6 || !all_digits(f->s, 6)) return false;
+    fix->hour = two_digits(f->s);
+    fix->min = two_digits(f->s + 2);
+    fix->sec = two_digits(f->s + 4);
+
+    uint16_t ms = 0;
+    if (f->len > 7 && f->s[6] == '.') {
+        int scale = 100;
+        for (int i = 7; i < f->len && scale > 0; i++) {
+            uint32_t d = (uint32_t)(f->s[i] - '0');
+            if (d > 9) return false;
+            ms += d * scale;
+            scale /= 10;
+        }
+    }
+    fix->ms = ms;
+    return true;
+}
+
+// ddmmyy
+static bool parse_date(const nmea_field_t *f, gnss_fix_t *fix) {
+    if (f->len != 6 || !all_digits(f->s, 6)) return false;
+    fix->day = two_digits(f->s);
+    fix->month = two_digits(f->s + 2);
+    fix->year = 2000 + two_digits(f->s + 4);
+    return true;
+}
+
+// (d)ddmm.mmmmm + hemisphere -> deg * 1e-7
+static bool parse_coord(const nmea_field_t *f, const nmea_field_t *hemi, int32_t *out) {
+    int64_t v;
+    if (hemi->len != 1 || !parse_fixed(f, 7, &v) || v < 0) return false;
+
+    int64_t deg = v / 1000000000LL;            // ddmm.m * 1e7 / (100 * 1e7)
+    int64_t min_e7 = v - deg * 1000000000LL;   // mm.m * 1e7
+    int64_t e7 = deg * 10000000LL + (min_e7 + 30) / 60;
+
+    char h = hemi->s[0];
+    if (h == 'S' || h == 'W') e7 = -e7;
+    else if (h != 'N' && h != 'E') return false;
+
+    *out = (int32_t)e7;
+    return true;
+}
+
+static bool parse_dop(const nmea_field_t *f, uint16_t *out) {
+    int64_t v;
+    if (!parse_fixed(f, 2, &v) || v < 0) return false;
+    *out = v > 0xFFFF ? 0xFFFF : (uint16_t)v;
+    return true;
+}
+
+static inline void set_valid(gnss_fix_t *fix, uint16_t bit, bool ok) {
+    if (ok) fix->valid |= bit;
+    else fix->valid &= (uint16_t)~bit;
+}
+
+static void decode_position(gnss_fix_t *fix, const nmea_field_t *f) {
+    int32_t lat, lon;
+    bool ok = parse_coord(&f[0], &f[1], &lat) && parse_coord(&f[2], &f[3], &lon);
+    if (ok) {
+        fix->lat = lat;
+        fix->lon = lon;
+    }
+    set_valid(fix, GNSS_VALID_POS, ok);
+}
+
+static void decode_speed_knots(gnss_fix_t *fix, const nmea_field_t *f) {
+    int64_t kn_milli;
+    bool ok = parse_fixed(f, 3, &kn_milli) && kn_milli >= 0;
+    if (ok) {
+        // 1 kn = 1852 m/h -> mm/s = kn * 1e3 * 1852 / 3600
+        fix->speed_mmps = (uint32_t)((kn_milli * 1852 + 1800) / 3600);
+    }
+    set_valid(fix, GNSS_VALID_SPEED, ok);
+}
+
+static void decode_course(gnss_fix_t *fix, const nmea_field_t *f) {
+    int64_t cog;
+    bool ok = parse_fixed(f, 5, &cog);
+    if (ok) fix->course = (int32_t)cog;
+    set_valid(fix, GNSS_VALID_COURSE, ok);
+}
+
+// $xxRMC,time,status,lat,N,lon,E,spd,cog,date,mv,mvE,mode[,navStatus]
+static bool decode_rmc(gnss_fix_t *fix, const nmea_field_t *f, int n) {
+    if (n < 12) return false;
+
+    set_valid(fix, GNSS_VALID_TIME, parse_time(&f[1], fix));
+    set_valid(fix, GNSS_VALID_DATE, parse_date(&f[9], fix));
+
+    if (f[2].len != 1 || f[2].s[0] != 'A') {
+        fix->fix_type = GNSS_FIX_NONE;
+        fix->valid &= (uint16_t)~(GNSS_VALID_POS | GNSS_VALID_SPEED | GNSS_VALID_COURSE);
+        return true;
+    }
+
+    decode_position(fix, &f[3]);
+    decode_speed_knots(fix, &f[7]);
+    decode_course(fix, &f[8]);
+    return true;
+}
+
+// $xxGGA,time,lat,N,lon,E,quality,numSV,HDOP,alt,M,sep,M,diffAge,diffStation
+static bool decode_gga(gnss_fix_t *fix, const nmea_field_t *f, int n) {
+    if (n < 12) return false;
+
+    set_valid(fix, GNSS_VALID_TIME, parse_time(&f[1], fix));
+
+    uint32_t quality = 0;
+    parse_uint(&f[6], &quality);
+    if (quality == 0) {
+        fix->fix_type = GNSS_FIX_NONE;
+    } else if (quality == 6) {
+        fix->fix_type = GNSS_FIX_DR;
+    } else if (fix->fix_type < GNSS_FIX_2D) {
+        // GGA cannot tell 2D from 3D; GSA refines it
+        fix->fix_type = GNSS_FIX_3D;
+    }
+
+    uint32_t num_sv;
+    if (parse_uint(&f[7], &num_sv)) fix->num_sv = num_sv > 255 ? 255 : (uint8_t)num_sv;
+
+    if (quality == 0) {
+        fix->valid &= (uint16_t)~(GNSS_VALID_POS | GNSS_VALID_ALT);
+        return true;
+    }
+
+    decode_position(fix, &f[2]);
+
+    int64_t alt_mm;
+    bool alt_ok = parse_fixed(&f[9], 3, &alt_mm);
+    if (alt_ok) fix->alt_mm = (int32_t)alt_mm;
+    set_valid(fix, GNSS_VALID_ALT, alt_ok);
+
+    uint16_t hdop;
+    if (parse_dop(&f[8], &hdop)) fix->hdop = hdop;
+    return true;
+}
+
+// $xxGSA,opMode,navMode,sv1..sv12,PDOP,HDOP,VDOP[,systemId]
+static bool decode_gsa(gnss_fix_t *fix, const nmea_field_t *f, int n) {
+    if (n < 18) return false;
+
+    uint32_t nav_mode = 0;
+    parse_uint(&f[2], &nav_mode);
+    if (nav_mode == 2) fix->fix_type = GNSS_FIX_2D;
+    else if (nav_mode == 3) fix->fix_type = GNSS_FIX_3D;
+    else fix->fix_type = GNSS_FIX_NONE;
+
+    bool ok = parse_dop(&f[15], &fix->pdop) &&
+              parse_dop(&f[16], &fix->hdop) &&
+              parse_dop(&f[17], &fix->vdop);
+    set_valid(fix, GNSS_VALID_DOP, ok);
+    return true;
+}
+
+// $xxGSV,numMsg,msgNum,numSV{,svid,elv,az,cno}[,signalId]
+static bool decode_gsv(nmea_gsv_t *gsv, const nmea_field_t *f, int n) {
+    if (n < 4) return false;
+
+    uint32_t total, num, in_view;
+    if (!parse_uint(&f[1], &total) || !parse_uint(&f[2], &num) || !parse_uint(&f[3], &in_view)) {
+        return false;
+    }
+    gsv->total_msgs = (uint8_t)total;
+    gsv->msg_num = (uint8_t)num;
+    gsv->num_in_view = (uint8_t)in_view;
+
+    int body = n - 4;
+    int groups = body / 4;
+    if (groups > NMEA_GSV_SATS_PER_MSG) groups = NMEA_GSV_SATS_PER_MSG;
+
+    uint32_t sig = 0;
+    gsv->signal_id = (body % 4 == 1 && parse_uint(&f[n - 1], &sig)) ? (uint8_t)sig : 0;
+
+    uint8_t count = 0;
+    for (int g = 0; g < groups; g++) {
+        const nmea_field_t *s = &f[4 + g * 4];
+        uint32_t svid, elev, azim, cn0;
+        if (!parse_uint(&s[0], &svid)) continue;
+
+        nmea_gsv_sat_t *sat = &gsv->sats[count++];
+        sat->svid = (uint8_t)svid;
+        sat->elev = parse_uint(&s[1], &elev) ? (int8_t)elev : -1;
+        sat->azim = parse_uint(&s[2], &azim) ? (uint16_t)azim : 0;
+        sat->cn0 = parse_uint(&s[3], &cn0) ? (uint8_t)cn0 : 0;
+    }
+    gsv->count = count;
+    return true;
+}
+
+// $xxVTG,cogt,T,cogm,M,sog,N,kph,K[,mode]
+static bool decode_vtg(gnss_fix_t *fix, const nmea_field_t *f, int n) {
+    if (n < 9) return false;
+
+    decode_course(fix, &f[1]);
+    if (f[5].len) {
+        decode_speed_knots(fix, &f[5]);
+    } else {
+        int64_t kph_milli;
+        bool ok = parse_fixed(&f[7], 3, &kph_milli) && kph_milli >= 0;
+        if (ok) fix->speed_mmps = (uint32_t)((kph_milli * 10 + 18) / 36);
+        set_valid(fix, GNSS_VALID_SPEED, ok);
+    }
+    return true;
+}
+
+static uint8_t talker_from_id(const char *id) {
+    switch ((id[0] << 8) | id[1]) {
+        case ('G' << 8) | 'P': return NMEA_TALKER_GPS;
+        case ('G' << 8) | 'L': return NMEA_TALKER_GLONASS;
+        case ('G' << 8) | 'A': return NMEA_TALKER_GALILEO;
+        case ('G' << 8) | 'B':
+        case ('B' << 8) | 'D': return NMEA_TALKER_BEIDOU;
+        case ('G' << 8) | 'Q': return NMEA_TALKER_QZSS;
+        case ('G' << 8) | 'N': return NMEA_TALKER_COMBINED;
+        default: return NMEA_TALKER_UNKNOWN;
+    }
+}
+
+nmea_msg_t nmea_decode(nmea_decoder_t *dec, const char *s, size_t len) {
+    // "$ttsss" minimum
+    if (len < 6 || s[0] != '$') return NMEA_MSG_UNKNOWN;
+
+    nmea_field_t f[NMEA_MAX_FIELDS];
+    int n = nmea_tokenize(s + 1, len - 1, f);
+    if (n < 1 || f[0].len != 5) return NMEA_MSG_UNKNOWN;
+
+    const char *id = f[0].s;
+    nmea_msg_t type;
+    bool ok;
+
+    switch (NMEA_ID(id[2], id[3], id[4])) {
+        case NMEA_ID('R', 'M', 'C'):
+            type = NMEA_MSG_RMC;
+            ok = decode_rmc(&dec->fix, f, n);
+            break;
+        case NMEA_ID('G', 'G', 'A'):
+            type = NMEA_MSG_GGA;
+            ok = decode_gga(&dec->fix, f, n);
+            break;
+        case NMEA_ID('G', 'S', 'A'):
+            type = NMEA_MSG_GSA;
+            ok = decode_gsa(&dec->fix, f, n);
+            break;
+        case NMEA_ID('G', 'S', 'V'):
+            type = NMEA_MSG_GSV;
+            dec->gsv.talker = talker_from_id(id);
+            ok = decode_gsv(&dec->gsv, f, n);
+            break;
+        case NMEA_ID('V', 'T', 'G'):
+            type = NMEA_MSG_VTG;
+            ok = decode_vtg(&dec->fix, f, n);
+            break;
+        default:
+            return NMEA_MSG_UNKNOWN;
+    }
+
+    if (!ok) {
+        dec->errors++;
+        return NMEA_MSG_INVALID;
+    }
+    dec->sentences++;
+    return type;
+}
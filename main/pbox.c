@@ -0,0 +1,315 @@
+#include "pbox.h"
+#include <math.h>
+#include <string.h>
+
+#define MIN_SLOPE_MPS2      0.2f    // Crossing sigma is unbounded on a flat speed trace
+#define MIN_FIT_SAMPLES     3
+#define QUIET_FRACTION      0.3f    // Of start_accel: below this the vehicle is still at rest
+#define NOISE_ALPHA         (1.0f / 64.0f)
+#define ONSET_LEAD_MAX_US   (1000 * 1000)   // Onset this far before the speed line: rolled off
+#define ONSET_LAG_MAX_US    (50 * 1000)
+#define ARM_HOLD_US         (500 * 1000)    // At rest this long before a trigger counts
+
+void pbox_init(pbox_t *e, const pbox_params_t *params, const pbox_interval_cfg_t *intervals, size_t count) {
+    memset(e, 0, sizeof(*e));
+    e->params = *params;
+    if (count > PBOX_MAX_INTERVALS) count = PBOX_MAX_INTERVALS;
+    for (size_t i = 0; i < count; i++) e->iv[i].cfg = intervals[i];
+    e->count = (uint8_t)count;
+    e->phase = PBOX_WAIT;
+}
+
+static bool from_launch(const pbox_interval_cfg_t *c) {
+    return c->kind == PBOX_DISTANCE || c->from <= 0.0f;
+}
+
+// Interpolated time at which the speed crosses thr between two samples,
+// and its variance from the speed sigma over the local slope
+static bool speed_crossing(const nav_sample_t *a, const nav_sample_t *b, float thr, bool up,
+                           int64_t *t_us, float *var) {
+    if (up ? !(a->speed < thr && b->speed >= thr) : !(a->speed > thr && b->speed <= thr)) return false;
+
+    float dv = b->speed - a->speed;
+    float dt = (float)(b->t_us - a->t_us);
+    float frac = (thr - a->speed) / dv;
+    *t_us = a->t_us + (int64_t)lrintf(frac * dt);
+
+    float slope = fmaxf(fabsf(dv) / (dt * 1e-6f), MIN_SLOPE_MPS2);
+    float sigma = a->speed_sigma + frac * (b->speed_sigma - a->speed_sigma);
+    *var = (sigma / slope) * (sigma / slope);
+    return true;
+}
+
+// Time at which the run distance reaches d within the segment, speed
+// linear in between
+static bool distance_crossing(const nav_sample_t *a, const nav_sample_t *b, float d0, float d1, float d,
+                              int64_t *t_us, float *v_at) {
+    if (!(d0 < d && d1 >= d)) return false;
+
+    float dt = (b->t_us - a->t_us) * 1e-6f;
+    float acc = (b->speed - a->speed) / dt;
+    float rem = d - d0;
+    float tau;
+    if (fabsf(acc) < 1e-3f) {
+        tau = a->speed > 0.0f ? rem / a->speed : dt;
+    } else {
+        tau = (-a->speed + sqrtf(fmaxf(a->speed * a->speed + 2.0f * acc * rem, 0.0f))) / acc;
+    }
+    tau = fminf(fmaxf(tau, 0.0f), dt);
+    *t_us = a->t_us + (int64_t)lrintf(tau * 1e6f);
+    *v_at = a->speed + acc * tau;
+    return true;
+}
+
+// Line through the last quiet sample and the trigger, back to zero
+// acceleration; a step in acceleration puts the onset at the quiet sample
+static void onset_solve(pbox_t *e, const nav_sample_t *s, float accel) {
+    float dt = (s->t_us - e->quiet_us) * 1e-6f;
+    float slope = dt > 0.0f ? (accel - e->quiet_accel) / dt : 0.0f;
+    if (e->quiet_us == 0 || slope <= 0.0f) {
+        e->onset_us = s->t_us;
+        e->onset_var = 0.0f;
+        return;
+    }
+    float back = fminf(fmaxf(e->quiet_accel, 0.0f) / slope, dt);
+    e->onset_us = e->quiet_us - (int64_t)lrintf(back * 1e6f);
+    e->onset_var = e->accel_var / (slope * slope);
+}
+
+static void fit_reset(pbox_t *e, int64_t t_us) {
+    e->trig_us = t_us;
+    e->s_t = e->s_v = e->s_tt = e->s_tv = e->s_vv = e->s_var = 0.0f;
+    e->n = 0;
+    e->dist = 0.0f;
+}
+
+static void fit_add(pbox_t *e, const nav_sample_t *s) {
+    float t = (s->t_us - e->trig_us) * 1e-6f;
+    e->s_t += t;
+    e->s_v += s->speed;
+    e->s_tt += t * t;
+    e->s_tv += t * s->speed;
+    e->s_vv += s->speed * s->speed;
+    e->s_var += s->speed_sigma * s->speed_sigma;
+    e->n++;
+}
+
+// Zero crossing of the least-squares line v = a t + b; its variance from
+// the parameter covariance, with the residual floored at the mean speed
+// variance since the fused trace is smoother than its error
+static bool fit_solve(pbox_t *e) {
+    float n = (float)e->n;
+    float det = n * e->s_tt - e->s_t * e->s_t;
+    if (e->n < MIN_FIT_SAMPLES || det <= 0.0f) return false;
+
+    float a = (n * e->s_tv - e->s_t * e->s_v) / det;
+    float b = (e->s_v - a * e->s_t) / n;
+    if (a <= 0.0f) return false;
+
+    float t0 = -b / a;
+    float res = (e->s_vv - b * e->s_v - a * e->s_tv) / fmaxf(n - 2.0f, 1.0f);
+    float s2 = fmaxf(res, e->s_var / n);
+    float var_a = n * s2 / det;
+    float var_b = s2 * e->s_tt / det;
+    float cov_ab = -s2 * e->s_t / det;
+
+    // The engine was stopped until the trigger: the line cannot start
+    // earlier than the fit window allows
+    float min_t0 = -(float)e->params.fit_timeout_us * 1e-6f;
+    if (t0 < min_t0) t0 = min_t0;
+
+    int64_t line_us = e->trig_us + (int64_t)lrintf(t0 * 1e6f);
+    float line_var = fmaxf((var_b + t0 * t0 * var_a + 2.0f * t0 * cov_ab) / (a * a), 0.0f);
+
+    // The line starts late by about half the jerk-limited rise, so the
+    // onset wins unless it is clearly inconsistent (a slow roll-off
+    // triggered well after the vehicle started moving)
+    if (e->onset_us <= line_us + ONSET_LAG_MAX_US && e->onset_us >= line_us - ONSET_LEAD_MAX_US) {
+        e->launch_us = e->onset_us;
+        e->launch_var = e->onset_var;
+    } else {
+        e->launch_us = line_us;
+        e->launch_var = line_var;
+    }
+    return true;
+}
+
+static void complete(pbox_interval_t *iv, uint32_t *done, int i) {
+    pbox_result_t *r = &iv->result;
+    r->start_us = iv->start_us;
+    r->end_us = iv->end_us;
+    r->time_s = (iv->end_us - iv->start_us) * 1e-6f;
+    r->sigma_s = sqrtf(iv->start_var + iv->end_var);
+    r->end_speed = iv->end_speed;
+    r->distance = iv->end_dist - iv->start_dist;
+    iv->runs++;
+    iv->state = PBOX_IV_IDLE;
+    *done |= 1u << i;
+}
+
+// Launch phase changes, applied to every launch interval
+static void launch_event(pbox_t *e, pbox_phase_t phase, uint32_t *done) {
+    for (int i = 0; i < e->count; i++) {
+        pbox_interval_t *iv = &e->iv[i];
+        if (!from_launch(&iv->cfg)) continue;
+
+        if (phase == PBOX_LAUNCH) {
+            iv->state = PBOX_IV_RUNNING;
+            iv->start_dist = 0.0f;
+        } else if (phase == PBOX_RUN) {
+            iv->start_us = e->launch_us;
+            iv->start_var = e->launch_var;
+            if (iv->state == PBOX_IV_ENDED) complete(iv, done, i);
+        } else {
+            iv->state = PBOX_IV_IDLE;
+        }
+    }
+}
+
+static void arm(pbox_t *e, const nav_sample_t *s) {
+    e->phase = PBOX_ARMED;
+    e->armed_us = s->t_us;
+    e->quiet_us = 0;
+}
+
+static void update_launch(pbox_t *e, const nav_sample_t *s, uint32_t *done) {
+    const pbox_params_t *p = &e->params;
+    float ah = sqrtf(s->accel[0] * s->accel[0] + s->accel[1] * s->accel[1]);
+
+    switch (e->phase) {
+    case PBOX_WAIT:
+        if (s->speed < p->start_speed) arm(e, s);
+        break;
+
+    case PBOX_ARMED:
+        if (s->speed >= p->fit_speed) {
+            e->phase = PBOX_WAIT;
+        } else if (ah >= p->start_accel && s->t_us - e->armed_us >= ARM_HOLD_US) {
+            onset_solve(e, s, ah);
+            fit_reset(e, s->t_us);
+            e->phase = PBOX_LAUNCH;
+            launch_event(e, PBOX_LAUNCH, done);
+        } else {
+            if (ah < p->start_accel * QUIET_FRACTION) {
+                e->quiet_us = s->t_us;
+                e->quiet_accel = ah;
+            }
+            e->accel_var += NOISE_ALPHA * (ah * ah - e->accel_var);
+        }
+        break;
+
+    case PBOX_LAUNCH:
+        if (s->speed >= p->start_speed && s->speed < p->fit_speed) fit_add(e, s);
+        if (s->speed >= p->fit_speed) {
+            if (fit_solve(e)) {
+                e->launches++;
+                e->phase = PBOX_RUN;
+                launch_event(e, PBOX_RUN, done);
+            } else {
+                e->false_starts++;
+                e->phase = PBOX_WAIT;
+                launch_event(e, PBOX_WAIT, done);
+            }
+        } else if (s->t_us - e->trig_us > (int64_t)p->fit_timeout_us) {
+            e->false_starts++;
+            if (s->speed < p->start_speed) arm(e, s);
+            else e->phase = PBOX_WAIT;
+            launch_event(e, PBOX_WAIT, done);
+        }
+        break;
+
+    case PBOX_RUN:
+        if (s->speed < p->start_speed) {
+            arm(e, s);
+            launch_event(e, PBOX_ARMED, done);
+        }
+        break;
+    }
+}
+
+static void update_interval(pbox_t *e, int i, const nav_sample_t *a, const nav_sample_t *b, float d0,
+                            uint32_t *done) {
+    pbox_interval_t *iv = &e->iv[i];
+    const pbox_interval_cfg_t *c = &iv->cfg;
+    int64_t t_us;
+    float var;
+
+    if (from_launch(c)) {
+        if (iv->state != PBOX_IV_RUNNING) return;
+        bool crossed;
+        if (c->kind == PBOX_DISTANCE) {
+            float v_at;
+            crossed = distance_crossing(a, b, d0, e->dist, c->to, &t_us, &v_at);
+            if (crossed) {
+                // Integrated speed: its error grows with the run time
+                float elapsed = (t_us - e->trig_us) * 1e-6f;
+                float sd = b->speed_sigma * elapsed;
+                var = v_at > 0.0f ? (sd / v_at) * (sd / v_at) : 0.0f;
+                iv->end_speed = v_at;
+                iv->end_dist = c->to;
+            }
+        } else {
+            crossed = speed_crossing(a, b, c->to, true, &t_us, &var);
+            if (crossed) {
+                iv->end_speed = c->to;
+                iv->end_dist = d0 + (e->dist - d0) * (float)(t_us - a->t_us) / (float)(b->t_us - a->t_us);
+            }
+        }
+        if (!crossed) return;
+        iv->end_us = t_us;
+        iv->end_var = var;
+        if (e->phase == PBOX_RUN) complete(iv, done, i);
+        else iv->state = PBOX_IV_ENDED;
+        return;
+    }
+
+    bool up = c->to > c->from;
+    if (iv->state == PBOX_IV_IDLE) {
+        if (speed_crossing(a, b, c->from, up, &t_us, &var)) {
+            iv->state = PBOX_IV_RUNNING;
+            iv->start_us = t_us;
+            iv->start_var = var;
+            iv->start_dist = e->dist;
+        }
+        return;
+    }
+
+    // Back across the start threshold: the run is abandoned
+    if (speed_crossing(a, b, c->from, !up, &t_us, &var)) {
+        iv->state = PBOX_IV_IDLE;
+        return;
+    }
+
+    // Braking to (nearly) zero: the fused speed never settles exactly at
+    // zero, so cross stop_speed and extrapolate with the deceleration
+    float target = c->to;
+    if (!up && target < e->params.stop_speed) target = e->params.stop_speed;
+    if (!speed_crossing(a, b, target, up, &t_us, &var)) return;
+
+    iv->end_speed = c->to;
+    if (target > c->to) {
+        float decel = (a->speed - b->speed) / ((b->t_us - a->t_us) * 1e-6f);
+        if (decel > MIN_SLOPE_MPS2) t_us += (int64_t)lrintf((target - c->to) / decel * 1e6f);
+    }
+    iv->end_us = t_us;
+    iv->end_var = var;
+    iv->end_dist = e->dist;
+    complete(iv, done, i);
+}
+
+uint32_t pbox_feed(pbox_t *e, const nav_sample_t *s) {
+    uint32_t done = 0;
+    if (e->prev.t_us == 0 || s->t_us <= e->prev.t_us) {
+        e->prev = *s;
+        return 0;
+    }
+
+    float d0 = e->dist;
+    e->dist += 0.5f * (e->prev.speed + s->speed) * (s->t_us - e->prev.t_us) * 1e-6f;
+
+    update_launch(e, s, &done);
+    for (int i = 0; i < e->count; i++) update_interval(e, i, &e->prev, s, d0, &done);
+
+    e->prev = *s;
+    return done;
+}
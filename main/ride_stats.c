@@ -0,0 +1,164 @@
+#include "ride_stats.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fastmath.h"
+
+#define WGS84_A         6378137.0f
+#define WGS84_E2        6.69437999014e-3f
+
+static void kahan_add(ride_kahan_t *k, float x) {
+    float y = x - k->c;
+    float t = k->sum + y;
+    k->c = (t - k->sum) - y;
+    k->sum = t;
+}
+
+static float kahan_value(const ride_kahan_t *k) {
+    return k->sum - k->c;
+}
+
+float ride_stats_step_m(int32_t lat1, int32_t lon1, int32_t lat2, int32_t lon2) {
+    int64_t dlat = (int64_t)lat2 - lat1;
+    int64_t dlon = (int64_t)lon2 - lon1;
+    if (dlon > 1800000000LL) dlon -= 3600000000LL;
+    if (dlon < -1800000000LL) dlon += 3600000000LL;
+    if (llabs(dlat) > RIDE_STATS_EQUIRECT_MAX_E7 || llabs(dlon) > RIDE_STATS_EQUIRECT_MAX_E7) {
+        return fast_haversine_m(lat1, lon1, lat2, lon2);
+    }
+
+    // Meridian and prime vertical radii at the mid latitude
+    float sin_lat, cos_lat;
+    fast_sincosf((float)(((int64_t)lat1 + lat2) / 2) * FAST_E7_TO_RAD, &sin_lat, &cos_lat);
+    // libm square roots: the fast ones round low, and a bias of a few ppm
+    // per step adds up over a ride; at fix rate the cost does not matter
+    float k = 1.0f / sqrtf(1.0f - WGS84_E2 * sin_lat * sin_lat);
+    float n = WGS84_A * k;
+    float m = n * (1.0f - WGS84_E2) * k * k;
+    float dy = m * ((float)dlat * FAST_E7_TO_RAD);
+    float dx = n * cos_lat * ((float)dlon * FAST_E7_TO_RAD);
+    return sqrtf(dx * dx + dy * dy);
+}
+
+void ride_stats_init(ride_stats_t *s, const ride_stats_params_t *params, const ride_stats_state_t *saved) {
+    memset(s, 0, sizeof(*s));
+    s->params = *params;
+    if (saved && ride_stats_state_valid(saved)) {
+        s->st = *saved;
+    } else {
+        s->st.version = RIDE_STATS_VERSION;
+    }
+    s->ele_ext = NAN;
+}
+
+bool ride_stats_state_valid(const ride_stats_state_t *st) {
+    if (st->version != RIDE_STATS_VERSION) return false;
+    const ride_kahan_t *k[] = { &st->distance, &st->gain, &st->loss, &st->vam_gain };
+    for (size_t i = 0; i < sizeof(k) / sizeof(k[0]); i++) {
+        if (!(kahan_value(k[i]) >= 0.0f) || !isfinite(k[i]->c)) return false;
+    }
+    return st->elapsed_us >= st->moving_us && st->moving_us >= st->climb_us && st->climb_us >= 0 &&
+           st->max_speed >= 0.0f && isfinite(st->max_speed);
+}
+
+void ride_stats_fix(ride_stats_t *s, int64_t t_us, int32_t lat, int32_t lon, float speed) {
+    const ride_stats_params_t *p = &s->params;
+    ride_stats_state_t *st = &s->st;
+    int64_t dt = t_us - s->fix_us;
+    bool step = s->have_fix && dt > 0 && dt <= p->max_gap_us;
+    if (!step) {
+        s->slow_us = 0;
+        s->slow_m = 0.0f;
+        s->ele_ext = NAN;
+    }
+
+    if (step) {
+        st->elapsed_us += dt;
+        if (st->paused && speed >= p->resume_speed) {
+            st->paused = false;
+            s->ele_ext = NAN;
+        }
+    }
+    if (step && !st->paused) {
+        float d = ride_stats_step_m(s->lat, s->lon, lat, lon);
+        kahan_add(&st->distance, d);
+        st->moving_us += dt;
+
+        // A jump no bike can make is a glitch, not a maximum
+        if (speed > st->max_speed && speed - s->speed <= p->max_accel * (float)dt * 1e-6f) st->max_speed = speed;
+
+        if (speed >= p->pause_speed) {
+            s->slow_us = 0;
+            s->slow_m = 0.0f;
+        } else {
+            s->slow_us += dt;
+            s->slow_m += d;
+            if (s->slow_us >= p->pause_delay_us) {
+                st->paused = true;
+                st->moving_us -= s->slow_us;
+                kahan_add(&st->distance, -s->slow_m);
+                s->slow_us = 0;
+                s->slow_m = 0.0f;
+            }
+        }
+    }
+
+    s->have_fix = true;
+    s->lat = lat;
+    s->lon = lon;
+    s->fix_us = t_us;
+    s->speed = speed;
+}
+
+// Moving time from the last extreme to now counts as climbing when the
+// rise over it is fast enough
+static void climbed(ride_stats_t *s, float dh) {
+    ride_stats_state_t *st = &s->st;
+    kahan_add(&st->gain, dh);
+    int64_t dt = st->moving_us - s->ele_ext_us;
+    if (dt > 0 && dh * 3.6e9f >= s->params.vam_min_rate * (float)dt) {
+        kahan_add(&st->vam_gain, dh);
+        st->climb_us += dt;
+    }
+}
+
+void ride_stats_alt(ride_stats_t *s, int64_t t_us, float alt) {
+    ride_stats_state_t *st = &s->st;
+    // Without a recent fix nothing tells a climb from pressure drift
+    if (!s->have_fix || t_us - s->fix_us > s->params.max_gap_us) {
+        s->ele_ext = NAN;
+        return;
+    }
+    if (st->paused || !isfinite(alt)) return;
+    if (isnan(s->ele_ext)) {
+        s->ele_ext = alt;
+        s->ele_ext_us = st->moving_us;
+        return;
+    }
+
+    float band = s->params.ele_band;
+    if (s->ele_dir > 0 ? alt > s->ele_ext : alt > s->ele_ext + band) {
+        climbed(s, alt - s->ele_ext);
+        s->ele_dir = 1;
+    } else if (s->ele_dir < 0 ? alt < s->ele_ext : alt < s->ele_ext - band) {
+        kahan_add(&st->loss, s->ele_ext - alt);
+        s->ele_dir = -1;
+    } else {
+        return;
+    }
+    s->ele_ext = alt;
+    s->ele_ext_us = st->moving_us;
+}
+
+void ride_stats_summary(const ride_stats_t *s, ride_stats_summary_t *out) {
+    const ride_stats_state_t *st = &s->st;
+    out->distance_m = kahan_value(&st->distance);
+    out->elapsed_s = (float)st->elapsed_us * 1e-6f;
+    out->moving_s = (float)st->moving_us * 1e-6f;
+    out->avg_speed = st->moving_us > 0 ? out->distance_m / out->moving_s : 0.0f;
+    out->max_speed = st->max_speed;
+    out->gain_m = kahan_value(&st->gain);
+    out->loss_m = kahan_value(&st->loss);
+    out->vam = st->climb_us > 0 ? kahan_value(&st->vam_gain) * 3.6e9f / (float)st->climb_us : 0.0f;
+    out->paused = st->paused;
+}
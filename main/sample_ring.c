@@ -0,0 +1,85 @@
+#include "sample_ring.h"
+#include <stddef.h>
+#include <string.h>
+
+// The newest sample can only be lapped by a producer that publishes
+// capacity - 1 samples during one copy; retry a few times regardless
+#define LATEST_MAX_ATTEMPTS 4
+
+void sample_ring_init(sample_ring_t *ring, void *slots, uint32_t elem_size, uint32_t capacity) {
+    ring->slots = slots;
+    ring->elem_size = elem_size;
+    ring->mask = capacity - 1;
+    atomic_init(&ring->head, 0);
+}
+
+static inline uint8_t *slot_at(const sample_ring_t *ring, uint32_t seq) {
+    return ring->slots + (size_t)(seq & ring->mask) * ring->elem_size;
+}
+
+void *sample_ring_claim(sample_ring_t *ring) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    // Consumers must see the previous publish (which marks this slot as
+    // taken) before any of the writes that follow into it. Slots are plain
+    // memory so they can be read in place; on Xtensa this is a MEMW.
+    atomic_thread_fence(memory_order_seq_cst);
+    return slot_at(ring, head);
+}
+
+void sample_ring_publish(sample_ring_t *ring) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+void sample_cursor_init(const sample_ring_t *ring, sample_cursor_t *cur) {
+    cur->seq = atomic_load_explicit(&ring->head, memory_order_acquire);
+    cur->lost = 0;
+}
+
+// Slot head (the one the producer may be writing) is never readable, so a
+// cursor holds at most capacity - 1 unread samples
+static void skip_overwritten(const sample_ring_t *ring, sample_cursor_t *cur, uint32_t head) {
+    uint32_t behind = head - cur->seq;
+    if (behind > ring->mask) {
+        cur->lost += behind - ring->mask;
+        cur->seq = head - ring->mask;
+    }
+}
+
+const void *sample_ring_peek(const sample_ring_t *ring, sample_cursor_t *cur, uint32_t *n) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    skip_overwritten(ring, cur, head);
+
+    uint32_t avail = head - cur->seq;
+    uint32_t to_wrap = ring->mask + 1 - (cur->seq & ring->mask);
+    *n = avail < to_wrap ? avail : to_wrap;
+    return avail ? slot_at(ring, cur->seq) : NULL;
+}
+
+bool sample_ring_consume(const sample_ring_t *ring, sample_cursor_t *cur, uint32_t n) {
+    // Order the slot reads before the head check
+    atomic_thread_fence(memory_order_acquire);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    // The oldest sample read goes first: if it is intact, so are the rest
+    if (head - cur->seq > ring->mask) {
+        skip_overwritten(ring, cur, head);
+        return false;
+    }
+    cur->seq += n;
+    return true;
+}
+
+bool sample_ring_read_latest(const sample_ring_t *ring, void *out) {
+    for (int attempt = 0; attempt < LATEST_MAX_ATTEMPTS; attempt++) {
+        uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if (head == 0) return false;
+
+        memcpy(out, slot_at(ring, head - 1), ring->elem_size);
+
+        atomic_thread_fence(memory_order_acquire);
+        uint32_t now = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        if (now - (head - 1) <= ring->mask) return true;
+    }
+    return false;
+}
@@ -0,0 +1,162 @@
+#include "sat_table.h"
+#include <string.h>
+
+#define RUN_ANY_GNSS 0xFF
+
+void sat_table_init(sat_table_t *t) {
+    memset(t, 0, sizeof(*t));
+}
+
+static int find(const sat_table_t *t, uint16_t key) {
+    for (int i = 0; i < t->count; i++) {
+        if (t->key[i] == key) return i;
+    }
+    return -1;
+}
+
+// One insertion sort step: move entry i to its place in order[]
+static void resort(sat_table_t *t, uint8_t i) {
+    uint8_t p = t->rank[i];
+    uint8_t cn0 = t->cn0[i];
+
+    while (p > 0 && t->cn0[t->order[p - 1]] < cn0) {
+        t->order[p] = t->order[p - 1];
+        t->rank[t->order[p]] = p;
+        p--;
+    }
+    while (p + 1 < t->count && t->cn0[t->order[p + 1]] > cn0) {
+        t->order[p] = t->order[p + 1];
+        t->rank[t->order[p]] = p;
+        p++;
+    }
+    t->order[p] = i;
+    t->rank[i] = p;
+}
+
+static void update(sat_table_t *t, uint16_t key, uint8_t cn0, int8_t elev, uint16_t azim,
+                   uint8_t flags, uint8_t gen) {
+    int i = find(t, key);
+    if (i < 0) {
+        if (t->count >= SAT_TABLE_MAX) {
+            t->overflows++;
+            return;
+        }
+        i = t->count++;
+        t->key[i] = key;
+        t->cn0[i] = 0;
+        t->order[i] = i;
+        t->rank[i] = i;     // Weakest position; resort() lifts it
+    }
+
+    t->elev[i] = elev;
+    t->azim[i] = azim;
+    t->flags[i] = flags | (cn0 > 0 ? SAT_FLAG_TRACKED : 0);
+    t->seen[i] = gen;
+    if (t->cn0[i] != cn0 || t->rank[i] == t->count - 1) {
+        t->cn0[i] = cn0;
+        resort(t, i);
+    }
+}
+
+static void remove_entry(sat_table_t *t, uint8_t i) {
+    // Close the gap in order[]
+    for (uint8_t p = t->rank[i]; p + 1 < t->count; p++) {
+        t->order[p] = t->order[p + 1];
+        t->rank[t->order[p]] = p;
+    }
+
+    // Move the last entry into slot i
+    uint8_t last = --t->count;
+    if (i != last) {
+        t->key[i] = t->key[last];
+        t->azim[i] = t->azim[last];
+        t->elev[i] = t->elev[last];
+        t->cn0[i] = t->cn0[last];
+        t->flags[i] = t->flags[last];
+        t->seen[i] = t->seen[last];
+        t->rank[i] = t->rank[last];
+        t->order[t->rank[i]] = i;
+    }
+    t->dropped++;
+}
+
+// Drop the run's satellites that it did not report this time
+static void sweep(sat_table_t *t, uint8_t gnss, uint8_t sig, uint8_t gen) {
+    for (int i = t->count - 1; i >= 0; i--) {
+        uint16_t key = t->key[i];
+        if (SAT_KEY_SIG(key) != sig) continue;
+        if (gnss != RUN_ANY_GNSS && SAT_KEY_GNSS(key) != gnss) continue;
+        if (t->seen[i] != gen) remove_entry(t, i);
+    }
+    t->updates++;
+}
+
+static int find_run(sat_table_t *t, uint8_t gnss, uint8_t sig) {
+    for (int r = 0; r < t->num_runs; r++) {
+        if (t->runs[r].gnss == gnss && t->runs[r].sig == sig) return r;
+    }
+    if (t->num_runs >= SAT_TABLE_MAX_RUNS) return -1;
+
+    int r = t->num_runs++;
+    t->runs[r].gnss = gnss;
+    t->runs[r].sig = sig;
+    t->runs[r].next_msg = 0;
+    t->runs[r].gen = 0;
+    return r;
+}
+
+static int gnss_from_talker(uint8_t talker) {
+    switch (talker) {
+        case NMEA_TALKER_GPS:     return SAT_GNSS_GPS;
+        case NMEA_TALKER_GLONASS: return SAT_GNSS_GLONASS;
+        case NMEA_TALKER_GALILEO: return SAT_GNSS_GALILEO;
+        case NMEA_TALKER_BEIDOU:  return SAT_GNSS_BEIDOU;
+        case NMEA_TALKER_QZSS:    return SAT_GNSS_QZSS;
+        default:                  return -1;
+    }
+}
+
+void sat_table_feed_gsv(sat_table_t *t, const nmea_gsv_t *gsv) {
+    int gnss = gnss_from_talker(gsv->talker);
+    uint8_t sig = gsv->signal_id & 0x0F;
+    if (gnss < 0) return;
+
+    int r = find_run(t, (uint8_t)gnss, sig);
+    if (r < 0) return;
+
+    if (gsv->msg_num == 1) {
+        t->runs[r].gen++;
+    } else if (gsv->msg_num != t->runs[r].next_msg) {
+        // Page lost: keep what was merged, skip the sweep
+        t->runs[r].next_msg = 0;
+        return;
+    }
+
+    uint8_t gen = t->runs[r].gen;
+    for (uint8_t k = 0; k < gsv->count; k++) {
+        const nmea_gsv_sat_t *s = &gsv->sats[k];
+        update(t, SAT_KEY(gnss, sig, s->svid), s->cn0, s->elev, s->azim, 0, gen);
+    }
+
+    if (gsv->msg_num >= gsv->total_msgs) {
+        t->runs[r].next_msg = 0;
+        sweep(t, (uint8_t)gnss, sig, gen);
+    } else {
+        t->runs[r].next_msg = gsv->msg_num + 1;
+    }
+}
+
+void sat_table_feed_nav_sat(sat_table_t *t, const ubx_nav_sat_hdr_t *hdr, const ubx_nav_sat_sv_t *svs) {
+    int r = find_run(t, RUN_ANY_GNSS, 0);
+    if (r < 0) return;
+    uint8_t gen = ++t->runs[r].gen;
+
+    for (uint8_t k = 0; k < hdr->numSvs; k++) {
+        const ubx_nav_sat_sv_t *s = &svs[k];
+        if (s->gnssId > 7) continue;
+        uint8_t flags = (s->flags & 0x08) ? SAT_FLAG_USED : 0;   // svUsed
+        uint16_t azim = s->azim >= 0 ? (uint16_t)s->azim : 0;
+        update(t, SAT_KEY(s->gnssId, 0, s->svId), s->cno, s->elev, azim, flags, gen);
+    }
+    sweep(t, RUN_ANY_GNSS, 0, gen);
+}
@@ -0,0 +1,435 @@
+#include "sensor_service.h"
+#include "config.h"
+#include "ahrs.h"
+#include "imu_bias.h"
+#include "latency_hist.h"
+#include "lsm6dsr_fifo.h"
+#include "mag_cal.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "nvs.h"
+#include <math.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "SENSOR_SVC";
+
+// Task notification bits
+#define NOTIFY_IMU      0x01    // FIFO watermark interrupt
+#define NOTIFY_MAG      0x02    // Poll timer
+#define NOTIFY_BARO     0x04
+#define NOTIFY_MAG_DONE     0x08    // Queued bus read completed
+#define NOTIFY_BARO_DONE    0x10
+
+#define IMU_BLOCK_MAX           64
+#define STATS_LOG_PERIOD_US     (10 * 1000 * 1000)
+
+#define MAG_CAL_NVS_NAMESPACE   "mag_cal"
+#define MAG_CAL_NVS_KEY         "cal"
+#define IMU_BIAS_NVS_NAMESPACE  "imu_bias"
+#define IMU_BIAS_NVS_KEY        "tab"
+
+typedef struct {
+    uint32_t period_us;     // Nominal sample interval
+    uint32_t samples;
+    uint32_t dropped;       // Whole periods missing from the stream
+    uint32_t errors;        // Failed bus reads
+    latency_hist_t jitter;  // |interval - period_us| between consecutive samples
+    int64_t last_us;
+} sensor_stats_t;
+
+static const char *const sensor_names[SENSOR_COUNT] = { "IMU", "MAG", "BARO" };
+
+static imu_sample_t imu_slots[SENSOR_IMU_RING_LEN];
+static mag_sample_t mag_slots[SENSOR_MAG_RING_LEN];
+static baro_sample_t baro_slots[SENSOR_BARO_RING_LEN];
+static sample_ring_t rings[SENSOR_COUNT];
+static attitude_sample_t att_slots[SENSOR_ATT_RING_LEN];
+static sample_ring_t att_ring;
+
+// Owned by the sensor task
+static sensor_service_config_t svc_cfg;
+static sensor_stats_t stats[SENSOR_COUNT];
+static TaskHandle_t svc_task = NULL;
+
+// Mag and baro reads wait in the I2C scheduler behind IMU drains instead
+// of blocking this task
+static sensors_read_req_t mag_req, baro_req;
+static bool mag_pending = false, baro_pending = false;
+
+static ahrs_t ahrs;
+
+// IMU bias: learned from the raw FIFO samples, subtracted before anything
+// is published. Runs on the sensor task.
+static imu_bias_t imu_bias;
+static bool imu_bias_dirty;
+static int64_t imu_bias_saved_us;
+static float last_imu_temp;
+static float still_mag[3];      // Mag direction at the start of the still stretch
+static bool still_mag_set;
+static mag_sample_t last_mag;   // Newest published mag sample, t_us 0 = none
+
+// Magnetometer calibration: requests come from other tasks, everything
+// else runs on the sensor task
+static mag_cal_t mag_cal;       // Applied to every published sample
+static mag_cal_acc_t mag_acc;
+static int64_t mag_cal_deadline_us;
+static atomic_bool mag_cal_start_req, mag_cal_cancel_req;
+static _Atomic uint8_t mag_cal_state = SENSOR_MAG_CAL_IDLE;
+static _Atomic uint8_t mag_cal_pct;
+
+_Static_assert((SENSOR_IMU_RING_LEN & (SENSOR_IMU_RING_LEN - 1)) == 0, "ring length must be a power of two");
+_Static_assert((SENSOR_MAG_RING_LEN & (SENSOR_MAG_RING_LEN - 1)) == 0, "ring length must be a power of two");
+_Static_assert((SENSOR_BARO_RING_LEN & (SENSOR_BARO_RING_LEN - 1)) == 0, "ring length must be a power of two");
+_Static_assert((SENSOR_ATT_RING_LEN & (SENSOR_ATT_RING_LEN - 1)) == 0, "ring length must be a power of two");
+
+static void mag_cal_load(void) {
+    mag_cal_identity(&mag_cal);
+    nvs_handle_t handle;
+    if (nvs_open(MAG_CAL_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) return;
+
+    mag_cal_t rec;
+    size_t size = sizeof(rec);
+    esp_err_t err = nvs_get_blob(handle, MAG_CAL_NVS_KEY, &rec, &size);
+    nvs_close(handle);
+
+    if (err == ESP_OK && size == sizeof(rec) && mag_cal_valid(&rec)) {
+        mag_cal = rec;
+        ESP_LOGI(TAG, "Mag calibration loaded: offset %.1f %.1f %.1f uT, field %.1f uT",
+                 rec.offset[0], rec.offset[1], rec.offset[2], rec.field_ut);
+    }
+}
+
+static esp_err_t mag_cal_save(const mag_cal_t *cal) {
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(MAG_CAL_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) return err;
+    err = nvs_set_blob(handle, MAG_CAL_NVS_KEY, cal, sizeof(*cal));
+    if (err == ESP_OK) err = nvs_commit(handle);
+    nvs_close(handle);
+    return err;
+}
+
+static void imu_bias_load(void) {
+    static imu_bias_table_t rec;
+    const imu_bias_params_t params = IMU_BIAS_DEFAULT_PARAMS;
+    const imu_bias_table_t *stored = NULL;
+
+    nvs_handle_t handle;
+    if (nvs_open(IMU_BIAS_NVS_NAMESPACE, NVS_READONLY, &handle) == ESP_OK) {
+        size_t size = sizeof(rec);
+        esp_err_t err = nvs_get_blob(handle, IMU_BIAS_NVS_KEY, &rec, &size);
+        nvs_close(handle);
+        if (err == ESP_OK && size == sizeof(rec) && imu_bias_table_valid(&rec)) stored = &rec;
+    }
+    imu_bias_init(&imu_bias, &params, stored);
+    if (stored) ESP_LOGI(TAG, "IMU bias table loaded%s", rec.accel_valid ? " (with accel offset)" : "");
+}
+
+static esp_err_t imu_bias_save(void) {
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(IMU_BIAS_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) return err;
+    err = nvs_set_blob(handle, IMU_BIAS_NVS_KEY, &imu_bias.table, sizeof(imu_bias.table));
+    if (err == ESP_OK) err = nvs_commit(handle);
+    nvs_close(handle);
+    return err;
+}
+
+esp_err_t sensor_service_init(const sensor_service_config_t *cfg) {
+    if (cfg->imu_hz == 0 || cfg->imu_watermark == 0) return ESP_ERR_INVALID_ARG;
+    svc_cfg = *cfg;
+
+    sample_ring_init(&rings[SENSOR_IMU], imu_slots, sizeof(imu_slots[0]), SENSOR_IMU_RING_LEN);
+    sample_ring_init(&rings[SENSOR_MAG], mag_slots, sizeof(mag_slots[0]), SENSOR_MAG_RING_LEN);
+    sample_ring_init(&rings[SENSOR_BARO], baro_slots, sizeof(baro_slots[0]), SENSOR_BARO_RING_LEN);
+    sample_ring_init(&att_ring, att_slots, sizeof(att_slots[0]), SENSOR_ATT_RING_LEN);
+    ahrs_init(&ahrs, AHRS_BETA, AHRS_ACCEL_GATE_G);
+
+    mag_cal_load();
+    imu_bias_load();
+
+    memset(stats, 0, sizeof(stats));
+    stats[SENSOR_IMU].period_us = 1000000 / lsm6dsr_odr_hz(lsm6dsr_odr_code(cfg->imu_hz));
+    stats[SENSOR_MAG].period_us = cfg->mag_hz ? 1000000 / cfg->mag_hz : 0;
+    stats[SENSOR_BARO].period_us = cfg->baro_hz ? 1000000 / cfg->baro_hz : 0;
+    return ESP_OK;
+}
+
+const sample_ring_t *sensor_service_ring(sensor_id_t id) {
+    return &rings[id];
+}
+
+const sample_ring_t *sensor_service_attitude_ring(void) {
+    return &att_ring;
+}
+
+void sensor_service_mag_cal_start(void) {
+    atomic_store(&mag_cal_start_req, true);
+}
+
+void sensor_service_mag_cal_cancel(void) {
+    atomic_store(&mag_cal_cancel_req, true);
+}
+
+sensor_mag_cal_state_t sensor_service_mag_cal_status(uint8_t *progress) {
+    if (progress) *progress = atomic_load(&mag_cal_pct);
+    return (sensor_mag_cal_state_t)atomic_load(&mag_cal_state);
+}
+
+// Interval to the previous sample: whole periods missing count as dropped,
+// the deviation of a regular interval from the nominal period as jitter
+static void account_sample(sensor_id_t id, int64_t t_us) {
+    sensor_stats_t *st = &stats[id];
+    st->samples++;
+    if (st->last_us != 0) {
+        int64_t interval = t_us - st->last_us;
+        int64_t period = st->period_us;
+        if (interval >= period + period / 2) {
+            st->dropped += (uint32_t)((interval + period / 2) / period) - 1;
+        } else {
+            latency_hist_add(&st->jitter, (uint32_t)llabs(interval - period));
+        }
+    }
+    st->last_us = t_us;
+}
+
+static void drain_imu(void) {
+    static imu_sample_t block[IMU_BLOCK_MAX];
+    static attitude_sample_t att[IMU_BLOCK_MAX];
+    int n;
+    do {
+        n = sensors_imu_fifo_read(block, IMU_BLOCK_MAX);
+        if (n < 0) {
+            stats[SENSOR_IMU].errors++;
+            return;
+        }
+
+        for (int i = 0; i < n; i++) {
+            if (imu_bias_feed(&imu_bias, &block[i])) imu_bias_dirty = true;
+        }
+        imu_bias_apply(&imu_bias, block, n);
+        if (n > 0) last_imu_temp = block[0].temp;
+
+        bool mag_fresh = last_mag.t_us != 0 && n > 0 && block[0].t_us - last_mag.t_us < AHRS_MAG_MAX_AGE_US;
+        ahrs_update_block(&ahrs, block, n, mag_fresh ? &last_mag : NULL, att);
+
+        for (int i = 0; i < n; i++) {
+            memcpy(sample_ring_claim(&rings[SENSOR_IMU]), &block[i], sizeof(block[i]));
+            sample_ring_publish(&rings[SENSOR_IMU]);
+            memcpy(sample_ring_claim(&att_ring), &att[i], sizeof(att[i]));
+            sample_ring_publish(&att_ring);
+            account_sample(SENSOR_IMU, block[i].t_us);
+        }
+    } while (n == IMU_BLOCK_MAX);
+}
+
+// Runs on the I2C bus task
+static void read_done_cb(i2c_txn_t *txn, void *arg) {
+    xTaskNotify(svc_task, (uint32_t)(uintptr_t)arg, eSetBits);
+}
+
+// A poll tick that finds the previous read still queued is skipped and
+// shows up as a dropped sample
+static void request_mag(void) {
+    if (mag_pending) return;
+    mag_pending = true;
+    sensors_read_mag_async(&mag_req, read_done_cb, (void *)NOTIFY_MAG_DONE);
+}
+
+static void request_baro(void) {
+    if (baro_pending) return;
+    baro_pending = true;
+    sensors_read_baro_async(&baro_req, read_done_cb, (void *)NOTIFY_BARO_DONE);
+}
+
+// A steady yaw looks still to the IMU; the field turning in device axes
+// during a still stretch gives it away
+static void check_still_heading(const float m[3]) {
+    if (!imu_bias_still(&imu_bias)) {
+        still_mag_set = false;
+        return;
+    }
+    if (!still_mag_set) {
+        memcpy(still_mag, m, sizeof(still_mag));
+        still_mag_set = true;
+        return;
+    }
+    float dot = m[0] * still_mag[0] + m[1] * still_mag[1] + m[2] * still_mag[2];
+    float n2 = (m[0] * m[0] + m[1] * m[1] + m[2] * m[2]) *
+               (still_mag[0] * still_mag[0] + still_mag[1] * still_mag[1] + still_mag[2] * still_mag[2]);
+    if (dot < IMU_BIAS_MAG_VETO_COS * sqrtf(n2)) {
+        imu_bias_veto(&imu_bias);
+        still_mag_set = false;
+    }
+}
+
+// Fold one uncorrected sample into a running calibration; once coverage
+// allows, solve, switch to the result and persist it
+static void mag_cal_step(const float raw[3], int64_t t_us) {
+    if (atomic_exchange(&mag_cal_cancel_req, false)) {
+        if (atomic_load(&mag_cal_state) == SENSOR_MAG_CAL_RUNNING) ESP_LOGI(TAG, "Mag calibration cancelled");
+        atomic_store(&mag_cal_state, SENSOR_MAG_CAL_IDLE);
+    }
+    if (atomic_exchange(&mag_cal_start_req, false)) {
+        mag_cal_acc_init(&mag_acc);
+        mag_cal_deadline_us = t_us + SENSOR_MAG_CAL_TIMEOUT_US;
+        atomic_store(&mag_cal_pct, 0);
+        atomic_store(&mag_cal_state, SENSOR_MAG_CAL_RUNNING);
+    }
+    if (atomic_load(&mag_cal_state) != SENSOR_MAG_CAL_RUNNING) return;
+
+    if (t_us > mag_cal_deadline_us) {
+        ESP_LOGW(TAG, "Mag calibration timed out: %u samples, %u/%u directions", (unsigned)mag_acc.n,
+                 mag_cal_coverage(&mag_acc), MAG_CAL_BINS);
+        atomic_store(&mag_cal_state, SENSOR_MAG_CAL_FAILED);
+        return;
+    }
+    if (!mag_cal_acc_add(&mag_acc, raw)) return;
+
+    uint8_t pct = mag_cal_progress(&mag_acc);
+    mag_cal_t cal;
+    // Stays short of 100 until a solve succeeds: more rotation may fix it
+    if (pct < 100 || !mag_cal_solve(&mag_acc, &cal)) {
+        atomic_store(&mag_cal_pct, pct < 100 ? pct : 99);
+        return;
+    }
+
+    mag_cal = cal;
+    esp_err_t err = mag_cal_save(&cal);
+    if (err != ESP_OK) ESP_LOGE(TAG, "Mag calibration not saved: %s", esp_err_to_name(err));
+    ESP_LOGI(TAG, "Mag calibration: offset %.1f %.1f %.1f uT, field %.1f uT, residual %.1f%%",
+             cal.offset[0], cal.offset[1], cal.offset[2], cal.field_ut, cal.residual * 100.0f);
+    atomic_store(&mag_cal_pct, 100);
+    atomic_store(&mag_cal_state, SENSOR_MAG_CAL_DONE);
+}
+
+// Completed reads are decoded straight into the claimed slot; a failed
+// read leaves it unpublished. The sample time is the start of the transfer.
+static void publish_mag(void) {
+    mag_pending = false;
+    mag_sample_t *s = sample_ring_claim(&rings[SENSOR_MAG]);
+    if (sensors_decode_mag(&mag_req, &s->mx, &s->my, &s->mz, &s->temp) != ESP_OK) {
+        stats[SENSOR_MAG].errors++;
+        return;
+    }
+    s->t_us = mag_req.txn.start_us;
+
+    float m[3] = { s->mx, s->my, s->mz };
+    mag_cal_step(m, s->t_us);
+    mag_cal_apply(&mag_cal, m, m);
+    s->mx = m[0];
+    s->my = m[1];
+    s->mz = m[2];
+    check_still_heading(m);
+    last_mag = *s;
+    sample_ring_publish(&rings[SENSOR_MAG]);
+    account_sample(SENSOR_MAG, s->t_us);
+}
+
+static void publish_baro(void) {
+    baro_pending = false;
+    baro_sample_t *s = sample_ring_claim(&rings[SENSOR_BARO]);
+    if (sensors_decode_baro(&baro_req, &s->pressure, &s->temp) != ESP_OK) {
+        stats[SENSOR_BARO].errors++;
+        return;
+    }
+    s->t_us = baro_req.txn.start_us;
+    sample_ring_publish(&rings[SENSOR_BARO]);
+    account_sample(SENSOR_BARO, s->t_us);
+}
+
+static void poll_timer_cb(void *arg) {
+    xTaskNotify(svc_task, (uint32_t)(uintptr_t)arg, eSetBits);
+}
+
+static esp_err_t start_poll_timer(const char *name, uint32_t bit, uint16_t hz) {
+    esp_timer_handle_t timer;
+    const esp_timer_create_args_t args = {
+        .callback = poll_timer_cb,
+        .arg = (void *)(uintptr_t)bit,
+        .name = name,
+    };
+    esp_err_t ret = esp_timer_create(&args, &timer);
+    if (ret == ESP_OK) ret = esp_timer_start_periodic(timer, 1000000 / hz);
+    if (ret != ESP_OK) ESP_LOGE(TAG, "%s timer failed: %s", name, esp_err_to_name(ret));
+    return ret;
+}
+
+static void log_stats(int64_t elapsed_us) {
+    for (int id = 0; id < SENSOR_COUNT; id++) {
+        sensor_stats_t *st = &stats[id];
+        if (st->period_us == 0) continue;
+        const latency_hist_t *h = &st->jitter;
+        ESP_LOGI(TAG, "%s: %lu samples/s, jitter mean=%luus p99<%luus max=%luus, dropped=%lu errors=%lu",
+                 sensor_names[id], (unsigned long)(st->samples * 1000000LL / elapsed_us),
+                 (unsigned long)latency_hist_mean(h), (unsigned long)latency_hist_percentile(h, 99),
+                 (unsigned long)h->max_us, (unsigned long)st->dropped, (unsigned long)st->errors);
+        st->samples = st->dropped = st->errors = 0;
+        latency_hist_reset(&st->jitter);
+    }
+
+    float g[3], a[3];
+    imu_bias_get(&imu_bias, last_imu_temp, g, a);
+    ESP_LOGI(TAG, "IMU bias @%.1f C: gyro %+.3f %+.3f %+.3f dps, accel %+.3f %+.3f %+.3f g, %s, %lu still windows",
+             last_imu_temp, g[0], g[1], g[2], a[0], a[1], a[2], imu_bias_still(&imu_bias) ? "still" : "moving",
+             (unsigned long)imu_bias.still);
+}
+
+static TickType_t ticks_until(int64_t deadline_us) {
+    int64_t remaining_us = deadline_us - esp_timer_get_time();
+    TickType_t ticks = remaining_us > 0 ? pdMS_TO_TICKS(remaining_us / 1000) : 0;
+    return ticks > 0 ? ticks : 1;
+}
+
+void sensor_task_entry(void *pvParameters) {
+    ESP_LOGI(TAG, "Sensor Task Started");
+    svc_task = xTaskGetCurrentTaskHandle();
+
+    bool imu_on = sensors_imu_fifo_start(svc_cfg.imu_hz, svc_cfg.imu_watermark, svc_task, NOTIFY_IMU) == ESP_OK;
+    if (svc_cfg.mag_hz) {
+        sensors_set_mag_rate(svc_cfg.mag_hz);
+        if (start_poll_timer("mag_poll", NOTIFY_MAG, svc_cfg.mag_hz) != ESP_OK) stats[SENSOR_MAG].period_us = 0;
+    }
+    if (svc_cfg.baro_hz) {
+        if (start_poll_timer("baro_poll", NOTIFY_BARO, svc_cfg.baro_hz) != ESP_OK) stats[SENSOR_BARO].period_us = 0;
+    }
+    if (!imu_on) stats[SENSOR_IMU].period_us = 0;
+
+    // Twice the watermark period: a missed interrupt edge still gets drained,
+    // also while the poll timers keep waking the task
+    const int64_t imu_timeout_us = 2LL * stats[SENSOR_IMU].period_us * svc_cfg.imu_watermark;
+    int64_t imu_deadline_us = esp_timer_get_time() + imu_timeout_us;
+    int64_t stats_us = esp_timer_get_time();
+
+    while (1) {
+        uint32_t bits = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &bits, imu_on ? ticks_until(imu_deadline_us) : portMAX_DELAY);
+        int64_t now = esp_timer_get_time();
+
+        // Queue the slow reads first: the IMU drain overtakes them on the bus
+        if (bits & NOTIFY_MAG) request_mag();
+        if (bits & NOTIFY_BARO) request_baro();
+        if (imu_on && ((bits & NOTIFY_IMU) || now >= imu_deadline_us)) {
+            drain_imu();
+            imu_deadline_us = now + imu_timeout_us;
+        }
+        if (bits & NOTIFY_MAG_DONE) publish_mag();
+        if (bits & NOTIFY_BARO_DONE) publish_baro();
+
+        if (now - stats_us >= STATS_LOG_PERIOD_US) {
+            log_stats(now - stats_us);
+            stats_us = now;
+            // Flash writes are rare and the FIFO covers the stall
+            if (imu_bias_dirty && (imu_bias_saved_us == 0 || now - imu_bias_saved_us >= IMU_BIAS_SAVE_PERIOD_US)) {
+                esp_err_t err = imu_bias_save();
+                if (err != ESP_OK) ESP_LOGE(TAG, "IMU bias not saved: %s", esp_err_to_name(err));
+                imu_bias_dirty = false;
+                imu_bias_saved_us = now;
+            }
+        }
+    }
+}
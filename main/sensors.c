@@ -1,25 +1,78 @@
 #include "sensors.h"
+#include "bmp388_comp.h"
+#include "lsm6dsr_fifo.h"
+#include "i2c_sched.h"
+#include "altitude.h"
+#include "driver/gpio.h"
 #include "driver/i2c_master.h"
 #include "esp_log.h"
-#include <math.h>
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <string.h>
 
 static const char *TAG = "SENSORS";
 
 static i2c_master_bus_handle_t bus_handle = NULL;
-static i2c_master_dev_handle_t imu_handle = NULL;
-static i2c_master_dev_handle_t mag_handle = NULL;
-static i2c_master_dev_handle_t baro_handle = NULL;
 
-// Alpha for Low Pass Filter (Gravity isolation)
-#define ALPHA_GRAVITY 0.2f
-static float g_grav_x = 0.0f, g_grav_y = 0.0f, g_grav_z = 0.0f;
-static bool grav_init = false;
-
-// BMP388 Floating Point Calibration Data
-struct bmp388_calib_float {
-    double T1, T2, T3;
-    double P1, P2, P3, P4, P5, P6, P7, P8, P9, P10, P11;
-} calib_float;
+typedef enum {
+    BUS_DEV_IMU,
+    BUS_DEV_MAG,
+    BUS_DEV_BARO,
+    BUS_DEV_COUNT,
+} bus_dev_t;
+
+static i2c_master_dev_handle_t dev_handles[BUS_DEV_COUNT];
+
+// Scheduling class per device: IMU FIFO drains go first, baro last;
+// within a class the earliest deadline (submission + budget) wins
+static const struct {
+    uint8_t prio;
+    uint32_t budget_us;
+} bus_class[BUS_DEV_COUNT] = {
+    [BUS_DEV_IMU]  = { 0, 1000 },
+    [BUS_DEV_MAG]  = { 1, 5000 },
+    [BUS_DEV_BARO] = { 2, 10000 },
+};
+
+// All transfers run on the bus task, most urgent first
+#define BUS_TASK_PRIO           7       // Above the sensor task
+#define BUS_TASK_STACK          3072
+#define BUS_STATS_PERIOD_US     (10 * 1000 * 1000)
+#define BUS_MAX_WRITE           8
+
+static i2c_sched_t bus_sched;
+static portMUX_TYPE bus_lock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t bus_task_handle = NULL;
+
+// LSM6DSR sensitivities: FS_XL = +-4 g, FS_G = 500 dps
+#define IMU_ACC_G_PER_LSB       (0.122f / 1000.0f)
+#define IMU_GYRO_DPS_PER_LSB    (17.5f / 1000.0f)
+#define IMU_FS_XL_4G            0x08
+#define IMU_FS_G_500DPS         0x04
+
+// FIFO words per burst read
+#define IMU_FIFO_CHUNK_WORDS    64
+
+// Bounded so that a device holding the bus cannot stall its caller forever
+#define I2C_TIMEOUT_MS          SENSOR_I2C_TIMEOUT_MS
+
+// LIS2MDL CFG_REG_A: temperature compensation, continuous mode
+#define MAG_CFG_A_COMP_TEMP     0x80
+
+static TaskHandle_t imu_fifo_task = NULL;
+static uint32_t imu_fifo_bits = 0;
+static bool imu_fifo_isr_added = false;
+static lsm6dsr_fifo_decoder_t imu_fifo_dec;
+static uint8_t imu_fifo_buf[IMU_FIFO_CHUNK_WORDS * LSM6DSR_FIFO_WORD_LEN];
+static uint32_t imu_ts_last = 0;
+static int64_t imu_ts_wraps = 0;
+
+// BMP388 Calibration Data
+static bmp388_calib_t baro_calib;
+#if !BMP388_INTEGER_COMPENSATION
+static bmp388_calib_double_t baro_calib_double;
+#endif
 
 static esp_err_t i2c_bus_init(void) {
     i2c_master_bus_config_t i2c_mst_config = {
@@ -42,56 +95,137 @@ static esp_err_t i2c_register_device(uint8_t addr, i2c_master_dev_handle_t *hand
     return i2c_master_bus_add_device(bus_handle, &dev_cfg, handle);
 }
 
-static esp_err_t read_register(i2c_master_dev_handle_t handle, uint8_t reg, uint8_t *data) {
-    return i2c_master_transmit_receive(handle, &reg, 1, data, 1, -1);
+// i2c_bus_ops_t, called from the bus task only
+static int bus_transfer(void *ctx, uint8_t dev, uint8_t reg, bool write, uint8_t *data, size_t len, uint32_t timeout_us) {
+    int timeout_ms = (int)((timeout_us + 999) / 1000);
+    esp_err_t err;
+    if (write) {
+        uint8_t buf[1 + BUS_MAX_WRITE];
+        if (len > BUS_MAX_WRITE) return I2C_TXN_ERROR;
+        buf[0] = reg;
+        memcpy(buf + 1, data, len);
+        err = i2c_master_transmit(dev_handles[dev], buf, len + 1, timeout_ms);
+    } else {
+        err = i2c_master_transmit_receive(dev_handles[dev], &reg, 1, data, len, timeout_ms);
+    }
+    if (err == ESP_OK) return I2C_TXN_OK;
+    return err == ESP_ERR_TIMEOUT ? I2C_TXN_TIMEOUT : I2C_TXN_ERROR;
+}
+
+static void bus_recover(void *ctx) {
+    ESP_LOGW(TAG, "I2C timeout, resetting bus");
+    i2c_master_bus_reset(bus_handle);
+}
+
+static int64_t bus_now(void *ctx) {
+    return esp_timer_get_time();
+}
+
+static const i2c_bus_ops_t bus_ops = {
+    .transfer = bus_transfer,
+    .recover = bus_recover,
+    .now_us = bus_now,
+};
+
+static void log_bus_stats(int64_t elapsed_us) {
+    i2c_sched_stats_t *st = &bus_sched.stats;
+    const latency_hist_t *h = &st->queue_delay;
+    uint32_t permille = (uint32_t)(st->busy_us * 1000 / elapsed_us);
+    ESP_LOGI(TAG, "I2C: busy %lu.%lu%%, %lu transfers (%lu merged), queue delay mean=%luus p99<%luus max=%luus, "
+             "late=%lu errors=%lu timeouts=%lu",
+             (unsigned long)(permille / 10), (unsigned long)(permille % 10), (unsigned long)st->transfers,
+             (unsigned long)st->merged, (unsigned long)latency_hist_mean(h),
+             (unsigned long)latency_hist_percentile(h, 99), (unsigned long)h->max_us, (unsigned long)st->late,
+             (unsigned long)st->errors, (unsigned long)st->timeouts);
+    memset(st, 0, sizeof(*st));
+}
+
+static void bus_task(void *pvParameters) {
+    int64_t stats_us = esp_timer_get_time();
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(BUS_STATS_PERIOD_US / 1000));
+        while (1) {
+            portENTER_CRITICAL(&bus_lock);
+            i2c_txn_t *batch = i2c_sched_pop(&bus_sched);
+            portEXIT_CRITICAL(&bus_lock);
+            if (!batch) break;
+            i2c_sched_execute(&bus_sched, batch);
+        }
+
+        int64_t now = esp_timer_get_time();
+        if (now - stats_us >= BUS_STATS_PERIOD_US) {
+            log_bus_stats(now - stats_us);
+            stats_us = now;
+        }
+    }
+}
+
+static void bus_submit(i2c_txn_t *txn, bus_dev_t dev, uint8_t reg, uint8_t flags, uint8_t *data, size_t len,
+                       i2c_txn_done_t done, void *arg) {
+    int64_t now = esp_timer_get_time();
+    txn->dev = dev;
+    txn->reg = reg;
+    txn->flags = flags;
+    txn->prio = bus_class[dev].prio;
+    txn->len = len;
+    txn->data = data;
+    txn->deadline_us = now + bus_class[dev].budget_us;
+    txn->timeout_us = I2C_TIMEOUT_MS * 1000;
+    txn->done = done;
+    txn->arg = arg;
+
+    portENTER_CRITICAL(&bus_lock);
+    i2c_sched_submit(&bus_sched, txn, now);
+    portEXIT_CRITICAL(&bus_lock);
+    xTaskNotifyGive(bus_task_handle);
+}
+
+static esp_err_t txn_result(const i2c_txn_t *txn) {
+    switch (txn->status) {
+    case I2C_TXN_OK: return ESP_OK;
+    case I2C_TXN_TIMEOUT: return ESP_ERR_TIMEOUT;
+    default: return ESP_FAIL;
+    }
+}
+
+static void bus_sync_done(i2c_txn_t *txn, void *arg) {
+    xSemaphoreGive((SemaphoreHandle_t)arg);
 }
 
-static esp_err_t read_registers(i2c_master_dev_handle_t handle, uint8_t reg, uint8_t *data, size_t len) {
-    return i2c_master_transmit_receive(handle, &reg, 1, data, len, -1);
+// Blocking transfer through the scheduler. The wait itself is unbounded,
+// the bus task bounds every transfer by its timeout.
+static esp_err_t bus_xfer(bus_dev_t dev, uint8_t reg, uint8_t flags, uint8_t *data, size_t len) {
+    StaticSemaphore_t done_buf;
+    SemaphoreHandle_t done = xSemaphoreCreateBinaryStatic(&done_buf);
+    i2c_txn_t txn;
+    bus_submit(&txn, dev, reg, flags, data, len, bus_sync_done, done);
+    xSemaphoreTake(done, portMAX_DELAY);
+    vSemaphoreDelete(done);
+    return txn_result(&txn);
 }
 
-static esp_err_t write_register(i2c_master_dev_handle_t handle, uint8_t reg, uint8_t data) {
-    uint8_t write_buf[2] = {reg, data};
-    return i2c_master_transmit(handle, write_buf, sizeof(write_buf), -1);
+static esp_err_t read_register(bus_dev_t dev, uint8_t reg, uint8_t *data) {
+    return bus_xfer(dev, reg, 0, data, 1);
+}
+
+static esp_err_t read_registers(bus_dev_t dev, uint8_t reg, uint8_t *data, size_t len) {
+    return bus_xfer(dev, reg, 0, data, len);
+}
+
+static esp_err_t write_register(bus_dev_t dev, uint8_t reg, uint8_t data) {
+    return bus_xfer(dev, reg, I2C_TXN_WRITE, &data, 1);
 }
 
 static void bmp388_read_calib_data(void) {
-    uint8_t data[21];
-    if (read_registers(baro_handle, 0x31, data, 21) == ESP_OK) {
-        // Read raw integer coeffs
-        uint16_t t1 = (data[1] << 8) | data[0];
-        uint16_t t2 = (data[3] << 8) | data[2];
-        int8_t   t3 = data[4];
-        int16_t  p1 = (data[6] << 8) | data[5];
-        int16_t  p2 = (data[8] << 8) | data[7];
-        int8_t   p3 = data[9];
-        int8_t   p4 = data[10];
-        uint16_t p5 = (data[12] << 8) | data[11];
-        uint16_t p6 = (data[14] << 8) | data[13];
-        int8_t   p7 = data[15];
-        int8_t   p8 = data[16];
-        int16_t  p9 = (data[18] << 8) | data[17];
-        int8_t   p10 = data[19];
-        int8_t   p11 = data[20];
-
-        // Convert to floating point with scaling factors (Bosch Datasheet)
-        calib_float.T1 = (double)t1 / 0.00390625f; // 2^-8
-        calib_float.T2 = (double)t2 / 1073741824.0f; // 2^30
-        calib_float.T3 = (double)t3 / 281474976710656.0f; // 2^48
-
-        calib_float.P1 = (double)(p1 - 16384) / 1048576.0f; // (P1-2^14)/2^20
-        calib_float.P2 = (double)(p2 - 16384) / 536870912.0f; // (P2-2^14)/2^29
-        calib_float.P3 = (double)p3 / 4294967296.0f; // 2^32
-        calib_float.P4 = (double)p4 / 137438953472.0f; // 2^37
-        calib_float.P5 = (double)p5 / 0.125f; // 2^-3
-        calib_float.P6 = (double)p6 / 64.0f; // 2^6
-        calib_float.P7 = (double)p7 / 256.0f; // 2^8
-        calib_float.P8 = (double)p8 / 32768.0f; // 2^15
-        calib_float.P9 = (double)p9 / 281474976710656.0f; // 2^48
-        calib_float.P10 = (double)p10 / 281474976710656.0f; // 2^48
-        calib_float.P11 = (double)p11 / 36893488147419103232.0f; // 2^65
-
-        ESP_LOGI(TAG, "BMP388 Calibration Loaded (Float)");
+    uint8_t data[BMP388_CALIB_LEN];
+    if (read_registers(BUS_DEV_BARO, BMP388_CALIB_REG, data, BMP388_CALIB_LEN) == ESP_OK) {
+        bmp388_calib_parse(data, &baro_calib);
+#if BMP388_INTEGER_COMPENSATION
+        ESP_LOGI(TAG, "BMP388 Calibration Loaded (Integer)");
+#else
+        bmp388_calib_to_double(&baro_calib, &baro_calib_double);
+        ESP_LOGI(TAG, "BMP388 Calibration Loaded (Double)");
+#endif
     } else {
         ESP_LOGE(TAG, "Failed to read BMP388 Calibration");
     }
@@ -100,21 +234,25 @@ static void bmp388_read_calib_data(void) {
 esp_err_t sensors_init(void) {
     ESP_LOGI(TAG, "Initializing I2C Sensors (New Driver)...");
     ESP_ERROR_CHECK(i2c_bus_init());
+    i2c_sched_init(&bus_sched, &bus_ops, NULL);
+    if (xTaskCreate(bus_task, "i2c_bus", BUS_TASK_STACK, NULL, BUS_TASK_PRIO, &bus_task_handle) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
 
-    ESP_ERROR_CHECK(i2c_register_device(IMU_I2C_ADDR, &imu_handle));
-    ESP_ERROR_CHECK(i2c_register_device(MAG_I2C_ADDR, &mag_handle));
-    ESP_ERROR_CHECK(i2c_register_device(BARO_I2C_ADDR, &baro_handle));
+    ESP_ERROR_CHECK(i2c_register_device(IMU_I2C_ADDR, &dev_handles[BUS_DEV_IMU]));
+    ESP_ERROR_CHECK(i2c_register_device(MAG_I2C_ADDR, &dev_handles[BUS_DEV_MAG]));
+    ESP_ERROR_CHECK(i2c_register_device(BARO_I2C_ADDR, &dev_handles[BUS_DEV_BARO]));
 
     // IMU: LSM6DSR
-    write_register(imu_handle, 0x10, 0x38);
-    write_register(imu_handle, 0x11, 0x34);
+    write_register(BUS_DEV_IMU, 0x10, 0x38);
+    write_register(BUS_DEV_IMU, 0x11, 0x34);
 
     // Mag: LIS2MDL
-    write_register(mag_handle, 0x60, 0x80);
-    write_register(mag_handle, 0x62, 0x10);
+    write_register(BUS_DEV_MAG, 0x60, MAG_CFG_A_COMP_TEMP);
+    write_register(BUS_DEV_MAG, 0x62, 0x10);
 
     // Baro: BMP388
-    write_register(baro_handle, 0x1B, 0x33);
+    write_register(BUS_DEV_BARO, 0x1B, 0x33);
 
     if (sensors_check_imu()) ESP_LOGI(TAG, "IMU detected.");
     else ESP_LOGE(TAG, "IMU not found!");
@@ -132,57 +270,179 @@ esp_err_t sensors_init(void) {
 
 bool sensors_check_imu(void) {
     uint8_t who_am_i = 0;
-    esp_err_t ret = read_register(imu_handle, 0x0F, &who_am_i);
+    esp_err_t ret = read_register(BUS_DEV_IMU, 0x0F, &who_am_i);
     return (ret == ESP_OK && who_am_i == LSM6DSR_WHO_AM_I_VAL);
 }
 
 bool sensors_check_mag(void) {
     uint8_t who_am_i = 0;
-    esp_err_t ret = read_register(mag_handle, 0x4F, &who_am_i);
+    esp_err_t ret = read_register(BUS_DEV_MAG, 0x4F, &who_am_i);
     return (ret == ESP_OK && who_am_i == LIS2MDL_WHO_AM_I_VAL);
 }
 
 bool sensors_check_baro(void) {
     uint8_t who_am_i = 0;
-    esp_err_t ret = read_register(baro_handle, 0x00, &who_am_i);
+    esp_err_t ret = read_register(BUS_DEV_BARO, 0x00, &who_am_i);
     return (ret == ESP_OK && who_am_i == BMP388_WHO_AM_I_VAL);
 }
 
+// Board orientation: sensor X and Z point opposite to the device axes
+static void imu_map_axes(const int16_t acc[3], const int16_t gyro[3],
+                         float *ax, float *ay, float *az, float *gx, float *gy, float *gz) {
+    *ax = acc[0] * IMU_ACC_G_PER_LSB * -1.0f;
+    *ay = acc[1] * IMU_ACC_G_PER_LSB;
+    *az = acc[2] * IMU_ACC_G_PER_LSB * -1.0f;
+
+    *gx = gyro[0] * IMU_GYRO_DPS_PER_LSB * -1.0f;
+    *gy = gyro[1] * IMU_GYRO_DPS_PER_LSB;
+    *gz = gyro[2] * IMU_GYRO_DPS_PER_LSB * -1.0f;
+}
+
 esp_err_t sensors_read_imu(float *ax, float *ay, float *az, float *gx, float *gy, float *gz, float *temp) {
     uint8_t raw[14];
-    esp_err_t ret = read_registers(imu_handle, 0x20, raw, 14);
+    esp_err_t ret = read_registers(BUS_DEV_IMU, 0x20, raw, 14);
     if (ret != ESP_OK) return ret;
 
     int16_t t_raw = (int16_t)(raw[1] << 8 | raw[0]);
-    int16_t g_x = (int16_t)(raw[3] << 8 | raw[2]);
-    int16_t g_y = (int16_t)(raw[5] << 8 | raw[4]);
-    int16_t g_z = (int16_t)(raw[7] << 8 | raw[6]);
-    int16_t a_x = (int16_t)(raw[9] << 8 | raw[8]);
-    int16_t a_y = (int16_t)(raw[11] << 8 | raw[10]);
-    int16_t a_z = (int16_t)(raw[13] << 8 | raw[12]);
-
-    float sensitivity_a = 0.122f / 1000.0f;
-    float sensitivity_g = 17.5f / 1000.0f;
-
-    *ax = a_x * sensitivity_a * -1.0f;
-    *ay = a_y * sensitivity_a;
-    *az = a_z * sensitivity_a * -1.0f;
+    int16_t gyro[3] = {
+        (int16_t)(raw[3] << 8 | raw[2]),
+        (int16_t)(raw[5] << 8 | raw[4]),
+        (int16_t)(raw[7] << 8 | raw[6]),
+    };
+    int16_t acc[3] = {
+        (int16_t)(raw[9] << 8 | raw[8]),
+        (int16_t)(raw[11] << 8 | raw[10]),
+        (int16_t)(raw[13] << 8 | raw[12]),
+    };
 
-    *gx = g_x * sensitivity_g * -1.0f;
-    *gy = g_y * sensitivity_g;
-    *gz = g_z * sensitivity_g * -1.0f;
+    imu_map_axes(acc, gyro, ax, ay, az, gx, gy, gz);
 
     *temp = (t_raw / 256.0f) + 25.0f;
 
     return ESP_OK;
 }
 
-esp_err_t sensors_read_mag(float *mx, float *my, float *mz, float *temp) {
-    uint8_t raw[8];
-    // Read 8 bytes starting from OUTX_L_REG (0x68) to include TEMP_OUT_L_REG (0x6E) and TEMP_OUT_H_REG (0x6F)
-    esp_err_t ret = read_registers(mag_handle, 0x68, raw, 8);
-    if (ret != ESP_OK) return ret;
+static void IRAM_ATTR imu_fifo_isr(void *arg) {
+    BaseType_t woken = pdFALSE;
+    xTaskNotifyFromISR(imu_fifo_task, imu_fifo_bits, eSetBits, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+esp_err_t sensors_imu_fifo_start(uint16_t odr_hz, uint16_t watermark, TaskHandle_t task, uint32_t notify_bits) {
+    uint8_t odr = lsm6dsr_odr_code(odr_hz);
+    uint16_t wtm = watermark * 3;   // Words: gyro + accel + timestamp per set
+    if (wtm == 0 || wtm > LSM6DSR_FIFO_WORDS / 2) return ESP_ERR_INVALID_ARG;
+
+    imu_fifo_task = task;
+    imu_fifo_bits = notify_bits;
+
+    if (!imu_fifo_isr_added) {
+        gpio_config_t int_conf = {
+            .pin_bit_mask = (1ULL << IMU_INT_PIN),
+            .mode = GPIO_MODE_INPUT,
+            .pull_up_en = GPIO_PULLUP_DISABLE,
+            .pull_down_en = GPIO_PULLDOWN_DISABLE,
+            .intr_type = GPIO_INTR_POSEDGE,
+        };
+        gpio_config(&int_conf);
+        // Already installed by another driver is fine
+        esp_err_t err = gpio_install_isr_service(0);
+        if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) return err;
+        gpio_isr_handler_add(IMU_INT_PIN, imu_fifo_isr, NULL);
+        imu_fifo_isr_added = true;
+    }
+
+    lsm6dsr_fifo_decoder_init(&imu_fifo_dec);
+    imu_ts_last = 0;
+    imu_ts_wraps = 0;
+
+    // Bypass mode empties the FIFO before the new configuration
+    esp_err_t ret = write_register(BUS_DEV_IMU, LSM6DSR_REG_FIFO_CTRL4, LSM6DSR_FIFO_MODE_BYPASS);
+    if (ret == ESP_OK) ret = write_register(BUS_DEV_IMU, LSM6DSR_REG_CTRL1_XL, (odr << 4) | IMU_FS_XL_4G);
+    if (ret == ESP_OK) ret = write_register(BUS_DEV_IMU, LSM6DSR_REG_CTRL2_G, (odr << 4) | IMU_FS_G_500DPS);
+    if (ret == ESP_OK) ret = write_register(BUS_DEV_IMU, LSM6DSR_REG_CTRL10_C, LSM6DSR_TIMESTAMP_EN);
+    if (ret == ESP_OK) ret = write_register(BUS_DEV_IMU, LSM6DSR_REG_FIFO_CTRL1, wtm & 0xFF);
+    if (ret == ESP_OK) ret = write_register(BUS_DEV_IMU, LSM6DSR_REG_FIFO_CTRL2, (wtm >> 8) & 0x01);
+    if (ret == ESP_OK) ret = write_register(BUS_DEV_IMU, LSM6DSR_REG_FIFO_CTRL3, (odr << 4) | odr);
+    if (ret == ESP_OK) ret = write_register(BUS_DEV_IMU, LSM6DSR_REG_INT1_CTRL, LSM6DSR_INT1_FIFO_TH);
+    if (ret == ESP_OK) ret = write_register(BUS_DEV_IMU, LSM6DSR_REG_FIFO_CTRL4,
+                                            LSM6DSR_FIFO_DEC_TS_1 | LSM6DSR_FIFO_MODE_CONTINUOUS);
+
+    if (ret == ESP_OK) ESP_LOGI(TAG, "IMU FIFO: %u Hz, watermark %u samples", odr_hz, watermark);
+    else ESP_LOGE(TAG, "IMU FIFO setup failed: %s", esp_err_to_name(ret));
+    return ret;
+}
+
+int sensors_imu_fifo_read(imu_sample_t *out, int max) {
+    uint8_t status[2];
+    // Every sample in the FIFO was taken before this instant
+    int64_t t_status = esp_timer_get_time();
+    if (read_registers(BUS_DEV_IMU, LSM6DSR_REG_FIFO_STATUS1, status, 2) != ESP_OK) return -1;
+    if (status[1] & LSM6DSR_FIFO_STATUS2_OVR) ESP_LOGW(TAG, "IMU FIFO overrun");
+
+    // Each set needs at least two words: never read more than fits in out
+    size_t queued = ((status[1] & 0x03) << 8) | status[0];
+    size_t words = queued;
+    if (words > (size_t)max * 2) words = (size_t)max * 2;
+    size_t left = queued - words;
+
+    // Temperature stays out of the FIFO: one reading per block is plenty
+    uint8_t t_raw[2];
+    float temp = 0.0f;
+    if (read_registers(BUS_DEV_IMU, 0x20, t_raw, 2) == ESP_OK) {
+        temp = (int16_t)(t_raw[1] << 8 | t_raw[0]) / 256.0f + 25.0f;
+    }
+
+    lsm6dsr_fifo_sample_t raw[IMU_FIFO_CHUNK_WORDS / 2];
+    int count = 0;
+    while (words > 0) {
+        size_t n = words < IMU_FIFO_CHUNK_WORDS ? words : IMU_FIFO_CHUNK_WORDS;
+        if (bus_xfer(BUS_DEV_IMU, LSM6DSR_REG_FIFO_DATA_OUT, I2C_TXN_NO_MERGE, imu_fifo_buf,
+                     n * LSM6DSR_FIFO_WORD_LEN) != ESP_OK) {
+            if (count == 0) return -1;
+            left += words;
+            break;
+        }
+        words -= n;
+
+        size_t k = lsm6dsr_fifo_decode(&imu_fifo_dec, imu_fifo_buf, n, raw, sizeof(raw) / sizeof(raw[0]), NULL);
+        for (size_t i = 0; i < k; i++) {
+            imu_sample_t *s = &out[count++];
+            if (raw[i].timestamp < imu_ts_last) imu_ts_wraps++;
+            imu_ts_last = raw[i].timestamp;
+            s->t_us = ((imu_ts_wraps << 32) + raw[i].timestamp) * LSM6DSR_TS_US_PER_TICK;
+            imu_map_axes(raw[i].acc, raw[i].gyro, &s->ax, &s->ay, &s->az, &s->gx, &s->gy, &s->gz);
+            s->temp = temp;
+        }
+    }
+
+    // Move the block to esp_timer time: its newest sample is pinned just
+    // before the status read, minus the sets still waiting in the FIFO
+    // (three words each). Spacing inside the block stays the IMU's own.
+    if (count > 0) {
+        int64_t newest = out[count - 1].t_us;
+        int64_t interval = count > 1 ? (newest - out[0].t_us) / (count - 1) : 0;
+        int64_t offset = t_status - newest - (int64_t)(left / 3) * interval;
+        for (int i = 0; i < count; i++) {
+            out[i].t_us += offset;
+        }
+    }
+    return count;
+}
+
+esp_err_t sensors_set_mag_rate(uint16_t hz) {
+    // CFG_REG_A ODR: 10 / 20 / 50 / 100 Hz, rounded up
+    uint8_t odr = hz <= 10 ? 0 : hz <= 20 ? 1 : hz <= 50 ? 2 : 3;
+    return write_register(BUS_DEV_MAG, 0x60, MAG_CFG_A_COMP_TEMP | (odr << 2));
+}
 
+// Read 8 bytes starting from OUTX_L_REG (0x68) to include TEMP_OUT_L_REG (0x6E) and TEMP_OUT_H_REG (0x6F)
+#define MAG_DATA_REG    0x68
+#define MAG_DATA_LEN    8
+#define BARO_DATA_REG   0x04
+#define BARO_DATA_LEN   6
+
+static void mag_convert(const uint8_t *raw, float *mx, float *my, float *mz, float *temp) {
     int16_t m_x = (int16_t)(raw[1] << 8 | raw[0]);
     int16_t m_y = (int16_t)(raw[3] << 8 | raw[2]);
     int16_t m_z = (int16_t)(raw[5] << 8 | raw[4]);
@@ -195,97 +455,68 @@ esp_err_t sensors_read_mag(float *mx, float *my, float *mz, float *temp) {
     *mz = m_z * sensitivity * -1.0f;
 
     *temp = (t_raw / 8.0f) + 25.0f;
-
-    return ESP_OK;
 }
 
-// BMP388 Compensate Float Implementation
-static float bmp388_compensate_temp(uint32_t uncomp_temp) {
-    double partial_data1;
-    double partial_data2;
-
-    partial_data1 = (double)(uncomp_temp - calib_float.T1);
-    partial_data2 = (double)(partial_data1 * calib_float.T2);
-
-    return (float)(partial_data2 + (partial_data1 * partial_data1) * calib_float.T3);
-}
-
-static float bmp388_compensate_press(uint32_t uncomp_press, float t_lin) {
-    double partial_data1;
-    double partial_data2;
-    double partial_data3;
-    double partial_data4;
-    double partial_out1;
-    double partial_out2;
+static void baro_convert(const uint8_t *raw, float *pressure, float *temp) {
+    uint32_t p_raw = (raw[2] << 16) | (raw[1] << 8) | raw[0];
+    uint32_t t_raw = (raw[5] << 16) | (raw[4] << 8) | raw[3];
 
-    partial_data1 = calib_float.P6 * t_lin;
-    partial_data2 = calib_float.P7 * (t_lin * t_lin);
-    partial_data3 = calib_float.P8 * (t_lin * t_lin * t_lin);
-    partial_out1 = calib_float.P5 + partial_data1 + partial_data2 + partial_data3;
+#if BMP388_INTEGER_COMPENSATION
+    int32_t t_cdeg;
+    uint32_t p_cpa;
+    bmp388_compensate_int(&baro_calib, p_raw, t_raw, &t_cdeg, &p_cpa);
 
-    partial_data1 = calib_float.P2 * t_lin;
-    partial_data2 = calib_float.P3 * (t_lin * t_lin);
-    partial_data3 = calib_float.P4 * (t_lin * t_lin * t_lin);
-    partial_out2 = (double)uncomp_press * (calib_float.P1 + partial_data1 + partial_data2 + partial_data3);
+    *temp = t_cdeg / 100.0f;
+    *pressure = p_cpa / 10000.0f; // 0.01 Pa -> hPa
+#else
+    double t_comp, p_comp;
+    bmp388_compensate_double(&baro_calib_double, p_raw, t_raw, &t_comp, &p_comp);
 
-    partial_data1 = (double)uncomp_press * (double)uncomp_press;
-    partial_data2 = calib_float.P9 + calib_float.P10 * t_lin;
-    partial_data3 = partial_data1 * partial_data2;
-    partial_data4 = partial_data3 + (double)uncomp_press * (double)uncomp_press * (double)uncomp_press * calib_float.P11;
+    *temp = (float)t_comp;
+    *pressure = (float)(p_comp / 100.0); // Pa -> hPa
+#endif
+}
 
-    return (float)(partial_out1 + partial_out2 + partial_data4);
+esp_err_t sensors_read_mag(float *mx, float *my, float *mz, float *temp) {
+    uint8_t raw[MAG_DATA_LEN];
+    esp_err_t ret = read_registers(BUS_DEV_MAG, MAG_DATA_REG, raw, MAG_DATA_LEN);
+    if (ret != ESP_OK) return ret;
+    mag_convert(raw, mx, my, mz, temp);
+    return ESP_OK;
 }
 
 esp_err_t sensors_read_baro(float *pressure, float *temp) {
-    uint8_t raw[6];
-    esp_err_t ret = read_registers(baro_handle, 0x04, raw, 6);
+    uint8_t raw[BARO_DATA_LEN];
+    esp_err_t ret = read_registers(BUS_DEV_BARO, BARO_DATA_REG, raw, BARO_DATA_LEN);
     if (ret != ESP_OK) return ret;
-
-    uint32_t p_raw = (raw[2] << 16) | (raw[1] << 8) | raw[0];
-    uint32_t t_raw = (raw[5] << 16) | (raw[4] << 8) | raw[3];
-
-    float t_lin = bmp388_compensate_temp(t_raw);
-    float p_comp = bmp388_compensate_press(p_raw, t_lin);
-
-    *temp = t_lin;
-    *pressure = p_comp / 100.0f; // Pa -> hPa
-
+    baro_convert(raw, pressure, temp);
     return ESP_OK;
 }
 
-// Derived Calculations
-
-void sensors_calc_gravity_linear(float ax, float ay, float az, float *grav_x, float *grav_y, float *grav_z, float *lin_x, float *lin_y, float *lin_z) {
-    if (!grav_init) {
-        g_grav_x = ax;
-        g_grav_y = ay;
-        g_grav_z = az;
-        grav_init = true;
-    } else {
-        g_grav_x = ALPHA_GRAVITY * ax + (1.0f - ALPHA_GRAVITY) * g_grav_x;
-        g_grav_y = ALPHA_GRAVITY * ay + (1.0f - ALPHA_GRAVITY) * g_grav_y;
-        g_grav_z = ALPHA_GRAVITY * az + (1.0f - ALPHA_GRAVITY) * g_grav_z;
-    }
+void sensors_read_mag_async(sensors_read_req_t *req, i2c_txn_done_t done, void *arg) {
+    bus_submit(&req->txn, BUS_DEV_MAG, MAG_DATA_REG, 0, req->raw, MAG_DATA_LEN, done, arg);
+}
 
-    *grav_x = g_grav_x;
-    *grav_y = g_grav_y;
-    *grav_z = g_grav_z;
+void sensors_read_baro_async(sensors_read_req_t *req, i2c_txn_done_t done, void *arg) {
+    bus_submit(&req->txn, BUS_DEV_BARO, BARO_DATA_REG, 0, req->raw, BARO_DATA_LEN, done, arg);
+}
 
-    *lin_x = ax - g_grav_x;
-    *lin_y = ay - g_grav_y;
-    *lin_z = az - g_grav_z;
+esp_err_t sensors_decode_mag(const sensors_read_req_t *req, float *mx, float *my, float *mz, float *temp) {
+    esp_err_t ret = txn_result(&req->txn);
+    if (ret == ESP_OK) mag_convert(req->raw, mx, my, mz, temp);
+    return ret;
 }
 
-float sensors_calc_heading(float mx, float my) {
-    // Simple Atan2 heading (requires tilt compensation for accuracy, but basic here)
-    float heading = atan2f(my, mx) * 180.0f / M_PI;
-    if (heading < 0) heading += 360.0f;
-    return heading;
+esp_err_t sensors_decode_baro(const sensors_read_req_t *req, float *pressure, float *temp) {
+    esp_err_t ret = txn_result(&req->txn);
+    if (ret == ESP_OK) baro_convert(req->raw, pressure, temp);
+    return ret;
 }
 
+// Derived Calculations
+
 float sensors_calc_altitude(float pressure_hpa, float temp_c) {
-    // Hypsometric formula
-    // h = ((P0/P)^(1/5.257) - 1) * (T + 273.15) / 0.0065
-    const float P0 = 1013.25f;
-    return 44330.0f * (1.0f - powf(pressure_hpa / P0, 0.1903f));
+    // Hypsometric formula, h = ((P0/P)^(1/5.257) - 1) * (T + 273.15) / 0.0065,
+    // from the table kernel
+    return altitude_from_pressure(pressure_hpa, temp_c);
 }
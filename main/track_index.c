@@ -0,0 +1,297 @@
+#include "track_index.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "track_log.h"
+
+#define REC_LEN         ((uint32_t)sizeof(track_index_rec_t))
+#define REC_CRC_LEN     (REC_LEN - 4)
+
+void track_summary_begin(track_summary_t *s, const char *name) {
+    static const ride_stats_params_t params = RIDE_STATS_DEFAULT_PARAMS;
+    memset(s, 0, sizeof(*s));
+    size_t n = strlen(name);
+    if (n > TRACK_INDEX_NAME_LEN - 1) n = TRACK_INDEX_NAME_LEN - 1;
+    memcpy(s->rec.name, name, n);
+    ride_stats_init(&s->ride, &params, NULL);
+}
+
+void track_summary_point(track_summary_t *s, int64_t t_us, const gpx_point_t *p) {
+    track_index_rec_t *r = &s->rec;
+    if (r->points++ == 0) {
+        s->first_us = t_us;
+        r->lat_min = r->lat_max = p->lat;
+        r->lon_min = r->lon_max = p->lon;
+    }
+    s->last_us = t_us;
+    if (!r->start_s && p->year) r->start_s = (uint32_t)(track_point_utc_ms(p) / 1000);
+
+    if (p->lat < r->lat_min) r->lat_min = p->lat;
+    if (p->lat > r->lat_max) r->lat_max = p->lat;
+    if (p->lon < r->lon_min) r->lon_min = p->lon;
+    if (p->lon > r->lon_max) r->lon_max = p->lon;
+
+    ride_stats_fix(&s->ride, t_us, p->lat, p->lon, p->speed_mmps * 1e-3f);
+    ride_stats_alt(&s->ride, t_us, p->ele_mm * 1e-3f);
+}
+
+void track_summary_pbox(track_summary_t *s, uint8_t interval, float time_s) {
+    if (interval >= PBOX_MAX_INTERVALS || !(time_s > 0.0f)) return;
+    uint32_t ms = (uint32_t)(time_s * 1000.0f + 0.5f);
+    uint32_t *best = &s->rec.pbox_ms[interval];
+    if (*best == 0 || ms < *best) *best = ms;
+}
+
+const track_index_rec_t *track_summary_end(track_summary_t *s, uint32_t file_len) {
+    track_index_rec_t *r = &s->rec;
+    ride_stats_summary_t sum;
+    ride_stats_summary(&s->ride, &sum);
+    r->duration_s = (uint32_t)((s->last_us - s->first_us) / 1000000);
+    r->distance_m = (uint32_t)(sum.distance_m + 0.5f);
+    r->max_speed_mmps = (uint32_t)(sum.max_speed * 1000.0f + 0.5f);
+    r->gain_m = (uint32_t)sum.gain_m;
+    r->file_len = file_len;
+    r->crc = track_crc32(0, r, REC_CRC_LEN);
+    return r;
+}
+
+static bool pread_all(int fd, void *buf, uint32_t len, uint32_t off) {
+    return pread(fd, buf, len, (off_t)off) == (ssize_t)len;
+}
+
+int track_summary_file(track_summary_t *s, const char *path, const char *name) {
+    track_summary_begin(s, name);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+
+    uint8_t *buf = malloc(CHUNK_WRITER_CHUNK);
+    track_header_t h;
+    struct stat st;
+    int ret = -1;
+    if (buf && fstat(fd, &st) == 0) {
+        if (pread_all(fd, buf, TRACK_HEADER_LEN, 0) && track_header_parse(buf, TRACK_HEADER_LEN, &h)) {
+            ret = 0;
+        } else {
+            errno = EINVAL;
+        }
+    }
+
+    // One read per chunk: blocks never cross a chunk boundary, so a
+    // chunk parses on its own and a damaged block costs only the rest of
+    // its chunk
+    uint32_t size = ret == 0 ? (uint32_t)st.st_size : 0;
+    for (uint32_t at = 0; at < size; at += CHUNK_WRITER_CHUNK) {
+        uint32_t len = size - at < CHUNK_WRITER_CHUNK ? size - at : CHUNK_WRITER_CHUNK;
+        if (!pread_all(fd, buf, len, at)) break;
+        track_ckpt_t c;
+        uint32_t off = TRACK_HEADER_LEN;
+        if (at > 0) off = track_ckpt_parse(buf, len, h.session, at / CHUNK_WRITER_CHUNK, &c) ? TRACK_CKPT_LEN : 0;
+
+        uint32_t n;
+        while ((n = track_block_check(buf + off, len - off, h.session, NULL)) != 0) {
+            track_reader_t r;
+            track_rec_t rec;
+            track_reader_begin(&r, &h, buf + off);
+            while (track_reader_next(&r, &rec)) {
+                if (rec.type == TRACK_REC_POINT) track_summary_point(s, rec.point.t_us, &rec.point.p);
+            }
+            off += n;
+        }
+    }
+    free(buf);
+    track_summary_end(s, size);
+
+    int err = errno;
+    close(fd);
+    errno = err;
+    return ret;
+}
+
+bool track_index_rec_valid(const track_index_rec_t *r) {
+    return r->crc == track_crc32(0, r, REC_CRC_LEN);
+}
+
+// Record count of an open index; an empty file gets its header when
+// create is set. A torn last record is not counted and gets overwritten.
+static int32_t index_count(int fd, bool create) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) return -1;
+    if (st.st_size == 0 && create) {
+        const uint32_t h[4] = { TRACK_INDEX_MAGIC, TRACK_INDEX_VERSION | REC_LEN << 16, 0, 0 };
+        return pwrite(fd, h, sizeof(h), 0) == (ssize_t)sizeof(h) ? 0 : -1;
+    }
+    uint32_t h[4];
+    if (!pread_all(fd, h, sizeof(h), 0) || h[0] != TRACK_INDEX_MAGIC || h[1] != (TRACK_INDEX_VERSION | REC_LEN << 16)) {
+        errno = EINVAL;
+        return -1;
+    }
+    return (int32_t)((st.st_size - TRACK_INDEX_HEADER_LEN) / REC_LEN);
+}
+
+static bool read_rec(int fd, uint32_t i, track_index_rec_t *r) {
+    return pread_all(fd, r, REC_LEN, TRACK_INDEX_HEADER_LEN + i * REC_LEN);
+}
+
+static bool write_rec(int fd, uint32_t i, const track_index_rec_t *r) {
+    return pwrite(fd, r, REC_LEN, (off_t)(TRACK_INDEX_HEADER_LEN + i * REC_LEN)) == (ssize_t)REC_LEN;
+}
+
+static int close_keep_errno(int fd, int ret) {
+    int err = errno;
+    if (close(fd) != 0 && ret >= 0) {
+        err = errno;
+        ret = -1;
+    }
+    errno = err;
+    return ret;
+}
+
+int track_index_append(const char *path, const track_index_rec_t *r) {
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) return -1;
+    int32_t n = index_count(fd, true);
+    if (n < 0) return close_keep_errno(fd, -1);
+
+    // Normally the newest session: one write at the end. An older one
+    // moves the later records up by one, last first.
+    uint32_t pos = (uint32_t)n;
+    track_index_rec_t prev;
+    while (pos > 0) {
+        if (!read_rec(fd, pos - 1, &prev)) return close_keep_errno(fd, -1);
+        if (prev.start_s <= r->start_s) break;
+        if (!write_rec(fd, pos, &prev)) return close_keep_errno(fd, -1);
+        pos--;
+    }
+    int ret = write_rec(fd, pos, r) && fsync(fd) == 0 ? 0 : -1;
+    return close_keep_errno(fd, ret);
+}
+
+int32_t track_index_count(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    return close_keep_errno(fd, index_count(fd, false));
+}
+
+int32_t track_index_read(const char *path, uint32_t first, uint32_t n, track_index_rec_t *out) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    int32_t count = index_count(fd, false);
+    if (count < 0) return close_keep_errno(fd, -1);
+    if (first >= (uint32_t)count) return close_keep_errno(fd, 0);
+    if (n > (uint32_t)count - first) n = (uint32_t)count - first;
+    ssize_t got = pread(fd, out, n * REC_LEN, (off_t)(TRACK_INDEX_HEADER_LEN + first * REC_LEN));
+    return close_keep_errno(fd, got == (ssize_t)(n * REC_LEN) ? (int32_t)n : -1);
+}
+
+// Binary search over an open index of count records
+static int32_t find_start(int fd, uint32_t count, uint32_t start_s) {
+    uint32_t lo = 0, hi = count;
+    track_index_rec_t r;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (!read_rec(fd, mid, &r)) return -1;
+        if (r.start_s < start_s) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return (int32_t)lo;
+}
+
+int32_t track_index_find(const char *path, uint32_t start_s) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    int32_t count = index_count(fd, false);
+    if (count < 0) return close_keep_errno(fd, -1);
+    return close_keep_errno(fd, find_start(fd, (uint32_t)count, start_s));
+}
+
+int track_index_contains(const char *path, uint32_t start_s, const char *name) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    int32_t count = index_count(fd, false);
+    int32_t i = count < 0 ? -1 : find_start(fd, (uint32_t)count, start_s);
+    if (i < 0) return close_keep_errno(fd, -1);
+
+    // Sessions starting in the same second follow each other
+    track_index_rec_t r;
+    for (; i < count; i++) {
+        if (!read_rec(fd, (uint32_t)i, &r)) return close_keep_errno(fd, -1);
+        if (r.start_s != start_s) break;
+        if (strncmp(r.name, name, TRACK_INDEX_NAME_LEN) == 0) return close_keep_errno(fd, 1);
+    }
+    return close_keep_errno(fd, 0);
+}
+
+static int rec_cmp(const void *a, const void *b) {
+    const track_index_rec_t *x = a, *y = b;
+    if (x->start_s != y->start_s) return x->start_s < y->start_s ? -1 : 1;
+    return strncmp(x->name, y->name, TRACK_INDEX_NAME_LEN);
+}
+
+int32_t track_index_rebuild(const char *dir, const char *path) {
+    DIR *d = opendir(dir);
+    if (!d) return -1;
+
+    track_index_rec_t *recs = NULL;
+    uint32_t n = 0, cap = 0;
+    track_summary_t s;
+    char file[300];
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        const char *ext = strrchr(e->d_name, '.');
+        if (strncasecmp(e->d_name, "ACT_", 4) != 0 || !ext || strlen(e->d_name) >= TRACK_INDEX_NAME_LEN) continue;
+        if (n == cap) {
+            cap = cap ? cap * 2 : 64;
+            track_index_rec_t *grown = realloc(recs, cap * REC_LEN);
+            if (!grown) {
+                free(recs);
+                closedir(d);
+                return -1;
+            }
+            recs = grown;
+        }
+
+        // A GPX file is listed by name and size only; its statistics
+        // come from the summary made while it was recorded
+        snprintf(file, sizeof(file), "%s/%s", dir, e->d_name);
+        struct stat st;
+        if (strcasecmp(ext, ".TRK") == 0) {
+            if (track_summary_file(&s, file, e->d_name) != 0) continue;
+        } else if (strcasecmp(ext, ".GPX") == 0 && stat(file, &st) == 0) {
+            track_summary_begin(&s, e->d_name);
+            track_summary_end(&s, (uint32_t)st.st_size);
+        } else {
+            continue;
+        }
+        recs[n++] = s.rec;
+    }
+    closedir(d);
+    qsort(recs, n, REC_LEN, rec_cmp);
+
+    // Written aside and renamed, so a reset leaves the old index or the
+    // new one
+    char tmp[300];
+    snprintf(tmp, sizeof(tmp), "%s.new", path);
+    int ret = -1;
+    int fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+        bool ok = index_count(fd, true) == 0 &&
+                  (n == 0 || pwrite(fd, recs, n * REC_LEN, TRACK_INDEX_HEADER_LEN) == (ssize_t)(n * REC_LEN)) &&
+                  fsync(fd) == 0;
+        ret = close_keep_errno(fd, ok ? 0 : -1);
+    }
+    free(recs);
+    if (ret == 0 && (unlink(path) == 0 || errno == ENOENT) && rename(tmp, path) == 0) return (int32_t)n;
+    int err = errno;
+    unlink(tmp);
+    errno = err;
+    return -1;
+}
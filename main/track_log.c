@@ -0,0 +1,501 @@
+#include "track_log.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MS_PER_DAY      86400000LL
+
+// CRC-32 (IEEE 802.3, reflected), a nibble at a time: 64 bytes of table
+static const uint32_t crc_nibble[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+};
+
+uint32_t track_crc32(uint32_t crc, const void *data, size_t len) {
+    const uint8_t *p = data;
+    crc = ~crc;
+    while (len--) {
+        crc ^= *p++;
+        crc = (crc >> 4) ^ crc_nibble[crc & 15];
+        crc = (crc >> 4) ^ crc_nibble[crc & 15];
+    }
+    return ~crc;
+}
+
+static void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    put_u16(p, (uint16_t)v);
+    put_u16(p + 2, (uint16_t)(v >> 16));
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return get_u16(p) | (uint32_t)get_u16(p + 2) << 16;
+}
+
+// Days since 1970-01-01 of a proleptic Gregorian date, and back
+static int64_t days_from_civil(int y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    unsigned yoe = (unsigned)(y - era * 400);
+    unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+static void civil_from_days(int64_t z, int *y, unsigned *m, unsigned *d) {
+    z += 719468;
+    int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    unsigned doe = (unsigned)(z - era * 146097);
+    unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    unsigned mp = (5 * doy + 2) / 153;
+    *d = doy - (153 * mp + 2) / 5 + 1;
+    *m = mp < 10 ? mp + 3 : mp - 9;
+    *y = (int)(yoe + era * 400) + (*m <= 2);
+}
+
+int64_t track_point_utc_ms(const gpx_point_t *p) {
+    if (!p->year) return 0;
+    return days_from_civil(p->year, p->month, p->day) * MS_PER_DAY +
+           ((p->hour * 60 + p->min) * 60 + p->sec) * 1000LL + p->ms;
+}
+
+// Integer fields in a fixed order; UTC as ms since 1970, 0 = no date
+static void point_fields(const gpx_point_t *p, int64_t f[TRACK_POINT_FIELDS]) {
+    int64_t utc = track_point_utc_ms(p);
+    f[0] = p->lat;
+    f[1] = p->lon;
+    f[2] = p->ele_mm;
+    f[3] = p->speed_mmps;
+    f[4] = p->course;
+    f[5] = utc;
+    f[6] = p->fix_type;
+    f[7] = p->num_sv;
+    f[8] = p->hdop;
+    f[9] = p->temp_c10;
+    f[10] = p->g_milli;
+    f[11] = p->bat_mv;
+    f[12] = p->mode;
+    f[13] = p->pbox;
+}
+
+static void point_from_fields(gpx_point_t *p, const int64_t f[TRACK_POINT_FIELDS]) {
+    memset(p, 0, sizeof(*p));
+    p->lat = (int32_t)f[0];
+    p->lon = (int32_t)f[1];
+    p->ele_mm = (int32_t)f[2];
+    p->speed_mmps = (uint32_t)f[3];
+    p->course = (int32_t)f[4];
+    if (f[5]) {
+        int64_t days = f[5] / MS_PER_DAY, ms = f[5] % MS_PER_DAY;
+        if (ms < 0) {
+            ms += MS_PER_DAY;
+            days--;
+        }
+        int y;
+        unsigned m, d;
+        civil_from_days(days, &y, &m, &d);
+        p->year = (uint16_t)y;
+        p->month = (uint8_t)m;
+        p->day = (uint8_t)d;
+        p->hour = (uint8_t)(ms / 3600000);
+        p->min = (uint8_t)(ms / 60000 % 60);
+        p->sec = (uint8_t)(ms / 1000 % 60);
+        p->ms = (uint16_t)(ms % 1000);
+    }
+    p->fix_type = (uint8_t)f[6];
+    p->num_sv = (uint8_t)f[7];
+    p->hdop = (uint16_t)f[8];
+    p->temp_c10 = (int16_t)f[9];
+    p->g_milli = (uint16_t)f[10];
+    p->bat_mv = (uint16_t)f[11];
+    p->mode = (uint8_t)f[12];
+    p->pbox = (uint8_t)f[13];
+}
+
+static uint8_t *put_varint(uint8_t *p, int64_t v) {
+    uint64_t u = ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+    while (u >= 0x80) {
+        *p++ = (uint8_t)(u | 0x80);
+        u >>= 7;
+    }
+    *p++ = (uint8_t)u;
+    return p;
+}
+
+// false when the varint runs past end or is longer than 64 bits
+static bool get_varint(const uint8_t **pp, const uint8_t *end, int64_t *v) {
+    const uint8_t *p = *pp;
+    uint64_t u = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (p >= end) return false;
+        uint8_t b = *p++;
+        u |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            *pp = p;
+            *v = (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+static int32_t quantize(float v, float unit) {
+    return (int32_t)lrintf(v / unit);
+}
+
+static void imu_fields(const imu_sample_t *s, int32_t f[7]) {
+    const float a = TRACK_ACCEL_NG_PER_LSB * 1e-9f, g = TRACK_GYRO_UDPS_PER_LSB * 1e-6f;
+    f[0] = quantize(s->ax, a);
+    f[1] = quantize(s->ay, a);
+    f[2] = quantize(s->az, a);
+    f[3] = quantize(s->gx, g);
+    f[4] = quantize(s->gy, g);
+    f[5] = quantize(s->gz, g);
+    f[6] = quantize(s->temp, 0.01f);
+}
+
+void track_log_init(track_log_t *w, const chunk_writer_config_t *cfg) {
+    memset(w, 0, sizeof(*w));
+    chunk_writer_init(&w->out, cfg);
+    latency_hist_reset(&w->encode_us);
+}
+
+int track_log_open(track_log_t *w, const char *path, int64_t start_us, uint32_t session, uint16_t imu_decim) {
+    if (chunk_writer_open(&w->out, path) != 0) return -1;
+    w->len = 0;
+    w->records = 0;
+    w->seq = 0;
+    w->session = session;
+    w->staged_t_us = start_us;
+
+    uint8_t h[TRACK_HEADER_LEN] = { 0 };
+    put_u32(h, TRACK_LOG_MAGIC);
+    put_u16(h + 4, TRACK_LOG_VERSION);
+    put_u16(h + 6, TRACK_HEADER_LEN);
+    put_u32(h + 8, TRACK_ACCEL_NG_PER_LSB);
+    put_u32(h + 12, TRACK_GYRO_UDPS_PER_LSB);
+    put_u32(h + 16, (uint32_t)start_us);
+    put_u32(h + 20, (uint32_t)((uint64_t)start_us >> 32));
+    put_u32(h + 24, session);
+    put_u16(h + 28, imu_decim);
+    put_u32(h + 32, track_crc32(0, h, 32));
+    chunk_writer_stage(&w->out, h, sizeof(h));
+    return 0;
+}
+
+static void stage_ckpt(track_log_t *w, uint32_t index) {
+    uint8_t c[TRACK_CKPT_LEN];
+    put_u32(c, TRACK_CKPT_MAGIC);
+    put_u32(c + 4, w->session);
+    put_u32(c + 8, index);
+    put_u32(c + 12, w->seq);
+    put_u32(c + 16, (uint32_t)w->staged_t_us);
+    put_u32(c + 20, (uint32_t)((uint64_t)w->staged_t_us >> 32));
+    put_u32(c + 24, w->dropped);
+    put_u32(c + 28, track_crc32(0, c, 28));
+    chunk_writer_stage(&w->out, c, sizeof(c));
+    w->checkpoints++;
+}
+
+bool track_log_seal(track_log_t *w) {
+    static const uint8_t zeros[256];
+    if (w->records == 0) return true;
+
+    // A block that would cross a chunk boundary goes after it, behind
+    // zeros and the checkpoint; all of it is staged or nothing
+    uint32_t block_len = TRACK_BLOCK_HDR_LEN + w->len;
+    uint32_t off = chunk_writer_staged(&w->out) % CHUNK_WRITER_CHUNK;
+    uint32_t pad = off + block_len > CHUNK_WRITER_CHUNK ? CHUNK_WRITER_CHUNK - off : 0;
+    bool ckpt = off == 0 || pad > 0;
+    bool ok = pad + (ckpt ? TRACK_CKPT_LEN : 0) + block_len <= chunk_writer_space(&w->out);
+    if (ok) {
+        for (uint32_t n; pad > 0; pad -= n) {
+            n = pad < sizeof(zeros) ? pad : sizeof(zeros);
+            chunk_writer_stage(&w->out, zeros, n);
+        }
+        if (ckpt) stage_ckpt(w, chunk_writer_staged(&w->out) / CHUNK_WRITER_CHUNK);
+
+        uint8_t *h = w->block;
+        put_u32(h, TRACK_BLOCK_MAGIC);
+        put_u32(h + 4, w->seq++);
+        put_u16(h + 8, (uint16_t)w->len);
+        put_u16(h + 10, w->records);
+        put_u32(h + 12, track_crc32(track_crc32(w->session, h + 4, 8), h + TRACK_BLOCK_HDR_LEN, w->len));
+        chunk_writer_stage(&w->out, h, block_len);
+        w->blocks++;
+        w->staged_t_us = w->pred.t_us;
+    } else {
+        w->dropped += w->records;
+    }
+    w->len = 0;
+    w->records = 0;
+    return ok;
+}
+
+// Payload position for a record at t_us, sealing first when the block is
+// full or old; the predictors restart with each block
+static uint8_t *rec_begin(track_log_t *w, int64_t t_us, uint8_t type, bool *ok) {
+    *ok = true;
+    if (w->records &&
+        (w->len + TRACK_REC_MAX > TRACK_BLOCK_MAX || t_us - w->block_t0 >= TRACK_BLOCK_SPAN_US)) {
+        *ok = track_log_seal(w);
+    }
+    if (w->records == 0) {
+        memset(&w->pred, 0, sizeof(w->pred));
+        w->block_t0 = t_us;
+    }
+    uint8_t *p = w->block + TRACK_BLOCK_HDR_LEN + w->len;
+    *p++ = type;
+    p = put_varint(p, t_us - w->pred.t_us);
+    w->pred.t_us = t_us;
+    return p;
+}
+
+static void rec_end(track_log_t *w, uint8_t *p, uint8_t type, int64_t t0) {
+    w->len = (uint32_t)(p - (w->block + TRACK_BLOCK_HDR_LEN));
+    w->records++;
+    w->count[type]++;
+    latency_hist_add(&w->encode_us, (uint32_t)(w->out.clock_us() - t0));
+}
+
+bool track_log_point(track_log_t *w, int64_t t_us, const gpx_point_t *pt) {
+    int64_t t0 = w->out.clock_us();
+    bool ok;
+    uint8_t *p = rec_begin(w, t_us, TRACK_REC_POINT, &ok);
+    int64_t f[TRACK_POINT_FIELDS];
+    point_fields(pt, f);
+    for (int i = 0; i < TRACK_POINT_FIELDS; i++) {
+        p = put_varint(p, f[i] - w->pred.point[i]);
+        w->pred.point[i] = f[i];
+    }
+    rec_end(w, p, TRACK_REC_POINT, t0);
+    return ok;
+}
+
+bool track_log_imu(track_log_t *w, const imu_sample_t *s) {
+    int64_t t0 = w->out.clock_us();
+    bool ok;
+    uint8_t *p = rec_begin(w, s->t_us, TRACK_REC_IMU, &ok);
+    int32_t f[7];
+    imu_fields(s, f);
+    for (int i = 0; i < 7; i++) {
+        p = put_varint(p, (int64_t)f[i] - w->pred.imu[i]);
+        w->pred.imu[i] = f[i];
+    }
+    rec_end(w, p, TRACK_REC_IMU, t0);
+    return ok;
+}
+
+bool track_log_baro(track_log_t *w, const baro_sample_t *s) {
+    int64_t t0 = w->out.clock_us();
+    bool ok;
+    uint8_t *p = rec_begin(w, s->t_us, TRACK_REC_BARO, &ok);
+    // hPa -> 0.01 Pa in double: float has 7 digits, the value 8
+    const int32_t f[2] = { (int32_t)llrint(s->pressure * 10000.0), quantize(s->temp, 0.01f) };
+    for (int i = 0; i < 2; i++) {
+        p = put_varint(p, (int64_t)f[i] - w->pred.baro[i]);
+        w->pred.baro[i] = f[i];
+    }
+    rec_end(w, p, TRACK_REC_BARO, t0);
+    return ok;
+}
+
+int track_log_close(track_log_t *w) {
+    if (!chunk_writer_is_open(&w->out)) return 0;
+    if (chunk_writer_flush(&w->out) >= 0) track_log_seal(w);
+    w->len = 0;
+    w->records = 0;
+    return chunk_writer_close(&w->out);
+}
+
+bool track_header_parse(const uint8_t *buf, size_t len, track_header_t *h) {
+    if (len < TRACK_HEADER_LEN || get_u32(buf) != TRACK_LOG_MAGIC) return false;
+    if (get_u16(buf + 6) != TRACK_HEADER_LEN || get_u32(buf + 32) != track_crc32(0, buf, 32)) return false;
+    h->version = get_u16(buf + 4);
+    h->accel_ng_per_lsb = get_u32(buf + 8);
+    h->gyro_udps_per_lsb = get_u32(buf + 12);
+    h->start_us = (int64_t)((uint64_t)get_u32(buf + 20) << 32 | get_u32(buf + 16));
+    h->session = get_u32(buf + 24);
+    h->imu_decim = get_u16(buf + 28);
+    return h->version == TRACK_LOG_VERSION;
+}
+
+uint32_t track_block_check(const uint8_t *buf, size_t avail, uint32_t session, uint32_t *seq) {
+    if (avail < TRACK_BLOCK_HDR_LEN || get_u32(buf) != TRACK_BLOCK_MAGIC) return 0;
+    uint32_t len = get_u16(buf + 8);
+    if (len > TRACK_BLOCK_MAX || TRACK_BLOCK_HDR_LEN + len > avail) return 0;
+    uint32_t crc = track_crc32(track_crc32(session, buf + 4, 8), buf + TRACK_BLOCK_HDR_LEN, len);
+    if (crc != get_u32(buf + 12)) return 0;
+    if (seq) *seq = get_u32(buf + 4);
+    return TRACK_BLOCK_HDR_LEN + len;
+}
+
+bool track_ckpt_parse(const uint8_t *buf, size_t len, uint32_t session, uint32_t index, track_ckpt_t *c) {
+    if (len < TRACK_CKPT_LEN || get_u32(buf) != TRACK_CKPT_MAGIC) return false;
+    if (get_u32(buf + 28) != track_crc32(0, buf, 28)) return false;
+    if (get_u32(buf + 4) != session || get_u32(buf + 8) != index) return false;
+    c->index = index;
+    c->seq = get_u32(buf + 12);
+    c->t_us = (int64_t)((uint64_t)get_u32(buf + 20) << 32 | get_u32(buf + 16));
+    c->dropped = get_u32(buf + 24);
+    return true;
+}
+
+void track_reader_begin(track_reader_t *r, const track_header_t *h, const uint8_t *block) {
+    memset(r, 0, sizeof(*r));
+    r->hdr = h;
+    r->p = block + TRACK_BLOCK_HDR_LEN;
+    r->end = r->p + get_u16(block + 8);
+    r->left = get_u16(block + 10);
+}
+
+bool track_reader_next(track_reader_t *r, track_rec_t *out) {
+    if (r->left == 0 || r->p >= r->end) return false;
+    r->left--;
+    out->type = *r->p++;
+
+    int64_t d, t;
+    if (!get_varint(&r->p, r->end, &d)) return false;
+    t = r->pred.t_us += d;
+
+    switch (out->type) {
+    case TRACK_REC_POINT:
+        for (int i = 0; i < TRACK_POINT_FIELDS; i++) {
+            if (!get_varint(&r->p, r->end, &d)) return false;
+            r->pred.point[i] += d;
+        }
+        out->point.t_us = t;
+        point_from_fields(&out->point.p, r->pred.point);
+        return true;
+    case TRACK_REC_IMU: {
+        for (int i = 0; i < 7; i++) {
+            if (!get_varint(&r->p, r->end, &d)) return false;
+            r->pred.imu[i] += (int32_t)d;
+        }
+        const int32_t *f = r->pred.imu;
+        float a = r->hdr->accel_ng_per_lsb * 1e-9f, g = r->hdr->gyro_udps_per_lsb * 1e-6f;
+        out->imu = (imu_sample_t){
+            .t_us = t,
+            .ax = f[0] * a, .ay = f[1] * a, .az = f[2] * a,
+            .gx = f[3] * g, .gy = f[4] * g, .gz = f[5] * g,
+            .temp = f[6] * 0.01f,
+        };
+        return true;
+    }
+    case TRACK_REC_BARO:
+        for (int i = 0; i < 2; i++) {
+            if (!get_varint(&r->p, r->end, &d)) return false;
+            r->pred.baro[i] += (int32_t)d;
+        }
+        out->baro = (baro_sample_t){
+            .t_us = t,
+            .pressure = (float)(r->pred.baro[0] * 1e-4),
+            .temp = r->pred.baro[1] * 0.01f,
+        };
+        return true;
+    default:
+        return false;   // Unknown type: its length is unknown too
+    }
+}
+
+static bool pread_all(int fd, void *buf, uint32_t len, uint32_t off) {
+    ssize_t n = pread(fd, buf, len, (off_t)off);
+    return n == (ssize_t)len;
+}
+
+static int64_t rec_t_us(const track_rec_t *r) {
+    switch (r->type) {
+    case TRACK_REC_POINT: return r->point.t_us;
+    case TRACK_REC_IMU: return r->imu.t_us;
+    default: return r->baro.t_us;
+    }
+}
+
+// Length of the intact part of the file: header, chunks and blocks
+static int64_t recover_scan(int fd, track_recovery_t *res) {
+    uint8_t buf[TRACK_HEADER_LEN];
+    track_header_t h;
+    struct stat st;
+    if (fstat(fd, &st) != 0) return -1;
+    res->size = (uint32_t)st.st_size;
+    if (!pread_all(fd, buf, TRACK_HEADER_LEN, 0) || !track_header_parse(buf, TRACK_HEADER_LEN, &h)) {
+        errno = EINVAL;
+        return -1;
+    }
+    res->start_us = res->end_us = h.start_us;
+
+    // Chunks are written in order, so the checkpoints are valid up to the
+    // last chunk that reached the card and not after it: zeros, or a
+    // deleted file with another session
+    uint32_t chunk = 0, pos = TRACK_HEADER_LEN;
+    for (uint32_t k = 1; (uint64_t)k * CHUNK_WRITER_CHUNK + TRACK_CKPT_LEN <= res->size; k++) {
+        track_ckpt_t c;
+        if (!pread_all(fd, buf, TRACK_CKPT_LEN, k * CHUNK_WRITER_CHUNK) ||
+            !track_ckpt_parse(buf, TRACK_CKPT_LEN, h.session, k, &c)) {
+            break;
+        }
+        chunk = k;
+        pos = k * CHUNK_WRITER_CHUNK + TRACK_CKPT_LEN;
+        res->checkpoints++;
+        res->seq = c.seq;
+        res->end_us = c.t_us;
+        res->dropped = c.dropped;
+    }
+
+    // Then the blocks of that chunk up to the first damaged or out of
+    // sequence one
+    uint8_t *blk = malloc(TRACK_BLOCK_HDR_LEN + TRACK_BLOCK_MAX);
+    if (!blk) return -1;
+    uint32_t end = (chunk + 1) * CHUNK_WRITER_CHUNK;
+    if (end > res->size) end = res->size;
+    while (pos + TRACK_BLOCK_HDR_LEN <= end && pread_all(fd, blk, TRACK_BLOCK_HDR_LEN, pos)) {
+        uint32_t len = get_u16(blk + 8), seq;
+        if (len > TRACK_BLOCK_MAX || pos + TRACK_BLOCK_HDR_LEN + len > end) break;
+        if (!pread_all(fd, blk + TRACK_BLOCK_HDR_LEN, len, pos + TRACK_BLOCK_HDR_LEN)) break;
+        if (track_block_check(blk, TRACK_BLOCK_HDR_LEN + len, h.session, &seq) == 0 || seq != res->seq) break;
+
+        track_reader_t r;
+        track_rec_t rec;
+        track_reader_begin(&r, &h, blk);
+        while (track_reader_next(&r, &rec)) res->end_us = rec_t_us(&rec);
+        res->seq++;
+        res->blocks++;
+        pos += TRACK_BLOCK_HDR_LEN + len;
+    }
+    free(blk);
+    return res->length = pos;
+}
+
+int track_log_recover(const char *path, track_recovery_t *res) {
+    memset(res, 0, sizeof(*res));
+    int fd = open(path, O_RDWR);
+    if (fd < 0) return -1;
+
+    int ret = -1;
+    int64_t len = recover_scan(fd, res);
+    if (len == res->size) {
+        ret = 0;
+    } else if (len >= 0 && ftruncate(fd, (off_t)len) == 0 && fsync(fd) == 0) {
+        ret = 1;
+    }
+    int err = errno;
+    if (close(fd) != 0 && ret >= 0) {
+        err = errno;
+        ret = -1;
+    }
+    errno = err;
+    return ret;
+}
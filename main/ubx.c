@@ -0,0 +1,201 @@
+#include "ubx.h"
+#include <string.h>
+
+typedef void (*ubx_handler_fn)(ubx_engine_t *eng, const uint8_t *payload, uint16_t len);
+
+typedef struct {
+    uint16_t key;       // (class << 8) | id
+    uint16_t min_len;   // Minimum payload length accepted
+    ubx_handler_fn fn;
+} ubx_handler_t;
+
+#define UBX_KEY(cls, id) ((uint16_t)(((cls) << 8) | (id)))
+
+void ubx_engine_init(ubx_engine_t *eng) {
+    memset(eng, 0, sizeof(*eng));
+}
+
+void ubx_checksum(uint8_t cls, uint8_t id, const uint8_t *payload, uint16_t len,
+                  uint8_t *ck_a, uint8_t *ck_b) {
+    uint8_t a = 0, b = 0;
+
+    a += cls;               b += a;
+    a += id;                b += a;
+    a += len & 0xFF;        b += a;
+    a += (len >> 8) & 0xFF; b += a;
+
+    for (uint16_t i = 0; i < len; i++) {
+        a += payload[i];
+        b += a;
+    }
+    *ck_a = a;
+    *ck_b = b;
+}
+
+size_t ubx_build_frame(uint8_t cls, uint8_t id, const uint8_t *payload, uint16_t len,
+                       uint8_t *buf, size_t buf_size) {
+    size_t total = (size_t)len + UBX_FRAME_OVERHEAD;
+    if (buf_size < total) return 0;
+
+    buf[0] = UBX_SYNC_CHAR_1;
+    buf[1] = UBX_SYNC_CHAR_2;
+    buf[2] = cls;
+    buf[3] = id;
+    buf[4] = len & 0xFF;
+    buf[5] = (len >> 8) & 0xFF;
+    if (len > 0) memcpy(&buf[UBX_HEADER_LEN], payload, len);
+    ubx_checksum(cls, id, payload, len, &buf[total - 2], &buf[total - 1]);
+    return total;
+}
+
+// Handlers. The dispatch table checks min_len, so fixed-layout messages
+// have nothing more to check in len.
+
+static void handle_nav_pvt(ubx_engine_t *eng, const uint8_t *payload, uint16_t len) {
+    (void)len;
+    ubx_nav_pvt_t *pvt = &eng->pvt;
+    memcpy(pvt, payload, sizeof(*pvt));
+
+    gnss_fix_t *fix = &eng->fix;
+    fix->itow_ms = pvt->iTOW;
+    fix->fix_type = pvt->fixType;
+    fix->num_sv = pvt->numSV;
+    fix->year = pvt->year;
+    fix->month = pvt->month;
+    fix->day = pvt->day;
+    fix->hour = pvt->hour;
+    fix->min = pvt->min;
+    fix->sec = pvt->sec;
+    // UTC and GPS time differ by whole seconds, so iTOW carries the epoch's ms
+    fix->ms = (uint16_t)(pvt->iTOW % 1000);
+    fix->pdop = pvt->pDOP;
+
+    uint16_t valid = fix->valid & (GNSS_VALID_DOP);
+    if (pvt->valid & UBX_PVT_VALID_DATE) valid |= GNSS_VALID_DATE;
+    if (pvt->valid & UBX_PVT_VALID_TIME) valid |= GNSS_VALID_TIME;
+
+    if ((pvt->flags & UBX_PVT_FLAGS_FIXOK) && pvt->fixType != GNSS_FIX_NONE &&
+        pvt->fixType != GNSS_FIX_TIME_ONLY) {
+        fix->lat = pvt->lat;
+        fix->lon = pvt->lon;
+        fix->alt_mm = pvt->hMSL;
+        fix->speed_mmps = pvt->gSpeed < 0 ? 0 : (uint32_t)pvt->gSpeed;
+        fix->course = pvt->headMot;
+        fix->vel_n = pvt->velN;
+        fix->vel_e = pvt->velE;
+        fix->vel_d = pvt->velD;
+        fix->h_acc_mm = pvt->hAcc;
+        fix->v_acc_mm = pvt->vAcc;
+        fix->s_acc_mmps = pvt->sAcc;
+        valid |= GNSS_VALID_POS | GNSS_VALID_SPEED | GNSS_VALID_COURSE | GNSS_VALID_VEL;
+        if (pvt->fixType != GNSS_FIX_2D) valid |= GNSS_VALID_ALT;
+    }
+    fix->valid = valid;
+}
+
+static void handle_nav_dop(ubx_engine_t *eng, const uint8_t *payload, uint16_t len) {
+    (void)len;
+    memcpy(&eng->dop, payload, sizeof(eng->dop));
+    eng->fix.pdop = eng->dop.pDOP;
+    eng->fix.hdop = eng->dop.hDOP;
+    eng->fix.vdop = eng->dop.vDOP;
+    eng->fix.valid |= GNSS_VALID_DOP;
+}
+
+static void handle_nav_timeutc(ubx_engine_t *eng, const uint8_t *payload, uint16_t len) {
+    (void)len;
+    memcpy(&eng->timeutc, payload, sizeof(eng->timeutc));
+}
+
+static void handle_nav_sat(ubx_engine_t *eng, const uint8_t *payload, uint16_t len) {
+    memcpy(&eng->sat, payload, sizeof(eng->sat));
+
+    size_t blocks = (len - sizeof(ubx_nav_sat_hdr_t)) / sizeof(ubx_nav_sat_sv_t);
+    if (blocks > eng->sat.numSvs) blocks = eng->sat.numSvs;
+    if (blocks > UBX_NAV_SAT_MAX_SVS) blocks = UBX_NAV_SAT_MAX_SVS;
+
+    memcpy(eng->sat_svs, payload + sizeof(ubx_nav_sat_hdr_t), blocks * sizeof(ubx_nav_sat_sv_t));
+    eng->sat.numSvs = (uint8_t)blocks;
+}
+
+static void handle_ack(ubx_engine_t *eng, const uint8_t *payload, bool ack) {
+    eng->ack.cls = payload[0];
+    eng->ack.id = payload[1];
+    eng->ack.ack = ack;
+    eng->ack.pending = true;
+}
+
+static void handle_ack_ack(ubx_engine_t *eng, const uint8_t *payload, uint16_t len) {
+    (void)len;
+    handle_ack(eng, payload, true);
+}
+
+static void handle_ack_nak(ubx_engine_t *eng, const uint8_t *payload, uint16_t len) {
+    (void)len;
+    handle_ack(eng, payload, false);
+}
+
+// Dispatch table, kept sorted by key for the binary search below
+static const ubx_handler_t ubx_handlers[] = {
+    { UBX_KEY(UBX_CLASS_NAV, UBX_ID_NAV_DOP),     sizeof(ubx_nav_dop_t),     handle_nav_dop },
+    { UBX_KEY(UBX_CLASS_NAV, UBX_ID_NAV_PVT),     sizeof(ubx_nav_pvt_t),     handle_nav_pvt },
+    { UBX_KEY(UBX_CLASS_NAV, UBX_ID_NAV_TIMEUTC), sizeof(ubx_nav_timeutc_t), handle_nav_timeutc },
+    { UBX_KEY(UBX_CLASS_NAV, UBX_ID_NAV_SAT),     sizeof(ubx_nav_sat_hdr_t), handle_nav_sat },
+    { UBX_KEY(UBX_CLASS_ACK, UBX_ID_ACK_NAK),     2,                         handle_ack_nak },
+    { UBX_KEY(UBX_CLASS_ACK, UBX_ID_ACK_ACK),     2,                         handle_ack_ack },
+};
+
+#define UBX_HANDLER_COUNT (sizeof(ubx_handlers) / sizeof(ubx_handlers[0]))
+
+static const ubx_handler_t *ubx_find_handler(uint16_t key) {
+    size_t lo = 0, hi = UBX_HANDLER_COUNT;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        uint16_t k = ubx_handlers[mid].key;
+        if (k == key) return &ubx_handlers[mid];
+        if (k < key) lo = mid + 1;
+        else hi = mid;
+    }
+    return NULL;
+}
+
+ubx_status_t ubx_engine_process(ubx_engine_t *eng, uint8_t cls, uint8_t id,
+                                const uint8_t *payload, uint16_t len,
+                                uint8_t ck_a, uint8_t ck_b) {
+    uint8_t a, b;
+    ubx_checksum(cls, id, payload, len, &a, &b);
+    if (a != ck_a || b != ck_b) {
+        eng->ck_errors++;
+        return UBX_ERR_CHECKSUM;
+    }
+    return ubx_engine_dispatch(eng, cls, id, payload, len);
+}
+
+ubx_status_t ubx_engine_dispatch(ubx_engine_t *eng, uint8_t cls, uint8_t id,
+                                 const uint8_t *payload, uint16_t len) {
+    eng->frames++;
+
+    const ubx_handler_t *h = ubx_find_handler(UBX_KEY(cls, id));
+    if (!h) {
+        eng->unhandled++;
+        return UBX_UNHANDLED;
+    }
+    if (len < h->min_len) {
+        eng->len_errors++;
+        return UBX_ERR_LENGTH;
+    }
+    h->fn(eng, payload, len);
+    return UBX_OK;
+}
+
+ubx_status_t ubx_engine_process_frame(ubx_engine_t *eng, const uint8_t *frame, size_t len) {
+    if (len < UBX_FRAME_OVERHEAD) return UBX_ERR_LENGTH;
+
+    uint16_t payload_len = (uint16_t)(frame[4] | (frame[5] << 8));
+    if ((size_t)payload_len + UBX_FRAME_OVERHEAD != len) {
+        eng->len_errors++;
+        return UBX_ERR_LENGTH;
+    }
+    return ubx_engine_process(eng, frame[2], frame[3], &frame[UBX_HEADER_LEN], payload_len,
+                              frame[len - 2], frame[len - 1]);
+}
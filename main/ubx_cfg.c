@@ -0,0 +1,105 @@
+#include "ubx_cfg.h"
+#include <string.h>
+
+// Storage size in bytes per key size field (bits 28..30); 0 = invalid
+static const uint8_t key_size_bytes[8] = { 0, 1, 1, 2, 4, 8, 0, 0 };
+
+void ubx_valset_init(ubx_valset_t *vs, uint8_t layers) {
+    memset(vs, 0, sizeof(*vs));
+    vs->payload[0] = 0x00;      // Version
+    vs->payload[1] = layers;
+    vs->len = 4;                // Version, layers, reserved(2)
+}
+
+bool ubx_valset_add(ubx_valset_t *vs, uint32_t key, uint64_t value) {
+    uint8_t size = key_size_bytes[(key >> 28) & 0x07];
+    if (size == 0 || vs->keys >= UBX_VALSET_MAX_KEYS ||
+        vs->len + 4 + size > UBX_VALSET_MAX_PAYLOAD) {
+        vs->overflow = true;
+        return false;
+    }
+
+    uint8_t *p = &vs->payload[vs->len];
+    for (int i = 0; i < 4; i++) p[i] = (key >> (8 * i)) & 0xFF;
+    for (int i = 0; i < size; i++) p[4 + i] = (value >> (8 * i)) & 0xFF;
+
+    vs->len += 4 + size;
+    vs->keys++;
+    return true;
+}
+
+void ubx_txn_start(ubx_txn_t *txn, uint8_t cls, uint8_t id, int64_t now_us,
+                   uint32_t timeout_us, uint8_t max_attempts) {
+    memset(txn, 0, sizeof(*txn));
+    txn->cls = cls;
+    txn->id = id;
+    txn->state = UBX_TXN_WAIT_ACK;
+    txn->attempts = 1;
+    txn->max_attempts = max_attempts ? max_attempts : 1;
+    txn->timeout_us = timeout_us;
+    txn->sent_us = now_us;
+    txn->deadline_us = now_us + timeout_us;
+}
+
+bool ubx_txn_on_ack(ubx_txn_t *txn, const ubx_ack_t *ack, int64_t now_us) {
+    if (txn->state != UBX_TXN_WAIT_ACK || ack->cls != txn->cls || ack->id != txn->id) {
+        return false;
+    }
+    txn->state = ack->ack ? UBX_TXN_ACKED : UBX_TXN_NAKED;
+    txn->done_us = now_us;
+    return true;
+}
+
+bool ubx_txn_poll(ubx_txn_t *txn, int64_t now_us) {
+    if (txn->state != UBX_TXN_WAIT_ACK || now_us < txn->deadline_us) return false;
+
+    if (txn->attempts >= txn->max_attempts) {
+        txn->state = UBX_TXN_TIMEOUT;
+        txn->done_us = now_us;
+        return false;
+    }
+    txn->attempts++;
+    txn->sent_us = now_us;
+    txn->deadline_us = now_us + txn->timeout_us;
+    return true;
+}
+
+bool ubx_cfg_build_profile(ubx_valset_t *vs, const gnss_profile_t *profile, uint8_t layers) {
+    uint8_t hz = profile->rate_hz;
+    if (hz == 0 || hz > 25) return false;
+
+    uint8_t c = profile->constellations;
+    uint8_t nmea = profile->ubx_only ? 0 : 1;
+    uint8_t per_second = hz;    // Output once every 'hz' epochs = about 1 Hz
+
+    ubx_valset_init(vs, layers);
+
+    ubx_valset_add(vs, UBX_KEY_RATE_MEAS, 1000 / hz);
+    ubx_valset_add(vs, UBX_KEY_RATE_NAV, 1);
+    ubx_valset_add(vs, UBX_KEY_NAVSPG_DYNMODEL, profile->dyn_model);
+
+    ubx_valset_add(vs, UBX_KEY_SIGNAL_GPS_ENA, (c & GNSS_CONST_GPS) != 0);
+    ubx_valset_add(vs, UBX_KEY_SIGNAL_GLO_ENA, (c & GNSS_CONST_GLONASS) != 0);
+    ubx_valset_add(vs, UBX_KEY_SIGNAL_GAL_ENA, (c & GNSS_CONST_GALILEO) != 0);
+    ubx_valset_add(vs, UBX_KEY_SIGNAL_BDS_ENA, (c & GNSS_CONST_BEIDOU) != 0);
+    ubx_valset_add(vs, UBX_KEY_SIGNAL_QZSS_ENA, (c & GNSS_CONST_QZSS) != 0);
+    ubx_valset_add(vs, UBX_KEY_SIGNAL_SBAS_ENA, (c & GNSS_CONST_SBAS) != 0);
+
+    ubx_valset_add(vs, UBX_KEY_UART1OUTPROT_UBX, 1);
+    ubx_valset_add(vs, UBX_KEY_UART1OUTPROT_NMEA, nmea);
+
+    ubx_valset_add(vs, UBX_KEY_MSGOUT_NAV_PVT_UART1, 1);
+    ubx_valset_add(vs, UBX_KEY_MSGOUT_NAV_DOP_UART1, 1);
+    ubx_valset_add(vs, UBX_KEY_MSGOUT_NAV_EOE_UART1, 1);
+    ubx_valset_add(vs, UBX_KEY_MSGOUT_NAV_SAT_UART1, per_second);
+    ubx_valset_add(vs, UBX_KEY_MSGOUT_NAV_TIMEUTC_UART1, per_second);
+
+    ubx_valset_add(vs, UBX_KEY_MSGOUT_NMEA_RMC_UART1, nmea);
+    ubx_valset_add(vs, UBX_KEY_MSGOUT_NMEA_GGA_UART1, nmea);
+    ubx_valset_add(vs, UBX_KEY_MSGOUT_NMEA_GSA_UART1, nmea);
+    ubx_valset_add(vs, UBX_KEY_MSGOUT_NMEA_GSV_UART1, nmea ? per_second : 0);
+    ubx_valset_add(vs, UBX_KEY_MSGOUT_NMEA_VTG_UART1, 0);
+    ubx_valset_add(vs, UBX_KEY_MSGOUT_NMEA_GLL_UART1, 0);
+
+    return !vs->overflow;
+}
@@ -0,0 +1,227 @@
+// Accuracy checks and timing of the Madgwick AHRS on a PC.
+//
+//   gcc -O2 -I../main/include ahrs_test.c ../main/ahrs.c -lm -o ahrs_test
+//   ./ahrs_test
+//
+// Synthetic 416 Hz IMU and magnetometer readings are generated from a
+// known attitude (earth frame x magnetic north, y west, z up, as in
+// ahrs.h) with the filter gains of config.h:
+// - static tilted pose: alignment on the first sample, heading;
+// - 90 deg/s yaw spin on that pose, gyro driven with mag correction;
+// - 0.5 g sustained cornering: the accel gate must keep the attitude,
+//   so the lateral acceleration stays in lin_body;
+// - 0.7 deg/s gyro bias for 60 s at rest, which the filter only bounds;
+// - ahrs_update_block against ahrs_update with the same dt.
+// Exit status 1 if an error bound is exceeded.
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "ahrs.h"
+
+// As in config.h, which needs the ESP-IDF headers
+#define AHRS_BETA           0.05f
+#define AHRS_ACCEL_GATE_G   0.1f
+
+#define RATE_HZ         416
+#define DEG             0.017453293f
+#define MIN_RUN_S       1.0
+
+static int failures;
+static const float mag_earth[3] = { 0.4f, 0.0f, -0.45f };   // North and down, any unit
+static const float up[3] = { 0.0f, 0.0f, 1.0f };
+static const float no_rate[3] = { 0.0f, 0.0f, 0.0f };
+
+static void expect_max(const char *what, double got, double max) {
+    printf("  %-44s %9.3f (limit %.3f)\n", what, got, max);
+    if (got <= max) return;
+    printf("FAIL %s\n", what);
+    failures++;
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void qmul(const float a[4], const float b[4], float o[4]) {
+    o[0] = a[0] * b[0] - a[1] * b[1] - a[2] * b[2] - a[3] * b[3];
+    o[1] = a[0] * b[1] + a[1] * b[0] + a[2] * b[3] - a[3] * b[2];
+    o[2] = a[0] * b[2] - a[1] * b[3] + a[2] * b[0] + a[3] * b[1];
+    o[3] = a[0] * b[3] + a[1] * b[2] - a[2] * b[1] + a[3] * b[0];
+}
+
+// Earth vector into device axes
+static void to_device(const float q[4], const float v[3], float o[3]) {
+    float qc[4] = { q[0], -q[1], -q[2], -q[3] }, p[4] = { 0, v[0], v[1], v[2] }, t[4], r[4];
+    qmul(qc, p, t);
+    qmul(t, q, r);
+    o[0] = r[1];
+    o[1] = r[2];
+    o[2] = r[3];
+}
+
+static void from_axis(float ax, float ay, float az, float angle, float q[4]) {
+    q[0] = cosf(angle / 2);
+    q[1] = ax * sinf(angle / 2);
+    q[2] = ay * sinf(angle / 2);
+    q[3] = az * sinf(angle / 2);
+}
+
+// Rotation angle of conj(a) * b; atan2 stays exact near zero where acos
+// of the dot product does not
+static double angle_err_deg(const float a[4], const float b[4]) {
+    double w = (double)a[0] * b[0] + (double)a[1] * b[1] + (double)a[2] * b[2] + (double)a[3] * b[3];
+    double x = (double)a[0] * b[1] - (double)a[1] * b[0] - (double)a[2] * b[3] + (double)a[3] * b[2];
+    double y = (double)a[0] * b[2] + (double)a[1] * b[3] - (double)a[2] * b[0] - (double)a[3] * b[1];
+    double z = (double)a[0] * b[3] - (double)a[1] * b[2] + (double)a[2] * b[1] - (double)a[3] * b[0];
+    return 2 * atan2(sqrt(x * x + y * y + z * z), fabs(w)) / DEG;
+}
+
+static double heading_err_deg(float got, float want) {
+    double d = fmod(fabs(got - want), 360.0);
+    return d > 180 ? 360 - d : d;
+}
+
+// Heading 130 deg, pitch 20 deg, roll -35 deg
+static void tilted_pose(float q[4]) {
+    float qy[4], qp[4], qr[4], t[4];
+    from_axis(0, 0, 1, -130 * DEG, qy);
+    from_axis(0, 1, 0, 20 * DEG, qp);
+    from_axis(1, 0, 0, -35 * DEG, qr);
+    qmul(qy, qp, t);
+    qmul(t, qr, q);
+}
+
+static void static_pose(void) {
+    float qt[4], acc[3], mag[3];
+    tilted_pose(qt);
+    to_device(qt, up, acc);
+    to_device(qt, mag_earth, mag);
+    ahrs_t f;
+    ahrs_init(&f, AHRS_BETA, AHRS_ACCEL_GATE_G);
+    ahrs_update(&f, no_rate, acc, mag, 1.0f / RATE_HZ);
+    printf("static tilted pose, heading 130 deg:\n");
+    expect_max("attitude error after the first sample, deg", angle_err_deg(f.q, qt), 0.1);
+    for (int i = 0; i < RATE_HZ * 5; i++) ahrs_update(&f, no_rate, acc, mag, 1.0f / RATE_HZ);
+    expect_max("attitude error after 5 s, deg", angle_err_deg(f.q, qt), 0.1);
+    expect_max("heading error, deg", heading_err_deg(ahrs_heading(f.q), 130), 0.1);
+}
+
+static void yaw_spin(void) {
+    float q[4], acc[3], mag[3];
+    tilted_pose(q);
+    ahrs_t f;
+    ahrs_init(&f, AHRS_BETA, AHRS_ACCEL_GATE_G);
+    const float w = 90 * DEG, we[3] = { 0, 0, w };
+    double max_err = 0;
+    for (int i = 0; i < RATE_HZ * 4; i++) {
+        float dq[4], qn[4], wb[3];
+        from_axis(0, 0, 1, w / RATE_HZ, dq);
+        qmul(dq, q, qn);
+        memcpy(q, qn, sizeof(q));
+        to_device(q, we, wb);
+        to_device(q, up, acc);
+        to_device(q, mag_earth, mag);
+        ahrs_update(&f, wb, acc, mag, 1.0f / RATE_HZ);
+        double e = angle_err_deg(f.q, q);
+        if (e > max_err) max_err = e;
+    }
+    printf("90 deg/s yaw spin for 4 s:\n");
+    expect_max("maximum attitude error, deg", max_err, 1.0);
+}
+
+static void cornering(void) {
+    float mag[3], a_turn[3] = { 0, 0.5f, 1 }, lp[3] = { 0, 0, 1 };
+    const float q_level[4] = { 1, 0, 0, 0 };
+    to_device(q_level, mag_earth, mag);
+    ahrs_t f;
+    ahrs_init(&f, AHRS_BETA, AHRS_ACCEL_GATE_G);
+    for (int i = 0; i < RATE_HZ; i++) ahrs_update(&f, no_rate, up, mag, 1.0f / RATE_HZ);
+    for (int i = 0; i < RATE_HZ * 10; i++) {
+        ahrs_update(&f, no_rate, a_turn, mag, 1.0f / RATE_HZ);
+        // The former gravity split: first-order low pass at alpha 0.2
+        for (int k = 0; k < 3; k++) lp[k] = 0.2f * a_turn[k] + 0.8f * lp[k];
+    }
+    float lin_body[3], lin_earth[3];
+    ahrs_linear_accel(f.q, a_turn, lin_body, lin_earth);
+    printf("0.5 g cornering for 10 s (low pass split would report %.3f g):\n", a_turn[1] - lp[1]);
+    expect_max("lateral lin_body error, g", fabs(lin_body[1] - 0.5), 0.01);
+    expect_max("attitude error, deg", angle_err_deg(f.q, q_level), 0.5);
+    expect_max("updates not gated, of 4160", RATE_HZ * 10 - (double)f.gated, 0);
+}
+
+static void gyro_bias(void) {
+    float qt[4], acc[3], mag[3];
+    const float bias[3] = { 0.5f * DEG, -0.3f * DEG, 0.4f * DEG };
+    tilted_pose(qt);
+    to_device(qt, up, acc);
+    to_device(qt, mag_earth, mag);
+    ahrs_t f;
+    ahrs_init(&f, AHRS_BETA, AHRS_ACCEL_GATE_G);
+    for (int i = 0; i < RATE_HZ * 60; i++) ahrs_update(&f, bias, acc, mag, 1.0f / RATE_HZ);
+    // No bias estimate in the filter: the error settles where the gain
+    // balances the bias instead of growing by 42 deg per minute
+    printf("0.7 deg/s gyro bias at rest for 60 s:\n");
+    expect_max("attitude error, deg", angle_err_deg(f.q, qt), 10.0);
+}
+
+static void block_api(void) {
+    enum { N = 64 };
+    imu_sample_t s[N];
+    attitude_sample_t out[N];
+    mag_sample_t m = { 0, 20, -5, -40, 25 };
+    for (int i = 0; i < N; i++) {
+        float t = i / (float)RATE_HZ;
+        s[i] = (imu_sample_t){ 1000000 + (int64_t)i * 1000000 / RATE_HZ, 0.02f * sinf(t), 0.01f, 1.0f,
+                               1.5f * sinf(t * 2), -1.0f * cosf(t * 1.7f), 30.0f, 25 };
+    }
+    ahrs_t a, b;
+    ahrs_init(&a, AHRS_BETA, AHRS_ACCEL_GATE_G);
+    ahrs_init(&b, AHRS_BETA, AHRS_ACCEL_GATE_G);
+    ahrs_update_block(&a, s, N, &m, out);
+    double max_err = 0;
+    for (int i = 0; i < N; i++) {
+        const float gyro[3] = { s[i].gx * DEG, s[i].gy * DEG, s[i].gz * DEG };
+        const float acc[3] = { s[i].ax, s[i].ay, s[i].az }, mag[3] = { m.mx, m.my, m.mz };
+        float dt = i ? (s[i].t_us - s[i - 1].t_us) * 1e-6f : 0.0f;
+        ahrs_update(&b, gyro, acc, mag, dt);
+        double e = angle_err_deg(out[i].q, b.q);
+        if (e > max_err) max_err = e;
+    }
+    printf("ahrs_update_block against ahrs_update:\n");
+    expect_max("maximum difference, deg", max_err, 0.01);
+}
+
+static void bench(void) {
+    float qt[4], acc[3], mag[3];
+    const float gyro[3] = { 0.01f, 0.02f, -0.01f };
+    tilted_pose(qt);
+    to_device(qt, up, acc);
+    to_device(qt, mag_earth, mag);
+    ahrs_t f;
+    ahrs_init(&f, AHRS_BETA, AHRS_ACCEL_GATE_G);
+    for (int with_mag = 1; with_mag >= 0; with_mag--) {
+        long n = 0;
+        double t0 = now_s(), t1;
+        do {
+            for (int i = 0; i < 100000; i++) ahrs_update(&f, gyro, acc, with_mag ? mag : NULL, 1.0f / RATE_HZ);
+            n += 100000;
+            t1 = now_s();
+        } while (t1 - t0 < MIN_RUN_S);
+        printf("%-9s %5.1f ns per update\n", with_mag ? "MARG:" : "IMU only:", (t1 - t0) * 1e9 / n);
+    }
+}
+
+int main(void) {
+    static_pose();
+    yaw_spin();
+    cornering();
+    gyro_bias();
+    block_api();
+    bench();
+    printf("AHRS checks: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
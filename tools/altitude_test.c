@@ -0,0 +1,140 @@
+// Accuracy checks and timing of the altitude kernel and the baro/GNSS
+// altitude filter on a PC.
+//
+//   gcc -O2 -I../main/include altitude_test.c ../main/altitude.c -lm -o altitude_test
+//   ./altitude_test
+//
+// The pressure kernel is compared with the double-precision formula over
+// its whole range, in the standard atmosphere and hypsometric at 20 deg C,
+// and timed against powf. The filter runs a simulated 20 min ride: QNH
+// 1025 hPa drifting 1.2 hPa/h, climbs at 1 m/s and descents at 2 m/s,
+// 25 Hz baro with 0.03 hPa noise and 1 Hz GNSS altitude with a slowly
+// wandering error. Also checked: pressure altitude before the first fix,
+// and that a late GNSS sample does not move the filter time back.
+// Exit status 1 if an error bound is exceeded.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "altitude.h"
+
+#define BARO_HZ         25
+#define RIDE_S          1200
+#define SETTLE_S        300     // Offset converged, errors counted from here
+#define MIN_RUN_S       1.0
+
+static int failures;
+
+static void expect_max(const char *what, double got, double max) {
+    printf("  %-40s %9.4f (limit %.4f)\n", what, got, max);
+    if (got <= max) return;
+    printf("FAIL %s\n", what);
+    failures++;
+}
+
+static double gauss(void) {
+    double u = (rand() + 1.0) / (RAND_MAX + 2.0), v = (rand() + 1.0) / (RAND_MAX + 2.0);
+    return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double isa_altitude(double p_hpa) {
+    return 44330.77 * (1 - pow(p_hpa / 1013.25, 0.190263));
+}
+
+static float powf_altitude(float p_hpa) {
+    return 44330.77f * (1.0f - powf(p_hpa / 1013.25f, 0.190263f));
+}
+
+static void kernel(void) {
+    double max_isa = 0, max_hyp = 0, max_powf = 0;
+    for (double p = ALTITUDE_P_MIN_HPA; p <= ALTITUDE_P_MAX_HPA; p += 0.013) {
+        double e = fabs(altitude_from_pressure((float)p, NAN) - isa_altitude(p));
+        if (e > max_isa) max_isa = e;
+        double hyp = (pow(1013.25 / p, 0.190263) - 1) * (20 + 273.15) / 0.0065;
+        e = fabs(altitude_from_pressure((float)p, 20.0f) - hyp);
+        if (e > max_hyp) max_hyp = e;
+        e = fabs(powf_altitude((float)p) - isa_altitude(p));
+        if (e > max_powf) max_powf = e;
+    }
+    printf("kernel, 250-1150 hPa against double (powf: %.4f m):\n", max_powf);
+    expect_max("standard atmosphere, m", max_isa, 0.05);
+    expect_max("hypsometric at 20 deg C, m", max_hyp, 0.05);
+    expect_max("clamped above the range, m",
+               fabs(altitude_from_pressure(1300.0f, NAN) - altitude_from_pressure(ALTITUDE_P_MAX_HPA, NAN)), 0);
+
+    for (int mode = 0; mode < 2; mode++) {
+        volatile float sink = 0;
+        long n = 0;
+        double t0 = now_s(), t1;
+        do {
+            for (int i = 0; i < 1000000; i++) {
+                float p = 900.0f + (i & 1023) * 0.1f;
+                sink += mode ? powf_altitude(p) : altitude_from_pressure(p, NAN);
+            }
+            n += 1000000;
+            t1 = now_s();
+        } while (t1 - t0 < MIN_RUN_S);
+        printf("  %-6s %5.1f ns per altitude\n", mode ? "powf:" : "table:", (t1 - t0) * 1e9 / n);
+    }
+}
+
+static void ride(void) {
+    const altitude_kf_params_t params = ALTITUDE_KF_DEFAULT_PARAMS;
+    altitude_kf_t f;
+    altitude_kf_init(&f, &params);
+    srand(3);
+
+    double h = 400, qnh = 1025, gnss_err = 0, se = 0, sv = 0, s_raw = 0;
+    double pre_fix_err = 0;
+    long n = 0;
+    for (long k = 0; k < (long)BARO_HZ * RIDE_S; k++) {
+        double t = (double)k / BARO_HZ;
+        double vz = t > 200 && t < 500 ? 1.0 : t > 700 && t < 800 ? -2.0 : 0.0;
+        h += vz / BARO_HZ;
+        qnh -= 1.2 / 3600 / BARO_HZ;
+        double p = qnh * pow(1 - 0.0065 * h / 288.15, 1 / 0.190263) + 0.03 * gauss();
+        int64_t t_us = 1 + (int64_t)llround(t * 1e6);
+        altitude_kf_baro(&f, t_us, altitude_from_pressure((float)p, NAN));
+
+        if (t < 10) {
+            // No fix yet: pressure altitude, the QNH error left in
+            double e = fabs(f.x[0] - isa_altitude(p));
+            if (k > BARO_HZ && e > pre_fix_err) pre_fix_err = e;
+        } else if (k % BARO_HZ == 0) {
+            gnss_err = 0.95 * gnss_err + 1.2 * gauss();
+            altitude_kf_gnss(&f, t_us, (float)(h + gnss_err + gauss()), 5.0f);
+        }
+        if (t > SETTLE_S) {
+            se += (f.x[0] - h) * (f.x[0] - h);
+            sv += (f.x[1] - vz) * (f.x[1] - vz);
+            s_raw += (isa_altitude(p) - h) * (isa_altitude(p) - h);
+            n++;
+        }
+    }
+    printf("20 min ride, QNH 1025 hPa drifting 1.2 hPa/h (fixed 1013.25 hPa: %.1f m RMS):\n", sqrt(s_raw / n));
+    expect_max("pressure altitude before the first fix, m", pre_fix_err, 2.0);
+    expect_max("altitude RMS, m", sqrt(se / n), 3.0);
+    expect_max("vertical speed RMS, m/s", sqrt(sv / n), 0.3);
+    expect_max("QNH error, hPa", fabs(altitude_kf_qnh(&f) - qnh), 1.0);
+    expect_max("measurements rejected", f.rejected, 0);
+
+    // A GNSS sample dated before the state must not move its time back
+    int64_t t_state = f.t_us;
+    float alt = f.x[0];
+    altitude_kf_gnss(&f, t_state - 200000, alt, 5.0f);
+    expect_max("state time moved by a late fix, us", (double)llabs(f.t_us - t_state), 0);
+}
+
+int main(void) {
+    kernel();
+    ride();
+    printf("altitude checks: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
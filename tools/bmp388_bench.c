@@ -0,0 +1,146 @@
+// Compares the BMP388 integer compensation with the double reference and
+// times both on a PC.
+//
+//   gcc -O2 -I../main/include bmp388_bench.c ../main/bmp388_comp.c -lm -o bmp388_bench
+//   ./bmp388_bench                  calibration of a production sensor
+//   ./bmp388_bench <42 hex digits>  NVM dump from register 0x31 on
+//
+// The raw temperature and pressure ranges are swept on a grid; pairs
+// whose reference result lies outside the operating range (-40..85 deg C,
+// 300..1250 hPa) are skipped, as the integer path clamps them. The NVM
+// bytes are also parsed back from the calibration. The timing only tells
+// the relative cost: the ESP32-S3 has no double FPU, so the gap there is
+// much wider than on a PC. Exit status 1 if a check fails.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bmp388_comp.h"
+
+#define MAX_ERR_PA      0.05
+#define MAX_ERR_C       0.011
+#define MIN_RUN_S       1.0
+
+static int failures;
+
+static void expect(const char *what, long got, long want) {
+    if (got == want) return;
+    printf("FAIL %s: got %ld, want %ld\n", what, got, want);
+    failures++;
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void to_nvm(const bmp388_calib_t *c, uint8_t nvm[BMP388_CALIB_LEN]) {
+    const uint16_t w[] = { c->par_t1, c->par_t2, (uint16_t)c->par_p1, (uint16_t)c->par_p2,
+                           c->par_p5, c->par_p6, (uint16_t)c->par_p9 };
+    const int at[] = { 0, 2, 5, 7, 11, 13, 17 };
+    for (int i = 0; i < 7; i++) {
+        nvm[at[i]] = w[i] & 0xFF;
+        nvm[at[i] + 1] = w[i] >> 8;
+    }
+    nvm[4] = (uint8_t)c->par_t3;
+    nvm[9] = (uint8_t)c->par_p3;
+    nvm[10] = (uint8_t)c->par_p4;
+    nvm[15] = (uint8_t)c->par_p7;
+    nvm[16] = (uint8_t)c->par_p8;
+    nvm[19] = (uint8_t)c->par_p10;
+    nvm[20] = (uint8_t)c->par_p11;
+}
+
+static int from_hex(const char *s, uint8_t nvm[BMP388_CALIB_LEN]) {
+    if (strlen(s) != 2 * BMP388_CALIB_LEN) return 0;
+    for (int i = 0; i < BMP388_CALIB_LEN; i++) {
+        unsigned v;
+        if (sscanf(s + 2 * i, "%2x", &v) != 1) return 0;
+        nvm[i] = (uint8_t)v;
+    }
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    // Production sensor
+    bmp388_calib_t c = { .par_t1 = 27212, .par_t2 = 19183, .par_t3 = -7, .par_p1 = -1328, .par_p2 = -3328,
+                         .par_p3 = 35, .par_p4 = -1, .par_p5 = 23636, .par_p6 = 23858, .par_p7 = 3,
+                         .par_p8 = -6, .par_p9 = 16111, .par_p10 = 24, .par_p11 = -60 };
+    uint8_t nvm[BMP388_CALIB_LEN];
+    if (argc > 1) {
+        if (!from_hex(argv[1], nvm)) {
+            fprintf(stderr, "usage: %s [%d hex digits of NVM]\n", argv[0], 2 * BMP388_CALIB_LEN);
+            return 2;
+        }
+        bmp388_calib_parse(nvm, &c);
+    } else {
+        bmp388_calib_t parsed;
+        to_nvm(&c, nvm);
+        bmp388_calib_parse(nvm, &parsed);
+        expect("NVM parse", memcmp(&parsed, &c, sizeof(c)), 0);
+    }
+    bmp388_calib_double_t d;
+    bmp388_calib_to_double(&c, &d);
+
+    double max_pa = 0, max_c = 0, sum_pa = 0;
+    long pairs = 0;
+    for (uint32_t rt = 6000000; rt <= 10000000; rt += 20000) {
+        for (uint32_t rp = 3000000; rp <= 9000000; rp += 20000) {
+            int32_t ti;
+            uint32_t pi;
+            double td, pd;
+            bmp388_compensate_double(&d, rp, rt, &td, &pd);
+            if (td < -40 || td > 85 || pd < 30000 || pd > 125000) continue;
+            bmp388_compensate_int(&c, rp, rt, &ti, &pi);
+            double e_pa = fabs(pi / 100.0 - pd), e_c = fabs(ti / 100.0 - td);
+            if (e_pa > max_pa) max_pa = e_pa;
+            if (e_c > max_c) max_c = e_c;
+            sum_pa += e_pa;
+            pairs++;
+        }
+    }
+    printf("%ld raw pairs in range: max %.4f Pa (mean %.4f), max %.4f deg C against double\n", pairs, max_pa,
+           pairs ? sum_pa / pairs : 0.0, max_c);
+    expect("pairs in range", pairs > 1000, 1);
+    expect("pressure within 0.05 Pa", max_pa <= MAX_ERR_PA, 1);
+    expect("temperature within 0.011 deg C", max_c <= MAX_ERR_C, 1);
+
+    // Out of range input is clamped, not wrapped
+    int32_t ti;
+    uint32_t pi;
+    bmp388_compensate_int(&c, 0, 0, &ti, &pi);
+    expect("clamped low temperature", ti >= -4000 && ti <= 8500, 1);
+    expect("clamped low pressure", pi >= 3000000u && pi <= 12500000u, 1);
+    bmp388_compensate_int(&c, 0xFFFFFF, 0xFFFFFF, &ti, &pi);
+    expect("clamped high temperature", ti >= -4000 && ti <= 8500, 1);
+    expect("clamped high pressure", pi >= 3000000u && pi <= 12500000u, 1);
+
+    // Timing over a slowly changing input, as at 50 Hz on the bike
+    for (int mode = 0; mode < 2; mode++) {
+        volatile double sink = 0;
+        long n = 0;
+        double t0 = now_s(), t1;
+        do {
+            for (uint32_t k = 0; k < 100000; k++) {
+                uint32_t rt = 8400000 + (k & 1023), rp = 6500000 + (k & 4095) * 3;
+                if (mode == 0) {
+                    bmp388_compensate_int(&c, rp, rt, &ti, &pi);
+                    sink += pi;
+                } else {
+                    double td, pd;
+                    bmp388_compensate_double(&d, rp, rt, &td, &pd);
+                    sink += pd;
+                }
+            }
+            n += 100000;
+            t1 = now_s();
+        } while (t1 - t0 < MIN_RUN_S);
+        printf("%-7s %6.1f ns per compensation\n", mode ? "double:" : "int64:", (t1 - t0) * 1e9 / n);
+    }
+
+    printf("BMP388 compensation checks: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,236 @@
+// Checks the error bounds documented in fastmath.h against double-precision
+// libm, and times the kernels against the C library on a PC.
+//
+//   gcc -O2 -I../main/include fastmath_test.c -lm -o fastmath_test
+//   ./fastmath_test
+//
+// Each float function is evaluated on 2M random points over the range its
+// doc comment states (log-uniform for the positive-only ones); the Q15
+// sine and cosine on every binary angle, atan2_q15 on random integer
+// coordinates with many short vectors, sqrt_q16 for exact rounding down.
+// Timing on the host says little about newlib's software float code on
+// the ESP32-S3, which is what the float kernels are for; it is printed
+// for comparison only. Exit status 1 if a documented bound is exceeded.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "fastmath.h"
+
+#define POINTS          2000000
+#define MIN_RUN_S       0.5
+
+static int failures;
+static float xs[POINTS], ys[POINTS];
+static volatile float sink;
+
+static void expect_max(const char *what, double got, double max) {
+    printf("  %-44s %10.3g (limit %.3g)\n", what, got, max);
+    if (got <= max) return;
+    printf("FAIL %s\n", what);
+    failures++;
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double uniform(double lo, double hi) {
+    return lo + (hi - lo) * (rand() / (double)RAND_MAX);
+}
+
+static float log_uniform(double lo_exp, double hi_exp) {
+    return (float)exp(uniform(lo_exp, hi_exp));
+}
+
+static void roots_and_atan(void) {
+    double inv = 0, sq = 0, at = 0, at_rel = 0;
+    for (int i = 0; i < POINTS; i++) {
+        float x = log_uniform(-40, 40);
+        double e = fabs(fast_inv_sqrtf(x) * sqrt((double)x) - 1);
+        if (e > inv) inv = e;
+        e = fabs(fast_sqrtf(x) / sqrt((double)x) - 1);
+        if (e > sq) sq = e;
+
+        // A quarter of the points close to the x axis, for the small-angle bound
+        float y = (float)uniform(-1, 1) * (i % 4 ? 1.0f : 1e-4f), xa = (float)uniform(-1, 1);
+        double r = atan2((double)y, (double)xa);
+        e = fabs(fast_atan2f(y, xa) - r);
+        if (e > at) at = e;
+        if (r != 0 && fabs(r) < 0.5 && e / fabs(r) > at_rel) at_rel = e / fabs(r);
+    }
+    printf("roots and atan2:\n");
+    expect_max("inv_sqrtf, relative", inv, 4.8e-6);
+    expect_max("sqrtf, relative", sq, 4.8e-6);
+    expect_max("atan2f, rad", at, 3.7e-6);
+    expect_max("atan2f below 0.5 rad, relative", at_rel, 4.6e-6);
+    expect_max("atan2f(0, 0)", fabs(fast_atan2f(0, 0)), 0);
+}
+
+static void exp_log_pow(void) {
+    double e2 = 0, l2 = 0, l2_ulp = 0, ln = 0, ex = 0, pw_baro = 0, pw = 0;
+    for (int i = 0; i < POINTS; i++) {
+        float x = (float)uniform(-125.9, 127.9);
+        double e = fabs(fast_exp2f(x) / exp2((double)x) - 1);
+        if (e > e2) e2 = e;
+
+        x = (float)uniform(0.5, 2);
+        e = fabs(fast_log2f(x) - log2((double)x));
+        if (e > l2) l2 = e;
+        e = fabs(fast_logf(x) - log((double)x));
+        if (e > ln) ln = e;
+
+        x = log_uniform(-80, 80);
+        double r = log2((double)x);
+        if (fabs(r) >= 1) {
+            e = fabs(fast_log2f(x) - r) / ldexp(1.0, ilogb(r) - 23);
+            if (e > l2_ulp) l2_ulp = e;
+        }
+
+        x = (float)uniform(-80, 80);
+        e = fabs(fast_expf(x) / exp((double)x) - 1) - 1e-7 * fabs(x);
+        if (e > ex) ex = e;
+
+        x = (float)uniform(0.25, 1.1);
+        e = fabs(fast_powf(x, 0.190263f) / pow((double)x, 0.190263) - 1);
+        if (e > pw_baro) pw_baro = e;
+
+        x = log_uniform(-5, 5);
+        float y = (float)uniform(-8, 8);
+        e = fabs(fast_powf(x, y) / pow((double)x, (double)y) - 1) - 1.2e-7 * fabs(y * log2((double)x));
+        if (e > pw) pw = e;
+    }
+    printf("exp, log, pow:\n");
+    expect_max("exp2f, relative", e2, 1.6e-7);
+    expect_max("log2f on [0.5, 2]", l2, 1.7e-7);
+    expect_max("log2f elsewhere, ulp of the result", l2_ulp, 1.6);
+    expect_max("logf on [0.5, 2]", ln, 1.3e-7);
+    expect_max("expf, relative beyond 1e-7 |x|", ex, 1.6e-7);
+    expect_max("powf barometric exponent, relative", pw_baro, 1.9e-7);
+    expect_max("powf, relative beyond 1.2e-7 |y log2 x|", pw, 5e-7);
+}
+
+static void sin_cos(void) {
+    double e100 = 0, e12k = 0;
+    for (int i = 0; i < POINTS; i++) {
+        float x = (float)uniform(-100, 100);
+        double e = fmax(fabs(fast_sinf(x) - sin((double)x)), fabs(fast_cosf(x) - cos((double)x)));
+        if (e > e100) e100 = e;
+        x = (float)uniform(-12000, 12000);
+        e = fmax(fabs(fast_sinf(x) - sin((double)x)), fabs(fast_cosf(x) - cos((double)x)));
+        if (e > e12k) e12k = e;
+    }
+    printf("sincosf:\n");
+    expect_max("up to 100 rad", e100, 9e-8);
+    expect_max("up to 12000 rad", e12k, 9e-8);
+}
+
+static double haversine(int32_t lat1, int32_t lon1, int32_t lat2, int32_t lon2) {
+    double p1 = lat1 * 1e-7 * M_PI / 180, p2 = lat2 * 1e-7 * M_PI / 180, dl = (double)lon2 - lon1;
+    if (dl > 1.8e9) dl -= 3.6e9;
+    if (dl < -1.8e9) dl += 3.6e9;
+    dl *= 1e-7 * M_PI / 180;
+    double a = pow(sin((p2 - p1) / 2), 2) + cos(p1) * cos(p2) * pow(sin(dl / 2), 2);
+    return 2 * FAST_EARTH_R_M * atan2(sqrt(a), sqrt(1 - a));
+}
+
+static void distance(void) {
+    double rel = 0, abs_short = 0;
+    for (int i = 0; i < POINTS; i++) {
+        // Legs of about 1 m, 10 km and across the globe
+        double span = i % 3 == 0 ? 1e2 : i % 3 == 1 ? 1e6 : 1e9;
+        int32_t lat1 = (int32_t)uniform(-8.5e8, 8.5e8), lon1 = (int32_t)uniform(-1.8e9, 1.8e9);
+        double lat2 = fmin(fmax(lat1 + uniform(-span, span), -9e8), 9e8), lon2 = lon1 + uniform(-span, span);
+        if (lon2 > 1.8e9) lon2 -= 3.6e9;
+        if (lon2 < -1.8e9) lon2 += 3.6e9;
+        double d = haversine(lat1, lon1, (int32_t)lat2, (int32_t)lon2);
+        double e = fabs(fast_haversine_m(lat1, lon1, (int32_t)lat2, (int32_t)lon2) - d);
+        if (d < 100 && e > abs_short) abs_short = e;
+        if (e > 5e-4 && d > 0 && e / d > rel) rel = e / d;
+    }
+    printf("haversine:\n");
+    expect_max("relative, where the error is over 0.5 mm", rel, 1e-5);
+    expect_max("legs under 100 m, m", abs_short, 5e-4);
+}
+
+static void fixed_point(void) {
+    int sin_lsb = 0;
+    for (int a = 0; a < 65536; a++) {
+        int e = abs(fast_sin_q15((uint16_t)a) - (int)lrint(32767 * sin(a * 2 * M_PI / 65536)));
+        if (e > sin_lsb) sin_lsb = e;
+        e = abs(fast_cos_q15((uint16_t)a) - (int)lrint(32767 * cos(a * 2 * M_PI / 65536)));
+        if (e > sin_lsb) sin_lsb = e;
+    }
+    double at_lsb = 0;
+    long sqrt_wrong = 0;
+    for (int i = 0; i < POINTS; i++) {
+        int32_t y = (int32_t)uniform(-2e9, 2e9), x = (int32_t)uniform(-2e9, 2e9);
+        if (i % 3 == 0) y /= 1000;
+        if (i % 5 == 0) x /= 100000;
+        double d = fast_atan2_q15(y, x) - atan2((double)y, (double)x) * FAST_ANGLE_PI / M_PI;
+        if (d > 32768) d -= 65536;
+        if (d < -32768) d += 65536;
+        if (fabs(d) > at_lsb) at_lsb = fabs(d);
+
+        uint32_t v = (uint32_t)rand() * 2u + (rand() & 1);
+        if (i % 4 == 0) v &= 0xffff;
+        uint64_t r = fast_sqrt_q16(v), n = (uint64_t)v << 16;
+        sqrt_wrong += !(r * r <= n && (r + 1) * (r + 1) > n);
+    }
+    printf("fixed point:\n");
+    expect_max("sin_q15 and cos_q15, LSB", sin_lsb, 1);
+    expect_max("atan2_q15, LSB", at_lsb, 1.2);
+    expect_max("sqrt_q16 not rounded down", sqrt_wrong, 0);
+}
+
+#define BENCH(name, fast, libc) do {                                        \
+    double t[2];                                                            \
+    for (int m = 0; m < 2; m++) {                                           \
+        float acc = 0;                                                      \
+        long n = 0;                                                         \
+        double t0 = now_s(), t1;                                            \
+        do {                                                                \
+            for (int i = 0; i < POINTS; i++) {                              \
+                float x = xs[i], y = ys[i];                                 \
+                (void)x, (void)y;                                           \
+                acc += m ? (libc) : (fast);                                 \
+            }                                                               \
+            n += POINTS;                                                    \
+            t1 = now_s();                                                   \
+        } while (t1 - t0 < MIN_RUN_S);                                      \
+        sink = acc;                                                         \
+        t[m] = (t1 - t0) * 1e9 / n;                                         \
+    }                                                                       \
+    printf("  %-10s %6.2f %6.2f\n", name, t[0], t[1]);                      \
+} while (0)
+
+static void bench(void) {
+    for (int i = 0; i < POINTS; i++) {
+        xs[i] = (float)uniform(0.01, 100);
+        ys[i] = (float)uniform(-3, 3);
+    }
+    printf("ns per call     fast   libc\n");
+    BENCH("inv_sqrt", fast_inv_sqrtf(x), 1.0f / sqrtf(x));
+    BENCH("atan2", fast_atan2f(y, x), atan2f(y, x));
+    BENCH("exp", fast_expf(y), expf(y));
+    BENCH("log", fast_logf(x), logf(x));
+    BENCH("pow", fast_powf(x, 0.190263f), powf(x, 0.190263f));
+    BENCH("sin", fast_sinf(y * 10), sinf(y * 10));
+    BENCH("sin_q15", (float)fast_sin_q15((uint16_t)(x * 600)), 32767 * sinf(x * 600 * 6.2831853f / 65536));
+    BENCH("atan2_q15", (float)fast_atan2_q15((int32_t)(y * 1e6f), (int32_t)(x * 1e6f)), atan2f(y, x) * 10430.378f);
+}
+
+int main(void) {
+    srand(1);
+    roots_and_atan();
+    exp_log_pow();
+    sin_cos();
+    distance();
+    fixed_point();
+    bench();
+    printf("fastmath checks: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,162 @@
+// Checks the LSM6DSR FIFO decoder and measures its speed on a PC.
+//
+//   gcc -O2 -I../main/include fifo_bench.c ../main/lsm6dsr_fifo.c -o fifo_bench
+//   ./fifo_bench
+//
+// A synthetic FIFO stream holds batch slots whose gyro, accel and
+// timestamp words come in every order, with temperature words mixed in,
+// some slots without a timestamp (the latest one is reused) and some
+// missing the gyro word (dropped, counted incomplete). The stream is fed
+// in bursts of random length with a random output capacity, so slots are
+// split across reads and words are left over for the next call; every
+// sample must come out once, in order, with its own values. Also checks
+// the ODR codes. Exit status 1 if a check fails.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "lsm6dsr_fifo.h"
+
+#define SLOTS           20000
+#define MAX_WORDS       (SLOTS * 4)
+#define MIN_RUN_S       1.0
+
+typedef struct {
+    uint32_t timestamp;
+    int16_t v;
+} want_t;
+
+static int failures;
+static uint8_t words[MAX_WORDS * LSM6DSR_FIFO_WORD_LEN];
+static size_t n_words;
+static want_t want[SLOTS];
+static size_t n_want, n_incomplete;
+
+static void expect(const char *what, long got, long want) {
+    if (got == want) return;
+    if (failures < 20) printf("FAIL %s: got %ld, want %ld\n", what, got, want);
+    failures++;
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void put(int sensor, int slot, int32_t v) {
+    uint8_t *w = &words[n_words++ * LSM6DSR_FIFO_WORD_LEN];
+    memset(w, 0, LSM6DSR_FIFO_WORD_LEN);
+    w[0] = (uint8_t)((sensor << 3) | (slot << 1));
+    if (sensor == LSM6DSR_TAG_TIMESTAMP) {
+        for (int k = 0; k < 4; k++) w[1 + k] = (uint8_t)(v >> (8 * k));
+        return;
+    }
+    for (int k = 0; k < 3; k++) {
+        w[1 + 2 * k] = (uint8_t)(v + k);
+        w[2 + 2 * k] = (uint8_t)((v + k) >> 8);
+    }
+}
+
+// Gyro carries +s, accel -s, so a mixed-up slot shows
+static void build_stream(void) {
+    uint32_t ts = 0, last_ts = 0;
+    n_words = n_want = n_incomplete = 0;
+    for (int s = 0; s < SLOTS; s++) {
+        int slot = s & 3;
+        int with_ts = rand() % 8 != 0;
+        int with_gyro = rand() % 500 != 0;
+        int order[3] = { LSM6DSR_TAG_GYRO, LSM6DSR_TAG_ACCEL, LSM6DSR_TAG_TIMESTAMP };
+        for (int k = 2; k > 0; k--) {
+            int j = rand() % (k + 1), t = order[k];
+            order[k] = order[j];
+            order[j] = t;
+        }
+        ts += 96;       // 416 Hz in 25 us ticks
+        for (int k = 0; k < 3; k++) {
+            if (order[k] == LSM6DSR_TAG_TIMESTAMP && !with_ts) continue;
+            if (order[k] == LSM6DSR_TAG_GYRO && !with_gyro) continue;
+            put(order[k], slot, order[k] == LSM6DSR_TAG_TIMESTAMP ? (int32_t)ts :
+                                order[k] == LSM6DSR_TAG_GYRO ? s : -s);
+            if (rand() % 50 == 0) put(LSM6DSR_TAG_TEMP, slot, 0x1234);
+        }
+        // Without its own timestamp a slot reuses the latest one, even
+        // from a slot that was dropped
+        if (with_ts) last_ts = ts;
+        if (!with_gyro) {
+            n_incomplete++;
+            continue;
+        }
+        want[n_want++] = (want_t){ last_ts, (int16_t)s };
+    }
+}
+
+static void check_stream(void) {
+    lsm6dsr_fifo_decoder_t d;
+    lsm6dsr_fifo_sample_t out[64];
+    lsm6dsr_fifo_decoder_init(&d);
+    size_t pos = 0, got = 0;
+    while (pos < n_words) {
+        size_t chunk = 1 + (size_t)rand() % 64, max_out = 1 + (size_t)rand() % 16, used;
+        if (chunk > n_words - pos) chunk = n_words - pos;
+        size_t k = lsm6dsr_fifo_decode(&d, &words[pos * LSM6DSR_FIFO_WORD_LEN], chunk, out, max_out, &used);
+        expect("output within capacity", k <= max_out, 1);
+        for (size_t j = 0; j < k && got < n_want; j++, got++) {
+            const want_t *w = &want[got];
+            expect("gyro", out[j].gyro[0], w->v);
+            expect("gyro z", out[j].gyro[2], (int16_t)(w->v + 2));
+            expect("accel", out[j].acc[0], (int16_t)-w->v);
+            expect("timestamp", (long)out[j].timestamp, (long)w->timestamp);
+        }
+        pos += used;
+    }
+    // The last slot is closed by the next read
+    lsm6dsr_fifo_sample_t last;
+    uint8_t next[LSM6DSR_FIFO_WORD_LEN] = { (uint8_t)(LSM6DSR_TAG_TEMP << 3) };
+    got += lsm6dsr_fifo_decode(&d, next, 1, &last, 1, NULL);
+
+    printf("%zu words, %zu sample sets, %lu incomplete, %lu other words\n", n_words, got,
+           (unsigned long)d.incomplete, (unsigned long)d.other);
+    expect("sample sets", (long)got, (long)n_want);
+    expect("incomplete slots", (long)d.incomplete, (long)n_incomplete);
+}
+
+static void check_odr(void) {
+    expect("416 Hz code", lsm6dsr_odr_code(416), 6);
+    expect("417 Hz code", lsm6dsr_odr_code(417), 6);
+    expect("418 Hz rounds up", lsm6dsr_odr_code(418), 7);
+    expect("above 6667 Hz", lsm6dsr_odr_code(10000), 10);
+    for (uint8_t c = 1; c <= 10; c++) expect("code round trip", lsm6dsr_odr_code(lsm6dsr_odr_hz(c)), c);
+    expect("invalid code", lsm6dsr_odr_hz(0), 0);
+}
+
+static void bench(void) {
+    static lsm6dsr_fifo_sample_t out[SLOTS];
+    lsm6dsr_fifo_decoder_t d;
+    long words_done = 0;
+    volatile size_t sets = 0;
+    double t0 = now_s(), t1;
+    do {
+        lsm6dsr_fifo_decoder_init(&d);
+        // Watermark bursts of 32 sets, as imu_task reads them
+        for (size_t pos = 0; pos < n_words;) {
+            size_t chunk = n_words - pos < 96 ? n_words - pos : 96, used;
+            sets += lsm6dsr_fifo_decode(&d, &words[pos * LSM6DSR_FIFO_WORD_LEN], chunk, out, SLOTS, &used);
+            pos += used;
+        }
+        words_done += (long)n_words;
+        t1 = now_s();
+    } while (t1 - t0 < MIN_RUN_S);
+    printf("decode: %.2f ns per word\n", (t1 - t0) * 1e9 / words_done);
+}
+
+int main(void) {
+    srand(11);
+    check_odr();
+    build_stream();
+    check_stream();
+    bench();
+    printf("FIFO decoder checks: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
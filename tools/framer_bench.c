@@ -0,0 +1,311 @@
+// Compares the GNSS stream framer with the byte state machine it replaced,
+// on clean, noisy and truncated interleaved NMEA + UBX captures.
+//
+//   gcc -O2 -I../main/include framer_bench.c ../main/gnss_framer.c ../main/ubx.c ../main/nmea.c -o framer_bench
+//   ./framer_bench
+//
+// Each capture is a 25 Hz stream of RMC, GGA, GSA, NAV-PVT, NAV-DOP and
+// NAV-EOE. The noisy one flips a byte in 1 frame of 200 and adds bursts
+// of random bytes between frames; the truncated one cuts 1 frame of 100
+// short, as an overrun of the UART ring does. Both framers feed the same
+// decoders in UART-sized chunks; the figure is capture bytes per CPU
+// second. Exit status 1 if the framer misses an intact frame or delivers
+// a damaged one.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "gnss_framer.h"
+#include "nmea.h"
+#include "ubx.h"
+
+#define SYNTH_SECONDS   600
+#define SYNTH_HZ        25
+#define CHUNK           2048    // BUF_SIZE in gnss.c
+#define MIN_RUN_S       1.0
+
+typedef struct {
+    const char *name;
+    uint8_t *buf;
+    size_t size;
+    uint32_t intact;        // Frames left whole
+} capture_t;
+
+// What both framers hand over, counted outside the decoders
+typedef struct {
+    uint32_t good;          // Checksum verified
+    uint32_t bad;           // Handed to a decoder with a wrong checksum
+} delivered_t;
+
+static nmea_decoder_t nmea;
+static ubx_engine_t ubx;
+static delivered_t got;
+static int accounting;
+
+static double cpu_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int nmea_checksum_ok(const uint8_t *s, size_t len) {
+    uint8_t x = 0;
+    size_t i = 1;
+    while (i < len && s[i] != '*') x ^= s[i++];
+    unsigned ck;
+    return i + 3 <= len && sscanf((const char *)s + i + 1, "%2X", &ck) == 1 && ck == x;
+}
+
+static void on_nmea(const uint8_t *s, size_t len) {
+    nmea_decode(&nmea, (const char *)s, len);
+    if (!accounting) return;
+    if (nmea_checksum_ok(s, len)) got.good++;
+    else got.bad++;
+}
+
+// ---- The loop in gnss_task_entry before the framer, decoding aside ----
+
+typedef enum {
+    PARSE_IDLE,
+    PARSE_NMEA,
+    PARSE_UBX_SYNC1,
+    PARSE_UBX_CLASS,
+    PARSE_UBX_ID,
+    PARSE_UBX_LEN1,
+    PARSE_UBX_LEN2,
+    PARSE_UBX_PAYLOAD,
+    PARSE_UBX_CKA,
+    PARSE_UBX_CKB
+} ParserState;
+
+typedef struct {
+    ParserState state;
+    uint8_t nmea_buf[256];
+    int nmea_idx;
+    uint8_t ubx_payload[1024];
+    int ubx_idx, ubx_len;
+    uint8_t ubx_class, ubx_id, ubx_ck_a;
+} old_parser_t;
+
+static void old_feed(old_parser_t *p, const uint8_t *data, int len) {
+    for (int i = 0; i < len; i++) {
+        uint8_t byte = data[i];
+
+        if (p->state == PARSE_IDLE || p->state == PARSE_NMEA) {
+            if (byte == '$') {
+                p->state = PARSE_NMEA;
+                p->nmea_idx = 0;
+                p->nmea_buf[p->nmea_idx++] = byte;
+            } else if (p->state == PARSE_NMEA) {
+                if (p->nmea_idx < (int)sizeof(p->nmea_buf) - 1) {
+                    p->nmea_buf[p->nmea_idx++] = byte;
+                    if (byte == '\n') {
+                        on_nmea(p->nmea_buf, p->nmea_idx);
+                        p->state = PARSE_IDLE;
+                    }
+                } else {
+                    p->state = PARSE_IDLE;
+                }
+            }
+        }
+
+        if (p->state == PARSE_IDLE && byte == UBX_SYNC_CHAR_1) {
+            p->state = PARSE_UBX_SYNC1;
+        } else if (p->state == PARSE_UBX_SYNC1) {
+            if (byte == UBX_SYNC_CHAR_2) p->state = PARSE_UBX_CLASS;
+            else p->state = PARSE_IDLE;
+        } else if (p->state == PARSE_UBX_CLASS) {
+            p->ubx_class = byte;
+            p->state = PARSE_UBX_ID;
+        } else if (p->state == PARSE_UBX_ID) {
+            p->ubx_id = byte;
+            p->state = PARSE_UBX_LEN1;
+        } else if (p->state == PARSE_UBX_LEN1) {
+            p->ubx_len = byte;
+            p->state = PARSE_UBX_LEN2;
+        } else if (p->state == PARSE_UBX_LEN2) {
+            p->ubx_len |= (byte << 8);
+            p->ubx_idx = 0;
+            if (p->ubx_len > 1024) p->state = PARSE_IDLE;
+            else p->state = PARSE_UBX_PAYLOAD;
+        } else if (p->state == PARSE_UBX_PAYLOAD) {
+            if (p->ubx_idx < p->ubx_len) p->ubx_payload[p->ubx_idx++] = byte;
+            if (p->ubx_idx == p->ubx_len) p->state = PARSE_UBX_CKA;
+        } else if (p->state == PARSE_UBX_CKA) {
+            p->ubx_ck_a = byte;
+            p->state = PARSE_UBX_CKB;
+        } else if (p->state == PARSE_UBX_CKB) {
+            ubx_status_t st = ubx_engine_process(&ubx, p->ubx_class, p->ubx_id, p->ubx_payload,
+                                                 (uint16_t)p->ubx_len, p->ubx_ck_a, byte);
+            if (accounting) {
+                if (st == UBX_ERR_CHECKSUM) got.bad++;
+                else got.good++;
+            }
+            p->state = PARSE_IDLE;
+        }
+    }
+}
+
+// ---- The framer, as gnss.c drives it ----
+
+static void on_frame(void *ctx, gnss_frame_type_t type, const uint8_t *frame, size_t len) {
+    (void)ctx;
+    if (type == GNSS_FRAME_NMEA) {
+        on_nmea(frame, len);
+        return;
+    }
+    ubx_engine_dispatch(&ubx, frame[2], frame[3], &frame[UBX_HEADER_LEN], (uint16_t)(len - UBX_FRAME_OVERHEAD));
+    if (accounting) got.good++;
+}
+
+// ---- Captures ----
+
+typedef enum { CLEAN, NOISY, TRUNCATED } damage_t;
+
+static size_t emit_nmea(uint8_t *out, const char *body) {
+    uint8_t x = 0;
+    for (const char *p = body; *p; p++) x ^= (uint8_t)*p;
+    return (size_t)sprintf((char *)out, "$%s*%02X\r\n", body, x);
+}
+
+// Appends a frame, damaged or not; returns 1 if it went in whole
+static int append(capture_t *c, const uint8_t *frame, size_t len, damage_t damage) {
+    uint8_t *out = c->buf + c->size;
+    memcpy(out, frame, len);
+    if (damage == NOISY && rand() % 200 == 0) {
+        // Bit errors past the first byte: a damaged sync is just a lost frame
+        size_t at = 1 + (size_t)rand() % (len - 1);
+        out[at] ^= (uint8_t)(1 + rand() % 255);
+        c->size += len;
+        return 0;
+    }
+    if (damage == TRUNCATED && rand() % 100 == 0) {
+        c->size += 1 + (size_t)rand() % (len - 1);
+        return 0;
+    }
+    c->size += len;
+    if (damage == NOISY && rand() % 500 == 0) {
+        for (int n = 1 + rand() % 64; n > 0; n--) c->buf[c->size++] = (uint8_t)rand();
+    }
+    return 1;
+}
+
+static capture_t synthesize(const char *name, damage_t damage) {
+    capture_t c = { .name = name };
+    c.buf = malloc((size_t)SYNTH_SECONDS * SYNTH_HZ * 1024);
+    uint8_t frame[256];
+    char body[160];
+    srand(7 + damage);
+    for (int e = 0; e < SYNTH_SECONDS * SYNTH_HZ; e++) {
+        int ms = e * (1000 / SYNTH_HZ);
+        int s = ms / 1000 % 60, m = ms / 60000 % 60, h = 10 + ms / 3600000;
+        double lat = 4717.11437 + e * 1e-5, lon = 833.91522 + e * 2e-5;
+        double kn = 20.0 + (rand() % 1000) * 0.01;
+        snprintf(body, sizeof(body), "GNRMC,%02d%02d%02d.%02d,A,%.5f,N,%010.5f,E,%.3f,%.2f,160926,,,A,V",
+                 h, m, s, ms % 1000 / 10, lat, lon, kn, 77.52);
+        c.intact += append(&c, frame, emit_nmea(frame, body), damage);
+        snprintf(body, sizeof(body), "GNGGA,%02d%02d%02d.%02d,%.5f,N,%010.5f,E,1,32,0.61,%.1f,M,48.0,M,,",
+                 h, m, s, ms % 1000 / 10, lat, lon, 499.6 + (rand() % 100) * 0.1);
+        c.intact += append(&c, frame, emit_nmea(frame, body), damage);
+        c.intact += append(&c, frame, emit_nmea(frame, "GNGSA,A,3,01,02,03,04,05,06,07,08,,,,,1.04,0.61,0.84,1"),
+                           damage);
+
+        ubx_nav_pvt_t pvt = { .iTOW = 123456000u + ms, .fixType = 3, .flags = UBX_PVT_FLAGS_FIXOK, .numSV = 32,
+                              .lat = 472852332 + e * 10, .lon = 85652650 + e * 20, .hMSL = 499600,
+                              .gSpeed = (int32_t)(kn * 514.444) };
+        c.intact += append(&c, frame, ubx_build_frame(UBX_CLASS_NAV, UBX_ID_NAV_PVT, (const uint8_t *)&pvt,
+                                                      sizeof(pvt), frame, sizeof(frame)), damage);
+        ubx_nav_dop_t dop = { .iTOW = pvt.iTOW, .pDOP = 104, .hDOP = 61, .vDOP = 84 };
+        c.intact += append(&c, frame, ubx_build_frame(UBX_CLASS_NAV, UBX_ID_NAV_DOP, (const uint8_t *)&dop,
+                                                      sizeof(dop), frame, sizeof(frame)), damage);
+        c.intact += append(&c, frame, ubx_build_frame(UBX_CLASS_NAV, UBX_ID_NAV_EOE, (const uint8_t *)&pvt.iTOW,
+                                                      4, frame, sizeof(frame)), damage);
+    }
+    return c;
+}
+
+// ---- Runs ----
+
+static void run_old(const capture_t *c) {
+    static old_parser_t p;
+    memset(&p, 0, sizeof(p));
+    for (size_t i = 0; i < c->size; i += CHUNK) {
+        old_feed(&p, c->buf + i, (int)(c->size - i < CHUNK ? c->size - i : CHUNK));
+    }
+}
+
+static void run_new(const capture_t *c) {
+    static gnss_framer_t fr;
+    gnss_framer_init(&fr, on_frame, NULL);
+    for (size_t i = 0; i < c->size; i += CHUNK) {
+        gnss_framer_feed(&fr, c->buf + i, c->size - i < CHUNK ? c->size - i : CHUNK);
+    }
+}
+
+static delivered_t account(void (*run)(const capture_t *), const capture_t *c) {
+    memset(&got, 0, sizeof(got));
+    accounting = 1;
+    run(c);
+    accounting = 0;
+    return got;
+}
+
+static double bytes_per_cpu_s(void (*run)(const capture_t *), const capture_t *c) {
+    unsigned passes = 0;
+    double t0 = cpu_s(), t;
+    do {
+        run(c);
+        passes++;
+    } while ((t = cpu_s() - t0) < MIN_RUN_S);
+    return c->size * (double)passes / t;
+}
+
+// Frames arriving in odd chunk sizes must come out the same
+static int check_chunking(const capture_t *c, uint32_t want) {
+    static gnss_framer_t fr;
+    gnss_framer_init(&fr, on_frame, NULL);
+    memset(&got, 0, sizeof(got));
+    accounting = 1;
+    srand(3);
+    for (size_t i = 0, n; i < c->size; i += n) {
+        n = 1 + (size_t)rand() % 97;
+        if (n > c->size - i) n = c->size - i;
+        gnss_framer_feed(&fr, c->buf + i, n);
+    }
+    accounting = 0;
+    return got.good == want && got.bad == 0;
+}
+
+int main(void) {
+    int failures = 0;
+    nmea_decoder_init(&nmea);
+    ubx_engine_init(&ubx);
+
+    capture_t caps[] = {
+        synthesize("clean", CLEAN),
+        synthesize("noisy", NOISY),
+        synthesize("truncated", TRUNCATED),
+    };
+    printf("%-10s %10s %8s | %-24s %8s | %-24s %8s %7s\n", "capture", "bytes", "intact",
+           "old loop: good / bad", "MB/cpu-s", "framer: good / bad", "MB/cpu-s", "speedup");
+    for (size_t i = 0; i < sizeof(caps) / sizeof(caps[0]); i++) {
+        const capture_t *c = &caps[i];
+        delivered_t o = account(run_old, c);
+        delivered_t n = account(run_new, c);
+        double old_bps = bytes_per_cpu_s(run_old, c);
+        double new_bps = bytes_per_cpu_s(run_new, c);
+        printf("%-10s %10zu %8u | %11u / %-10u %8.1f | %11u / %-10u %8.1f %6.2fx\n", c->name, c->size, c->intact,
+               o.good, o.bad, old_bps * 1e-6, n.good, n.bad, new_bps * 1e-6, new_bps / old_bps);
+        if (n.good != c->intact || n.bad != 0) {
+            printf("FAIL %s: the framer delivered %u of %u intact frames\n", c->name, n.good, c->intact);
+            failures++;
+        }
+        if (!check_chunking(c, c->intact)) {
+            printf("FAIL %s: 1-97 byte chunks framed differently\n", c->name);
+            failures++;
+        }
+    }
+    for (size_t i = 0; i < sizeof(caps) / sizeof(caps[0]); i++) free(caps[i].buf);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,207 @@
+// Checks the GNSS aiding record and the frames gnss.c sends with it, on a
+// PC.
+//
+//   gcc -O2 -I../main/include gnss_aid_test.c ../main/gnss_aid.c ../main/ubx.c -o gnss_aid_test
+//   ./gnss_aid_test
+//
+// gnss_aid_utc_seconds against dates worked out independently (the
+// epoch, leap days, 2038, 2100). MGA-INI-POS_LLH and MGA-INI-TIME_UTC,
+// the UPD-SOS poll and create frames and the CFG-RST GNSS start and stop
+// frames byte for byte against reference frames, checksums included;
+// the four fixed frames are the ones given in the u-blox interface
+// description. gnss_aid_parse_sos on restore statuses, on the ACK and NAK
+// a backup is answered with, and on short payloads. The record: made from
+// a fix, refused without a position, date or time, checked after a
+// round trip through storage, rejected with a wrong version, a position
+// out of range or a clock from before GNSS_AID_TIME_MIN_UTC_S, and its
+// ephemeris judged stale after GNSS_AID_EPH_MAX_AGE_S. Exit status 1 if
+// a check fails.
+
+#include <stdio.h>
+#include <string.h>
+#include "gnss_aid.h"
+
+static int failures;
+
+static void expect(const char *what, long long got, long long want) {
+    if (got == want) return;
+    printf("FAIL %s: got %lld, want %lld\n", what, got, want);
+    failures++;
+}
+
+static void expect_frame(const char *what, const uint8_t *got, size_t len, const uint8_t *want, size_t want_len) {
+    if (len == want_len && memcmp(got, want, len) == 0) return;
+    printf("FAIL %s:\n  got ", what);
+    for (size_t i = 0; i < len; i++) printf(" %02X", got[i]);
+    printf("\n  want");
+    for (size_t i = 0; i < want_len; i++) printf(" %02X", want[i]);
+    printf("\n");
+    failures++;
+}
+
+static void utc_seconds(void) {
+    static const struct {
+        uint16_t year;
+        uint8_t month, day, hour, min, sec;
+        long long want;
+    } dates[] = {
+        { 1970, 1, 1, 0, 0, 0, 0 },
+        { 1969, 12, 31, 23, 59, 59, -1 },
+        { 2000, 2, 29, 12, 0, 0, 951825600 },
+        { 2000, 3, 1, 0, 0, 0, 951868800 },
+        { 2024, 2, 29, 12, 34, 56, 1709210096 },
+        { 2038, 1, 19, 3, 14, 8, 2147483648LL },
+        { 2100, 3, 1, 0, 0, 0, 4107542400LL },
+        { 2026, 10, 16, 8, 30, 15, 1792139415 },
+    };
+    for (size_t i = 0; i < sizeof(dates) / sizeof(dates[0]); i++) {
+        char what[64];
+        snprintf(what, sizeof(what), "utc seconds of %04u-%02u-%02u", dates[i].year, dates[i].month, dates[i].day);
+        expect(what, gnss_aid_utc_seconds(dates[i].year, dates[i].month, dates[i].day, dates[i].hour,
+                                          dates[i].min, dates[i].sec), dates[i].want);
+    }
+}
+
+static void fixed_frames(void) {
+    static const uint8_t poll[] = { 0xB5, 0x62, 0x09, 0x14, 0x00, 0x00, 0x1D, 0x60 };
+    static const uint8_t create[] = { 0xB5, 0x62, 0x09, 0x14, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0xEC };
+    static const uint8_t stop[] = { 0xB5, 0x62, 0x06, 0x04, 0x04, 0x00, 0x00, 0x00, 0x08, 0x00, 0x16, 0x74 };
+    static const uint8_t start[] = { 0xB5, 0x62, 0x06, 0x04, 0x04, 0x00, 0x00, 0x00, 0x09, 0x00, 0x17, 0x76 };
+    uint8_t buf[GNSS_AID_FRAME_MAX];
+    expect_frame("UPD-SOS poll", buf, gnss_aid_encode_sos_poll(buf, sizeof(buf)), poll, sizeof(poll));
+    expect_frame("UPD-SOS create", buf, gnss_aid_encode_sos_create(buf, sizeof(buf)), create, sizeof(create));
+    expect_frame("CFG-RST GNSS stop", buf, gnss_aid_encode_gnss_stop(buf, sizeof(buf)), stop, sizeof(stop));
+    expect_frame("CFG-RST GNSS start", buf, gnss_aid_encode_gnss_start(buf, sizeof(buf)), start, sizeof(start));
+    expect("UPD-SOS create into a short buffer", (long long)gnss_aid_encode_sos_create(buf, sizeof(create) - 1), 0);
+}
+
+static void aiding_frames(void) {
+    // 22.5431234 N 113.9421234 E, 50.123 m, 2.5 m: 10 km added for the
+    // time the device was off
+    static const uint8_t pos[] = {
+        0xB5, 0x62, 0x13, 0x40, 0x14, 0x00, 0x01, 0x00, 0x00, 0x00, 0xC2, 0xCE, 0x6F, 0x0D, 0x32, 0x30,
+        0xEA, 0x43, 0x94, 0x13, 0x00, 0x00, 0x3A, 0x43, 0x0F, 0x00, 0x36, 0x1C,
+    };
+    // 33.8567890 S 70.0123456 W, 12.345 m below sea level
+    static const uint8_t pos_sw[] = {
+        0xB5, 0x62, 0x13, 0x40, 0x14, 0x00, 0x01, 0x00, 0x00, 0x00, 0x2E, 0xDD, 0xD1, 0xEB, 0xC0, 0xF6,
+        0x44, 0xD6, 0x2E, 0xFB, 0xFF, 0xFF, 0x40, 0x42, 0x0F, 0x00, 0xB7, 0x6A,
+    };
+    // 2026-10-16 08:30:15 UTC +- 2 s, leap seconds unknown
+    static const uint8_t time_utc[] = {
+        0xB5, 0x62, 0x13, 0x40, 0x18, 0x00, 0x10, 0x00, 0x00, 0x80, 0xEA, 0x07, 0x0A, 0x10, 0x08, 0x1E,
+        0x0F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3D, 0xF9,
+    };
+    uint8_t buf[GNSS_AID_FRAME_MAX];
+    gnss_aid_record_t rec = { .version = GNSS_AID_VERSION, .fix_type = 3, .lat = 225431234, .lon = 1139421234,
+                              .alt_mm = 50123, .h_acc_mm = 2500, .utc_s = 1792139415 };
+    expect_frame("MGA-INI-POS_LLH", buf, gnss_aid_encode_pos(&rec, buf, sizeof(buf)), pos, sizeof(pos));
+    rec.lat = -338567890;
+    rec.lon = -700123456;
+    rec.alt_mm = -12345;
+    rec.h_acc_mm = 0;
+    expect_frame("MGA-INI-POS_LLH south west", buf, gnss_aid_encode_pos(&rec, buf, sizeof(buf)), pos_sw,
+                 sizeof(pos_sw));
+    expect_frame("MGA-INI-TIME_UTC", buf, gnss_aid_encode_time(1792139415, 2, buf, sizeof(buf)), time_utc,
+                 sizeof(time_utc));
+    expect("MGA-INI-TIME_UTC into a short buffer", (long long)gnss_aid_encode_time(0, 2, buf, sizeof(time_utc) - 1),
+           0);
+
+    // The calendar written into TIME_UTC, across month, year and leap days
+    static const int64_t times[] = { 951825600, 951868799, 1709251199, 1735689599, 4107542400LL };
+    for (size_t i = 0; i < sizeof(times) / sizeof(times[0]); i++) {
+        size_t len = gnss_aid_encode_time(times[i], 1, buf, sizeof(buf));
+        const uint8_t *p = buf + 6;
+        int64_t back = len ? gnss_aid_utc_seconds((uint16_t)(p[4] | p[5] << 8), p[6], p[7], p[8], p[9], p[10]) : -1;
+        expect("MGA-INI-TIME_UTC calendar", back, times[i]);
+    }
+}
+
+static void sos_status(void) {
+    gnss_sos_restore_t st;
+    for (uint8_t r = 0; r <= 3; r++) {
+        const uint8_t restored[8] = { 3, 0, 0, 0, r, 0, 0, 0 };
+        st = (gnss_sos_restore_t)99;
+        expect("restore status parsed", gnss_aid_parse_sos(restored, sizeof(restored), &st), 1);
+        expect("restore status", st, r);
+    }
+    const uint8_t odd[8] = { 3, 0, 0, 0, 7, 0, 0, 0 };
+    expect("unknown restore status parsed", gnss_aid_parse_sos(odd, sizeof(odd), &st), 1);
+    expect("unknown restore status", st, GNSS_SOS_UNKNOWN);
+
+    // A backup is answered with cmd 2: response 1 ACK, 0 NAK
+    const uint8_t ack[8] = { 2, 0, 0, 0, 1, 0, 0, 0 }, nak[8] = { 2, 0, 0, 0, 0, 0, 0, 0 };
+    st = GNSS_SOS_RESTORED;
+    expect("backup ACK taken for a restore status", gnss_aid_parse_sos(ack, sizeof(ack), &st), 0);
+    expect("backup NAK taken for a restore status", gnss_aid_parse_sos(nak, sizeof(nak), &st), 0);
+    expect("status left alone", st, GNSS_SOS_RESTORED);
+    const uint8_t restored[8] = { 3, 0, 0, 0, 2, 0, 0, 0 };
+    expect("short restore status", gnss_aid_parse_sos(restored, 7, &st), 0);
+    expect("empty payload", gnss_aid_parse_sos(restored, 0, &st), 0);
+}
+
+static void record(void) {
+    const gnss_fix_t fix = {
+        .lat = 225431234, .lon = 1139421234, .alt_mm = 50123, .h_acc_mm = 2500,
+        .year = 2026, .month = 10, .day = 16, .hour = 8, .min = 30, .sec = 15, .fix_type = 3,
+        .valid = GNSS_VALID_TIME | GNSS_VALID_DATE | GNSS_VALID_POS | GNSS_VALID_ALT,
+    };
+    gnss_aid_record_t rec, stored;
+    expect("record from a full fix", gnss_aid_record_from_fix(&rec, &fix, GNSS_AID_FLAG_SOS), 1);
+    expect("record version", rec.version, GNSS_AID_VERSION);
+    expect("record flags", rec.flags, GNSS_AID_FLAG_SOS);
+    expect("record lat", rec.lat, fix.lat);
+    expect("record lon", rec.lon, fix.lon);
+    expect("record alt", rec.alt_mm, fix.alt_mm);
+    expect("record time", rec.utc_s, 1792139415);
+
+    // As NVS gives it back: a blob of the same bytes
+    memcpy(&stored, &rec, sizeof(rec));
+    expect("stored record valid", gnss_aid_record_valid(&stored), 1);
+
+    gnss_fix_t f = fix;
+    f.valid &= ~GNSS_VALID_ALT;
+    expect("record without altitude", gnss_aid_record_from_fix(&rec, &f, 0), 1);
+    expect("altitude left out", rec.alt_mm, 0);
+    static const uint16_t missing[] = { GNSS_VALID_POS, GNSS_VALID_DATE, GNSS_VALID_TIME };
+    static const char *const names[] = { "record without a position", "record without a date",
+                                         "record without a time" };
+    for (int i = 0; i < 3; i++) {
+        f = fix;
+        f.valid &= ~missing[i];
+        expect(names[i], gnss_aid_record_from_fix(&rec, &f, 0), 0);
+    }
+
+    rec = stored;
+    rec.version = GNSS_AID_VERSION + 1;
+    expect("record of another version", gnss_aid_record_valid(&rec), 0);
+    rec = stored;
+    rec.lat = 900000001;
+    expect("record north of the pole", gnss_aid_record_valid(&rec), 0);
+    rec = stored;
+    rec.lon = -1800000001;
+    expect("record west of the antimeridian", gnss_aid_record_valid(&rec), 0);
+    // A fix dated by a receiver that had not found the time yet
+    rec = stored;
+    rec.utc_s = GNSS_AID_TIME_MIN_UTC_S - 1;
+    expect("record from before 2024", gnss_aid_record_valid(&rec), 0);
+    memset(&rec, 0, sizeof(rec));
+    expect("blank record", gnss_aid_record_valid(&rec), 0);
+
+    const int64_t t = stored.utc_s;
+    expect("ephemeris just after the fix", gnss_aid_ephemeris_fresh(&stored, t + 60), 1);
+    expect("ephemeris just under the limit", gnss_aid_ephemeris_fresh(&stored, t + GNSS_AID_EPH_MAX_AGE_S - 1), 1);
+    expect("stale ephemeris", gnss_aid_ephemeris_fresh(&stored, t + GNSS_AID_EPH_MAX_AGE_S), 0);
+    expect("clock behind the record", gnss_aid_ephemeris_fresh(&stored, t - 1), 0);
+    expect("clock not set", gnss_aid_ephemeris_fresh(&stored, 1000), 0);
+}
+
+int main(void) {
+    utc_seconds();
+    fixed_frames();
+    aiding_frames();
+    sos_status();
+    record();
+    printf("aiding checks: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
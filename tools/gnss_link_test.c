@@ -0,0 +1,196 @@
+// Drives the GNSS link negotiation (gnss_link) against a simulated
+// receiver that answers at several baud rates.
+//
+//   gcc -O2 -I../main/include gnss_link_test.c ../main/gnss_link.c ../main/gnss_framer.c ../main/ubx.c -o gnss_link_test
+//   ./gnss_link_test
+//
+// The receiver starts at a given rate and sends power-on NMEA at 1 Hz
+// unless told to stay quiet, answers a MON-VER poll and applies
+// CFG-UART1-BAUDRATE a few ms after receiving it, as long as the host
+// talks at its rate. Whatever it sends at another rate reaches the host
+// as garbage of the matching length. All bytes go through gnss_framer,
+// as in gnss.c, so only frames that pass their checksum count. Checked
+// per scenario: the rate the link comes up at, fallback, and that it
+// matches the receiver. Exit status 1 if a check fails.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gnss_framer.h"
+#include "gnss_link.h"
+#include "ubx.h"
+
+#define STEP_US             1000
+#define RUN_US              (60 * 1000000LL)
+#define REPLY_DELAY_US      5000
+#define SWITCH_DELAY_US     2000
+#define OUTPUT_PHASE_US     300000
+
+typedef struct {
+    uint32_t baud;
+    int powered;
+    int periodic;           // 1 Hz power-on output
+    int ignores_switch;     // Rate locked, e.g. by a BBR setting
+    int64_t reply_at;       // MON-VER answer due, -1 = none
+    int64_t switch_at;      // Rate change due, -1 = none
+    uint32_t switch_to;
+} fake_gnss_t;
+
+typedef struct {
+    const char *name;
+    uint32_t start_baud;
+    uint32_t target;
+    int periodic;
+    int ignores_switch;
+    int powered;
+    uint32_t want_baud;     // 0: must not come up
+    int want_fallback;
+} scenario_t;
+
+static int failures;
+static int64_t now_us;
+static uint32_t host_baud;
+static fake_gnss_t rx;
+static gnss_link_t link;
+static gnss_framer_t framer;
+static uint32_t polls, switches;
+
+static void expect(const char *what, long got, long want) {
+    if (got == want) return;
+    printf("FAIL %s: got %ld, want %ld\n", what, got, want);
+    failures++;
+}
+
+// ---- Link operations, as gnss.c performs them ----
+
+static void op_set_baud(void *ctx, uint32_t baud) {
+    (void)ctx;
+    host_baud = baud;
+    gnss_framer_init(&framer, framer.cb, NULL);     // uart_flush_input
+}
+
+static void op_send_poll(void *ctx) {
+    (void)ctx;
+    polls++;
+    if (rx.powered && host_baud == rx.baud) rx.reply_at = now_us + REPLY_DELAY_US;
+}
+
+static void op_send_baud_cfg(void *ctx, uint32_t baud) {
+    (void)ctx;
+    switches++;
+    if (rx.powered && host_baud == rx.baud && !rx.ignores_switch) {
+        rx.switch_at = now_us + SWITCH_DELAY_US;
+        rx.switch_to = baud;
+    }
+}
+
+static const gnss_link_ops_t ops = { op_set_baud, op_send_poll, op_send_baud_cfg };
+
+static void on_frame(void *ctx, gnss_frame_type_t type, const uint8_t *frame, size_t len) {
+    (void)ctx;
+    (void)type;
+    (void)frame;
+    (void)len;
+    if (!gnss_link_up(&link)) gnss_link_on_frame(&link, now_us);
+}
+
+// ---- Receiver output over the line ----
+
+static void transmit(const uint8_t *bytes, size_t len) {
+    if (host_baud == rx.baud) {
+        gnss_framer_feed(&framer, bytes, len);
+        return;
+    }
+    // Sampled at the wrong rate: about as many symbols as fit, all garbage
+    uint8_t junk[512];
+    size_t n = (size_t)((double)len * host_baud / rx.baud);
+    if (n == 0) n = 1;
+    if (n > sizeof(junk)) n = sizeof(junk);
+    for (size_t i = 0; i < n; i++) junk[i] = (uint8_t)rand();
+    gnss_framer_feed(&framer, junk, n);
+}
+
+static void send_nmea(void) {
+    static const char *gga = "$GNGGA,,,,,,0,00,99.99,,,,,,*56\r\n";
+    transmit((const uint8_t *)gga, strlen(gga));
+}
+
+static void send_mon_ver(void) {
+    uint8_t payload[40] = "ROM SPG 5.10 (7b202e)";
+    uint8_t frame[64];
+    transmit(frame, ubx_build_frame(UBX_CLASS_MON, UBX_ID_MON_VER, payload, sizeof(payload), frame, sizeof(frame)));
+}
+
+// Runs until the link is up or RUN_US passes; returns the time to link up
+static int64_t run(const scenario_t *s) {
+    rx = (fake_gnss_t){ s->start_baud, s->powered, s->periodic, s->ignores_switch, -1, -1, 0 };
+    now_us = 0;
+    polls = switches = 0;
+    gnss_framer_init(&framer, on_frame, NULL);
+    gnss_link_start(&link, &ops, NULL, s->target, now_us);
+    for (; now_us < RUN_US && !gnss_link_up(&link); now_us += STEP_US) {
+        if (rx.switch_at >= 0 && now_us >= rx.switch_at) {
+            rx.baud = rx.switch_to;
+            rx.switch_at = -1;
+        }
+        if (rx.powered && rx.periodic && now_us % 1000000 == OUTPUT_PHASE_US) send_nmea();
+        if (rx.reply_at >= 0 && now_us >= rx.reply_at) {
+            rx.reply_at = -1;
+            send_mon_ver();
+        }
+        if (!gnss_link_up(&link)) gnss_link_poll(&link, now_us);
+    }
+    return gnss_link_up(&link) ? link.up_us - link.started_us : -1;
+}
+
+int main(void) {
+    static const scenario_t scenarios[] = {
+        { "factory default 9600 -> 460800", 9600, 460800, 1, 0, 1, 460800, 0 },
+        { "38400 -> 921600", 38400, 921600, 1, 0, 1, 921600, 0 },
+        { "MCU reset, receiver kept 460800", 460800, 460800, 1, 0, 1, 460800, 0 },
+        { "receiver at 921600, target 460800", 921600, 460800, 1, 0, 1, 460800, 0 },
+        { "quiet receiver at 115200 (poll only)", 115200, 460800, 0, 0, 1, 460800, 0 },
+        { "switch ignored at 115200", 115200, 460800, 1, 1, 1, 115200, 1 },
+        { "switch ignored, quiet, at 230400", 230400, 921600, 0, 1, 1, 230400, 1 },
+        { "receiver unpowered", 9600, 460800, 1, 0, 0, 0, 0 },
+    };
+
+    srand(11);
+    printf("%-38s %9s %8s %6s %8s %5s %8s\n", "scenario", "link up", "baud", "fallbk", "ms", "polls", "switches");
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        const scenario_t *s = &scenarios[i];
+        int64_t t = run(s);
+        printf("%-38s %9s %8lu %6s %8lld %5u %8u\n", s->name, t >= 0 ? "yes" : "no",
+               (unsigned long)(t >= 0 ? link.baud : 0), link.fallback ? "yes" : "no",
+               (long long)(t >= 0 ? t / 1000 : RUN_US / 1000), polls, switches);
+        if (!s->want_baud) {
+            expect(s->name, t >= 0, 0);
+            // Keeps cycling through the candidates
+            expect("probe rounds continue", link.probe_rounds >= 5, 1);
+            continue;
+        }
+        expect(s->name, (long)(t >= 0 ? link.baud : 0), (long)s->want_baud);
+        expect("fallback", link.fallback, s->want_fallback);
+        expect("receiver at link rate", (long)rx.baud, (long)link.baud);
+        expect("at most two switch attempts", switches <= GNSS_LINK_SWITCH_ATTEMPTS, 1);
+    }
+
+    // Load estimates behind the RX ring size and the 75 % utilization check
+    gnss_profile_t p = { 10, GNSS_DYN_AUTOMOTIVE, 0x0f, 0 };
+    for (int hz = 10; hz <= 25; hz += 15) {
+        p.rate_hz = (uint8_t)hz;
+        printf("%d Hz, 4 systems, NMEA on: %lu B/s, %lu byte bursts, %u byte RX ring; 115200 %s, 460800 %s\n", hz,
+               (unsigned long)gnss_link_bytes_per_sec(&p, GNSS_LINK_MAX_SV),
+               (unsigned long)gnss_link_burst_bytes(&p, GNSS_LINK_MAX_SV),
+               (unsigned)gnss_link_rx_buffer_size(&p, GNSS_LINK_MAX_SV),
+               gnss_link_baud_sufficient(&p, GNSS_LINK_MAX_SV, 115200) ? "ok" : "overloaded",
+               gnss_link_baud_sufficient(&p, GNSS_LINK_MAX_SV, 460800) ? "ok" : "overloaded");
+    }
+    expect("115200 overloaded at 25 Hz with NMEA", gnss_link_baud_sufficient(&p, GNSS_LINK_MAX_SV, 115200), 0);
+    expect("460800 carries 25 Hz with NMEA", gnss_link_baud_sufficient(&p, GNSS_LINK_MAX_SV, 460800), 1);
+    expect("RX ring holds two bursts", gnss_link_rx_buffer_size(&p, GNSS_LINK_MAX_SV) >=
+                                           2 * gnss_link_burst_bytes(&p, GNSS_LINK_MAX_SV), 1);
+
+    printf("link checks: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
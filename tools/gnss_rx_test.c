@@ -0,0 +1,248 @@
+// Drives GNSS reception (gnss_rx) from a fake UART and compares the
+// event-driven mode with the former 50 ms polling loop.
+//
+//   gcc -O2 -I../main/include gnss_rx_test.c ../main/gnss_rx.c ../main/gnss_framer.c ../main/latency_hist.c ../main/ubx.c -o gnss_rx_test
+//   ./gnss_rx_test
+//
+// The fake receiver sends a 25 Hz burst per epoch (RMC, GGA, GSA, then
+// NAV-PVT and NAV-EOE unless NMEA only) at GNSS_BAUD_RATE, byte by byte
+// on a microsecond clock. The fake UART raises a data event when its
+// FIFO reaches the driver's 120 byte threshold, or GNSS_RX_TOUT_SYMBOLS
+// after the last byte, and stamps chunks the way gnss.c does. Checked:
+// each epoch closes exactly once, at NAV-EOE (or once the line idles
+// without it), before the bytes after it in the same chunk, and with
+// the arrival time of its last byte; chunking does not change any of
+// that. Exit status 1 if a check fails. Latency is from the true arrival
+// of an epoch's last byte to its publish.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gnss_rx.h"
+#include "ubx.h"
+
+// As in config.h, which needs the ESP-IDF headers
+#define GNSS_BAUD_RATE          460800
+#define GNSS_RX_TOUT_SYMBOLS    3
+#define GNSS_EPOCH_IDLE_MS      3
+
+#define EPOCHS          (25 * 600)
+#define EPOCH_US        40000
+#define OUTPUT_DELAY_US 15000   // Receiver computes before it sends
+#define FIFO_THRESHOLD  120     // ESP-IDF UART driver default
+#define TICK_US         10000   // FreeRTOS at 100 Hz: the idle wait rounds up to one tick
+#define POLL_US         50000   // uart_read_bytes timeout of the old loop
+#define POLL_BUF        2048
+
+typedef struct {
+    uint8_t *buf;
+    int64_t *byte_us;       // Arrival time of each byte
+    size_t size;
+    size_t *epoch_end;      // Offset just past each epoch's last byte
+} stream_t;
+
+typedef struct {
+    size_t off, len;
+    int64_t arrival_us;     // As gnss.c stamps it
+    int64_t event_us;       // When the task gets to run
+} chunk_t;
+
+static int failures;
+static const stream_t *cur;
+static gnss_rx_t rx;
+static int64_t now_us;
+static uint32_t closed, frames, frames_at_close[EPOCHS + 1];
+static gnss_epoch_end_t last_reason;
+static latency_hist_t true_latency;
+static int check_stamp;
+static uint32_t frames_per_epoch;
+
+static void expect(const char *what, long got, long want) {
+    if (got == want) return;
+    printf("FAIL %s: got %ld, want %ld\n", what, got, want);
+    failures++;
+}
+
+static size_t emit_nmea(uint8_t *out, const char *body) {
+    uint8_t x = 0;
+    for (const char *p = body; *p; p++) x ^= (uint8_t)*p;
+    return (size_t)sprintf((char *)out, "$%s*%02X\r\n", body, x);
+}
+
+static stream_t synthesize(int with_ubx, uint32_t baud) {
+    stream_t s;
+    size_t cap = (size_t)EPOCHS * 512;
+    s.buf = malloc(cap);
+    s.byte_us = malloc(cap * sizeof(*s.byte_us));
+    s.epoch_end = malloc(EPOCHS * sizeof(*s.epoch_end));
+    s.size = 0;
+    double byte_us = 10e6 / baud;
+    char body[128];
+    for (int e = 0; e < EPOCHS; e++) {
+        size_t start = s.size;
+        int ms = e * (EPOCH_US / 1000);
+        snprintf(body, sizeof(body), "GNRMC,10%02d%02d.%02d,A,4717.11437,N,00833.91522,E,0.004,77.52,160926,,,A,V",
+                 ms / 60000 % 60, ms / 1000 % 60, ms % 1000 / 10);
+        s.size += emit_nmea(s.buf + s.size, body);
+        snprintf(body, sizeof(body), "GNGGA,10%02d%02d.%02d,4717.11399,N,00833.91590,E,1,08,1.01,499.6,M,48.0,M,,",
+                 ms / 60000 % 60, ms / 1000 % 60, ms % 1000 / 10);
+        s.size += emit_nmea(s.buf + s.size, body);
+        s.size += emit_nmea(s.buf + s.size, "GNGSA,A,3,23,29,07,08,09,18,26,28,,,,,1.94,1.18,1.54,1");
+        if (with_ubx) {
+            ubx_nav_pvt_t pvt = { .iTOW = 123456000u + ms, .fixType = 3, .flags = UBX_PVT_FLAGS_FIXOK };
+            s.size += ubx_build_frame(UBX_CLASS_NAV, UBX_ID_NAV_PVT, (const uint8_t *)&pvt, sizeof(pvt),
+                                      s.buf + s.size, cap - s.size);
+            s.size += ubx_build_frame(UBX_CLASS_NAV, UBX_ID_NAV_EOE, (const uint8_t *)&pvt.iTOW, 4,
+                                      s.buf + s.size, cap - s.size);
+        }
+        int64_t t0 = (int64_t)e * EPOCH_US + OUTPUT_DELAY_US;
+        for (size_t i = start; i < s.size; i++) s.byte_us[i] = t0 + (int64_t)((i - start + 1) * byte_us);
+        s.epoch_end[e] = s.size;
+    }
+    return s;
+}
+
+// ---- Fake UARTs ----
+
+// Event-driven driver: FIFO threshold or RX timeout, whichever comes first
+static size_t uart_events(const stream_t *s, uint32_t baud, chunk_t *out) {
+    int64_t tout_us = (int64_t)GNSS_RX_TOUT_SYMBOLS * 10 * 1000000 / baud;
+    size_t n = 0, start = 0;
+    for (size_t i = 0; i < s->size; i++) {
+        int full = i + 1 - start == FIFO_THRESHOLD;
+        int gap = i + 1 == s->size || s->byte_us[i + 1] - s->byte_us[i] > tout_us;
+        if (!full && !gap) continue;
+        // gnss.c takes the RX timeout back off a timeout event's time
+        int64_t event_us = s->byte_us[i] + (full ? 0 : tout_us);
+        out[n++] = (chunk_t){ start, i + 1 - start, event_us - (full ? 0 : tout_us), event_us };
+        start = i + 1;
+    }
+    return n;
+}
+
+// The old loop: whatever arrived during a 50 ms read, stamped at its return
+static size_t uart_polls(const stream_t *s, chunk_t *out) {
+    size_t n = 0, i = 0;
+    for (int64_t t = 0; i < s->size; t += POLL_US) {
+        size_t start = i;
+        while (i < s->size && s->byte_us[i] <= t + POLL_US && i - start < POLL_BUF) i++;
+        int64_t end = i - start == POLL_BUF ? s->byte_us[i - 1] : t + POLL_US;
+        out[n++] = (chunk_t){ start, i - start, end, end };
+        t = end - POLL_US;
+    }
+    return n;
+}
+
+// ---- Receiver under test ----
+
+static void on_frame(void *ctx, gnss_frame_type_t type, const uint8_t *frame, size_t len) {
+    (void)ctx;
+    (void)type;
+    (void)frame;
+    (void)len;
+    frames++;
+}
+
+static void on_epoch(void *ctx, int64_t last_byte_us, gnss_epoch_end_t reason) {
+    (void)ctx;
+    // Truth: the newest epoch whose frames have all been handed over
+    uint32_t e = frames / frames_per_epoch;
+    if (e > 0) {
+        int64_t last_us = cur->byte_us[cur->epoch_end[e - 1] - 1];
+        if (check_stamp) expect("last byte stamp", (long)last_byte_us, (long)last_us);
+        latency_hist_add(&true_latency, (uint32_t)(now_us - last_us));
+    }
+    if (closed <= EPOCHS) frames_at_close[closed] = frames;
+    gnss_rx_record_publish(&rx, last_byte_us, now_us);
+    last_reason = reason;
+    closed++;
+}
+
+// Feeds the chunks as gnss_receive() does; returns the epochs closed
+static uint32_t run(const stream_t *s, const chunk_t *chunks, size_t n, int polling) {
+    cur = s;
+    closed = frames = 0;
+    latency_hist_reset(&true_latency);
+    gnss_rx_init(&rx, on_frame, on_epoch, NULL);
+    for (size_t i = 0; i < n; i++) {
+        now_us = chunks[i].event_us;
+        if (chunks[i].len) gnss_rx_feed(&rx, s->buf + chunks[i].off, chunks[i].len, chunks[i].arrival_us);
+        if (polling) {
+            if (chunks[i].len < POLL_BUF) gnss_rx_idle(&rx);
+            continue;
+        }
+        // No event within the idle wait: the line went quiet
+        int64_t idle_us = GNSS_EPOCH_IDLE_MS * 1000 < TICK_US ? TICK_US : GNSS_EPOCH_IDLE_MS * 1000;
+        if (rx.epoch_open && !rx.eoe_seen && (i + 1 == n || chunks[i + 1].event_us - now_us > idle_us)) {
+            now_us += idle_us;
+            gnss_rx_idle(&rx);
+        }
+    }
+    return closed;
+}
+
+static void print_latency(const char *label, const latency_hist_t *h) {
+    printf("%-40s %5u fixes published, p50 <= %5u us, p99 <= %5u us, mean %5u us, max %5u us\n", label, h->total,
+           latency_hist_percentile(h, 50), latency_hist_percentile(h, 99), latency_hist_mean(h), h->max_us);
+}
+
+static void check_mode(const char *name, int with_ubx) {
+    static chunk_t chunks[EPOCHS * 64];
+    stream_t s = synthesize(with_ubx, GNSS_BAUD_RATE);
+    frames_per_epoch = with_ubx ? 5 : 3;
+    char label[64];
+
+    size_t n = uart_events(&s, GNSS_BAUD_RATE, chunks);
+    check_stamp = 1;
+    expect("epochs closed", run(&s, chunks, n, 0), EPOCHS);
+    expect("close reason", last_reason, with_ubx ? GNSS_EPOCH_END_EOE : GNSS_EPOCH_END_IDLE);
+    expect("frames per epoch", frames_at_close[EPOCHS - 1], EPOCHS * frames_per_epoch);
+    snprintf(label, sizeof(label), "%s, event-driven:", name);
+    print_latency(label, &true_latency);
+    // gnss_rx's own histogram sees the same thing
+    expect("recorded latency", latency_hist_percentile(&rx.latency, 99), latency_hist_percentile(&true_latency, 99));
+
+    // The old loop stamps its chunks at the read's return, not at the bytes
+    n = uart_polls(&s, chunks);
+    check_stamp = 0;
+    expect("polled epochs closed", run(&s, chunks, n, 1) > 0, 1);
+    snprintf(label, sizeof(label), "%s, 50 ms polling:", name);
+    print_latency(label, &true_latency);
+
+    // Two epochs in one chunk: the first closes before the second is framed
+    if (with_ubx) {
+        chunk_t both = { 0, s.epoch_end[1], s.byte_us[s.epoch_end[1] - 1], s.byte_us[s.epoch_end[1] - 1] };
+        check_stamp = 0;
+        run(&s, &both, 1, 0);
+        expect("NAV-EOE closes mid-chunk", frames_at_close[0], frames_per_epoch);
+    }
+
+    // Ragged chunks within each burst, stamped with their last byte, close
+    // the same epochs
+    n = 0;
+    srand(5);
+    for (size_t off = 0, len, e = 0; off < s.size; off += len) {
+        if (off == s.epoch_end[e]) e++;
+        len = 1 + (size_t)rand() % 300;
+        if (len > s.epoch_end[e] - off) len = s.epoch_end[e] - off;
+        chunks[n] = (chunk_t){ off, len, s.byte_us[off + len - 1], s.byte_us[off + len - 1] };
+        n++;
+    }
+    check_stamp = 0;
+    uint32_t got = run(&s, chunks, n, 0);
+    expect("ragged chunks: epochs closed", got, EPOCHS);
+    expect("ragged chunks: frames per epoch", frames_at_close[EPOCHS - 1], EPOCHS * frames_per_epoch);
+
+    free(s.buf);
+    free(s.byte_us);
+    free(s.epoch_end);
+}
+
+int main(void) {
+    printf("%d epochs at 25 Hz, %d baud, RX timeout %d symbols, idle wait %d ms\n", EPOCHS, GNSS_BAUD_RATE,
+           GNSS_RX_TOUT_SYMBOLS, GNSS_EPOCH_IDLE_MS * 1000 < TICK_US ? TICK_US / 1000 : GNSS_EPOCH_IDLE_MS);
+    check_mode("UBX + NMEA with NAV-EOE", 1);
+    check_mode("NMEA only", 0);
+    printf("reception checks: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
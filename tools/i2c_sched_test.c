@@ -0,0 +1,214 @@
+// Runs the I2C transaction scheduler against a simulated bus.
+//
+//   gcc -O2 -I../main/include i2c_sched_test.c ../main/i2c_sched.c ../main/latency_hist.c -o i2c_sched_test
+//   ./i2c_sched_test
+//
+// The bus holds three devices (IMU, mag, baro) whose registers read back
+// a pattern derived from device and address, takes 10 us plus 9 us per
+// byte (400 kHz), and can be told to hold the bus or NACK one device.
+// Checked: priority and deadline order, merging of touching and
+// overlapping reads with the data scattered back, NO_MERGE and long
+// reads left alone, timeout with bus recovery and error status. A random
+// load of the three sensors then checks every byte read and that no
+// burst exceeds I2C_SCHED_MAX_BURST. Exit status 1 if a check fails.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "i2c_sched.h"
+
+#define DEV_IMU         0
+#define DEV_MAG         1
+#define DEV_BARO        2
+#define FIFO_PORT       0x78
+#define FIFO_DRAIN_LEN  448
+#define STRESS_TXNS     200000
+
+static int failures;
+static int64_t clk;
+static int stuck_dev = -1, nack_dev = -1, recovers;
+static unsigned longest_merged;
+static uint8_t order[16];
+static int n_order;
+
+static void expect(const char *what, long got, long want) {
+    if (got == want) return;
+    if (failures < 20) printf("FAIL %s: got %ld, want %ld\n", what, got, want);
+    failures++;
+}
+
+// The IMU FIFO data port does not auto-increment
+static uint8_t reg_value(uint8_t dev, unsigned first, unsigned i) {
+    unsigned reg = dev == DEV_IMU && first == FIFO_PORT ? first : first + i;
+    return (uint8_t)(dev * 100 + reg);
+}
+
+// ---- Simulated bus ----
+
+static int bus_transfer(void *ctx, uint8_t dev, uint8_t reg, bool write, uint8_t *data, size_t len,
+                        uint32_t timeout_us) {
+    (void)ctx;
+    if (dev == stuck_dev) {
+        clk += timeout_us;
+        return I2C_TXN_TIMEOUT;
+    }
+    clk += 10 + 9 * (int64_t)len;
+    if (dev == nack_dev) return I2C_TXN_ERROR;
+    if (!write) {
+        for (size_t i = 0; i < len; i++) data[i] = reg_value(dev, reg, i);
+    }
+    return I2C_TXN_OK;
+}
+
+static void bus_recover(void *ctx) {
+    (void)ctx;
+    recovers++;
+}
+
+static int64_t bus_now(void *ctx) {
+    (void)ctx;
+    return clk;
+}
+
+static const i2c_bus_ops_t ops = { bus_transfer, bus_recover, bus_now };
+
+static void on_done(i2c_txn_t *t, void *arg) {
+    (void)t;
+    if (n_order < (int)sizeof(order)) order[n_order++] = (uint8_t)(intptr_t)arg;
+}
+
+static void make(i2c_txn_t *t, uint8_t dev, uint8_t reg, uint16_t len, uint8_t *buf, uint8_t prio, int64_t deadline,
+                 int id, uint8_t flags) {
+    *t = (i2c_txn_t){ .dev = dev, .reg = reg, .flags = flags, .prio = prio, .len = len, .data = buf,
+                      .deadline_us = deadline, .timeout_us = 1000, .done = on_done, .arg = (void *)(intptr_t)id };
+}
+
+static void run_all(i2c_sched_t *s) {
+    i2c_txn_t *batch;
+    while ((batch = i2c_sched_pop(s))) {
+        unsigned lo = batch->reg, hi = batch->reg + batch->len;
+        for (i2c_txn_t *t = batch->next; t; t = t->next) {
+            if (t->reg < lo) lo = t->reg;
+            if (t->reg + t->len > hi) hi = t->reg + t->len;
+        }
+        if (batch->next && hi - lo > longest_merged) longest_merged = hi - lo;
+        i2c_sched_execute(s, batch);
+    }
+}
+
+static int data_ok(const i2c_txn_t *t) {
+    for (unsigned i = 0; i < t->len; i++) {
+        if (t->data[i] != reg_value(t->dev, t->reg, i)) return 0;
+    }
+    return 1;
+}
+
+static void test_order_and_merge(void) {
+    static uint8_t buf[8][FIFO_DRAIN_LEN];
+    i2c_sched_t s;
+    i2c_txn_t t[8];
+    i2c_sched_init(&s, &ops, NULL);
+    n_order = 0;
+    make(&t[0], DEV_BARO, 0x04, 6, buf[0], 2, 100, 0, 0);
+    make(&t[1], DEV_MAG, 0x68, 6, buf[1], 1, 50, 1, 0);
+    make(&t[2], DEV_IMU, 0x3A, 2, buf[2], 0, 10, 2, 0);                  // FIFO status
+    make(&t[3], DEV_MAG, 0x6E, 2, buf[3], 1, 40, 3, 0);                  // Touches the mag data, earlier
+    make(&t[4], DEV_IMU, FIFO_PORT, FIFO_DRAIN_LEN, buf[4], 0, 5, 4, I2C_TXN_NO_MERGE);
+    make(&t[5], DEV_BARO, 0x03, 1, buf[5], 2, 90, 5, 0);                 // Touches the baro data
+    make(&t[6], DEV_IMU, 0x3B, 1, buf[6], 0, 5, 6, I2C_TXN_NO_MERGE);    // Overlaps status, clear-on-read
+    for (int i = 0; i < 7; i++) i2c_sched_submit(&s, &t[i], 0);
+    run_all(&s);
+
+    static const uint8_t want[] = { 4, 6, 2, 3, 1, 5, 0 };
+    expect("completions", n_order, sizeof(want));
+    for (int i = 0; i < n_order && i < (int)sizeof(want); i++) expect("completion order", order[i], want[i]);
+    for (int i = 0; i < 7; i++) expect("data", data_ok(&t[i]), 1);
+    expect("transfers", (long)s.stats.transfers, 5);
+    expect("merged", (long)s.stats.merged, 2);
+
+    // A plain read longer than a burst is served on its own
+    i2c_sched_init(&s, &ops, NULL);
+    make(&t[0], DEV_MAG, 0x00, 100, buf[0], 1, 0, 0, 0);
+    make(&t[1], DEV_MAG, 0x10, 4, buf[1], 1, 0, 1, 0);
+    i2c_sched_submit(&s, &t[0], 0);
+    i2c_sched_submit(&s, &t[1], 0);
+    run_all(&s);
+    expect("long read not merged", (long)s.stats.merged, 0);
+    expect("long read data", data_ok(&t[0]) && data_ok(&t[1]), 1);
+}
+
+static void test_faults(void) {
+    static uint8_t buf[4][16];
+    i2c_sched_t s;
+    i2c_txn_t t[4];
+    i2c_sched_init(&s, &ops, NULL);
+    stuck_dev = DEV_MAG;
+    recovers = 0;
+    make(&t[0], DEV_MAG, 0x68, 6, buf[0], 1, clk, 0, 0);
+    make(&t[1], DEV_IMU, 0x3A, 2, buf[1], 0, clk + 5000, 1, 0);
+    make(&t[2], DEV_BARO, 0x04, 6, buf[2], 2, clk, 2, 0);
+    for (int i = 0; i < 3; i++) i2c_sched_submit(&s, &t[i], clk);
+    run_all(&s);
+    expect("stuck device times out", t[0].status, I2C_TXN_TIMEOUT);
+    expect("others served", t[1].status == I2C_TXN_OK && t[2].status == I2C_TXN_OK, 1);
+    expect("bus recovered once", recovers, 1);
+    expect("timeouts counted", (long)s.stats.timeouts, 1);
+    expect("late after the stall", (long)s.stats.late >= 1, 1);
+    stuck_dev = -1;
+
+    nack_dev = DEV_BARO;
+    make(&t[3], DEV_BARO, 0x04, 6, buf[3], 2, clk, 3, 0);
+    i2c_sched_submit(&s, &t[3], clk);
+    run_all(&s);
+    expect("NACK is an error", t[3].status, I2C_TXN_ERROR);
+    expect("errors counted", (long)s.stats.errors, 1);
+    expect("no recovery on NACK", recovers, 1);
+    nack_dev = -1;
+}
+
+// IMU drains and status reads, mag and baro reads of random ranges,
+// submitted in random bunches; every byte is checked
+static void test_random_load(void) {
+    enum { POOL = 32 };
+    static uint8_t buf[POOL][FIFO_DRAIN_LEN];
+    static i2c_txn_t t[POOL];
+    i2c_sched_t s;
+    i2c_sched_init(&s, &ops, NULL);
+    srand(13);
+    long bad = 0, done = 0;
+    for (long n = 0; n < STRESS_TXNS;) {
+        int bunch = 1 + rand() % POOL;
+        for (int i = 0; i < bunch; i++, n++) {
+            uint8_t dev = (uint8_t)(rand() % 3);
+            if (dev == DEV_IMU && rand() % 4 == 0) {
+                make(&t[i], dev, FIFO_PORT, (uint16_t)(7 * (1 + rand() % 64)), buf[i], 0, clk + 2000, i, I2C_TXN_NO_MERGE);
+            } else {
+                // Below the FIFO port, which is only read with NO_MERGE
+                uint8_t reg = (uint8_t)(rand() % (FIFO_PORT - 24));
+                make(&t[i], dev, reg, (uint16_t)(1 + rand() % 24), buf[i], dev, clk + 1000 * (1 + dev), i, 0);
+            }
+            i2c_sched_submit(&s, &t[i], clk);
+        }
+        run_all(&s);
+        for (int i = 0; i < bunch; i++) {
+            bad += t[i].status != I2C_TXN_OK || !data_ok(&t[i]);
+            done++;
+        }
+    }
+    printf("random load: %ld transactions in %lu transfers (%lu merged), %ld bad, longest burst %u B; "
+           "queue delay mean %lu us, p99 %lu us\n", done, (unsigned long)s.stats.transfers,
+           (unsigned long)s.stats.merged, bad, longest_merged, (unsigned long)latency_hist_mean(&s.stats.queue_delay),
+           (unsigned long)latency_hist_percentile(&s.stats.queue_delay, 99));
+    expect("random load data", bad, 0);
+    expect("bursts within I2C_SCHED_MAX_BURST", longest_merged <= I2C_SCHED_MAX_BURST, 1);
+    expect("some reads merged", s.stats.merged > 0, 1);
+}
+
+int main(void) {
+    test_order_and_merge();
+    test_faults();
+    test_random_load();
+    printf("scheduler checks: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,172 @@
+// Accuracy checks and timing of the online IMU bias estimator on a PC.
+//
+//   gcc -O2 -I../main/include imu_bias_test.c ../main/imu_bias.c -lm -o imu_bias_test
+//   ./imu_bias_test [seed]
+//
+// 50 min of synthetic 416 Hz data: the gyro bias drifts at 0.03 dps/C
+// while the die temperature ramps 20 -> 45 -> 30 C, and a 0.02 g accel
+// offset is added. Every minute starts with 15 s at rest (the first six
+// on the six faces), the rest is rotation, with 20 s and 45 s steady-yaw
+// stretches that leave gravity alone; the 45 s ones are vetoed after
+// 20 s as the sensor service does when the magnetometer turns. The last
+// 10 min have no rest at all, so the bias comes from the table.
+// Compared while moving: the estimate, a one-shot calibration at the
+// first rest, and no correction; gz bias RMS and the heading error they
+// integrate to. Exit status 1 if an error bound is exceeded.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "imu_bias.h"
+
+#define RATE_HZ         416
+#define DURATION_S      3000
+#define REST_UNTIL_S    2400    // No rest after this
+#define MIN_RUN_S       1.0
+
+static int failures;
+static const float bias_25c[3] = { 0.5f, -0.3f, 0.8f };         // dps
+static const float bias_per_c[3] = { 0.02f, -0.015f, 0.03f };   // dps/C
+static const float accel_offset[3] = { 0.02f, -0.015f, 0.03f }; // g
+static const float faces[IMU_BIAS_ACCEL_FACES][3] = { { 0, 0, 1 }, { 0, 0, -1 }, { 1, 0, 0 },
+                                                      { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 } };
+
+static void expect_max(const char *what, double got, double max) {
+    printf("  %-44s %9.4f (limit %.4f)\n", what, got, max);
+    if (got <= max) return;
+    printf("FAIL %s\n", what);
+    failures++;
+}
+
+static double gauss(void) {
+    double u = (rand() + 1.0) / (RAND_MAX + 2.0), v = (rand() + 1.0) / (RAND_MAX + 2.0);
+    return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static float temp_at(double t) {
+    if (t < 1200) return (float)(20 + 25 * t / 1200);
+    if (t < 1800) return 45;
+    return (float)(45 - 15 * (t - 1800) / 1200);
+}
+
+static void drive(void) {
+    const imu_bias_params_t params = IMU_BIAS_DEFAULT_PARAMS;
+    static imu_bias_t e;
+    imu_bias_init(&e, &params, NULL);
+
+    const double dt = 1.0 / RATE_HZ;
+    double se_est = 0, se_boot = 0, se_raw = 0, se_late = 0, head_est = 0, head_boot = 0, head_raw = 0;
+    long n_moving = 0, n_late = 0, false_still = 0;
+    float boot[3] = { 0, 0, 0 };
+    bool boot_set = false;
+    for (long k = 0; k < (long)RATE_HZ * DURATION_S; k++) {
+        double t = k * dt, in_minute = fmod(t, 60);
+        int minute = (int)(t / 60);
+        float temp = temp_at(t);
+        bool rest = in_minute < 15 && t < REST_UNTIL_S;
+        bool long_yaw = !rest && minute % 11 == 5;
+        bool yaw = long_yaw || (!rest && minute % 7 == 3 && in_minute < 35);
+        const float *up = t < 360 ? faces[minute % IMU_BIAS_ACCEL_FACES] : faces[0];
+
+        float bias[3], rate[3] = { 0, 0, 0 }, acc[3] = { up[0], up[1], up[2] };
+        for (int a = 0; a < 3; a++) bias[a] = bias_25c[a] + bias_per_c[a] * (temp - 25);
+        if (yaw) {
+            rate[2] = 2.0f;
+        } else if (!rest) {
+            rate[0] = (float)(20 * sin(t * 1.3));
+            rate[1] = (float)(15 * sin(t * 0.7 + 1));
+            rate[2] = (float)(30 * sin(t * 0.4 + 2));
+            for (int a = 0; a < 3; a++) acc[a] += (float)(0.05 * gauss());
+        }
+        imu_sample_t s = { (int64_t)llround(t * 1e6),
+                           (float)(acc[0] + accel_offset[0] + 0.0015 * gauss()),
+                           (float)(acc[1] + accel_offset[1] + 0.0015 * gauss()),
+                           (float)(acc[2] + accel_offset[2] + 0.0015 * gauss()),
+                           (float)(rate[0] + bias[0] + 0.07 * gauss()),
+                           (float)(rate[1] + bias[1] + 0.07 * gauss()),
+                           (float)(rate[2] + bias[2] + 0.07 * gauss()),
+                           temp };
+        imu_bias_feed(&e, &s);
+        // The magnetometer has turned more than 3 deg by now
+        if (long_yaw && in_minute >= 20 && imu_bias_still(&e)) imu_bias_veto(&e);
+
+        if (!boot_set && imu_bias_still(&e)) {
+            float a[3];
+            imu_bias_get(&e, temp, boot, a);
+            boot_set = true;
+        }
+        if (rest) continue;
+        false_still += imu_bias_still(&e);
+        float g[3], a[3];
+        imu_bias_get(&e, temp, g, a);
+        double err = g[2] - bias[2], err_boot = boot[2] - bias[2];
+        se_est += err * err;
+        se_boot += err_boot * err_boot;
+        se_raw += (double)bias[2] * bias[2];
+        head_est += err * dt;
+        head_boot += err_boot * dt;
+        head_raw += bias[2] * dt;
+        n_moving++;
+        if (t >= REST_UNTIL_S) {
+            se_late += err * err;
+            n_late++;
+        }
+    }
+
+    printf("50 min drive, %u windows, %u still (one-shot calibration: %.3f dps RMS, none: %.3f):\n", e.windows,
+           e.still, sqrt(se_boot / n_moving), sqrt(se_raw / n_moving));
+    expect_max("gz bias error while moving, dps RMS", sqrt(se_est / n_moving), 0.1);
+    expect_max("from the table in the last 10 min, dps RMS", sqrt(se_late / n_late), 0.05);
+    expect_max("still while turning, share of samples", (double)false_still / n_moving, 0.02);
+    printf("heading error integrated while moving (one-shot: %.0f deg, none: %.0f):\n", head_boot, head_raw);
+    expect_max("estimate, deg", fabs(head_est), 100);
+    double off_err = 0;
+    for (int a = 0; a < 3; a++) {
+        double d = fabs(e.table.accel[a] - accel_offset[a]);
+        if (d > off_err) off_err = d;
+    }
+    printf("accel offset (%s):\n", e.table.accel_valid ? "fitted" : "not fitted");
+    expect_max("not fitted", !e.table.accel_valid, 0);
+    expect_max("error, g", off_err, 1e-3);
+    expect_max("table invalid after the drive", !imu_bias_table_valid(&e.table), 0);
+
+    // A stored table makes the estimate usable before the first rest
+    imu_bias_t warm;
+    imu_bias_init(&warm, &params, &e.table);
+    float g[3], a[3];
+    imu_bias_get(&warm, 40, g, a);
+    expect_max("stored table at 40 C, gz error dps", fabs(g[2] - (bias_25c[2] + bias_per_c[2] * 15)), 0.05);
+}
+
+static void bench(void) {
+    const imu_bias_params_t params = IMU_BIAS_DEFAULT_PARAMS;
+    imu_bias_t e;
+    imu_bias_init(&e, &params, NULL);
+    imu_sample_t s = { 0, 0.01f, 0.02f, 1.0f, 0.5f, -0.3f, 0.8f, 25 };
+    long n = 0;
+    double t0 = now_s(), t1;
+    do {
+        for (int i = 0; i < 1000000; i++) {
+            s.gx = 0.5f + (i & 7) * 0.01f;
+            imu_bias_feed(&e, &s);
+        }
+        n += 1000000;
+        t1 = now_s();
+    } while (t1 - t0 < MIN_RUN_S);
+    printf("feed: %.1f ns per sample\n", (t1 - t0) * 1e9 / n);
+}
+
+int main(int argc, char **argv) {
+    srand(argc > 1 ? (unsigned)atoi(argv[1]) : 1);
+    drive();
+    bench();
+    printf("bias checks: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
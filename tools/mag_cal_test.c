@@ -0,0 +1,204 @@
+// Accuracy checks and timing of the magnetometer ellipsoid calibration on
+// a PC.
+//
+//   gcc -O2 -I../main/include mag_cal_test.c ../main/mag_cal.c -lm -o mag_cal_test
+//   ./mag_cal_test [seed]
+//
+// A 48 uT field is turned through all directions by a slow tumble and
+// distorted as a magnetometer in the device sees it: hard iron offset
+// 25/-40/12 uT, non-diagonal soft iron, 0.4 uT noise. Samples are fed
+// until mag_cal_progress reaches 100, then the fit is solved. Checked on
+// fresh undistorted directions: the offset and the corrected field
+// magnitude against the uncorrected one. Also checked: rotation in one
+// plane only never reaches full progress and does not solve, samples
+// closer than MAG_CAL_MIN_STEP_UT are skipped, and mag_cal_apply in place.
+// Exit status 1 if an error bound is exceeded.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "mag_cal.h"
+
+#define FIELD_UT        48.0
+#define NOISE_UT        0.4
+#define MAX_FEED        50000
+#define EVAL_POINTS     2000
+#define MIN_RUN_S       1.0
+
+static int failures;
+static const double offset[3] = { 25.0, -40.0, 12.0 };
+static const double soft_iron[3][3] = { { 1.15, 0.08, -0.05 }, { 0.08, 0.90, 0.04 }, { -0.05, 0.04, 1.05 } };
+
+static void expect_max(const char *what, double got, double max) {
+    printf("  %-44s %9.4f (limit %.4f)\n", what, got, max);
+    if (got <= max) return;
+    printf("FAIL %s\n", what);
+    failures++;
+}
+
+static double gauss(void) {
+    double u = (rand() + 1.0) / (RAND_MAX + 2.0), v = (rand() + 1.0) / (RAND_MAX + 2.0);
+    return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// What the sensor reads for a true field t
+static void distort(const double t[3], double noise, float raw[3]) {
+    for (int a = 0; a < 3; a++) {
+        raw[a] = (float)(offset[a] + soft_iron[a][0] * t[0] + soft_iron[a][1] * t[1] + soft_iron[a][2] * t[2] +
+                         noise * gauss());
+    }
+}
+
+static void random_direction(double t[3]) {
+    double z = 2.0 * rand() / RAND_MAX - 1, ph = 2 * M_PI * rand() / RAND_MAX, s = sqrt(1 - z * z);
+    t[0] = FIELD_UT * s * cos(ph);
+    t[1] = FIELD_UT * s * sin(ph);
+    t[2] = FIELD_UT * z;
+}
+
+static double magnitude(const float v[3]) {
+    return sqrt((double)v[0] * v[0] + (double)v[1] * v[1] + (double)v[2] * v[2]);
+}
+
+static void full_rotation(mag_cal_acc_t *acc) {
+    mag_cal_acc_init(acc);
+    int fed = 0, taken = 0;
+    while (fed < MAX_FEED && mag_cal_progress(acc) < 100) {
+        // Slow tumble: heading turns, the nose wanders up and down
+        double th = fed * 0.0031, el = 1.5 * sin(fed * 0.00077);
+        double t[3] = { FIELD_UT * cos(th) * cos(el), FIELD_UT * sin(th) * cos(el), FIELD_UT * sin(el) };
+        float raw[3];
+        distort(t, NOISE_UT, raw);
+        taken += mag_cal_acc_add(acc, raw);
+        fed++;
+    }
+    printf("tumble: %d samples read, %d taken, coverage %u of %d, progress %u\n", fed, taken,
+           mag_cal_coverage(acc), MAG_CAL_BINS, mag_cal_progress(acc));
+    expect_max("samples until progress 100", fed, MAX_FEED - 1);
+}
+
+static void accuracy(const mag_cal_acc_t *acc, mag_cal_t *cal) {
+    bool ok = mag_cal_solve(acc, cal);
+    printf("solve: offset %.2f/%.2f/%.2f uT, field %.2f uT, residual %.4f\n", cal->offset[0], cal->offset[1],
+           cal->offset[2], cal->field_ut, cal->residual);
+    expect_max("solve failed", !ok, 0);
+    expect_max("valid after the solve (0 = yes)", !mag_cal_valid(cal), 0);
+    double off_err = 0;
+    for (int a = 0; a < 3; a++) {
+        double e = fabs(cal->offset[a] - offset[a]);
+        if (e > off_err) off_err = e;
+    }
+    expect_max("offset error, uT", off_err, 0.2);
+
+    double se_cal = 0, se_raw = 0, max_cal = 0;
+    for (int i = 0; i < EVAL_POINTS; i++) {
+        double t[3];
+        float raw[3], out[3];
+        random_direction(t);
+        distort(t, 0, raw);
+        mag_cal_apply(cal, raw, out);
+        double e = magnitude(out) / cal->field_ut - 1, r = magnitude(raw) / FIELD_UT - 1;
+        se_cal += e * e;
+        se_raw += r * r;
+        if (fabs(e) > max_cal) max_cal = fabs(e);
+    }
+    printf("field magnitude on %d fresh directions (uncorrected: %.1f %% RMS):\n", EVAL_POINTS,
+           100 * sqrt(se_raw / EVAL_POINTS));
+    expect_max("corrected RMS error, %", 100 * sqrt(se_cal / EVAL_POINTS), 0.5);
+    expect_max("corrected maximum error, %", 100 * max_cal, 1.5);
+}
+
+static void planar(void) {
+    mag_cal_acc_t acc;
+    mag_cal_acc_init(&acc);
+    // Flat on a table: heading turns, the field keeps its dip
+    for (int i = 0; i < MAX_FEED; i++) {
+        double th = i * 0.0031, el = -1.1;
+        double t[3] = { FIELD_UT * cos(th) * cos(el), FIELD_UT * sin(th) * cos(el), FIELD_UT * sin(el) };
+        float raw[3];
+        distort(t, NOISE_UT, raw);
+        mag_cal_acc_add(&acc, raw);
+    }
+    mag_cal_t cal;
+    printf("rotation in one plane (coverage %u, progress %u):\n", mag_cal_coverage(&acc), mag_cal_progress(&acc));
+    expect_max("progress", mag_cal_progress(&acc), 99);
+    expect_max("solved (0 = refused)", mag_cal_solve(&acc, &cal), 0);
+}
+
+static void small_steps(void) {
+    mag_cal_acc_t acc;
+    mag_cal_acc_init(&acc);
+    float m[3] = { 10, 20, 30 };
+    mag_cal_acc_add(&acc, m);
+    m[0] += 0.9f * MAG_CAL_MIN_STEP_UT;
+    bool close = mag_cal_acc_add(&acc, m);
+    m[0] += 0.2f * MAG_CAL_MIN_STEP_UT;
+    bool far = mag_cal_acc_add(&acc, m);
+    printf("step filter:\n");
+    expect_max("closer sample taken (0 = skipped)", close, 0);
+    expect_max("farther sample skipped (0 = taken)", !far, 0);
+}
+
+static void in_place(const mag_cal_t *cal) {
+    float a[3] = { 30, -12, 55 }, b[3];
+    mag_cal_apply(cal, a, b);
+    mag_cal_apply(cal, a, a);
+    printf("apply in place:\n");
+    expect_max("difference, uT", fabs(a[0] - b[0]) + fabs(a[1] - b[1]) + fabs(a[2] - b[2]), 0);
+}
+
+static void bench(const mag_cal_acc_t *acc) {
+    mag_cal_t cal;
+    volatile float sink = 0;
+    long n = 0;
+    double t0 = now_s(), t1;
+    do {
+        for (int i = 0; i < 10000; i++) {
+            mag_cal_solve(acc, &cal);
+            sink += cal.field_ut;
+        }
+        n += 10000;
+        t1 = now_s();
+    } while (t1 - t0 < MIN_RUN_S);
+    printf("solve: %.2f us\n", (t1 - t0) * 1e6 / n);
+
+    mag_cal_acc_t a = *acc;
+    float raw[3];
+    double t[3];
+    random_direction(t);
+    distort(t, 0, raw);
+    n = 0;
+    t0 = now_s();
+    do {
+        for (int i = 0; i < 100000; i++) {
+            // Alternate far enough apart that every sample is taken
+            raw[0] += i & 1 ? -3.0f : 3.0f;
+            mag_cal_acc_add(&a, raw);
+        }
+        n += 100000;
+        t1 = now_s();
+    } while (t1 - t0 < MIN_RUN_S);
+    printf("add:   %.1f ns per sample\n", (t1 - t0) * 1e9 / n);
+}
+
+int main(int argc, char **argv) {
+    srand(argc > 1 ? (unsigned)atoi(argv[1]) : 1);
+    static mag_cal_acc_t acc;
+    mag_cal_t cal;
+    full_rotation(&acc);
+    accuracy(&acc, &cal);
+    planar();
+    small_steps();
+    in_place(&cal);
+    bench(&acc);
+    printf("calibration checks: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,211 @@
+// Replays a straight-line drive through the GNSS/IMU EKF on a PC and
+// compares the fused speed with the GNSS speed alone.
+//
+//   gcc -O2 -I../main/include nav_ekf_replay.c ../main/nav_ekf.c -lm -o nav_ekf_replay
+//   ./nav_ekf_replay [profile.csv]
+//
+// The profile gives the true longitudinal acceleration, one
+// "t_s,accel_mps2" line per change (held until the next line; lines
+// starting with '#' or a letter are skipped). Without one, a 40 s run
+// accelerates at 3 m/s^2 to 100 km/h, cruises, and brakes at 6 m/s^2.
+// The drive is sampled like the device does: 416 Hz earth-frame
+// acceleration with 0.3 m/s^2 noise and 0.2 m/s^2 bias, GNSS at 1 and
+// 10 Hz with 0.1 m/s and 1 m noise, delivered 50 ms late and dated back
+// by that latency as the nav task does. Output is read every 10 ms.
+// Reported per GNSS rate: speed RMS error of the EKF and of the last fix,
+// and the error in the time 90 km/h is crossed and the stop is reached.
+// Exit status 1 if the EKF is not better than the last fix or a crossing
+// is off by more than 100 ms (150 ms for the stop).
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "nav_ekf.h"
+
+// As in config.h, which needs the ESP-IDF headers
+#define NAV_GNSS_LATENCY_US     50000
+
+#define IMU_HZ          416
+#define OUT_PERIOD_US   10000
+#define G_MPS2          9.80665
+#define ACC_NOISE       0.3     // m/s^2
+#define ACC_BIAS        0.2     // m/s^2
+#define SPEED_NOISE     0.1     // m/s
+#define POS_NOISE       1.0     // m
+#define CROSS_MPS       25.0    // 90 km/h
+#define STOP_MPS        0.3
+#define MAX_STEPS       256
+
+typedef struct {
+    double t, accel;
+} step_t;
+
+typedef struct {
+    double rms_ekf, rms_fix;
+    double cross_ekf, cross_fix;    // Error against the true time, s
+    double stop_ekf, stop_fix;
+    double realtime;
+    uint32_t rejected;
+} result_t;
+
+static step_t profile[MAX_STEPS];
+static int n_steps;
+static double duration;
+
+static double gauss(void) {
+    double u = (rand() + 1.0) / (RAND_MAX + 2.0), v = (rand() + 1.0) / (RAND_MAX + 2.0);
+    return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+static double accel_at(double t) {
+    double a = 0;
+    for (int i = 0; i < n_steps && profile[i].t <= t; i++) a = profile[i].accel;
+    return a;
+}
+
+static void default_profile(void) {
+    static const step_t drive[] = { { 0, 0 }, { 5, 3.0 }, { 5 + 27.7778 / 3.0, 0 }, { 25, -6.0 },
+                                    { 25 + 27.7778 / 6.0, 0 } };
+    memcpy(profile, drive, sizeof(drive));
+    n_steps = sizeof(drive) / sizeof(drive[0]);
+    duration = 40;
+}
+
+static int load_profile(const char *path) {
+    FILE *in = fopen(path, "r");
+    if (!in) {
+        perror(path);
+        return 0;
+    }
+    char line[128];
+    n_steps = 0;
+    while (fgets(line, sizeof(line), in) && n_steps < MAX_STEPS) {
+        if (line[0] == '#' || (line[0] >= 'A' && line[0] <= 'z')) continue;
+        if (sscanf(line, "%lf,%lf", &profile[n_steps].t, &profile[n_steps].accel) == 2) n_steps++;
+    }
+    fclose(in);
+    duration = n_steps ? profile[n_steps - 1].t + 5 : 0;
+    return n_steps > 0;
+}
+
+static double time_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void run(int gnss_hz, result_t *r) {
+    const nav_ekf_params_t params = NAV_EKF_DEFAULT_PARAMS;
+    const double dt = 1.0 / IMU_HZ, delay = NAV_GNSS_LATENCY_US * 1e-6;
+    const int period = IMU_HZ / gnss_hz;
+    nav_ekf_t f;
+    nav_ekf_init(&f, &params);
+    srand(1);
+
+    struct {
+        double t, v, x;
+    } pending[16];
+    int n_pending = 0, n_out = 0;
+    double v = 0, x = 0, fix_speed = 0, se_ekf = 0, se_fix = 0;
+    double cross_true = -1, cross_ekf = -1, cross_fix = -1, stop_true = -1, stop_ekf = -1, stop_fix = -1;
+    double braking_from = -1;
+    int64_t next_out = 0;
+    double c0 = time_s();
+
+    for (long k = 1; k * dt < duration; k++) {
+        double t = k * dt, a = accel_at(t);
+        x += v * dt + 0.5 * a * dt * dt;
+        v += a * dt;
+        if (v < 0) v = 0;
+        if (cross_true < 0 && v >= CROSS_MPS) cross_true = t;
+        if (a < 0 && braking_from < 0) braking_from = t;
+        if (braking_from >= 0 && stop_true < 0 && v <= 0.01) stop_true = t;
+
+        attitude_sample_t att = { 0 };
+        att.t_us = (int64_t)llround(t * 1e6);
+        att.q[0] = 1;
+        att.lin_earth[0] = (float)((a + ACC_BIAS + ACC_NOISE * gauss()) / G_MPS2);
+        att.lin_earth[1] = (float)(ACC_NOISE * gauss() / G_MPS2);
+        att.lin_earth[2] = (float)(ACC_NOISE * gauss() / G_MPS2);
+        nav_ekf_predict(&f, &att);
+
+        if (k % period == 0 && n_pending < 16) {
+            pending[n_pending].t = t;
+            pending[n_pending].v = v + SPEED_NOISE * gauss();
+            pending[n_pending].x = x + POS_NOISE * gauss();
+            n_pending++;
+        }
+        while (n_pending && t >= pending[0].t + delay) {
+            // Due north from 47.3 N 8.5 E
+            gnss_fix_t fix = { 0 };
+            fix.fix_type = 3;
+            fix.valid = GNSS_VALID_POS | GNSS_VALID_VEL | GNSS_VALID_ALT;
+            fix.lat = 473000000 + (int32_t)lrint(pending[0].x / 0.011119493);
+            fix.lon = 85000000;
+            fix.alt_mm = 400000;
+            fix.vel_n = (int32_t)lrint(pending[0].v * 1000);
+            fix.s_acc_mmps = 150;
+            fix.h_acc_mm = 1500;
+            fix.v_acc_mm = 2500;
+            nav_ekf_update_gnss(&f, &fix, att.t_us - NAV_GNSS_LATENCY_US);
+            fix_speed = pending[0].v;
+            if (cross_fix < 0 && fix_speed >= CROSS_MPS) cross_fix = pending[0].t;
+            if (braking_from >= 0 && stop_fix < 0 && fix_speed <= STOP_MPS) stop_fix = pending[0].t;
+            memmove(&pending[0], &pending[1], --n_pending * sizeof(pending[0]));
+        }
+
+        if (att.t_us >= next_out) {
+            next_out += OUT_PERIOD_US;
+            nav_sample_t o;
+            nav_ekf_output(&f, &o);
+            if (t > 1) {
+                se_ekf += (o.speed - v) * (o.speed - v);
+                se_fix += (fix_speed - v) * (fix_speed - v);
+                n_out++;
+            }
+            if (cross_ekf < 0 && o.speed >= CROSS_MPS) cross_ekf = t;
+            if (braking_from >= 0 && stop_ekf < 0 && o.speed <= STOP_MPS) stop_ekf = t;
+        }
+    }
+
+    r->realtime = duration / (time_s() - c0);
+    r->rms_ekf = sqrt(se_ekf / n_out);
+    r->rms_fix = sqrt(se_fix / n_out);
+    r->cross_ekf = cross_true >= 0 && cross_ekf >= 0 ? cross_ekf - cross_true : NAN;
+    r->cross_fix = cross_true >= 0 && cross_fix >= 0 ? cross_fix - cross_true : NAN;
+    r->stop_ekf = stop_true >= 0 && stop_ekf >= 0 ? stop_ekf - stop_true : NAN;
+    r->stop_fix = stop_true >= 0 && stop_fix >= 0 ? stop_fix - stop_true : NAN;
+    r->rejected = f.rejected;
+}
+
+static int within(double err, double max) {
+    return isnan(err) || fabs(err) <= max;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        if (!load_profile(argv[1])) return 2;
+    } else {
+        default_profile();
+    }
+
+    int failures = 0;
+    printf("GNSS  | speed RMS m/s | 90 km/h crossing ms | stop ms         | rejected | x real time\n");
+    printf("rate  | EKF   last fix| EKF      fix epochs | EKF     fix     |          |\n");
+    static const int rates[] = { 1, 10 };
+    for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+        result_t r;
+        run(rates[i], &r);
+        printf("%2d Hz | %5.2f %6.2f  | %+6.0f   %+6.0f     | %+6.0f  %+6.0f  | %8u | %6.0f\n", rates[i], r.rms_ekf,
+               r.rms_fix, r.cross_ekf * 1e3, r.cross_fix * 1e3, r.stop_ekf * 1e3, r.stop_fix * 1e3,
+               (unsigned)r.rejected, r.realtime);
+        if (!(r.rms_ekf < r.rms_fix) || !within(r.cross_ekf, 0.1) || !within(r.stop_ekf, 0.15)) {
+            printf("FAIL at %d Hz\n", rates[i]);
+            failures++;
+        }
+    }
+    printf("EKF replay: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
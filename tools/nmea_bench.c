@@ -0,0 +1,191 @@
+// Checks the NMEA decoder against known sentences and measures its
+// throughput on a PC.
+//
+//   gcc -O2 -I../main/include nmea_bench.c ../main/nmea.c -o nmea_bench
+//   ./nmea_bench                    synthetic 25 Hz GPS+GLONASS+Galileo+BeiDou stream
+//   ./nmea_bench capture.nmea       a captured log, one sentence per line
+//
+// The log is loaded and split into sentences first, so the timing covers
+// the decoder only. Exit status 1 if a known sentence decodes wrongly.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "nmea.h"
+
+#define SYNTH_SECONDS   600
+#define SYNTH_HZ        25
+#define MIN_RUN_S       1.0
+
+typedef struct {
+    const char *s;
+    size_t len;
+} sentence_t;
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int failures;
+
+static void expect(const char *what, long got, long want) {
+    if (got == want) return;
+    printf("FAIL %s: got %ld, want %ld\n", what, got, want);
+    failures++;
+}
+
+static nmea_msg_t decode_str(nmea_decoder_t *d, const char *s) {
+    return nmea_decode(d, s, strlen(s));
+}
+
+// u-blox protocol description examples, decoded into one fix
+static void self_check(void) {
+    nmea_decoder_t d;
+    nmea_decoder_init(&d);
+    expect("RMC type", decode_str(&d, "$GNRMC,083559.00,A,4717.11437,N,00833.91522,E,0.004,77.52,091202,,,A,V*57\r\n"), NMEA_MSG_RMC);
+    expect("GGA type", decode_str(&d, "$GNGGA,092725.00,4717.11399,N,00833.91590,E,1,08,1.01,499.6,M,48.0,M,,*5B\r\n"), NMEA_MSG_GGA);
+    expect("GSA type", decode_str(&d, "$GNGSA,A,3,23,29,07,08,09,18,26,28,,,,,1.94,1.18,1.54,1*0D\r\n"), NMEA_MSG_GSA);
+    expect("GSV type", decode_str(&d, "$GPGSV,3,1,09,09,,,17,10,,,40,12,,,49,13,,,35,1*6F\r\n"), NMEA_MSG_GSV);
+    expect("VTG type", decode_str(&d, "$GNVTG,77.52,T,,M,0.004,N,0.008,K,A*3D\r\n"), NMEA_MSG_VTG);
+
+    const gnss_fix_t *f = &d.fix;
+    expect("lat", f->lat, 472852332);
+    expect("lon", f->lon, 85652650);
+    expect("alt_mm", f->alt_mm, 499600);
+    expect("speed_mmps", f->speed_mmps, 2);
+    expect("course", f->course, 7752000);
+    expect("pdop", f->pdop, 194);
+    expect("hdop", f->hdop, 118);
+    expect("vdop", f->vdop, 154);
+    expect("fix_type", f->fix_type, GNSS_FIX_3D);
+    expect("num_sv", f->num_sv, 8);
+    expect("time", f->hour * 10000 + f->min * 100 + f->sec, 92725);
+    expect("date", f->year * 10000 + f->month * 100 + f->day, 20021209);
+    expect("valid", f->valid, 0x7f);
+    expect("gsv page", d.gsv.msg_num * 10 + d.gsv.total_msgs, 13);
+    expect("gsv in view", d.gsv.num_in_view, 9);
+    expect("gsv count", d.gsv.count, 4);
+    expect("gsv svid", d.gsv.sats[0].svid, 9);
+    expect("gsv cn0", d.gsv.sats[3].cn0, 35);
+    expect("gsv empty elevation", d.gsv.sats[0].elev, -1);
+
+    expect("malformed", decode_str(&d, "$GNGGA,092725.00,4717.1x399,N*00\r\n"), NMEA_MSG_INVALID);
+    expect("unknown", decode_str(&d, "$GNZDA,082710.00,16,09,2002,00,00*76\r\n"), NMEA_MSG_UNKNOWN);
+}
+
+// Appends one sentence with its checksum
+static size_t emit(char *out, const char *body) {
+    uint8_t x = 0;
+    for (const char *p = body; *p; p++) x ^= (uint8_t)*p;
+    return (size_t)sprintf(out, "$%s*%02X\r\n", body, x);
+}
+
+// What a multi-constellation receiver sends per epoch: RMC, VTG, GGA, a
+// GSA per system and the GSV pages of 12 satellites per system
+static char *synthesize(size_t *size) {
+    static const char *talkers[] = { "GP", "GL", "GA", "GB" };
+    size_t cap = (size_t)SYNTH_SECONDS * SYNTH_HZ * 2400;
+    char *buf = malloc(cap), body[160];
+    size_t n = 0;
+    srand(1);
+    for (int e = 0; e < SYNTH_SECONDS * SYNTH_HZ; e++) {
+        int ms = e * (1000 / SYNTH_HZ);
+        int s = ms / 1000 % 60, m = ms / 60000 % 60, h = 10 + ms / 3600000;
+        double lat = 4717.11437 + e * 1e-5, lon = 833.91522 + e * 2e-5;
+        double kn = 20.0 + (rand() % 1000) * 0.01;
+        snprintf(body, sizeof(body), "GNRMC,%02d%02d%02d.%02d,A,%.5f,N,%010.5f,E,%.3f,%.2f,160926,,,A,V",
+                 h, m, s, ms % 1000 / 10, lat, lon, kn, 77.52);
+        n += emit(buf + n, body);
+        snprintf(body, sizeof(body), "GNVTG,77.52,T,,M,%.3f,N,%.3f,K,A", kn, kn * 1.852);
+        n += emit(buf + n, body);
+        snprintf(body, sizeof(body), "GNGGA,%02d%02d%02d.%02d,%.5f,N,%010.5f,E,1,32,0.61,%.1f,M,48.0,M,,",
+                 h, m, s, ms % 1000 / 10, lat, lon, 499.6 + (rand() % 100) * 0.1);
+        n += emit(buf + n, body);
+        for (int c = 0; c < 4; c++) {
+            snprintf(body, sizeof(body), "GNGSA,A,3,%02d,%02d,%02d,%02d,%02d,%02d,%02d,%02d,,,,,1.04,0.61,0.84,%d",
+                     c * 8 + 1, c * 8 + 2, c * 8 + 3, c * 8 + 4, c * 8 + 5, c * 8 + 6, c * 8 + 7, c * 8 + 8, c + 1);
+            n += emit(buf + n, body);
+        }
+        for (int c = 0; c < 4; c++) {
+            for (int page = 1; page <= 3; page++) {
+                int k = snprintf(body, sizeof(body), "%sGSV,3,%d,12", talkers[c], page);
+                for (int j = 0; j < 4; j++) {
+                    int sv = (page - 1) * 4 + j + 1;
+                    k += snprintf(body + k, sizeof(body) - k, ",%02d,%02d,%03d,%02d", sv, 10 + sv * 5,
+                                  sv * 29 % 360, 25 + rand() % 25);
+                }
+                snprintf(body + k, sizeof(body) - k, ",1");
+                n += emit(buf + n, body);
+            }
+        }
+    }
+    *size = n;
+    return buf;
+}
+
+static char *load(const char *path, size_t *size) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *buf = malloc(len > 0 ? (size_t)len : 1);
+    *size = fread(buf, 1, (size_t)len, f);
+    fclose(f);
+    return buf;
+}
+
+int main(int argc, char **argv) {
+    self_check();
+    printf("known sentences: %s\n", failures ? "FAILED" : "ok");
+
+    size_t size;
+    char *buf = argc > 1 ? load(argv[1], &size) : synthesize(&size);
+    if (!buf) return 1;
+
+    // Sentences are the '$'...'\n' runs, as the framer hands them over
+    size_t count = 0, cap = 1024, bytes = 0;
+    sentence_t *list = malloc(cap * sizeof(*list));
+    for (size_t i = 0; i < size; i++) {
+        if (buf[i] != '$') continue;
+        const char *end = memchr(buf + i, '\n', size - i);
+        size_t len = end ? (size_t)(end - (buf + i)) + 1 : size - i;
+        if (count == cap) list = realloc(list, (cap *= 2) * sizeof(*list));
+        list[count++] = (sentence_t){ buf + i, len };
+        bytes += len;
+        i += len - 1;
+    }
+    if (count == 0) {
+        printf("no sentences in %s\n", argc > 1 ? argv[1] : "the synthetic stream");
+        return 1;
+    }
+
+    nmea_decoder_t d;
+    uint32_t types[NMEA_MSG_INVALID + 1] = { 0 };
+    nmea_decoder_init(&d);
+    for (size_t i = 0; i < count; i++) types[nmea_decode(&d, list[i].s, list[i].len)]++;
+
+    unsigned passes = 0;
+    double t0 = now_s(), t;
+    do {
+        nmea_decoder_init(&d);
+        for (size_t i = 0; i < count; i++) nmea_decode(&d, list[i].s, list[i].len);
+        passes++;
+    } while ((t = now_s() - t0) < MIN_RUN_S);
+
+    printf("%s: %zu sentences, %zu bytes (RMC %u GGA %u GSA %u GSV %u VTG %u, other %u, malformed %u)\n",
+           argc > 1 ? argv[1] : "synthetic 25 Hz, 4 constellations", count, bytes, types[NMEA_MSG_RMC],
+           types[NMEA_MSG_GGA], types[NMEA_MSG_GSA], types[NMEA_MSG_GSV], types[NMEA_MSG_VTG],
+           types[NMEA_MSG_UNKNOWN], types[NMEA_MSG_INVALID]);
+    printf("decode: %.2f M sentences/s, %.1f MB/s, %.0f ns/sentence (%u passes)\n",
+           count * passes / t * 1e-6, bytes * (double)passes / t * 1e-6, t / (count * (double)passes) * 1e9, passes);
+    free(list);
+    free(buf);
+    return failures ? 1 : 0;
+}
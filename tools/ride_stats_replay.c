@@ -0,0 +1,265 @@
+// Replays synthetic rides through the ride statistics engine on a PC.
+//
+//   gcc -O2 -I../main/include ride_stats_replay.c ../main/ride_stats.c -lm -o ride_stats_replay
+//   ./ride_stats_replay [seed]
+//
+// A 3 h ride at 46.5 N over rolling terrain is sampled as the logger
+// feeds it: 10 Hz fixes with 1.2 m correlated position noise, Doppler
+// speed noise and rare 30 m/s glitches, and 25 Hz baro altitude with
+// noise and a slow drift. There are stops of 20-90 s, a 15 min stop
+// during which the pressure drifts, and a 20 s GNSS outage. Distance,
+// moving time, gain and loss are compared with the true path, and the
+// maximum speed with the fastest the bike went. The ride is fed a second
+// time with the state saved and restored every 10 min, as through NVS.
+// Then the no-fix drift case: 10 min of baro rising 30 m before the first
+// fix, and again during an outage after 2 min of riding on the flat, must
+// climb nothing. Exit status 1 if an error bound is exceeded.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ride_stats.h"
+
+#define WGS84_A         6378137.0
+#define WGS84_E2        6.69437999014e-3
+#define STEP_US         20000   // 50 Hz: baro every 2nd step, fixes every 5th
+#define HOURS           3.0
+#define LAT0            46.5
+#define SAVE_PERIOD_US  600000000LL
+#define DRIFT_M         30.0
+
+typedef struct {
+    char type;              // 'F' fix, 'A' altitude
+    int64_t t_us;
+    int32_t lat, lon;
+    float v;                // m/s for a fix, m for an altitude
+} event_t;
+
+typedef struct {
+    double distance, moving, gain, loss, max_speed;
+} truth_t;
+
+static int failures;
+static event_t *events;
+static size_t n_events, cap_events;
+
+static void expect_max(const char *what, double got, double max) {
+    printf("  %-44s %9.4f (limit %.4f)\n", what, got, max);
+    if (got <= max) return;
+    printf("FAIL %s\n", what);
+    failures++;
+}
+
+static double gauss(void) {
+    double u = (rand() + 1.0) / (RAND_MAX + 2.0), v = (rand() + 1.0) / (RAND_MAX + 2.0);
+    return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+static double uniform(double lo, double hi) {
+    return lo + (hi - lo) * (rand() / (double)RAND_MAX);
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void add(char type, int64_t t_us, double lat, double lon, double v) {
+    if (n_events == cap_events) {
+        cap_events = cap_events ? 2 * cap_events : 1 << 16;
+        events = realloc(events, cap_events * sizeof(*events));
+        if (!events) exit(2);
+    }
+    events[n_events++] = (event_t){ type, t_us, (int32_t)llround(lat * 1e7), (int32_t)llround(lon * 1e7), (float)v };
+}
+
+// Meridian and prime vertical radii at lat, deg
+static void radii(double lat, double *m, double *n) {
+    double s = sin(lat * M_PI / 180), k = 1 / sqrt(1 - WGS84_E2 * s * s);
+    *n = WGS84_A * k;
+    *m = *n * (1 - WGS84_E2) * k * k;
+}
+
+// Move d metres on bearing brg (rad); steps are centimetres, so the local
+// radii are exact enough for the truth
+static void move(double *lat, double *lon, double brg, double d) {
+    double m, n;
+    radii(*lat, &m, &n);
+    *lat += d * cos(brg) / m * 180 / M_PI;
+    *lon += d * sin(brg) / (n * cos(*lat * M_PI / 180)) * 180 / M_PI;
+}
+
+static double terrain(double s) {
+    return 400 * sin(s / 9000) + 60 * sin(s / 1300 + 1) + 8 * sin(s / 170) + 600;
+}
+
+static bool stopped(const double (*stops)[2], int n, double t) {
+    for (int i = 0; i < n; i++) {
+        if (t >= stops[i][0] && t < stops[i][0] + stops[i][1]) return true;
+    }
+    return false;
+}
+
+static void ride(truth_t *tr) {
+    const double end_s = HOURS * 3600, outage_s = 0.3 * end_s, dt = STEP_US * 1e-6;
+    double stops[64][2];
+    int n_stops = 0;
+    for (double t = 300; t < end_s - 600 && n_stops < 63; t += uniform(400, 1500)) {
+        stops[n_stops][0] = t;
+        stops[n_stops++][1] = uniform(20, 90);
+    }
+    stops[n_stops][0] = 0.55 * end_s;
+    stops[n_stops++][1] = 900;
+
+    double lat = LAT0, lon = 8.0, brg = 0.3, s = 0, v = 0, vt = 8, nx = 0, ny = 0, bias = 0;
+    double prev_h = terrain(0), fix_lat = lat, fix_lon = lon;
+    memset(tr, 0, sizeof(*tr));
+    for (long k = 0; k * dt < end_s; k++) {
+        double t = k * dt;
+        bool stop = stopped(stops, n_stops, t);
+        if (stop) {
+            v = fmax(0, v - 3 * dt);
+        } else {
+            if (rand() % 500 == 0) vt = uniform(4, 14);
+            double grade = terrain(s + 1) - terrain(s);
+            double target = grade > 0 ? vt * (1 - 6 * grade) : vt * (1 - 3 * grade);
+            target = fmin(fmax(target, 2.5), 18);
+            v += fmax(-2.5 * dt, fmin(1.5 * dt, target - v));
+        }
+        brg += 0.01 * gauss();
+        if (v > 0) {
+            move(&lat, &lon, brg, v * dt);
+            s += v * dt;
+            tr->moving += dt;
+        }
+        if (v > tr->max_speed) tr->max_speed = v;
+        double h = terrain(s);
+        if (h > prev_h) {
+            tr->gain += h - prev_h;
+        } else {
+            tr->loss += prev_h - h;
+        }
+        prev_h = h;
+
+        // Pressure drifts slowly, and faster with the weather during a stop
+        bias += 0.002 * gauss() + (stop ? 0.003 * dt : 0);
+        int64_t t_us = k * STEP_US;
+        if (k % 2 == 0) add('A', t_us, 0, 0, h + bias + 0.12 * gauss());
+        if (k % 5 == 0) {
+            nx = 0.998 * nx + 0.076 * gauss();
+            ny = 0.998 * ny + 0.076 * gauss();
+            double e_lat = lat, e_lon = lon;
+            move(&e_lat, &e_lon, atan2(nx, ny), hypot(nx, ny));
+            double speed = fabs(v + 0.08 * gauss()) + (rand() % 5000 == 0 ? 30 : 0);
+            if (t < outage_s || t >= outage_s + 20) add('F', t_us, e_lat, e_lon, speed);
+
+            double m, n, mid = (lat + fix_lat) / 2 * M_PI / 180;
+            radii((lat + fix_lat) / 2, &m, &n);
+            tr->distance += hypot(m * (lat - fix_lat) * M_PI / 180, n * cos(mid) * (lon - fix_lon) * M_PI / 180);
+            fix_lat = lat;
+            fix_lon = lon;
+        }
+    }
+}
+
+static void feed(ride_stats_t *s, const event_t *e) {
+    if (e->type == 'F') {
+        ride_stats_fix(s, e->t_us, e->lat, e->lon, e->v);
+    } else {
+        ride_stats_alt(s, e->t_us, e->v);
+    }
+}
+
+static void replay(const truth_t *tr) {
+    const ride_stats_params_t params = RIDE_STATS_DEFAULT_PARAMS;
+    static ride_stats_t s, r;
+    ride_stats_init(&s, &params, NULL);
+    double t0 = now_s();
+    for (size_t i = 0; i < n_events; i++) feed(&s, &events[i]);
+    double ns = (now_s() - t0) * 1e9 / n_events;
+
+    ride_stats_init(&r, &params, NULL);
+    int64_t next_save = SAVE_PERIOD_US;
+    unsigned restores = 0;
+    for (size_t i = 0; i < n_events; i++) {
+        feed(&r, &events[i]);
+        if (events[i].t_us >= next_save) {
+            ride_stats_state_t saved = r.st;
+            ride_stats_init(&r, &params, &saved);
+            next_save += SAVE_PERIOD_US;
+            restores++;
+        }
+    }
+
+    ride_stats_summary_t o, ro;
+    ride_stats_summary(&s, &o);
+    ride_stats_summary(&r, &ro);
+    printf("%.0f h ride, %zu events: %.3f km in %.1f min moving (true %.3f km, %.1f min), +%.1f/-%.1f m "
+           "(true +%.1f/-%.1f), max %.2f m/s, VAM %.0f m/h\n", HOURS, n_events, o.distance_m / 1e3,
+           o.moving_s / 60, tr->distance / 1e3, tr->moving / 60, o.gain_m, o.loss_m, tr->gain, tr->loss,
+           o.max_speed, o.vam);
+    expect_max("distance error, %", 100 * fabs(o.distance_m / tr->distance - 1), 1.0);
+    expect_max("moving time error, %", 100 * fabs(o.moving_s / tr->moving - 1), 1.0);
+    expect_max("gain error, %", 100 * fabs(o.gain_m / tr->gain - 1), 3.0);
+    expect_max("loss error, %", 100 * fabs(o.loss_m / tr->loss - 1), 3.0);
+    expect_max("max speed above the true one, m/s", o.max_speed - tr->max_speed, 0.5);
+    printf("restored %u times:\n", restores);
+    expect_max("distance difference, m", fabs(ro.distance_m - o.distance_m), 2.0 * restores);
+    expect_max("moving time difference, s", fabs(ro.moving_s - o.moving_s), 0.1 * restores);
+    expect_max("gain difference, m", fabs(ro.gain_m - o.gain_m), params.ele_band * restores);
+    printf("update: %.1f ns per event\n", ns);
+}
+
+// Baro rising DRIFT_M over 10 min at 25 Hz from t0_us on, with no fix
+static void drift(ride_stats_t *s, int64_t t0_us, double alt) {
+    for (int k = 0; k < 15000; k++) ride_stats_alt(s, t0_us + k * 40000LL, (float)(alt + DRIFT_M * k / 15000.0));
+}
+
+static void no_fix_drift(void) {
+    const ride_stats_params_t params = RIDE_STATS_DEFAULT_PARAMS;
+    ride_stats_t s;
+    ride_stats_summary_t o;
+    printf("baro rising %.0f m in 10 min without a fix:\n", DRIFT_M);
+
+    // Indoors at power-on, then out on the flat
+    ride_stats_init(&s, &params, NULL);
+    drift(&s, 0, 500);
+    for (int k = 0; k < 1200; k++) {
+        int64_t t = 600000000LL + k * 100000LL;
+        ride_stats_fix(&s, t, 465000000 + k * 90, 80000000, 8.0f);
+        ride_stats_alt(&s, t, (float)(500 + DRIFT_M));
+    }
+    ride_stats_summary(&s, &o);
+    expect_max("before the first fix, gain m", o.gain_m, 0);
+
+    // 2 min on the flat, then the fixes stop while the ride goes on
+    ride_stats_init(&s, &params, NULL);
+    int64_t t = 0;
+    for (int k = 0; k < 1200; k++, t += 100000) {
+        ride_stats_fix(&s, t, 465000000 + k * 90, 80000000, 8.0f);
+        ride_stats_alt(&s, t, 500.0f);
+    }
+    drift(&s, t, 500);
+    t += 600000000;
+    for (int k = 0; k < 1200; k++, t += 100000) {
+        ride_stats_fix(&s, t, 466080000 + k * 90, 80000000, 8.0f);
+        ride_stats_alt(&s, t, (float)(500 + DRIFT_M));
+    }
+    ride_stats_summary(&s, &o);
+    double allowed = DRIFT_M * params.max_gap_us / 600e6;
+    expect_max("during an outage, gain m", o.gain_m, allowed);
+}
+
+int main(int argc, char **argv) {
+    srand(argc > 1 ? (unsigned)atoi(argv[1]) : 1);
+    truth_t tr;
+    ride(&tr);
+    replay(&tr);
+    no_fix_drift();
+    free(events);
+    printf("ride checks: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,148 @@
+// Stress test of the lock-free sample ring with one producer and several
+// consumers of different speeds.
+//
+//   gcc -O2 -pthread -I../main/include ring_stress.c ../main/sample_ring.c -o ring_stress
+//   ./ring_stress [consumers] [samples]      default 3 consumers, 20000000 samples
+//
+// The producer publishes as fast as it can into a 64-slot ring; every
+// sample is derived from its sequence number. Consumer 0 reads without
+// delay, the others spin per sample so they are lapped all the time, and
+// one more thread polls sample_ring_read_latest(). A run accepted by
+// sample_ring_consume() must be intact and in order; every sample must be
+// either accepted or counted lost on the cursor. On a single core the
+// threads only meet at preemption, so discarded runs are rare; use a
+// multi-core machine. Exit status 1 if a torn sample was accepted or
+// samples went missing.
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "sample_ring.h"
+
+#define MAX_CONSUMERS   8
+#define RING_SLOTS      64
+#define SLOW_SPIN       2000    // Busy loop per sample in slow consumers
+
+typedef struct {
+    uint64_t seq, a, b, c;
+} sample_t;
+
+typedef struct {
+    pthread_t thread;
+    int spin;
+    uint64_t got, torn, fails;
+    uint32_t lost;
+} consumer_t;
+
+static sample_t slots[RING_SLOTS];
+static sample_ring_t ring;
+static uint64_t total;
+static atomic_int done;
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int intact(const sample_t *s) {
+    return s->a == s->seq * 3 && s->b == (s->seq ^ 0x5555) && s->c == ~s->seq;
+}
+
+static void *producer(void *arg) {
+    (void)arg;
+    for (uint64_t i = 0; i < total; i++) {
+        sample_t *s = sample_ring_claim(&ring);
+        s->seq = i;
+        s->a = i * 3;
+        s->b = i ^ 0x5555;
+        s->c = ~i;
+        sample_ring_publish(&ring);
+    }
+    atomic_store(&done, 1);
+    return NULL;
+}
+
+static void *consumer(void *arg) {
+    consumer_t *c = arg;
+    sample_cursor_t cur;
+    sample_cursor_init(&ring, &cur);
+    uint64_t last = 0;
+    int first = 1;
+    for (;;) {
+        uint32_t n;
+        const sample_t *s = sample_ring_peek(&ring, &cur, &n);
+        if (!s) {
+            if (atomic_load(&done) && sample_ring_count(&ring) == cur.seq) break;
+            continue;
+        }
+        // Read in place, decide after the consume check
+        uint64_t run_last = last;
+        int run_first = first, torn = 0;
+        for (uint32_t i = 0; i < n; i++) {
+            if (!intact(&s[i]) || (!run_first && s[i].seq <= run_last)) torn = 1;
+            run_last = s[i].seq;
+            run_first = 0;
+            for (volatile int k = 0; k < c->spin; k++) {
+            }
+        }
+        if (sample_ring_consume(&ring, &cur, n)) {
+            c->got += n;
+            c->torn += torn;
+            last = run_last;
+            first = 0;
+        } else {
+            c->fails++;
+        }
+    }
+    c->lost = cur.lost;
+    return NULL;
+}
+
+static void *latest_reader(void *arg) {
+    uint64_t *torn = arg;
+    sample_t s;
+    while (!atomic_load(&done)) {
+        if (sample_ring_read_latest(&ring, &s) && !intact(&s)) (*torn)++;
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    int consumers = argc > 1 ? atoi(argv[1]) : 3;
+    total = argc > 2 ? strtoull(argv[2], NULL, 10) : 20000000;
+    if (consumers < 1 || consumers > MAX_CONSUMERS || total < 1000 || total >= UINT32_MAX) {
+        fprintf(stderr, "usage: %s [consumers 1-%d] [samples 1000..2^32-1]\n", argv[0], MAX_CONSUMERS);
+        return 2;
+    }
+
+    sample_ring_init(&ring, slots, sizeof(sample_t), RING_SLOTS);
+    static consumer_t c[MAX_CONSUMERS];
+    pthread_t prod, latest;
+    uint64_t latest_torn = 0;
+    for (int i = 0; i < consumers; i++) {
+        c[i].spin = i == 0 ? 0 : SLOW_SPIN * i;
+        pthread_create(&c[i].thread, NULL, consumer, &c[i]);
+    }
+    pthread_create(&latest, NULL, latest_reader, &latest_torn);
+    double t0 = now_s();
+    pthread_create(&prod, NULL, producer, NULL);
+    pthread_join(prod, NULL);
+    double t1 = now_s();
+
+    int bad = 0;
+    for (int i = 0; i < consumers; i++) {
+        pthread_join(c[i].thread, NULL);
+        printf("consumer %d (spin %5d): %llu read, %lu lost, %llu torn accepted, %llu runs discarded\n", i,
+               c[i].spin, (unsigned long long)c[i].got, (unsigned long)c[i].lost, (unsigned long long)c[i].torn,
+               (unsigned long long)c[i].fails);
+        if (c[i].torn || c[i].got + c[i].lost != total) bad = 1;
+    }
+    pthread_join(latest, NULL);
+    printf("read_latest: %llu torn\n", (unsigned long long)latest_torn);
+    printf("%llu samples, %.1f M samples/s published\n", (unsigned long long)total, total / (t1 - t0) / 1e6);
+    printf("ring stress: %s\n", bad || latest_torn ? "FAILED" : "ok");
+    return bad || latest_torn ? 1 : 0;
+}
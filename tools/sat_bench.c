@@ -0,0 +1,244 @@
+// Checks the satellite table and times a NAV-SAT update at 60+ SVs.
+//
+//   gcc -O2 -I../main/include sat_bench.c ../main/sat_table.c -o sat_bench
+//   ./sat_bench
+//
+// A simulated sky of up to 64 satellites over four constellations drifts
+// in CN0 every epoch, with satellites rising and setting. It is fed as
+// NAV-SAT and as multi-page GSV runs, some with a page lost. After every
+// message order[] and rank[] must be inverse permutations sorted by CN0;
+// after every complete run the table must hold exactly the sky that run
+// reported. The timing compares the incremental update against clearing
+// the table and sorting all entries each epoch, as a display that re-sorts
+// would. Exit status 1 if a check fails.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sat_table.h"
+
+#define SKY_MAX         64
+#define EPOCHS          5000
+#define MIN_RUN_S       1.0
+
+typedef struct {
+    uint8_t gnss, svid, cn0, up;
+    int8_t elev;
+    int16_t azim;
+} sky_sv_t;
+
+static int failures;
+static sky_sv_t sky[SKY_MAX];
+
+static void expect(const char *what, long got, long want) {
+    if (got == want) return;
+    if (failures < 20) printf("FAIL %s: got %ld, want %ld\n", what, got, want);
+    failures++;
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void sky_init(void) {
+    static const uint8_t gnss[4] = { SAT_GNSS_GPS, SAT_GNSS_GALILEO, SAT_GNSS_BEIDOU, SAT_GNSS_GLONASS };
+    for (int k = 0; k < SKY_MAX; k++) {
+        sky[k].gnss = gnss[k % 4];
+        sky[k].svid = (uint8_t)(k / 4 + 1);
+        sky[k].cn0 = (uint8_t)(15 + rand() % 35);
+        sky[k].up = 1;
+        sky[k].elev = (int8_t)(rand() % 90);
+        sky[k].azim = (int16_t)(rand() % 360);
+    }
+}
+
+// CN0 jitter every epoch; now and then a satellite sets or rises
+static void sky_step(int churn) {
+    for (int k = 0; k < SKY_MAX; k++) {
+        int c = sky[k].cn0 + rand() % 5 - 2;
+        sky[k].cn0 = (uint8_t)(c < 0 ? 0 : c > 55 ? 55 : c);
+        if (churn && rand() % 200 == 0) sky[k].up = !sky[k].up;
+    }
+}
+
+static int sky_count(int gnss) {
+    int n = 0;
+    for (int k = 0; k < SKY_MAX; k++) n += sky[k].up && (gnss < 0 || sky[k].gnss == gnss);
+    return n;
+}
+
+static int to_nav_sat(ubx_nav_sat_hdr_t *h, ubx_nav_sat_sv_t *sv) {
+    int n = 0;
+    for (int k = 0; k < SKY_MAX; k++) {
+        if (!sky[k].up) continue;
+        sv[n] = (ubx_nav_sat_sv_t){ sky[k].gnss, sky[k].svid, sky[k].cn0, sky[k].elev, sky[k].azim, 0,
+                                    sky[k].cn0 > 30 ? 0x08u : 0u };
+        n++;
+    }
+    memset(h, 0, sizeof(*h));
+    h->numSvs = (uint8_t)n;
+    return n;
+}
+
+static void check_order(const sat_table_t *t) {
+    for (int p = 0; p < t->count; p++) {
+        expect("rank[order[p]] == p", t->rank[t->order[p]], p);
+        if (p > 0) expect("order by CN0", t->cn0[t->order[p - 1]] >= t->cn0[t->order[p]], 1);
+    }
+}
+
+// The table must hold exactly the sky's satellites of gnss (-1: all)
+static void check_contents(const sat_table_t *t, int gnss, uint8_t sig) {
+    for (int k = 0; k < SKY_MAX; k++) {
+        if (!sky[k].up || (gnss >= 0 && sky[k].gnss != gnss)) continue;
+        int found = -1;
+        for (int i = 0; i < t->count; i++) {
+            if (t->key[i] == SAT_KEY(sky[k].gnss, sig, sky[k].svid)) found = i;
+        }
+        expect("reported satellite present", found >= 0, 1);
+        if (found >= 0) expect("CN0", t->cn0[found], sky[k].cn0);
+    }
+    int n = 0;
+    for (int i = 0; i < t->count; i++) n += gnss < 0 || SAT_KEY_GNSS(t->key[i]) == gnss;
+    expect("no stale satellites", n, sky_count(gnss));
+}
+
+static int talker_of(uint8_t gnss) {
+    switch (gnss) {
+        case SAT_GNSS_GPS:     return NMEA_TALKER_GPS;
+        case SAT_GNSS_GALILEO: return NMEA_TALKER_GALILEO;
+        case SAT_GNSS_BEIDOU:  return NMEA_TALKER_BEIDOU;
+        default:               return NMEA_TALKER_GLONASS;
+    }
+}
+
+// Sends one constellation as a GSV run; lose_page > 0 drops that page.
+// Returns 1 if the run was complete.
+static int feed_gsv_run(sat_table_t *t, uint8_t gnss, int lose_page) {
+    int idx[SKY_MAX], n = 0;
+    for (int k = 0; k < SKY_MAX; k++) {
+        if (sky[k].up && sky[k].gnss == gnss) idx[n++] = k;
+    }
+    int pages = n ? (n + NMEA_GSV_SATS_PER_MSG - 1) / NMEA_GSV_SATS_PER_MSG : 1;
+    for (int m = 1; m <= pages; m++) {
+        nmea_gsv_t g = { 0 };
+        g.talker = (uint8_t)talker_of(gnss);
+        g.total_msgs = (uint8_t)pages;
+        g.msg_num = (uint8_t)m;
+        g.num_in_view = (uint8_t)n;
+        g.signal_id = 1;
+        for (int j = (m - 1) * NMEA_GSV_SATS_PER_MSG; j < n && g.count < NMEA_GSV_SATS_PER_MSG; j++) {
+            const sky_sv_t *s = &sky[idx[j]];
+            g.sats[g.count++] = (nmea_gsv_sat_t){ s->svid, s->elev, (uint16_t)s->azim, s->cn0 };
+        }
+        if (m == lose_page) continue;
+        sat_table_feed_gsv(t, &g);
+        check_order(t);
+    }
+    return lose_page < 1 || lose_page > pages;
+}
+
+static void test_nav_sat(void) {
+    static sat_table_t t;
+    ubx_nav_sat_hdr_t h;
+    ubx_nav_sat_sv_t sv[SKY_MAX];
+    sat_table_init(&t);
+    sky_init();
+    for (int e = 0; e < EPOCHS; e++) {
+        sky_step(1);
+        to_nav_sat(&h, sv);
+        sat_table_feed_nav_sat(&t, &h, sv);
+        check_order(&t);
+        check_contents(&t, -1, 0);
+    }
+    expect("NAV-SAT runs", (long)t.updates, EPOCHS);
+    expect("overflows", (long)t.overflows, 0);
+    printf("NAV-SAT: %d epochs, %u satellites dropped on setting\n", EPOCHS, (unsigned)t.dropped);
+}
+
+static void test_gsv(void) {
+    static const uint8_t gnss[4] = { SAT_GNSS_GPS, SAT_GNSS_GALILEO, SAT_GNSS_BEIDOU, SAT_GNSS_GLONASS };
+    static sat_table_t t;
+    sat_table_init(&t);
+    sky_init();
+    int lost = 0;
+    for (int e = 0; e < EPOCHS; e++) {
+        sky_step(1);
+        for (int c = 0; c < 4; c++) {
+            sat_table_t before = t;
+            int lose = rand() % 20 == 0 ? 1 + rand() % 5 : 0;
+            if (feed_gsv_run(&t, gnss[c], lose)) {
+                check_contents(&t, gnss[c], 1);
+            } else {
+                // Nothing swept on an incomplete run
+                lost++;
+                expect("no sweep after a lost page", (long)t.updates, (long)before.updates);
+            }
+        }
+    }
+    printf("GSV: %d epochs x 4 constellations, %d runs with a lost page\n", EPOCHS, lost);
+}
+
+// Baseline: rebuild the arrays and sort the index from scratch
+static const sat_table_t *full_sort_table;
+
+static int cmp_full(const void *a, const void *b) {
+    const uint8_t *cn0 = full_sort_table->cn0;
+    return cn0[*(const uint8_t *)b] - cn0[*(const uint8_t *)a];
+}
+
+static void full_update(sat_table_t *t, const ubx_nav_sat_hdr_t *h, const ubx_nav_sat_sv_t *sv) {
+    t->count = 0;
+    for (int k = 0; k < h->numSvs; k++) {
+        uint8_t i = t->count++;
+        t->key[i] = SAT_KEY(sv[k].gnssId, 0, sv[k].svId);
+        t->cn0[i] = sv[k].cno;
+        t->elev[i] = sv[k].elev;
+        t->azim[i] = (uint16_t)sv[k].azim;
+        t->flags[i] = (sv[k].flags & 0x08) ? SAT_FLAG_USED : 0;
+        t->order[i] = i;
+    }
+    full_sort_table = t;
+    qsort(t->order, t->count, 1, cmp_full);
+    for (int p = 0; p < t->count; p++) t->rank[t->order[p]] = (uint8_t)p;
+}
+
+static void bench(void) {
+    static ubx_nav_sat_hdr_t h[EPOCHS];
+    static ubx_nav_sat_sv_t sv[EPOCHS][SKY_MAX];
+    static sat_table_t t;
+    sky_init();
+    for (int e = 0; e < EPOCHS; e++) {
+        sky_step(0);
+        to_nav_sat(&h[e], sv[e]);
+    }
+
+    for (int mode = 0; mode < 2; mode++) {
+        long n = 0;
+        double t0 = now_s(), t1;
+        sat_table_init(&t);
+        do {
+            for (int e = 0; e < EPOCHS; e++) {
+                if (mode == 0) sat_table_feed_nav_sat(&t, &h[e], sv[e]);
+                else full_update(&t, &h[e], sv[e]);
+            }
+            n += EPOCHS;
+            t1 = now_s();
+        } while (t1 - t0 < MIN_RUN_S);
+        printf("%-28s %d satellites: %6.2f us per update\n", mode ? "clear and sort each epoch," : "incremental (sat_table),",
+               SKY_MAX, (t1 - t0) * 1e6 / n);
+        check_order(&t);
+    }
+}
+
+int main(void) {
+    srand(9);
+    test_nav_sat();
+    test_gsv();
+    bench();
+    printf("satellite table checks: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,132 @@
+// Torn-read stress test and publish latency of the GNSS snapshot seqlock.
+//
+//   gcc -O2 -pthread -I../main/include snapshot_stress.c ../main/gnss_snapshot.c -o snapshot_stress
+//   ./snapshot_stress [readers] [publishes]        default 3 readers, 1000000 publishes
+//
+// One writer publishes fixes whose every byte is derived from the epoch,
+// at a few microseconds apart so reads overlap publishes all the time.
+// Even readers poll with gnss_snapshot_read_newer(), odd ones copy every
+// time with gnss_snapshot_read(); each copy is checked byte for byte.
+// Publish latency is measured without readers first, then under
+// contention; on fewer cores than threads the maximum is a preemption,
+// not the seqlock. Exit status 1 on a torn read or an epoch going back.
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "gnss_snapshot.h"
+
+#define MAX_READERS     16
+#define WRITER_SPIN     300     // Busy loop between publishes
+
+typedef struct {
+    pthread_t thread;
+    int every;              // Copy even without a new epoch
+    long reads, fresh, misses, torn, backwards;
+} reader_t;
+
+static gnss_snapshot_store_t store;
+static atomic_int stop;
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void make_fix(gnss_fix_t *f, uint32_t epoch) {
+    memset(f, (int)(epoch * 131u >> 3), sizeof(*f));
+    f->lat = (int32_t)epoch;
+    f->lon = -(int32_t)epoch;
+}
+
+static int consistent(const gnss_snapshot_t *s) {
+    gnss_fix_t want;
+    make_fix(&want, s->epoch);
+    return memcmp(&s->fix, &want, sizeof(want)) == 0 && s->capture_us == (int64_t)s->epoch * 3;
+}
+
+static void *reader(void *arg) {
+    reader_t *r = arg;
+    gnss_snapshot_t s;
+    uint32_t last = 0;
+    while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+        r->reads++;
+        bool ok = r->every ? gnss_snapshot_read(&store, &s) : gnss_snapshot_read_newer(&store, last, &s);
+        if (!ok || s.epoch == last) {
+            r->misses++;
+            continue;
+        }
+        r->fresh++;
+        if (!consistent(&s)) r->torn++;
+        if (s.epoch < last) r->backwards++;
+        last = s.epoch;
+    }
+    return NULL;
+}
+
+static int cmp_i64(const void *a, const void *b) {
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Publishes n fixes and prints the latency distribution
+static void publish_run(const char *label, long n, int64_t *lat) {
+    gnss_fix_t f;
+    for (long i = 0; i < n; i++) {
+        uint32_t epoch = (uint32_t)i + 1;
+        make_fix(&f, epoch);
+        for (volatile int k = 0; k < WRITER_SPIN; k++) {
+        }
+        int64_t t0 = now_ns();
+        gnss_snapshot_publish(&store, &f, (int64_t)epoch * 3);
+        lat[i] = now_ns() - t0;
+    }
+    qsort(lat, (size_t)n, sizeof(*lat), cmp_i64);
+    printf("publish, %-16s median %4lld ns, p99 %5lld ns, p99.99 %6lld ns, max %7lld ns\n", label,
+           (long long)lat[n / 2], (long long)lat[n * 99 / 100], (long long)lat[n * 9999 / 10000],
+           (long long)lat[n - 1]);
+}
+
+int main(int argc, char **argv) {
+    int readers = argc > 1 ? atoi(argv[1]) : 3;
+    long publishes = argc > 2 ? atol(argv[2]) : 1000000;
+    if (readers < 1 || readers > MAX_READERS || publishes < 100) {
+        fprintf(stderr, "usage: %s [readers 1-%d] [publishes >= 100]\n", argv[0], MAX_READERS);
+        return 2;
+    }
+    int64_t *lat = malloc((size_t)publishes * sizeof(*lat));
+
+    gnss_snapshot_init(&store);
+    publish_run("no readers:", publishes, lat);
+
+    gnss_snapshot_init(&store);
+    static reader_t r[MAX_READERS];
+    for (int i = 0; i < readers; i++) {
+        r[i].every = i & 1;
+        pthread_create(&r[i].thread, NULL, reader, &r[i]);
+    }
+    char label[32];
+    snprintf(label, sizeof(label), "%d readers:", readers);
+    publish_run(label, publishes, lat);
+    atomic_store(&stop, 1);
+
+    long torn = 0, backwards = 0;
+    for (int i = 0; i < readers; i++) {
+        pthread_join(r[i].thread, NULL);
+        printf("reader %d (%s): %ld reads, %ld new epochs, %ld without news, %ld torn, %ld out of order\n", i,
+               r[i].every ? "read" : "read_newer", r[i].reads, r[i].fresh, r[i].misses, r[i].torn, r[i].backwards);
+        torn += r[i].torn;
+        backwards += r[i].backwards;
+    }
+
+    gnss_snapshot_t s;
+    int last_ok = gnss_snapshot_read(&store, &s) && s.epoch == (uint32_t)publishes && consistent(&s);
+    printf("torn reads: %ld, out of order: %ld, final epoch %s\n", torn, backwards, last_ok ? "ok" : "WRONG");
+    free(lat);
+    return torn || backwards || !last_ok ? 1 : 0;
+}
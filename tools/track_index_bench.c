@@ -0,0 +1,337 @@
+// Session index cost at the scale of a full card, and its lookups checked,
+// on a PC.
+//
+//   gcc -O2 -I../main/include -Wl,--wrap=open,--wrap=pread track_index_bench.c ../main/track_index.c ../main/ride_stats.c ../main/track_log.c ../main/chunk_writer.c ../main/latency_hist.c -lm -o track_index_bench
+//   ./track_index_bench [sessions]
+//
+// Writes sessions (default 10000) of 2 to 10 min at 1 Hz into a scratch
+// directory under /tmp, a few hours to days apart, and appends each
+// summary to the index as the logger does when a session closes. The
+// logger stops at ACT_9999 (TRACK_NUMBER_MAX in logger.c), so a card
+// never holds more than 9999 of its sessions; here the 10000th is named
+// ACT_10000.TRK, which the index and the rebuild take like any other
+// name, to time the index at the size asked of it. Timed: the append, listing the whole
+// index and sorting it by distance, finding a date and reading a page of
+// 20 from there, the boot check that the newest track is indexed, an
+// insert older than every session, and against those a directory scan
+// that reads the first point of each file and a full rebuild. open and
+// pread are wrapped to count them. Checked: every find against a linear
+// search, track_index_contains for present and absent sessions, the
+// record CRCs, and the rebuilt index against the appended one apart from
+// the P-Box bests, which only the logger knows. Exit status 1 if a check
+// fails.
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "track_index.h"
+#include "track_log.h"
+
+#define SESSIONS        10000
+#define SESSIONS_MAX    99999   // ACT_nnnnn.TRK still fits TRACK_INDEX_NAME_LEN
+#define RING_SIZE       (64 * 1024)
+#define QUERIES         1000
+#define PAGE            20
+
+static int failures;
+static char dir[64], index_path[96];
+static int64_t sim_us;
+static unsigned long opens, preads;
+static track_index_rec_t *appended;
+
+int __real_open(const char *path, int flags, ...);
+ssize_t __real_pread(int fd, void *buf, size_t n, off_t off);
+
+int __wrap_open(const char *path, int flags, ...) {
+    va_list ap;
+    va_start(ap, flags);
+    int mode = flags & O_CREAT ? va_arg(ap, int) : 0;
+    va_end(ap);
+    opens++;
+    return __real_open(path, flags, mode);
+}
+
+ssize_t __wrap_pread(int fd, void *buf, size_t n, off_t off) {
+    preads++;
+    return __real_pread(fd, buf, n, off);
+}
+
+static void expect(const char *what, long got, long want) {
+    if (got == want) return;
+    printf("FAIL %s: got %ld, want %ld\n", what, got, want);
+    failures++;
+}
+
+static int64_t sim_clock(void) {
+    return sim_us;
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void path_of(char *path, size_t size, const char *file) {
+    snprintf(path, size, "%s/%s", dir, file);
+}
+
+static void count_reset(void) {
+    opens = preads = 0;
+}
+
+// A session written as the logger does, with its summary built alongside
+static void make_session(unsigned number, uint32_t start_s, track_summary_t *s) {
+    static uint8_t ring[RING_SIZE];
+    static track_log_t w;
+    const chunk_writer_config_t cfg = { .ring = ring, .ring_size = RING_SIZE, .clock_us = sim_clock };
+    char name[24], path[128];
+    snprintf(name, sizeof(name), "ACT_%04u.TRK", number);
+    path_of(path, sizeof(path), name);
+    track_log_init(&w, &cfg);
+    sim_us = 1000000;
+    expect("session created", track_log_open(&w, path, sim_us, 0x1000u + number, 4), 0);
+    track_summary_begin(s, name);
+
+    int points = 120 + rand() % 480;
+    int32_t lat = 470000000 + rand() % 10000000, lon = 80000000 + rand() % 10000000, ele = 400000 + rand() % 1000000;
+    for (int k = 0; k < points; k++, sim_us += 1000000) {
+        time_t t = (time_t)start_s + k;
+        struct tm tm;
+        gmtime_r(&t, &tm);
+        lat += rand() % 2000 - 800;
+        lon += rand() % 2000 - 800;
+        ele += rand() % 2000 - 900;
+        gpx_point_t p = {
+            .lat = lat, .lon = lon, .ele_mm = ele, .speed_mmps = (uint32_t)(3000 + rand() % 6000),
+            .year = (uint16_t)(tm.tm_year + 1900), .month = (uint8_t)(tm.tm_mon + 1), .day = (uint8_t)tm.tm_mday,
+            .hour = (uint8_t)tm.tm_hour, .min = (uint8_t)tm.tm_min, .sec = (uint8_t)tm.tm_sec,
+            .fix_type = 3, .num_sv = 12, .hdop = 80, .bat_mv = 3900,
+        };
+        track_log_point(&w, sim_us, &p);
+        track_summary_point(s, sim_us, &p);
+        if (chunk_writer_pending(&w.out) >= CHUNK_WRITER_CHUNK) chunk_writer_flush(&w.out);
+    }
+    if (rand() % 10 == 0) track_summary_pbox(s, 0, 3.0f + (rand() % 1000) * 0.01f);
+    expect("session closed", track_log_close(&w), 0);
+    track_summary_end(s, w.out.file_len);
+}
+
+static void fill(int sessions) {
+    track_summary_t s;
+    uint32_t start_s = 1700000000;
+    double total = 0, max = 0;
+    for (int i = 0; i < sessions; i++) {
+        start_s += 3600 + (uint32_t)(rand() % 200000);
+        make_session((unsigned)i + 1, start_s, &s);
+        appended[i] = s.rec;
+        double t0 = now_s();
+        expect("append", track_index_append(index_path, &s.rec), 0);
+        double t = now_s() - t0;
+        total += t;
+        if (t > max) max = t;
+    }
+    struct stat st;
+    stat(index_path, &st);
+    printf("%d sessions, index %ld KB\n", sessions, (long)st.st_size / 1024);
+    printf("  append in time order          %8.1f us mean, %.1f us max\n", total / sessions * 1e6, max * 1e6);
+    expect("index count", track_index_count(index_path), sessions);
+}
+
+static int by_distance(const void *a, const void *b) {
+    const track_index_rec_t *x = a, *y = b;
+    return x->distance_m < y->distance_m ? 1 : x->distance_m > y->distance_m ? -1 : 0;
+}
+
+static int by_start(const void *a, const void *b) {
+    const track_index_rec_t *x = a, *y = b;
+    return x->start_s < y->start_s ? -1 : x->start_s > y->start_s;
+}
+
+static void list(int sessions, track_index_rec_t *all) {
+    count_reset();
+    double t0 = now_s();
+    int32_t got = track_index_read(index_path, 0, (uint32_t)sessions, all);
+    long bad = 0;
+    for (int i = 0; i < got; i++) bad += !track_index_rec_valid(&all[i]);
+    double t_list = now_s() - t0;
+    qsort(all, (size_t)got, sizeof(all[0]), by_distance);
+    double t_sort = now_s() - t0;
+    printf("  list all                      %8.2f ms, %lu open, %lu preads\n", t_list * 1e3, opens, preads);
+    printf("  list all + sort by distance   %8.2f ms\n", t_sort * 1e3);
+    expect("records listed", got, sessions);
+    expect("records failing their CRC", bad, 0);
+}
+
+static void find(int sessions) {
+    double total = 0;
+    long wrong = 0;
+    count_reset();
+    for (int q = 0; q < QUERIES; q++) {
+        uint32_t first = appended[0].start_s, span = appended[sessions - 1].start_s - first;
+        uint32_t when = first + (uint32_t)((double)rand() / RAND_MAX * span);
+        track_index_rec_t page[PAGE];
+        double t0 = now_s();
+        int32_t at = track_index_find(index_path, when);
+        int32_t n = track_index_read(index_path, (uint32_t)at, PAGE, page);
+        total += now_s() - t0;
+
+        int32_t ref = 0;
+        while (ref < sessions && appended[ref].start_s < when) ref++;
+        wrong += at != ref || (n > 0 && page[0].start_s != appended[ref].start_s);
+    }
+    printf("  find a date + page of %d      %8.1f us, %.1f preads\n", PAGE, total / QUERIES * 1e6,
+           (double)preads / QUERIES);
+    expect("finds differing from a linear search", wrong, 0);
+}
+
+static void contains(int sessions) {
+    long missing = 0, false_hits = 0;
+    for (int i = 0; i < sessions; i += 97) {
+        const track_index_rec_t *r = &appended[i];
+        missing += track_index_contains(index_path, r->start_s, r->name) != 1;
+        false_hits += track_index_contains(index_path, r->start_s, "ACT_0000.TRK") != 0;
+        false_hits += track_index_contains(index_path, r->start_s + 1, r->name) != 0;
+    }
+    expect("indexed sessions not found", missing, 0);
+    expect("absent sessions found", false_hits, 0);
+
+    // What the logger does at boot for the newest track
+    const track_index_rec_t *last = &appended[sessions - 1];
+    char path[128];
+    track_summary_t s;
+    track_index_rec_t r;
+    path_of(path, sizeof(path), last->name);
+    count_reset();
+    double t0 = now_s();
+    track_index_read(index_path, (uint32_t)sessions - 1, 1, &r);
+    double t_last = now_s() - t0;
+    unsigned long last_preads = preads;
+    t0 = now_s();
+    int summarised = track_summary_file(&s, path, last->name);
+    int in = track_index_contains(index_path, s.rec.start_s, s.rec.name);
+    double t_check = now_s() - t0;
+    printf("  boot: newest is last record   %8.1f us, %lu preads\n", t_last * 1e6, last_preads);
+    printf("  boot: summarise + contains    %8.1f us, %lu preads\n", t_check * 1e6, preads - last_preads);
+    expect("newest track summarised", summarised, 0);
+    expect("newest track in the index", in, 1);
+}
+
+static void scan(int sessions) {
+    track_index_rec_t *recs = calloc((size_t)sessions + 16, sizeof(*recs));
+    static uint8_t buf[TRACK_BLOCK_HDR_LEN + TRACK_BLOCK_MAX];
+    int n = 0;
+    count_reset();
+    double t0 = now_s();
+    DIR *d = opendir(dir);
+    struct dirent *e;
+    while (recs && d && (e = readdir(d)) != NULL && n < sessions + 16) {
+        if (strncasecmp(e->d_name, "ACT_", 4) != 0) continue;
+        char path[sizeof(dir) + sizeof(e->d_name)];
+        snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+        int fd = open(path, O_RDONLY);
+        track_header_t h;
+        track_reader_t r;
+        track_rec_t rec;
+        if (fd >= 0 && pread(fd, buf, TRACK_HEADER_LEN, 0) == TRACK_HEADER_LEN &&
+            track_header_parse(buf, TRACK_HEADER_LEN, &h) &&
+            pread(fd, buf, sizeof(buf), TRACK_HEADER_LEN) > TRACK_BLOCK_HDR_LEN) {
+            track_reader_begin(&r, &h, buf);
+            if (track_reader_next(&r, &rec)) recs[n].start_s = (uint32_t)(track_point_utc_ms(&rec.point.p) / 1000);
+            snprintf(recs[n].name, sizeof(recs[n].name), "%.*s", TRACK_INDEX_NAME_LEN - 1, e->d_name);
+            n++;
+        }
+        if (fd >= 0) close(fd);
+    }
+    if (d) closedir(d);
+    qsort(recs, (size_t)n, sizeof(recs[0]), by_start);
+    printf("without the index:\n");
+    printf("  scan first points + sort      %8.1f ms, %lu opens, %lu preads\n", (now_s() - t0) * 1e3, opens, preads);
+    expect("files scanned", n, sessions);
+    free(recs);
+}
+
+static void rebuild(int sessions, track_index_rec_t *all) {
+    char path[128];
+    path_of(path, sizeof(path), "REBUILT.IDX");
+    count_reset();
+    double t0 = now_s();
+    int32_t n = track_index_rebuild(dir, path);
+    printf("  rebuild from every file       %8.0f ms, %lu opens, %lu preads\n", (now_s() - t0) * 1e3, opens, preads);
+    expect("sessions rebuilt", n, sessions);
+
+    long differ = 0;
+    expect("rebuilt records read", track_index_read(path, 0, (uint32_t)sessions, all), sessions);
+    for (int i = 0; i < sessions; i++) {
+        track_index_rec_t a = appended[i], b = all[i];
+        memset(a.pbox_ms, 0, sizeof(a.pbox_ms));
+        memset(b.pbox_ms, 0, sizeof(b.pbox_ms));
+        a.crc = b.crc = 0;
+        differ += memcmp(&a, &b, sizeof(a)) != 0;
+    }
+    expect("rebuilt records differing from the appended ones", differ, 0);
+    unlink(path);
+}
+
+static void insert_oldest(int sessions) {
+    track_index_rec_t early = appended[0], r;
+    early.start_s = 1;
+    snprintf(early.name, sizeof(early.name), "ACT_0000.TRK");
+    double t0 = now_s();
+    expect("insert", track_index_append(index_path, &early), 0);
+    printf("  insert older than all         %8.1f ms\n", (now_s() - t0) * 1e3);
+    expect("count after the insert", track_index_count(index_path), sessions + 1);
+    expect("find the inserted session", track_index_find(index_path, 1), 0);
+    expect("inserted session found", track_index_contains(index_path, 1, "ACT_0000.TRK"), 1);
+    expect("first record read", track_index_read(index_path, 0, 1, &r), 1);
+    expect("first record is the inserted one", strcmp(r.name, "ACT_0000.TRK"), 0);
+}
+
+static void clean_up(int sessions) {
+    char path[128], name[24];
+    for (int i = 0; i < sessions; i++) {
+        snprintf(name, sizeof(name), "ACT_%04u.TRK", (unsigned)i + 1);
+        path_of(path, sizeof(path), name);
+        unlink(path);
+    }
+    unlink(index_path);
+    rmdir(dir);
+}
+
+int main(int argc, char **argv) {
+    int sessions = argc > 1 ? atoi(argv[1]) : SESSIONS;
+    if (sessions < 1 || sessions > SESSIONS_MAX) {
+        fprintf(stderr, "usage: %s [sessions, 1..%d]\n", argv[0], SESSIONS_MAX);
+        return 2;
+    }
+    snprintf(dir, sizeof(dir), "/tmp/track_index_bench.XXXXXX");
+    if (!mkdtemp(dir)) {
+        perror(dir);
+        return 2;
+    }
+    path_of(index_path, sizeof(index_path), "TRACKS.IDX");
+    appended = calloc((size_t)sessions, sizeof(*appended));
+    track_index_rec_t *all = calloc((size_t)sessions, sizeof(*all));
+    if (!appended || !all) return 2;
+
+    srand(7);
+    fill(sessions);
+    list(sessions, all);
+    find(sessions);
+    contains(sessions);
+    insert_oldest(sessions);
+    scan(sessions);
+    rebuild(sessions, all);
+    clean_up(sessions);
+    free(all);
+    free(appended);
+    printf("index checks: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,335 @@
+// Size and encoding cost of the binary track log against direct GPX, and
+// the checks behind trk_convert, on a PC.
+//
+//   gcc -O2 -I../main/include track_log_bench.c ../main/track_log.c ../main/gpx_writer.c ../main/chunk_writer.c ../main/latency_hist.c -lm -o track_log_bench
+//   ./track_log_bench [hours]
+//
+// A synthetic ride (default 1 h) with 25 Hz fixes wandering at about
+// 8 m/s is written three ways into a scratch directory under /tmp: GPX,
+// TRK with the points only, and TRK with the points plus 104 Hz IMU and
+// 25 Hz baro records as the logger writes them. Reported per file: MB per
+// hour, bytes and encoding time per record. Then the points-only TRK is
+// decoded and written through gpx_writer as trk_convert does, which must
+// give a file byte-identical to the direct GPX; and the full TRK, with 20
+// random bytes flipped and its tail cut off, must decode with only the
+// blocks hit lost. Exit status 1 if a check fails.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "gpx_writer.h"
+#include "track_log.h"
+
+#define FIX_PERIOD_US   40000   // 25 Hz
+#define IMU_PERIOD_US   9615    // 104 Hz: LOGGER_IMU_DECIM 4 of 416 Hz
+#define RING_SIZE       (1024 * 1024)
+#define FLIPS           20
+
+static int failures;
+static char dir[64];
+
+typedef struct {
+    double bytes, records, ns;
+} cost_t;
+
+typedef struct {
+    unsigned long blocks, skipped, bad_records, records;
+    int64_t last_t_us;
+    bool out_of_order;
+} decode_t;
+
+static void expect(const char *what, long got, long want) {
+    if (got == want) return;
+    printf("FAIL %s: got %ld, want %ld\n", what, got, want);
+    failures++;
+}
+
+static int64_t clock_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static double gauss(void) {
+    double u = (rand() + 1.0) / (RAND_MAX + 2.0), v = (rand() + 1.0) / (RAND_MAX + 2.0);
+    return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+static uint8_t *read_file(const char *path, size_t *len) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    long n = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *buf = n > 0 ? malloc((size_t)n) : NULL;
+    if (buf && fread(buf, 1, (size_t)n, f) != (size_t)n) {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(f);
+    *len = buf ? (size_t)n : 0;
+    return buf;
+}
+
+static void path_of(char *path, size_t size, const char *file) {
+    snprintf(path, size, "%s/%s", dir, file);
+}
+
+static void flush_full(chunk_writer_t *out) {
+    if (chunk_writer_pending(out) >= CHUNK_WRITER_CHUNK) chunk_writer_flush(out);
+}
+
+// The ride: a slowly turning, climbing course from Shenzhen
+static void ride(double hours, bool sensors, track_log_t *trk, gpx_writer_t *gpx, cost_t *c_trk, cost_t *c_gpx) {
+    srand(1);
+    double lat = 22.5431234, lon = 113.9421234, heading = 0, v = 8, ele = 50;
+    const int64_t end_us = (int64_t)(hours * 3600e6);
+    int64_t t_imu = 0, t_baro = 0;
+    for (int64_t t = 0; t < end_us; t += FIX_PERIOD_US) {
+        double t0;
+        if (sensors) {
+            for (; t_imu <= t; t_imu += IMU_PERIOD_US) {
+                imu_sample_t s = { t_imu, (float)(0.02 * gauss()), (float)(0.02 * gauss()), (float)(1 + 0.03 * gauss()),
+                                   (float)(2 * gauss()), (float)(2 * gauss()), (float)(5 * sin(t_imu * 1e-7) + gauss()),
+                                   (float)(31.5 + t_imu * 1e-10) };
+                t0 = now_ns();
+                track_log_imu(trk, &s);
+                c_trk->ns += now_ns() - t0;
+                c_trk->records++;
+            }
+            for (; t_baro <= t; t_baro += FIX_PERIOD_US) {
+                baro_sample_t b = { t_baro, (float)(1005.0 + (50 - ele) * 0.12 + 0.003 * gauss()),
+                                    (float)(30.0 + t_baro * 1e-10) };
+                t0 = now_ns();
+                track_log_baro(trk, &b);
+                c_trk->ns += now_ns() - t0;
+                c_trk->records++;
+            }
+        }
+
+        heading += 0.05 * gauss();
+        v = fmax(0, v + 0.05 * gauss());
+        ele += 0.01 * gauss() + 0.002;
+        lat += v * 0.04 * cos(heading) / 111320.0;
+        lon += v * 0.04 * sin(heading) / (111320.0 * cos(lat * M_PI / 180));
+        int64_t ms = t / 1000 + 8 * 3600000LL;
+        gpx_point_t p = {
+            .lat = (int32_t)llround((lat + 0.3e-5 * gauss()) * 1e7),
+            .lon = (int32_t)llround((lon + 0.3e-5 * gauss()) * 1e7),
+            .ele_mm = (int32_t)llround(ele * 1000),
+            .speed_mmps = (uint32_t)llround(v * 1000),
+            .course = (int32_t)llround(fmod(heading * 180 / M_PI + 3600, 360) * 1e5),
+            .year = 2026, .month = 10, .day = 16,
+            .hour = (uint8_t)(ms / 3600000 % 24), .min = (uint8_t)(ms / 60000 % 60), .sec = (uint8_t)(ms / 1000 % 60),
+            .ms = (uint16_t)(ms % 1000),
+            .fix_type = 3, .num_sv = (uint8_t)(14 + (rand() % 100 == 0)), .hdop = 87, .temp_c10 = 315,
+            .g_milli = (uint16_t)(50 + 20 * fabs(gauss())), .bat_mv = (uint16_t)(4100 - t / 10000000), .mode = 1,
+        };
+        t0 = now_ns();
+        track_log_point(trk, t, &p);
+        c_trk->ns += now_ns() - t0;
+        c_trk->records++;
+        if (gpx) {
+            t0 = now_ns();
+            gpx_writer_add(gpx, &p);
+            c_gpx->ns += now_ns() - t0;
+            c_gpx->records++;
+            flush_full(&gpx->out);
+        }
+        flush_full(&trk->out);
+    }
+}
+
+static void open_writers(const char *trk_file, const char *gpx_file, track_log_t *trk, gpx_writer_t *gpx) {
+    static uint8_t ring_trk[RING_SIZE], ring_gpx[RING_SIZE];
+    const chunk_writer_config_t c_trk = { .ring = ring_trk, .ring_size = RING_SIZE, .prealloc = RING_SIZE,
+                                          .clock_us = clock_us };
+    const chunk_writer_config_t c_gpx = { .ring = ring_gpx, .ring_size = RING_SIZE, .prealloc = RING_SIZE,
+                                          .clock_us = clock_us };
+    char path[128];
+    track_log_init(trk, &c_trk);
+    path_of(path, sizeof(path), trk_file);
+    expect("TRK created", track_log_open(trk, path, 0, 0x5EED1234u, 4), 0);
+    if (gpx) {
+        gpx_writer_init(gpx, &c_gpx);
+        path_of(path, sizeof(path), gpx_file);
+        expect("GPX created", gpx_writer_open(gpx, path, "ACT_0001"), 0);
+    }
+}
+
+static double file_size(const char *file) {
+    char path[128];
+    struct stat st;
+    path_of(path, sizeof(path), file);
+    return stat(path, &st) == 0 ? (double)st.st_size : 0;
+}
+
+static void report(const char *what, const cost_t *c, double hours) {
+    printf("%-26s %6.2f MB/h %6.1f B/record %6.0f ns/record\n", what, c->bytes / hours / 1e6, c->bytes / c->records,
+           c->ns / c->records);
+}
+
+// Walks the file as trk_convert does; points go to gpx if given
+static void decode(const uint8_t *buf, size_t len, const track_header_t *hdr, gpx_writer_t *gpx, decode_t *d) {
+    memset(d, 0, sizeof(*d));
+    d->last_t_us = INT64_MIN;
+    size_t off = TRACK_HEADER_LEN;
+    while (off < len) {
+        track_ckpt_t ck;
+        if (off % CHUNK_WRITER_CHUNK == 0 &&
+            track_ckpt_parse(buf + off, len - off, hdr->session, (uint32_t)(off / CHUNK_WRITER_CHUNK), &ck)) {
+            off += TRACK_CKPT_LEN;
+            continue;
+        }
+        // Zeros up to a chunk boundary pad a block that would cross it
+        if (buf[off] == 0) {
+            size_t z = off + 1;
+            while (z < len && z % CHUNK_WRITER_CHUNK && buf[z] == 0) z++;
+            if (z == len || z % CHUNK_WRITER_CHUNK == 0) {
+                off = z;
+                continue;
+            }
+        }
+        uint32_t seq, n = track_block_check(buf + off, len - off, hdr->session, &seq);
+        if (n == 0) {
+            d->skipped++;
+            off++;
+            continue;
+        }
+        d->blocks++;
+        track_reader_t r;
+        track_rec_t rec;
+        track_reader_begin(&r, hdr, buf + off);
+        while (track_reader_next(&r, &rec)) {
+            d->records++;
+            if (rec.type != TRACK_REC_POINT) continue;
+            if (rec.point.t_us <= d->last_t_us) d->out_of_order = true;
+            d->last_t_us = rec.point.t_us;
+            if (gpx) {
+                gpx_writer_add(gpx, &rec.point.p);
+                flush_full(&gpx->out);
+            }
+        }
+        d->bad_records += r.left;
+        off += n;
+    }
+}
+
+static void round_trip(void) {
+    size_t len, a_len, b_len;
+    char path[128];
+    path_of(path, sizeof(path), "POINTS.TRK");
+    uint8_t *buf = read_file(path, &len);
+    track_header_t hdr;
+    expect("points TRK header", buf && track_header_parse(buf, len, &hdr), 1);
+    if (!buf) return;
+
+    static uint8_t ring[RING_SIZE];
+    const chunk_writer_config_t cfg = { .ring = ring, .ring_size = RING_SIZE, .clock_us = clock_us };
+    gpx_writer_t gpx;
+    gpx_writer_init(&gpx, &cfg);
+    path_of(path, sizeof(path), "CONVERT.GPX");
+    expect("converted GPX created", gpx_writer_open(&gpx, path, "ACT_0001"), 0);
+    decode_t d;
+    decode(buf, len, &hdr, &gpx, &d);
+    expect("converted GPX closed", gpx_writer_close(&gpx), 0);
+    free(buf);
+
+    uint8_t *a = read_file(path, &a_len);
+    path_of(path, sizeof(path), "DIRECT.GPX");
+    uint8_t *b = read_file(path, &b_len);
+    bool same = a && b && a_len == b_len && memcmp(a, b, a_len) == 0;
+    printf("points TRK to GPX: %lu blocks, %lu points, %s the direct GPX\n", d.blocks, d.records,
+           same ? "byte-identical to" : "DIFFERENT from");
+    expect("converted GPX identical", same, 1);
+    free(a);
+    free(b);
+}
+
+static void damage(void) {
+    size_t len;
+    char path[128];
+    path_of(path, sizeof(path), "FULL.TRK");
+    uint8_t *buf = read_file(path, &len);
+    track_header_t hdr;
+    expect("full TRK header", buf && track_header_parse(buf, len, &hdr), 1);
+    if (!buf) return;
+
+    decode_t intact, hit;
+    decode(buf, len, &hdr, NULL, &intact);
+    srand(7);
+    for (int i = 0; i < FLIPS; i++) {
+        size_t at = TRACK_HEADER_LEN + (size_t)rand() % (len - TRACK_HEADER_LEN);
+        buf[at] ^= (uint8_t)(1 + rand() % 255);
+    }
+    size_t cut = len - (size_t)(1 + rand() % 3000);
+    decode(buf, cut, &hdr, NULL, &hit);
+    printf("full TRK, %d bytes flipped and %lu cut: %lu of %lu blocks left, %lu bytes skipped\n", FLIPS,
+           (unsigned long)(len - cut), hit.blocks, intact.blocks, hit.skipped);
+    expect("intact file skips nothing", (long)intact.skipped, 0);
+    expect("at most one block per flip and the tail lost", intact.blocks - hit.blocks <= FLIPS + 1, 1);
+    expect("bad records", (long)hit.bad_records, 0);
+    expect("points in time order", hit.out_of_order, 0);
+    free(buf);
+}
+
+static void clean_up(void) {
+    static const char *const files[] = { "DIRECT.GPX", "POINTS.TRK", "FULL.TRK", "CONVERT.GPX" };
+    char path[128];
+    for (size_t i = 0; i < sizeof(files) / sizeof(files[0]); i++) {
+        path_of(path, sizeof(path), files[i]);
+        unlink(path);
+    }
+    rmdir(dir);
+}
+
+int main(int argc, char **argv) {
+    double hours = argc > 1 ? atof(argv[1]) : 1.0;
+    if (!(hours > 0)) {
+        fprintf(stderr, "usage: %s [hours]\n", argv[0]);
+        return 2;
+    }
+    snprintf(dir, sizeof(dir), "/tmp/track_log_bench.XXXXXX");
+    if (!mkdtemp(dir)) {
+        perror(dir);
+        return 2;
+    }
+
+    static track_log_t trk;
+    static gpx_writer_t gpx;
+    cost_t c_gpx = { 0 }, c_points = { 0 }, c_full = { 0 };
+    open_writers("POINTS.TRK", "DIRECT.GPX", &trk, &gpx);
+    ride(hours, false, &trk, &gpx, &c_points, &c_gpx);
+    expect("points TRK dropped", (long)trk.dropped, 0);
+    expect("GPX dropped", (long)gpx.dropped, 0);
+    expect("points TRK closed", track_log_close(&trk), 0);
+    expect("GPX closed", gpx_writer_close(&gpx), 0);
+    open_writers("FULL.TRK", NULL, &trk, NULL);
+    ride(hours, true, &trk, NULL, &c_full, NULL);
+    expect("full TRK dropped", (long)trk.dropped, 0);
+    expect("full TRK closed", track_log_close(&trk), 0);
+
+    c_gpx.bytes = file_size("DIRECT.GPX");
+    c_points.bytes = file_size("POINTS.TRK");
+    c_full.bytes = file_size("FULL.TRK");
+    printf("%.1f h ride, 25 Hz fixes:\n", hours);
+    report("GPX", &c_gpx, hours);
+    report("TRK points", &c_points, hours);
+    report("TRK + IMU 104 Hz + baro", &c_full, hours);
+
+    round_trip();
+    damage();
+    clean_up();
+    printf("track log checks: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,320 @@
+// Power-loss fault injection against track_log_recover on a PC.
+//
+//   gcc -O2 -I../main/include -Wl,--wrap=fsync,--wrap=pread track_recover_test.c ../main/track_log.c ../main/gpx_writer.c ../main/chunk_writer.c ../main/latency_hist.c -lm -o track_recover_test
+//   ./track_recover_test [cuts]
+//
+// A 20 min full-rate ride (25 Hz points and baro, 26 Hz IMU records) is
+// written as the logger does, committing every 5 s, and left open in its
+// preallocated file as a power loss would. Each cut (default 10000) keeps
+// the file up to a random offset and fills the rest as the card might:
+// zeros, random bytes, a file of another session with the same layout,
+// or nothing (a shorter file). After track_log_recover the file must be
+// exactly the original up to the last block that survived intact, and a
+// second pass must find it intact; a cut inside the header must fail
+// with EINVAL. Also checked: a closed file is left alone, and the reads
+// a 2 h ride costs. fsync and pread are wrapped to count them. Exit
+// status 1 if a cut is recovered wrongly.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "track_log.h"
+
+// As in config.h, which needs the ESP-IDF headers
+#define LOGGER_COMMIT_PERIOD_US (5 * 1000 * 1000)
+#define LOGGER_PREALLOC         (1024 * 1024)
+
+#define SESSION         0x12345678u
+#define MAX_BLOCKS      200000
+
+static int failures;
+static char dir[64];
+static int64_t sim_us;
+static unsigned long fsyncs, preads, pread_bytes;
+static track_log_t w;
+static uint32_t ends[MAX_BLOCKS];       // End offsets of the blocks of the reference file
+
+int __real_fsync(int fd);
+ssize_t __real_pread(int fd, void *buf, size_t n, off_t off);
+
+int __wrap_fsync(int fd) {
+    fsyncs++;
+    return __real_fsync(fd);
+}
+
+ssize_t __wrap_pread(int fd, void *buf, size_t n, off_t off) {
+    preads++;
+    pread_bytes += n;
+    return __real_pread(fd, buf, n, off);
+}
+
+static void expect(const char *what, long got, long want) {
+    if (got == want) return;
+    printf("FAIL %s: got %ld, want %ld\n", what, got, want);
+    failures++;
+}
+
+static int64_t sim_clock(void) {
+    return sim_us;
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void path_of(char *path, size_t size, const char *file) {
+    snprintf(path, size, "%s/%s", dir, file);
+}
+
+static uint8_t *read_file(const char *path, size_t *len) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    long n = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *buf = malloc(n > 0 ? (size_t)n : 1);
+    if (buf && n > 0 && fread(buf, 1, (size_t)n, f) != (size_t)n) {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(f);
+    *len = buf ? (size_t)n : 0;
+    return buf;
+}
+
+static int write_file(const char *path, const uint8_t *buf, size_t len) {
+    FILE *f = fopen(path, "wb");
+    if (!f) return -1;
+    size_t n = fwrite(buf, 1, len, f);
+    return fclose(f) == 0 && n == len ? 0 : -1;
+}
+
+// Writes a ride as the logger does and returns the longest stretch of
+// track that was not yet on the card, in seconds. Left open unless closed
+// is set: close(2) without the track_log_close is what a power loss leaves.
+static double ride(const char *file, uint32_t session, double minutes, bool closed, unsigned seed) {
+    static uint8_t ring[256 * 1024];
+    const chunk_writer_config_t cfg = { .ring = ring, .ring_size = sizeof(ring), .prealloc = LOGGER_PREALLOC,
+                                        .clock_us = sim_clock };
+    char path[128];
+    path_of(path, sizeof(path), file);
+    unlink(path);
+    track_log_init(&w, &cfg);
+    srand(seed);
+    sim_us = 1000000;
+    expect("track created", track_log_open(&w, path, sim_us, session, 4), 0);
+
+    const int64_t end_us = sim_us + (int64_t)(minutes * 60e6);
+    int64_t next_commit = sim_us + LOGGER_COMMIT_PERIOD_US, durable_us = sim_us;
+    int32_t lat = 473000000, lon = 85000000, ele = 400000;
+    double worst_loss = 0;
+    for (; sim_us < end_us; sim_us += 1000) {
+        if (sim_us % 40000 == 0) {
+            gpx_point_t p = {
+                .lat = lat += rand() % 200 - 50, .lon = lon += rand() % 200 - 50, .ele_mm = ele += rand() % 100 - 50,
+                .speed_mmps = 8000 + rand() % 500, .course = rand() % 36000000,
+                .year = 2026, .month = 10, .day = 16, .hour = 10, .min = (uint8_t)(sim_us / 60000000 % 60),
+                .sec = (uint8_t)(sim_us / 1000000 % 60), .ms = (uint16_t)(sim_us / 1000 % 1000),
+                .fix_type = 3, .num_sv = 14, .hdop = 90, .temp_c10 = 215, .g_milli = 1000 + rand() % 100,
+                .bat_mv = 3900, .mode = 1,
+            };
+            track_log_point(&w, sim_us, &p);
+            baro_sample_t b = { .t_us = sim_us, .pressure = 960.0f + (rand() % 100) * 0.01f, .temp = 21.5f };
+            track_log_baro(&w, &b);
+        }
+        if (sim_us % 38462 < 1000) {
+            imu_sample_t s = { .t_us = sim_us, .ax = (rand() % 2000 - 1000) * 1e-3f, .ay = 0.01f, .az = 1.0f,
+                               .gx = (rand() % 200 - 100) * 0.1f, .gy = 0.5f, .gz = -0.2f, .temp = 30.0f };
+            track_log_imu(&w, &s);
+        }
+        // The flush task: whole chunks as they fill, the partial one every
+        // commit period
+        if (sim_us % 10000 == 0) {
+            if (sim_us >= next_commit) {
+                next_commit = sim_us + LOGGER_COMMIT_PERIOD_US;
+                if (chunk_writer_commit(&w.out) >= 0) durable_us = w.staged_t_us;
+            } else if (chunk_writer_flush(&w.out) > 0 && chunk_writer_pending(&w.out) == 0) {
+                durable_us = w.staged_t_us;
+            }
+        }
+        double loss = (sim_us - durable_us) * 1e-6;
+        if (loss > worst_loss) worst_loss = loss;
+    }
+    if (closed) {
+        expect("track closed", track_log_close(&w), 0);
+    } else {
+        close(w.out.fd);
+    }
+    return worst_loss;
+}
+
+// Blocks of an intact file in sequence, as trk_convert walks them
+static uint32_t scan_blocks(const uint8_t *buf, size_t len, uint32_t session, uint32_t *block_ends) {
+    uint32_t n = 0;
+    size_t off = TRACK_HEADER_LEN;
+    while (off < len) {
+        track_ckpt_t ck;
+        if (off % CHUNK_WRITER_CHUNK == 0 &&
+            track_ckpt_parse(buf + off, len - off, session, (uint32_t)(off / CHUNK_WRITER_CHUNK), &ck)) {
+            off += TRACK_CKPT_LEN;
+            continue;
+        }
+        if (buf[off] == 0) {
+            size_t z = off + 1;
+            while (z < len && z % CHUNK_WRITER_CHUNK && buf[z] == 0) z++;
+            if (z == len || z % CHUNK_WRITER_CHUNK == 0) {
+                off = z;
+                continue;
+            }
+        }
+        uint32_t seq, l = track_block_check(buf + off, len - off, session, &seq);
+        if (!l || seq != n || n == MAX_BLOCKS) break;
+        off += l;
+        if (block_ends) block_ends[n] = (uint32_t)off;
+        n++;
+    }
+    return n;
+}
+
+static void cuts(int trials) {
+    fsyncs = 0;
+    double loss = ride("REF.TRK", SESSION, 20, false, 1);
+    printf("20 min full-rate ride: %u blocks, %u checkpoints, %.1f fsyncs/min, up to %.2f s of track not on the card\n",
+           w.blocks, w.checkpoints, fsyncs / 20.0, loss);
+    ride("STALE.TRK", 0x9ABCDEF0u, 20, false, 2);
+
+    char path[128];
+    size_t len, stale_len;
+    path_of(path, sizeof(path), "REF.TRK");
+    uint8_t *ref = read_file(path, &len);
+    path_of(path, sizeof(path), "STALE.TRK");
+    uint8_t *stale = read_file(path, &stale_len);
+    uint32_t blocks = ref ? scan_blocks(ref, len, SESSION, ends) : 0;
+    expect("reference readable", blocks > 0 && stale_len == len, 1);
+    if (!blocks || stale_len != len) return;
+
+    static const char *const kinds[] = { "zeros", "random bytes", "another session", "short file" };
+    unsigned long failed[4] = { 0 }, max_reads = 0, max_lost = 0;
+    double recover_s = 0;
+    uint8_t *img = malloc(len);
+    path_of(path, sizeof(path), "CUT.TRK");
+    srand(42);
+    for (int i = 0; i < trials; i++) {
+        // Up to a chunk past the data, into the preallocated tail
+        uint32_t cut = (uint32_t)((((uint64_t)rand() << 16) ^ (uint64_t)rand()) % (ends[blocks - 1] + 4096));
+        int kind = i % 4;
+        size_t img_len = len;
+        memcpy(img, ref, cut);
+        if (kind == 0) {
+            memset(img + cut, 0, len - cut);
+        } else if (kind == 1) {
+            for (size_t k = cut; k < len; k++) img[k] = (uint8_t)rand();
+        } else if (kind == 2) {
+            memcpy(img + cut, stale + cut, len - cut);
+        } else {
+            img_len = cut;
+        }
+        if (write_file(path, img, img_len) != 0) {
+            perror(path);
+            break;
+        }
+
+        track_recovery_t r;
+        preads = 0;
+        double t0 = now_s();
+        int ret = track_log_recover(path, &r);
+        int err = errno;
+        recover_s += now_s() - t0;
+        if (preads > max_reads) max_reads = preads;
+
+        // Bytes past the cut that happen to equal the original (zeros
+        // ending a block, equal stale data) are as good as written
+        uint32_t same = cut;
+        if (kind != 3) {
+            while (same < ends[blocks - 1] && img[same] == ref[same]) same++;
+        }
+        uint32_t want = 0;
+        while (want < blocks && ends[want] <= same) want++;
+        uint32_t kept_end = want ? ends[want - 1] : TRACK_HEADER_LEN;
+
+        bool ok;
+        if (cut < TRACK_HEADER_LEN) {
+            ok = ret < 0 && err == EINVAL;
+        } else {
+            size_t out_len;
+            uint8_t *out = read_file(path, &out_len);
+            ok = ret >= 0 && out && r.seq == want && out_len == r.length && r.length >= kept_end &&
+                 memcmp(out, ref, out_len) == 0 && scan_blocks(out, out_len, SESSION, NULL) == want;
+            free(out);
+            if (ok && same - kept_end > max_lost) max_lost = same - kept_end;
+            if (ok && track_log_recover(path, &r) != 0) ok = false;
+        }
+        if (!ok) {
+            if (failures < 5) printf("FAIL cut at %u, %s: returned %d, %u blocks, want %u\n", cut, kinds[kind], ret,
+                                     r.seq, want);
+            failed[kind]++;
+            failures++;
+        }
+    }
+    printf("%d cuts: failed %lu with zeros, %lu with random bytes, %lu with another session, %lu short;\n"
+           "  at most %lu reads and %.0f us mean per recovery, at most %lu bytes written after the last intact block dropped\n",
+           trials, failed[0], failed[1], failed[2], failed[3], max_reads, recover_s / trials * 1e6, max_lost);
+    free(img);
+    free(ref);
+    free(stale);
+    unlink(path);
+}
+
+static void closed_file(void) {
+    char path[128];
+    ride("CLOSED.TRK", 0x55AA55AAu, 5, true, 3);
+    path_of(path, sizeof(path), "CLOSED.TRK");
+    track_recovery_t r;
+    int ret = track_log_recover(path, &r);
+    printf("closed file: %u blocks, %u bytes\n", r.seq, r.size);
+    expect("closed file left alone", ret, 0);
+    expect("closed file length", r.length, r.size);
+    unlink(path);
+}
+
+static void long_ride(void) {
+    char path[128];
+    ride("LONG.TRK", 0x0BADCAFEu, 120, false, 4);
+    path_of(path, sizeof(path), "LONG.TRK");
+    track_recovery_t r;
+    preads = pread_bytes = 0;
+    double t0 = now_s();
+    int ret = track_log_recover(path, &r);
+    printf("2 h ride: %u KB trimmed to %u KB in %.2f ms, %u checkpoints and %u tail blocks read in %lu preads "
+           "(%lu KB), %.1f min of track kept\n", r.size / 1024, r.length / 1024, (now_s() - t0) * 1e3, r.checkpoints,
+           r.blocks, preads, pread_bytes / 1024, (r.end_us - r.start_us) / 60e6);
+    expect("2 h ride trimmed", ret, 1);
+    unlink(path);
+}
+
+int main(int argc, char **argv) {
+    int trials = argc > 1 ? atoi(argv[1]) : 10000;
+    snprintf(dir, sizeof(dir), "/tmp/track_recover_test.XXXXXX");
+    if (trials <= 0 || !mkdtemp(dir)) {
+        fprintf(stderr, "usage: %s [cuts]\n", argv[0]);
+        return 2;
+    }
+    cuts(trials);
+    closed_file();
+    long_ride();
+
+    char path[128];
+    path_of(path, sizeof(path), "REF.TRK");
+    unlink(path);
+    path_of(path, sizeof(path), "STALE.TRK");
+    unlink(path);
+    rmdir(dir);
+    printf("recovery checks: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
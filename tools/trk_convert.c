@@ -0,0 +1,194 @@
+// Converts a binary track log (.TRK) from the SD card to GPX or CSV on a PC.
+//
+//   gcc -O2 -I../main/include trk_convert.c ../main/track_log.c ../main/gpx_writer.c
+//       ../main/chunk_writer.c ../main/latency_hist.c -lm -o trk_convert
+//   ./trk_convert ACT_0001.TRK ACT_0001.gpx         GPX with the <extensions> fields
+//   ./trk_convert ACT_0001.TRK points.csv           one CSV line per GNSS point
+//   ./trk_convert -t imu ACT_0001.TRK imu.csv       IMU (or -t baro) samples
+//
+// The output format follows the extension of the output file. Blocks that
+// fail their CRC are skipped and the reader resynchronises on the next
+// block, so a file cut short by a power loss converts up to its last
+// complete block. The logger trims such a file on the next boot. A
+// summary goes to stderr.
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include "gpx_writer.h"
+#include "track_log.h"
+
+#define RING_SIZE       (64 * 1024)
+
+static int64_t clock_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static uint8_t *read_file(const char *path, size_t *len) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    long n = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *buf = n > 0 ? malloc((size_t)n) : NULL;
+    if (buf && fread(buf, 1, (size_t)n, f) != (size_t)n) {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(f);
+    *len = buf ? (size_t)n : 0;
+    return buf;
+}
+
+// Track name: the file name without directory and extension
+static void track_name(const char *path, char *name, size_t size) {
+    const char *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    snprintf(name, size, "%s", base);
+    char *dot = strrchr(name, '.');
+    if (dot) *dot = '\0';
+}
+
+static void csv_point(FILE *out, const track_header_t *h, const track_rec_t *r) {
+    const gpx_point_t *p = &r->point.p;
+    fprintf(out, "%.3f,%04u-%02u-%02uT%02u:%02u:%02u.%03uZ,%.7f,%.7f,%.3f,%.3f,%.2f,%u,%u,%.2f,%.1f,%.3f,%u,%u,%u\n",
+            (r->point.t_us - h->start_us) * 1e-6, p->year, p->month, p->day, p->hour, p->min, p->sec, p->ms,
+            p->lat * 1e-7, p->lon * 1e-7, p->ele_mm * 1e-3, p->speed_mmps * 1e-3, p->course * 1e-5, p->fix_type,
+            p->num_sv, p->hdop * 0.01, p->temp_c10 * 0.1, p->g_milli * 1e-3, p->bat_mv, p->mode, p->pbox);
+}
+
+int main(int argc, char **argv) {
+    int want = TRACK_REC_POINT;
+    int arg = 1;
+    if (argc > 2 && strcmp(argv[1], "-t") == 0) {
+        want = strcmp(argv[2], "imu") == 0 ? TRACK_REC_IMU : strcmp(argv[2], "baro") == 0 ? TRACK_REC_BARO : TRACK_REC_POINT;
+        arg = 3;
+    }
+    if (argc - arg != 2) {
+        fprintf(stderr, "usage: %s [-t point|imu|baro] in.TRK out.gpx|out.csv\n", argv[0]);
+        return 2;
+    }
+    const char *in_path = argv[arg], *out_path = argv[arg + 1];
+    const char *ext = strrchr(out_path, '.');
+    bool gpx = ext && strcasecmp(ext, ".gpx") == 0;
+    if (gpx && want != TRACK_REC_POINT) {
+        fprintf(stderr, "GPX holds GNSS points only\n");
+        return 2;
+    }
+
+    size_t len;
+    uint8_t *buf = read_file(in_path, &len);
+    track_header_t hdr;
+    if (!buf || !track_header_parse(buf, len, &hdr)) {
+        fprintf(stderr, "%s: %s\n", in_path, buf ? "not a track log" : strerror(errno));
+        return 1;
+    }
+
+    gpx_writer_t w;
+    FILE *csv = NULL;
+    if (gpx) {
+        const chunk_writer_config_t cfg = {
+            .ring = malloc(RING_SIZE),
+            .ring_size = RING_SIZE,
+            .clock_us = clock_us,
+        };
+        gpx_writer_init(&w, &cfg);
+        char name[64];
+        track_name(in_path, name, sizeof(name));
+        // Replaced like the CSV output; the writer itself never overwrites
+        if ((unlink(out_path) != 0 && errno != ENOENT) || gpx_writer_open(&w, out_path, name) != 0) {
+            perror(out_path);
+            return 1;
+        }
+    } else {
+        csv = fopen(out_path, "w");
+        if (!csv) {
+            perror(out_path);
+            return 1;
+        }
+        if (want == TRACK_REC_POINT) {
+            fprintf(csv, "t_s,utc,lat,lon,ele_m,speed_mps,course_deg,fix,sats,hdop,temp_c,g,bat_mv,mode,pbox\n");
+        } else if (want == TRACK_REC_IMU) {
+            fprintf(csv, "t_s,ax_g,ay_g,az_g,gx_dps,gy_dps,gz_dps,temp_c\n");
+        } else {
+            fprintf(csv, "t_s,pressure_hpa,temp_c\n");
+        }
+    }
+
+    unsigned long blocks = 0, skipped = 0, gaps = 0, bad_records = 0, count[4] = { 0 };
+    uint32_t next_seq = 0, dropped = 0;
+    size_t off = TRACK_HEADER_LEN;
+    while (off < len) {
+        // Checkpoint on a chunk boundary, zeros before one
+        track_ckpt_t ck;
+        if (off % CHUNK_WRITER_CHUNK == 0 &&
+            track_ckpt_parse(buf + off, len - off, hdr.session, (uint32_t)(off / CHUNK_WRITER_CHUNK), &ck)) {
+            dropped = ck.dropped;
+            off += TRACK_CKPT_LEN;
+            continue;
+        }
+        if (buf[off] == 0) {
+            size_t z = off + 1;
+            while (z < len && z % CHUNK_WRITER_CHUNK && buf[z] == 0) z++;
+            if (z == len || z % CHUNK_WRITER_CHUNK == 0) {
+                off = z;
+                continue;
+            }
+        }
+
+        uint32_t seq;
+        uint32_t n = track_block_check(buf + off, len - off, hdr.session, &seq);
+        if (n == 0) {
+            skipped++;
+            off++;
+            continue;
+        }
+        if (seq != next_seq) gaps++;
+        next_seq = seq + 1;
+        blocks++;
+
+        track_reader_t r;
+        track_rec_t rec;
+        track_reader_begin(&r, &hdr, buf + off);
+        while (track_reader_next(&r, &rec)) {
+            count[rec.type]++;
+            if (rec.type != want) continue;
+            if (gpx) {
+                gpx_writer_add(&w, &rec.point.p);
+                if (chunk_writer_pending(&w.out) >= CHUNK_WRITER_CHUNK) chunk_writer_flush(&w.out);
+            } else if (want == TRACK_REC_POINT) {
+                csv_point(csv, &hdr, &rec);
+            } else if (want == TRACK_REC_IMU) {
+                const imu_sample_t *s = &rec.imu;
+                fprintf(csv, "%.6f,%.5f,%.5f,%.5f,%.4f,%.4f,%.4f,%.2f\n", (s->t_us - hdr.start_us) * 1e-6, s->ax,
+                        s->ay, s->az, s->gx, s->gy, s->gz, s->temp);
+            } else {
+                const baro_sample_t *s = &rec.baro;
+                fprintf(csv, "%.6f,%.4f,%.2f\n", (s->t_us - hdr.start_us) * 1e-6, s->pressure, s->temp);
+            }
+        }
+        if (r.left) bad_records += r.left;
+        off += n;
+    }
+
+    int ret = 0;
+    if (gpx) {
+        ret = gpx_writer_close(&w);
+    } else {
+        ret = fclose(csv);
+    }
+    if (ret != 0) perror(out_path);
+
+    fprintf(stderr, "%lu blocks, %lu points, %lu IMU, %lu baro; %lu bytes skipped, %lu sequence gaps, %lu bad records; "
+            "%lu records dropped by the logger before the last checkpoint\n",
+            blocks, count[TRACK_REC_POINT], count[TRACK_REC_IMU], count[TRACK_REC_BARO], skipped, gaps, bad_records,
+            (unsigned long)dropped);
+    free(buf);
+    return ret != 0;
+}
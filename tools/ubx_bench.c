@@ -0,0 +1,214 @@
+// Checks the UBX engine and measures its throughput on a PC.
+//
+//   gcc -O2 -I../main/include ubx_bench.c ../main/ubx.c -o ubx_bench
+//   ./ubx_bench                     synthetic 25 Hz NAV-PVT/DOP/TIMEUTC/SAT/EOE stream
+//   ./ubx_bench capture.ubx         a raw receiver capture (NMEA in it is skipped)
+//
+// Frames are located and split before the timing, so it covers checksum
+// and dispatch only. Exit status 1 if a check fails.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ubx.h"
+
+#define SYNTH_SECONDS   600
+#define SYNTH_HZ        25
+#define SYNTH_SVS       40
+#define MIN_RUN_S       1.0
+
+typedef struct {
+    const uint8_t *p;
+    uint32_t len;
+} frame_t;
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int failures;
+
+static void expect(const char *what, long got, long want) {
+    if (got == want) return;
+    printf("FAIL %s: got %ld, want %ld\n", what, got, want);
+    failures++;
+}
+
+static ubx_nav_pvt_t make_pvt(uint32_t itow) {
+    ubx_nav_pvt_t p;
+    memset(&p, 0, sizeof(p));
+    p.iTOW = itow;
+    p.year = 2026;
+    p.month = 9;
+    p.day = 16;
+    p.hour = 10;
+    p.min = 11;
+    p.sec = 12;
+    p.valid = UBX_PVT_VALID_DATE | UBX_PVT_VALID_TIME;
+    p.fixType = 3;
+    p.flags = UBX_PVT_FLAGS_FIXOK;
+    p.numSV = 24;
+    p.lat = 472852332;
+    p.lon = 85652650;
+    p.hMSL = 499600;
+    p.velN = 20000;
+    p.velE = -19000;
+    p.velD = 150;
+    p.gSpeed = 27589;
+    p.headMot = 31345000;
+    p.hAcc = 1200;
+    p.vAcc = 1900;
+    p.sAcc = 140;
+    p.pDOP = 104;
+    return p;
+}
+
+static void self_check(void) {
+    static ubx_engine_t e;
+    uint8_t buf[128];
+    ubx_engine_init(&e);
+
+    ubx_nav_pvt_t p = make_pvt(123456200);
+    size_t n = ubx_build_frame(UBX_CLASS_NAV, UBX_ID_NAV_PVT, (const uint8_t *)&p, sizeof(p), buf, sizeof(buf));
+    expect("PVT status", ubx_engine_process_frame(&e, buf, n), UBX_OK);
+    expect("lat", e.fix.lat, 472852332);
+    expect("alt_mm", e.fix.alt_mm, 499600);
+    expect("speed_mmps", e.fix.speed_mmps, 27589);
+    expect("vel_e", e.fix.vel_e, -19000);
+    expect("s_acc", e.fix.s_acc_mmps, 140);
+    expect("ms from iTOW", e.fix.ms, 200);
+    expect("valid", e.fix.valid, GNSS_VALID_TIME | GNSS_VALID_DATE | GNSS_VALID_POS | GNSS_VALID_ALT |
+                                 GNSS_VALID_SPEED | GNSS_VALID_COURSE | GNSS_VALID_VEL);
+
+    p.flags = 0;    // No fixOK: time only, position kept from before
+    p.lat = 0;
+    n = ubx_build_frame(UBX_CLASS_NAV, UBX_ID_NAV_PVT, (const uint8_t *)&p, sizeof(p), buf, sizeof(buf));
+    ubx_engine_process_frame(&e, buf, n);
+    expect("no fixOK: position not valid", e.fix.valid & GNSS_VALID_POS, 0);
+    expect("no fixOK: lat kept", e.fix.lat, 472852332);
+
+    ubx_nav_dop_t d = { .iTOW = 123456200, .pDOP = 104, .hDOP = 61, .vDOP = 84 };
+    n = ubx_build_frame(UBX_CLASS_NAV, UBX_ID_NAV_DOP, (const uint8_t *)&d, sizeof(d), buf, sizeof(buf));
+    expect("DOP status", ubx_engine_process_frame(&e, buf, n), UBX_OK);
+    expect("hdop", e.fix.hdop, 61);
+    expect("DOP valid", !!(e.fix.valid & GNSS_VALID_DOP), 1);
+
+    buf[10] ^= 1;
+    expect("corrupt payload", ubx_engine_process_frame(&e, buf, n), UBX_ERR_CHECKSUM);
+    n = ubx_build_frame(UBX_CLASS_NAV, UBX_ID_NAV_DOP, (const uint8_t *)&d, 10, buf, sizeof(buf));
+    expect("short payload", ubx_engine_process_frame(&e, buf, n), UBX_ERR_LENGTH);
+    expect("frame length mismatch", ubx_engine_process_frame(&e, buf, n - 1), UBX_ERR_LENGTH);
+
+    const uint8_t acked[2] = { UBX_CLASS_CFG, UBX_ID_CFG_VALSET };
+    n = ubx_build_frame(UBX_CLASS_ACK, UBX_ID_ACK_NAK, acked, 2, buf, sizeof(buf));
+    expect("NAK status", ubx_engine_process_frame(&e, buf, n), UBX_OK);
+    expect("NAK", e.ack.pending && !e.ack.ack && e.ack.cls == UBX_CLASS_CFG && e.ack.id == UBX_ID_CFG_VALSET, 1);
+    n = ubx_build_frame(UBX_CLASS_MON, UBX_ID_MON_VER, acked, 2, buf, sizeof(buf));
+    expect("unhandled", ubx_engine_process_frame(&e, buf, n), UBX_UNHANDLED);
+    expect("counters", e.frames * 1000 + e.ck_errors * 100 + e.len_errors * 10 + e.unhandled, 6000 + 100 + 20 + 1);
+}
+
+// One epoch as the receiver sends it in UBX-only mode
+static uint8_t *synthesize(size_t *size, size_t *epoch_bytes) {
+    uint8_t payload[sizeof(ubx_nav_sat_hdr_t) + SYNTH_SVS * sizeof(ubx_nav_sat_sv_t)];
+    size_t cap = (size_t)SYNTH_SECONDS * SYNTH_HZ * (sizeof(payload) + 256);
+    uint8_t *buf = malloc(cap);
+    size_t n = 0;
+    srand(1);
+    for (int e = 0; e < SYNTH_SECONDS * SYNTH_HZ; e++) {
+        uint32_t itow = 123456000 + e * (1000 / SYNTH_HZ);
+        size_t start = n;
+        ubx_nav_pvt_t p = make_pvt(itow);
+        p.lat += e * 10;
+        p.gSpeed += rand() % 1000;
+        n += ubx_build_frame(UBX_CLASS_NAV, UBX_ID_NAV_PVT, (const uint8_t *)&p, sizeof(p), buf + n, cap - n);
+        ubx_nav_dop_t d = { .iTOW = itow, .pDOP = 104, .hDOP = 61, .vDOP = 84 };
+        n += ubx_build_frame(UBX_CLASS_NAV, UBX_ID_NAV_DOP, (const uint8_t *)&d, sizeof(d), buf + n, cap - n);
+        ubx_nav_timeutc_t t = { .iTOW = itow, .year = 2026, .month = 9, .day = 16, .valid = 7 };
+        n += ubx_build_frame(UBX_CLASS_NAV, UBX_ID_NAV_TIMEUTC, (const uint8_t *)&t, sizeof(t), buf + n, cap - n);
+        // NAV-SAT once a second, as configured for the satellite view
+        if (e % SYNTH_HZ == 0) {
+            ubx_nav_sat_hdr_t h = { .iTOW = itow, .version = 1, .numSvs = SYNTH_SVS };
+            memcpy(payload, &h, sizeof(h));
+            for (int i = 0; i < SYNTH_SVS; i++) {
+                ubx_nav_sat_sv_t sv = { .gnssId = (uint8_t)(i / 10), .svId = (uint8_t)(i % 10 + 1),
+                                        .cno = (uint8_t)(25 + rand() % 25), .elev = (int8_t)(i * 2), .azim = (int16_t)(i * 9) };
+                memcpy(payload + sizeof(h) + i * sizeof(sv), &sv, sizeof(sv));
+            }
+            n += ubx_build_frame(UBX_CLASS_NAV, UBX_ID_NAV_SAT, payload, sizeof(payload), buf + n, cap - n);
+        }
+        uint32_t eoe = itow;
+        n += ubx_build_frame(UBX_CLASS_NAV, UBX_ID_NAV_EOE, (const uint8_t *)&eoe, 4, buf + n, cap - n);
+        if (e == 1) *epoch_bytes = n - start;
+    }
+    *size = n;
+    return buf;
+}
+
+static uint8_t *load(const char *path, size_t *size) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *buf = malloc(len > 0 ? (size_t)len : 1);
+    *size = fread(buf, 1, (size_t)len, f);
+    fclose(f);
+    return buf;
+}
+
+int main(int argc, char **argv) {
+    self_check();
+    printf("engine checks: %s\n", failures ? "FAILED" : "ok");
+
+    size_t size, epoch_bytes = 0;
+    uint8_t *buf = argc > 1 ? load(argv[1], &size) : synthesize(&size, &epoch_bytes);
+    if (!buf) return 1;
+
+    // Frames by sync chars and length; whatever lies between is skipped
+    size_t count = 0, cap = 1024, bytes = 0;
+    frame_t *list = malloc(cap * sizeof(*list));
+    for (size_t i = 0; i + UBX_FRAME_OVERHEAD <= size; i++) {
+        if (buf[i] != UBX_SYNC_CHAR_1 || buf[i + 1] != UBX_SYNC_CHAR_2) continue;
+        size_t len = (size_t)(buf[i + 4] | buf[i + 5] << 8) + UBX_FRAME_OVERHEAD;
+        if (i + len > size) break;
+        if (count == cap) list = realloc(list, (cap *= 2) * sizeof(*list));
+        list[count++] = (frame_t){ buf + i, (uint32_t)len };
+        bytes += len;
+        i += len - 1;
+    }
+    if (count == 0) {
+        printf("no UBX frames in %s\n", argv[1]);
+        return 1;
+    }
+
+    static ubx_engine_t e;
+    ubx_engine_init(&e);
+    uint32_t ok = 0;
+    for (size_t i = 0; i < count; i++) ok += ubx_engine_process_frame(&e, list[i].p, list[i].len) == UBX_OK;
+    const ubx_engine_t first = e;
+
+    unsigned passes = 0;
+    double t0 = now_s(), t;
+    do {
+        for (size_t i = 0; i < count; i++) ubx_engine_process_frame(&e, list[i].p, list[i].len);
+        passes++;
+    } while ((t = now_s() - t0) < MIN_RUN_S);
+
+    // NAV-EOE has no handler: the framer acts on it
+    printf("%s: %zu frames, %zu bytes; %u handled, %u checksum errors, %u length errors, %u unhandled\n",
+           argc > 1 ? argv[1] : "synthetic 25 Hz", count, bytes, (unsigned)ok, (unsigned)first.ck_errors,
+           (unsigned)first.len_errors, (unsigned)first.unhandled);
+    if (epoch_bytes) printf("epoch without NAV-SAT: %zu bytes\n", epoch_bytes);
+    printf("verify + dispatch: %.2f M frames/s, %.1f MB/s, %.0f ns/frame (%u passes)\n",
+           count * passes / t * 1e-6, bytes * (double)passes / t * 1e-6, t / (count * (double)passes) * 1e9, passes);
+    free(list);
+    free(buf);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,284 @@
+// Applies receiver profiles through the CFG-VALSET builder and ACK
+// tracking against a scripted fake receiver.
+//
+//   gcc -O2 -I../main/include ubx_cfg_test.c ../main/ubx_cfg.c ../main/ubx.c ../main/gnss_framer.c -o ubx_cfg_test
+//   ./ubx_cfg_test
+//
+// The host side does what gnss.c does: one VALSET per profile, replies
+// framed by gnss_framer and decoded by the UBX engine, retries from
+// ubx_txn_poll(). The fake receiver checks each frame and payload, knows
+// only the keys in ubx_cfg.h, applies a VALSET all or nothing and answers
+// after a fixed delay, unless the script drops the reply or has it
+// reject a key. Exit status 1 if a check fails.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gnss_framer.h"
+#include "ubx.h"
+#include "ubx_cfg.h"
+
+// As in gnss.c
+#define CFG_ACK_TIMEOUT_US  (250 * 1000)
+#define CFG_MAX_ATTEMPTS    3
+
+#define REPLY_DELAY_US      (18 * 1000)
+#define STEP_US             1000
+#define DB_MAX              64
+
+typedef struct {
+    uint32_t key;
+    uint64_t value;
+} cfg_item_t;
+
+typedef struct {
+    cfg_item_t db[DB_MAX];
+    int n;
+    uint32_t reject_key;    // Answer NAK if a VALSET carries it
+    int drop_replies;       // Replies lost on the line
+    int valsets;            // VALSETs received
+    uint8_t reply[32];
+    size_t reply_len;
+    int64_t reply_at;
+} fake_rx_t;
+
+static const uint32_t known_keys[] = {
+    UBX_KEY_UART1_BAUDRATE, UBX_KEY_UART1OUTPROT_UBX, UBX_KEY_UART1OUTPROT_NMEA, UBX_KEY_RATE_MEAS,
+    UBX_KEY_RATE_NAV, UBX_KEY_NAVSPG_DYNMODEL, UBX_KEY_SIGNAL_GPS_ENA, UBX_KEY_SIGNAL_SBAS_ENA,
+    UBX_KEY_SIGNAL_GAL_ENA, UBX_KEY_SIGNAL_BDS_ENA, UBX_KEY_SIGNAL_QZSS_ENA, UBX_KEY_SIGNAL_GLO_ENA,
+    UBX_KEY_MSGOUT_NAV_PVT_UART1, UBX_KEY_MSGOUT_NAV_SAT_UART1, UBX_KEY_MSGOUT_NAV_DOP_UART1,
+    UBX_KEY_MSGOUT_NAV_TIMEUTC_UART1, UBX_KEY_MSGOUT_NAV_EOE_UART1, UBX_KEY_MSGOUT_NMEA_RMC_UART1,
+    UBX_KEY_MSGOUT_NMEA_VTG_UART1, UBX_KEY_MSGOUT_NMEA_GGA_UART1, UBX_KEY_MSGOUT_NMEA_GSA_UART1,
+    UBX_KEY_MSGOUT_NMEA_GSV_UART1, UBX_KEY_MSGOUT_NMEA_GLL_UART1,
+};
+
+static int failures;
+static int64_t now_us;
+static fake_rx_t rx;
+static gnss_framer_t framer;
+static ubx_engine_t eng;
+static ubx_txn_t txn;
+static ubx_valset_t vs;
+static uint8_t frame_buf[UBX_VALSET_MAX_PAYLOAD + UBX_FRAME_OVERHEAD];
+
+static void expect(const char *what, long got, long want) {
+    if (got == want) return;
+    printf("FAIL %s: got %ld, want %ld\n", what, got, want);
+    failures++;
+}
+
+static int db_get(const fake_rx_t *r, uint32_t key, uint64_t *value) {
+    for (int i = 0; i < r->n; i++) {
+        if (r->db[i].key != key) continue;
+        *value = r->db[i].value;
+        return 1;
+    }
+    return 0;
+}
+
+static void db_set(fake_rx_t *r, uint32_t key, uint64_t value) {
+    for (int i = 0; i < r->n; i++) {
+        if (r->db[i].key == key) {
+            r->db[i].value = value;
+            return;
+        }
+    }
+    r->db[r->n++] = (cfg_item_t){ key, value };
+}
+
+// ---- Fake receiver ----
+
+static int key_known(uint32_t key) {
+    for (size_t i = 0; i < sizeof(known_keys) / sizeof(known_keys[0]); i++) {
+        if (known_keys[i] == key) return 1;
+    }
+    return 0;
+}
+
+// Checks a VALSET payload and applies it if every item is acceptable
+static int rx_valset(fake_rx_t *r, const uint8_t *p, size_t len) {
+    static const uint8_t size_bytes[8] = { 0, 1, 1, 2, 4, 8, 0, 0 };
+    if (len < 4 || p[0] != 0 || p[1] == 0 || (p[1] & ~0x07) || p[2] || p[3]) return 0;
+
+    cfg_item_t items[UBX_VALSET_MAX_KEYS];
+    int n = 0;
+    for (size_t i = 4; i < len; n++) {
+        if (len - i < 4 || n == UBX_VALSET_MAX_KEYS) return 0;
+        uint32_t key = (uint32_t)p[i] | (uint32_t)p[i + 1] << 8 | (uint32_t)p[i + 2] << 16 | (uint32_t)p[i + 3] << 24;
+        uint8_t size = size_bytes[(key >> 28) & 7];
+        if (size == 0 || len - i - 4 < size || !key_known(key) || key == r->reject_key) return 0;
+        uint64_t value = 0;
+        for (int b = 0; b < size; b++) value |= (uint64_t)p[i + 4 + b] << (8 * b);
+        items[n] = (cfg_item_t){ key, value };
+        i += 4 + size;
+    }
+    for (int i = 0; i < n; i++) db_set(r, items[i].key, items[i].value);
+    return 1;
+}
+
+static void rx_receive(fake_rx_t *r, const uint8_t *frame, size_t len) {
+    uint8_t check[sizeof(frame_buf)];
+    size_t payload_len = len - UBX_FRAME_OVERHEAD;
+    if (len < UBX_FRAME_OVERHEAD || frame[0] != UBX_SYNC_CHAR_1 || frame[1] != UBX_SYNC_CHAR_2 ||
+        (size_t)(frame[4] | frame[5] << 8) != payload_len ||
+        ubx_build_frame(frame[2], frame[3], frame + UBX_HEADER_LEN, payload_len, check, sizeof(check)) != len ||
+        memcmp(check, frame, len)) {
+        return;     // The receiver ignores what it cannot frame
+    }
+    if (frame[2] != UBX_CLASS_CFG || frame[3] != UBX_ID_CFG_VALSET) return;
+
+    r->valsets++;
+    int ok = rx_valset(r, frame + UBX_HEADER_LEN, payload_len);
+    const uint8_t acked[2] = { UBX_CLASS_CFG, UBX_ID_CFG_VALSET };
+    if (r->drop_replies > 0) {
+        r->drop_replies--;
+        return;
+    }
+    r->reply_len = ubx_build_frame(UBX_CLASS_ACK, ok ? UBX_ID_ACK_ACK : UBX_ID_ACK_NAK, acked, 2, r->reply,
+                                   sizeof(r->reply));
+    r->reply_at = now_us + REPLY_DELAY_US;
+}
+
+// ---- Host side, as gnss.c ----
+
+static void on_frame(void *ctx, gnss_frame_type_t type, const uint8_t *frame, size_t len) {
+    (void)ctx;
+    if (type != GNSS_FRAME_UBX) return;
+    ubx_engine_dispatch(&eng, frame[2], frame[3], frame + UBX_HEADER_LEN, (uint16_t)(len - UBX_FRAME_OVERHEAD));
+    if (eng.ack.pending) {
+        ubx_txn_on_ack(&txn, &eng.ack, now_us);
+        eng.ack.pending = false;
+    }
+}
+
+static void send_valset(void) {
+    size_t n = ubx_build_frame(UBX_CLASS_CFG, UBX_ID_CFG_VALSET, vs.payload, vs.len, frame_buf, sizeof(frame_buf));
+    rx_receive(&rx, frame_buf, n);
+}
+
+// Sends the profile and runs the clock until the transaction ends
+static ubx_txn_state_t apply(const gnss_profile_t *profile) {
+    rx.valsets = 0;
+    rx.reply_len = 0;
+    if (!ubx_cfg_build_profile(&vs, profile, UBX_CFG_LAYER_RAM)) return UBX_TXN_IDLE;
+    send_valset();
+    ubx_txn_start(&txn, UBX_CLASS_CFG, UBX_ID_CFG_VALSET, now_us, CFG_ACK_TIMEOUT_US, CFG_MAX_ATTEMPTS);
+    while (ubx_txn_busy(&txn)) {
+        now_us += STEP_US;
+        if (rx.reply_len && now_us >= rx.reply_at) {
+            gnss_framer_feed(&framer, rx.reply, rx.reply_len);
+            rx.reply_len = 0;
+        }
+        if (ubx_txn_poll(&txn, now_us)) send_valset();
+    }
+    return (ubx_txn_state_t)txn.state;
+}
+
+// The receiver's settings match the profile
+static void check_db(const gnss_profile_t *p) {
+    static const struct {
+        uint32_t key;
+        uint8_t mask;
+    } signals[] = {
+        { UBX_KEY_SIGNAL_GPS_ENA, GNSS_CONST_GPS },      { UBX_KEY_SIGNAL_GLO_ENA, GNSS_CONST_GLONASS },
+        { UBX_KEY_SIGNAL_GAL_ENA, GNSS_CONST_GALILEO },  { UBX_KEY_SIGNAL_BDS_ENA, GNSS_CONST_BEIDOU },
+        { UBX_KEY_SIGNAL_QZSS_ENA, GNSS_CONST_QZSS },    { UBX_KEY_SIGNAL_SBAS_ENA, GNSS_CONST_SBAS },
+    };
+    uint64_t v = 0;
+    int nmea = !p->ubx_only;
+    expect("measurement period", db_get(&rx, UBX_KEY_RATE_MEAS, &v) ? (long)v : -1, 1000 / p->rate_hz);
+    expect("dynamic model", db_get(&rx, UBX_KEY_NAVSPG_DYNMODEL, &v) ? (long)v : -1, p->dyn_model);
+    for (size_t i = 0; i < sizeof(signals) / sizeof(signals[0]); i++) {
+        expect("signal enable", db_get(&rx, signals[i].key, &v) ? (long)v : -1, !!(p->constellations & signals[i].mask));
+    }
+    expect("NMEA protocol", db_get(&rx, UBX_KEY_UART1OUTPROT_NMEA, &v) ? (long)v : -1, nmea);
+    expect("NAV-PVT every epoch", db_get(&rx, UBX_KEY_MSGOUT_NAV_PVT_UART1, &v) ? (long)v : -1, 1);
+    expect("NAV-EOE every epoch", db_get(&rx, UBX_KEY_MSGOUT_NAV_EOE_UART1, &v) ? (long)v : -1, 1);
+    expect("NAV-SAT at 1 Hz", db_get(&rx, UBX_KEY_MSGOUT_NAV_SAT_UART1, &v) ? (long)v : -1, p->rate_hz);
+    expect("GGA", db_get(&rx, UBX_KEY_MSGOUT_NMEA_GGA_UART1, &v) ? (long)v : -1, nmea);
+    expect("GSV at 1 Hz", db_get(&rx, UBX_KEY_MSGOUT_NMEA_GSV_UART1, &v) ? (long)v : -1, nmea ? p->rate_hz : 0);
+}
+
+static void check_builder(void) {
+    ubx_valset_init(&vs, UBX_CFG_LAYER_RAM);
+    expect("invalid key size", ubx_valset_add(&vs, 0x00210001u, 1), 0);
+    ubx_valset_init(&vs, UBX_CFG_LAYER_RAM);
+    for (int i = 0; i < UBX_VALSET_MAX_KEYS; i++) ubx_valset_add(&vs, UBX_KEY_RATE_NAV, 1);
+    expect("64 keys fit", vs.overflow, 0);
+    expect("65th key", ubx_valset_add(&vs, UBX_KEY_RATE_NAV, 1), 0);
+    gnss_profile_t bad = { .rate_hz = 30 };
+    expect("30 Hz profile", ubx_cfg_build_profile(&vs, &bad, UBX_CFG_LAYER_RAM), 0);
+}
+
+int main(void) {
+    static const uint8_t rates[] = { 1, 5, 10, 25 };
+    static const uint8_t models[] = { GNSS_DYN_PORTABLE, GNSS_DYN_AUTOMOTIVE, GNSS_DYN_BIKE };
+    static const uint8_t masks[] = {
+        GNSS_CONST_GPS,
+        GNSS_CONST_GPS | GNSS_CONST_GALILEO,
+        GNSS_CONST_GPS | GNSS_CONST_GLONASS | GNSS_CONST_GALILEO | GNSS_CONST_BEIDOU,
+        0x3f,
+    };
+
+    gnss_framer_init(&framer, on_frame, NULL);
+    ubx_engine_init(&eng);
+    check_builder();
+
+    // Every profile: one VALSET, applied in one round trip
+    int profiles = 0;
+    for (size_t r = 0; r < sizeof(rates); r++) {
+        for (size_t m = 0; m < sizeof(models); m++) {
+            for (size_t c = 0; c < sizeof(masks); c++) {
+                for (int u = 0; u < 2; u++) {
+                    gnss_profile_t p = { rates[r], models[m], masks[c], u };
+                    int64_t t0 = now_us;
+                    expect("profile acked", apply(&p), UBX_TXN_ACKED);
+                    expect("one VALSET", rx.valsets, 1);
+                    expect("round trip us", (long)(txn.done_us - t0), REPLY_DELAY_US);
+                    check_db(&p);
+                    profiles++;
+                }
+            }
+        }
+    }
+    printf("%d profiles: %u bytes of payload in one VALSET each, applied in one %d ms round trip\n", profiles,
+           vs.len, REPLY_DELAY_US / 1000);
+
+    gnss_profile_t p = { 25, GNSS_DYN_BIKE, GNSS_CONST_GPS | GNSS_CONST_GALILEO, 1 };
+
+    // The first ACK is lost: one retry after the timeout
+    rx.drop_replies = 1;
+    int64_t t0 = now_us;
+    expect("lost ACK: acked", apply(&p), UBX_TXN_ACKED);
+    expect("lost ACK: attempts", txn.attempts, 2);
+    expect("lost ACK: us to ACK", (long)(txn.done_us - t0), CFG_ACK_TIMEOUT_US + REPLY_DELAY_US);
+    printf("lost ACK: applied after %d attempts, %lld ms\n", txn.attempts, (long long)(txn.done_us - t0) / 1000);
+
+    // Receiver silent: gives up after the last attempt
+    rx.drop_replies = CFG_MAX_ATTEMPTS;
+    t0 = now_us;
+    expect("silent: timeout", apply(&p), UBX_TXN_TIMEOUT);
+    expect("silent: VALSETs", rx.valsets, CFG_MAX_ATTEMPTS);
+    expect("silent: us to give up", (long)(txn.done_us - t0), (long)CFG_MAX_ATTEMPTS * CFG_ACK_TIMEOUT_US);
+
+    // A key the firmware rejects: NAK, nothing applied, no retry
+    gnss_profile_t glonass = { 10, GNSS_DYN_AUTOMOTIVE, GNSS_CONST_GPS | GNSS_CONST_GLONASS, 0 };
+    uint64_t before = 0;
+    db_get(&rx, UBX_KEY_RATE_MEAS, &before);
+    rx.reject_key = UBX_KEY_SIGNAL_QZSS_ENA;
+    expect("rejected key: NAK", apply(&glonass), UBX_TXN_NAKED);
+    expect("rejected key: VALSETs", rx.valsets, 1);
+    uint64_t after = 0;
+    db_get(&rx, UBX_KEY_RATE_MEAS, &after);
+    expect("rejected key: all or nothing", (long)after, (long)before);
+    rx.reject_key = 0;
+
+    // ACKs for other messages do not close the transaction
+    ubx_txn_start(&txn, UBX_CLASS_CFG, UBX_ID_CFG_VALSET, now_us, CFG_ACK_TIMEOUT_US, CFG_MAX_ATTEMPTS);
+    ubx_ack_t other = { .pending = true, .ack = true, .cls = UBX_CLASS_CFG, .id = UBX_ID_CFG_RST };
+    expect("other ACK ignored", ubx_txn_on_ack(&txn, &other, now_us), 0);
+    expect("still waiting", ubx_txn_busy(&txn), 1);
+
+    printf("configuration checks: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}